@@ -0,0 +1,244 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef WEOS_COMMON_CONDITION_VARIABLE_ANY_HPP
+#define WEOS_COMMON_CONDITION_VARIABLE_ANY_HPP
+
+#ifndef WEOS_CONFIG_HPP
+    #error "Do not include this file directly."
+#endif // WEOS_CONFIG_HPP
+
+#include "waiter_queue.hpp"
+#include "../chrono.hpp"
+#include "../mutex.hpp"
+#include "../semaphore.hpp"
+
+
+WEOS_BEGIN_NAMESPACE
+
+namespace detail
+{
+#if defined(WEOS_WRAP_CXX11)
+typedef cv_status cv_status_type;
+#else
+typedef cv_status::cv_status cv_status_type;
+#endif
+} // namespace detail
+
+//! A condition variable which works with any lock.
+//! The condition_variable_any can be used with every type which provides
+//! lock() and unlock(). Like the condition_variable of the CMSIS backend,
+//! every waiting thread enqueues an object with a semaphore, which lives on
+//! its stack, in an intrusive list. Thus, no memory is allocated and the
+//! lock of the caller is released only once per wait.
+//! Unlike the condition_variable, the waiters may use different locks.
+//! Therefore, notify_all() signals every waiter itself instead of letting
+//! them wake each other after reacquiring their locks.
+class condition_variable_any
+{
+public:
+    //! Creates a condition variable.
+    condition_variable_any()
+    {
+    }
+
+    //! Destroys the condition variable.
+    //!
+    //! \note The condition variable must not be destroyed if a thread is
+    //! waiting on it.
+    ~condition_variable_any()
+    {
+        WEOS_ASSERT(m_waiters.empty());
+    }
+
+    //! Notifies a thread waiting on this condition variable.
+    //! Notifies one thread which is waiting on this condition variable.
+    void notify_one() WEOS_NOEXCEPT
+    {
+        lock_guard<mutex> locker(m_mutex);
+
+        // Do not access a waiter after sending a signal to it. It may
+        // have returned already.
+        detail::waiter_queue_hook* w = m_waiters.pop_front();
+        if (w)
+            static_cast<WaitingThread*>(w)->signal.post();
+    }
+
+    //! Notifies all threads waiting on this condition variable.
+    //! Notifies all threads which are waiting on this condition variable.
+    //! Every waiter is signalled directly. A waiter which blocks on its
+    //! lock does not hold back the waiters which use another lock.
+    void notify_all() WEOS_NOEXCEPT
+    {
+        lock_guard<mutex> locker(m_mutex);
+
+        while (detail::waiter_queue_hook* w = m_waiters.pop_front())
+            static_cast<WaitingThread*>(w)->signal.post();
+    }
+
+    //! Waits on this condition variable.
+    //! The given \p lock is released and the current thread is added to a
+    //! list of threads waiting for a notification. The calling thread is
+    //! blocked until a notification is sent via notify() or notify_all()
+    //! or a spurious wakeup occurs. The \p lock is reacquired when the
+    //! function exits.
+    template <typename LockT>
+    void wait(LockT& lock)
+    {
+        WaitingThread w;
+        enqueue(w);
+
+        {
+            // We can only release the lock when we are sure that a signal
+            // will reach our thread.
+            detail::lock_releaser<LockT> releaser(lock);
+            w.signal.wait();
+        }
+    }
+
+    //! Waits on this condition variable until a predicate is satisfied.
+    //! Waits until the predicate \p pred returns \p true. The predicate is
+    //! evaluated with the \p lock held.
+    template <typename LockT, typename PredicateT>
+    void wait(LockT& lock, PredicateT pred)
+    {
+        while (!pred())
+            wait(lock);
+    }
+
+    //! Waits on this condition variable with a timeout.
+    //! Releases the given \p lock and adds the calling thread to a list
+    //! of threads waiting for a notification. The thread is blocked until
+    //! a notification is sent, a spurious wakeup occurs or the timeout
+    //! period \p d expires. When the function returns, the \p lock is
+    //! reacquired no matter what has caused the wakeup.
+    template <typename LockT, typename RepT, typename PeriodT>
+    detail::cv_status_type wait_for(LockT& lock,
+                                    const chrono::duration<RepT, PeriodT>& d)
+    {
+        WaitingThread w;
+        enqueue(w);
+
+        {
+            detail::lock_releaser<LockT> releaser(lock);
+            // If we are still in the queue, nobody has notified us.
+            // Otherwise, the signal has been posted together with the
+            // removal from the queue.
+            if (!w.signal.try_wait_for(d) && maybeDequeue(w))
+                return cv_status::timeout;
+        }
+
+        return cv_status::no_timeout;
+    }
+
+    //! Waits on this condition variable until a predicate is satisfied or
+    //! a timeout occurs.
+    //! Waits until the predicate \p pred returns \p true or the timeout
+    //! period \p d expires. Returns the value of the predicate.
+    template <typename LockT, typename RepT, typename PeriodT,
+              typename PredicateT>
+    bool wait_for(LockT& lock, const chrono::duration<RepT, PeriodT>& d,
+                  PredicateT pred)
+    {
+        return wait_until(lock, chrono::steady_clock::now() + d, pred);
+    }
+
+    //! Waits on this condition variable until a point in time.
+    //! Releases the given \p lock and blocks the calling thread until a
+    //! notification is sent, a spurious wakeup occurs or the time point
+    //! \p t has been reached. The \p lock is reacquired before the
+    //! function returns.
+    template <typename LockT, typename ClockT, typename DurationT>
+    detail::cv_status_type wait_until(
+            LockT& lock, const chrono::time_point<ClockT, DurationT>& t)
+    {
+        if (wait_for(lock, t - ClockT::now()) == cv_status::no_timeout)
+            return cv_status::no_timeout;
+        // The clock may have been adjusted while we were waiting. An early
+        // return is reported as a spurious wakeup.
+        return ClockT::now() < t ? cv_status::no_timeout : cv_status::timeout;
+    }
+
+    //! Waits on this condition variable until a predicate is satisfied or
+    //! a point in time has been reached.
+    //! Waits until the predicate \p pred returns \p true or the time point
+    //! \p t has been reached. Returns the value of the predicate.
+    template <typename LockT, typename ClockT, typename DurationT,
+              typename PredicateT>
+    bool wait_until(LockT& lock,
+                    const chrono::time_point<ClockT, DurationT>& t,
+                    PredicateT pred)
+    {
+        while (!pred())
+        {
+            if (wait_until(lock, t) == cv_status::timeout)
+                return pred();
+        }
+        return true;
+    }
+
+private:
+    //! An object to wait on a signal.
+    struct WaitingThread : public detail::waiter_queue_hook
+    {
+        // A semaphore to send a signal to this waiting thread.
+        semaphore signal;
+    };
+
+    //! Adds the waiter \p w to the queue.
+    void enqueue(WaitingThread& w)
+    {
+        lock_guard<mutex> locker(m_mutex);
+        m_waiters.push_back(w);
+    }
+
+    //! Removes the waiter \p w from the queue unless it has been notified
+    //! already. Returns \p true if the waiter has been removed.
+    bool maybeDequeue(WaitingThread& w)
+    {
+        lock_guard<mutex> locker(m_mutex);
+        if (!w.queued)
+            return false;
+        m_waiters.remove(w);
+        return true;
+    }
+
+    //! A mutex to protect the list of waiters from concurrent modifications.
+    mutex m_mutex;
+    //! The threads waiting on this condition variable.
+    detail::waiter_queue m_waiters;
+
+
+    // ---- Hidden methods.
+    condition_variable_any(const condition_variable_any&);
+    condition_variable_any& operator= (const condition_variable_any&);
+};
+
+WEOS_END_NAMESPACE
+
+#endif // WEOS_COMMON_CONDITION_VARIABLE_ANY_HPP
@@ -36,6 +36,9 @@
 
 
 #include "system_error.hpp"
+#include "../utility.hpp"
+
+#include <algorithm> // for swap()
 
 // -----------------------------------------------------------------------------
 // C++11
@@ -66,10 +69,6 @@ WEOS_END_NAMESPACE
 // -----------------------------------------------------------------------------
 #elif defined(WEOS_USE_BOOST)
 
-#include "../utility.hpp"
-
-#include <algorithm> // for swap()
-
 WEOS_BEGIN_NAMESPACE
 
 struct defer_lock_t {};
@@ -380,4 +379,301 @@ WEOS_END_NAMESPACE
     #error "No mutexlocks.hpp available."
 #endif
 
+// -----------------------------------------------------------------------------
+// shared_lock
+// -----------------------------------------------------------------------------
+
+WEOS_BEGIN_NAMESPACE
+
+//! A shared lock for a reader-writer mutex.
+//! The shared_lock is the counterpart of the unique_lock for the shared
+//! ownership of a mutex. It locks the mutex with lock_shared() and unlocks
+//! it with unlock_shared().
+template <typename MutexT>
+class shared_lock
+{
+public:
+    typedef MutexT mutex_type;
+
+    //! Creates a lock which is not associated with a mutex.
+    shared_lock() WEOS_NOEXCEPT
+        : m_mutex(0),
+          m_locked(false)
+    {
+    }
+
+    //! Creates a shared lock with locking.
+    //! Creates a shared lock tied to the \p mutex and locks it shared.
+    explicit shared_lock(mutex_type& mutex)
+        : m_mutex(&mutex),
+          m_locked(true)
+    {
+        m_mutex->lock_shared();
+    }
+
+    //! Creates a shared lock without locking.
+    //! Creates a shared lock which will be tied to the given \p mutex but
+    //! does not lock this mutex.
+    shared_lock(mutex_type& mutex, defer_lock_t /*tag*/) WEOS_NOEXCEPT
+        : m_mutex(&mutex),
+          m_locked(false)
+    {
+    }
+
+    //! Creates a shared lock by trying to lock a mutex.
+    //! Creates a shared lock, which tries to lock the given \p mutex shared.
+    //! If locking has been successful can be queried by owns_lock.
+    shared_lock(mutex_type& mutex, try_to_lock_t /*tag*/)
+        : m_mutex(&mutex),
+          m_locked(m_mutex->try_lock_shared())
+    {
+    }
+
+    //! Creates a shared lock for a locked mutex.
+    //! Creates a shared lock for the given \p mutex. The constructor does
+    //! not lock the mutex but assumes that the caller has already locked
+    //! it shared.
+    shared_lock(mutex_type& mutex, adopt_lock_t /*tag*/)
+        : m_mutex(&mutex),
+          m_locked(true)
+    {
+    }
+
+    //! Creates a shared lock which tries to lock the \p mutex shared until
+    //! the \p timePoint.
+    template <typename ClockT, typename DurationT>
+    shared_lock(mutex_type& mutex,
+                const chrono::time_point<ClockT, DurationT>& timePoint)
+        : m_mutex(&mutex),
+          m_locked(m_mutex->try_lock_shared_until(timePoint))
+    {
+    }
+
+    //! Creates a shared lock which tries to lock the \p mutex shared within
+    //! the given \p duration.
+    template <typename RepT, typename PeriodT>
+    shared_lock(mutex_type& mutex,
+                const chrono::duration<RepT, PeriodT>& duration)
+        : m_mutex(&mutex),
+          m_locked(m_mutex->try_lock_shared_for(duration))
+    {
+    }
+
+    //! Move construction.
+    //!
+    //! Creates a shared lock by moving from the \p other lock.
+    shared_lock(WEOS_RV_REF(shared_lock) other) WEOS_NOEXCEPT
+        : m_mutex(other.m_mutex),
+          m_locked(other.m_locked)
+    {
+        other.m_mutex = 0;
+        other.m_locked = false;
+    }
+
+    //! Destroys the shared lock.
+    //! If the lock has an associated mutex and has locked this mutex, the
+    //! mutex is unlocked.
+    ~shared_lock()
+    {
+        if (m_locked)
+            m_mutex->unlock_shared();
+    }
+
+    //! Move assignment.
+    //!
+    //! Moves the \p other lock to this lock. If this lock owns a mutex, it
+    //! will be released.
+    shared_lock& operator= (WEOS_RV_REF(shared_lock) other) WEOS_NOEXCEPT
+    {
+        if (m_locked)
+            m_mutex->unlock_shared();
+
+        m_mutex = other.m_mutex;
+        m_locked = other.m_locked;
+
+        other.m_mutex = 0;
+        other.m_locked = false;
+
+        return *this;
+    }
+
+    //! Locks the associated mutex shared.
+    void lock()
+    {
+        if (m_mutex == 0)
+            WEOS_THROW_SYSTEM_ERROR(errc::operation_not_permitted,
+                                    "shared_lock::lock: no mutex");
+        if (m_locked)
+            WEOS_THROW_SYSTEM_ERROR(errc::resource_deadlock_would_occur,
+                                    "shared_lock::lock: already locked");
+
+        m_mutex->lock_shared();
+        m_locked = true;
+    }
+
+    //! Returns a pointer to the associated mutex.
+    //! Returns a pointer to the mutex to which this lock is tied. This may
+    //! be a null-pointer, if no mutex has been supplied so far.
+    mutex_type* mutex() const WEOS_NOEXCEPT
+    {
+        return m_mutex;
+    }
+
+    //! Checks if this lock owns a locked mutex.
+    //! Returns \p true, if a mutex is tied to this lock and the lock has
+    //! shared ownership of it.
+    bool owns_lock() const WEOS_NOEXCEPT
+    {
+        return m_locked;
+    }
+
+    //! Releases the mutex without unlocking.
+    //! Breaks the association of this lock and its mutex (which is returned
+    //! by this function). The lock won't interact with the mutex any longer.
+    //! Instead the responsibility is transfered to the caller.
+    mutex_type* release() WEOS_NOEXCEPT
+    {
+        mutex_type* m = m_mutex;
+        m_mutex = 0;
+        m_locked = false;
+        return m;
+    }
+
+    //! Swaps two locks.
+    //! Swaps this lock with the \p other lock.
+    void swap(shared_lock& other) WEOS_NOEXCEPT
+    {
+        using std::swap;
+        swap(m_mutex, other.m_mutex);
+        swap(m_locked, other.m_locked);
+    }
+
+    //! Tries to lock the associated mutex shared.
+    //!
+    //! Tries to lock the associated mutex shared and returns \p true if it
+    //! could be locked and \p false otherwise.
+    bool try_lock()
+    {
+        if (m_mutex == 0)
+            WEOS_THROW_SYSTEM_ERROR(errc::operation_not_permitted,
+                                    "shared_lock::try_lock: no mutex");
+        if (m_locked)
+            WEOS_THROW_SYSTEM_ERROR(errc::resource_deadlock_would_occur,
+                                    "shared_lock::try_lock: already locked");
+
+        m_locked = m_mutex->try_lock_shared();
+        return m_locked;
+    }
+
+    //! Tries to lock the associated mutex shared within a certain timeout.
+    //!
+    //! Tries to lock the associated mutex shared within the given
+    //! \p duration. The method returns \p true, if the mutex could be locked.
+    template <typename RepT, typename PeriodT>
+    bool try_lock_for(const chrono::duration<RepT, PeriodT>& duration)
+    {
+        if (m_mutex == 0)
+            WEOS_THROW_SYSTEM_ERROR(errc::operation_not_permitted,
+                                    "shared_lock::try_lock_for: no mutex");
+        if (m_locked)
+            WEOS_THROW_SYSTEM_ERROR(errc::resource_deadlock_would_occur,
+                                    "shared_lock::try_lock_for: already locked");
+
+        m_locked = m_mutex->try_lock_shared_for(duration);
+        return m_locked;
+    }
+
+    //! Tries to lock the associated mutex shared before a certain time point.
+    //!
+    //! Tries to lock the associated mutex shared up to the given
+    //! \p timePoint. The method returns \p true, if the mutex could be
+    //! locked.
+    template <typename ClockT, typename DurationT>
+    bool try_lock_until(const chrono::time_point<ClockT, DurationT>& timePoint)
+    {
+        if (m_mutex == 0)
+            WEOS_THROW_SYSTEM_ERROR(errc::operation_not_permitted,
+                                    "shared_lock::try_lock_until: no mutex");
+        if (m_locked)
+            WEOS_THROW_SYSTEM_ERROR(errc::resource_deadlock_would_occur,
+                                    "shared_lock::try_lock_until: already locked");
+
+        m_locked = m_mutex->try_lock_shared_until(timePoint);
+        return m_locked;
+    }
+
+    //! Unlocks the associated mutex.
+    void unlock()
+    {
+        if (!m_locked)
+            WEOS_THROW_SYSTEM_ERROR(errc::operation_not_permitted,
+                                    "shared_lock::unlock: not locked");
+
+        m_mutex->unlock_shared();
+        m_locked = false;
+    }
+
+    //! Checks if the lock ows the mutex.
+    //!
+    //! Checks if this lock owns the mutex. This is equivalent to calling
+    //! owns_lock().
+    /*explicit*/ operator bool() const WEOS_NOEXCEPT
+    {
+        return m_locked;
+    }
+
+private:
+    //! A pointer to the associated mutex.
+    mutex_type* m_mutex;
+    //! A flag indicating if the mutex has been locked.
+    bool m_locked;
+
+
+    WEOS_MOVABLE_BUT_NOT_COPYABLE(shared_lock)
+};
+
+//! Swap two shared locks \p x and \p y.
+template <typename MutexT>
+inline
+void swap(shared_lock<MutexT>& x, shared_lock<MutexT>& y) WEOS_NOEXCEPT
+{
+    x.swap(y);
+}
+
+// -----------------------------------------------------------------------------
+// lock_releaser
+// -----------------------------------------------------------------------------
+
+namespace detail
+{
+//! A helper class for temporarily releasing a lock.
+//! The lock_releaser is a helper class to release a lock until the object
+//! goes out of scope. The constructor calls unlock() and the destructor
+//! calls lock(). It is somehow the dual to the lock_guard which calls lock()
+//! in the constructor and unlock() in the destructor.
+template <typename LockT>
+class lock_releaser
+{
+public:
+    typedef LockT lock_type;
+
+    explicit lock_releaser(lock_type& lock)
+        : m_lock(lock)
+    {
+        m_lock.unlock();
+    }
+
+    ~lock_releaser()
+    {
+        m_lock.lock();
+    }
+
+private:
+    lock_type& m_lock;
+};
+
+} // namespace detail
+
+WEOS_END_NAMESPACE
+
 #endif // WEOS_COMMON_MUTEXLOCKS_HPP
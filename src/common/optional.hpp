@@ -0,0 +1,244 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef WEOS_COMMON_OPTIONAL_HPP
+#define WEOS_COMMON_OPTIONAL_HPP
+
+
+#ifndef WEOS_CONFIG_HPP
+    #error "Do not include this file directly."
+#endif // WEOS_CONFIG_HPP
+
+
+#include "../type_traits.hpp"
+#include "../utility.hpp"
+
+#include <new>
+
+
+WEOS_BEGIN_NAMESPACE
+
+//! An optional value.
+//! An optional<T> either holds a value of type \p TType or is empty. The
+//! value is stored inside the object, i.e. no memory is allocated from the
+//! heap. In contrast to a std::pair<bool, T>, an empty optional does not
+//! need to construct a T, so T need not be default-constructible.
+template <typename TType>
+class optional
+{
+public:
+    //! The type of the contained value.
+    typedef TType value_type;
+
+    //! Creates an empty optional.
+    optional()
+        : m_engaged(false)
+    {
+    }
+
+    //! Creates an optional which holds a copy of \p value.
+    optional(const value_type& value)
+        : m_engaged(false)
+    {
+        emplace(value);
+    }
+
+    //! Copy-constructs an optional.
+    optional(const optional& other)
+        : m_engaged(false)
+    {
+        if (other.m_engaged)
+            emplace(*other);
+    }
+
+#if defined(WEOS_USE_CXX11)
+    //! Creates an optional which holds the moved \p value.
+    optional(value_type&& value)
+        : m_engaged(false)
+    {
+        emplace(std::move(value));
+    }
+
+    //! Move-constructs an optional. The \p other optional still holds a
+    //! (moved-from) value afterwards.
+    optional(optional&& other)
+        : m_engaged(false)
+    {
+        if (other.m_engaged)
+            emplace(std::move(*other));
+    }
+#endif // WEOS_USE_CXX11
+
+    //! Destroys the optional and its value.
+    ~optional()
+    {
+        reset();
+    }
+
+    //! Copy-assigns an optional.
+    optional& operator= (const optional& other)
+    {
+        if (this != &other)
+        {
+            reset();
+            if (other.m_engaged)
+                emplace(*other);
+        }
+        return *this;
+    }
+
+#if defined(WEOS_USE_CXX11)
+    //! Move-assigns an optional.
+    optional& operator= (optional&& other)
+    {
+        if (this != &other)
+        {
+            reset();
+            if (other.m_engaged)
+                emplace(std::move(*other));
+        }
+        return *this;
+    }
+#endif // WEOS_USE_CXX11
+
+    //! Constructs a new value in place.
+    //! Destroys the current value, if there is one, and constructs a new
+    //! one from the given arguments.
+    void emplace()
+    {
+        reset();
+        ::new (address()) value_type();
+        m_engaged = true;
+    }
+
+    template <class T1>
+    void emplace(WEOS_FWD_REF(T1) x1)
+    {
+        reset();
+        ::new (address()) value_type(weos::forward<T1>(x1));
+        m_engaged = true;
+    }
+
+    template <class T1, class T2>
+    void emplace(WEOS_FWD_REF(T1) x1, WEOS_FWD_REF(T2) x2)
+    {
+        reset();
+        ::new (address()) value_type(weos::forward<T1>(x1),
+                                     weos::forward<T2>(x2));
+        m_engaged = true;
+    }
+
+    //! Destroys the value.
+    //! Destroys the value, if there is one, and leaves the optional empty.
+    void reset()
+    {
+        if (m_engaged)
+        {
+            static_cast<value_type*>(address())->~value_type();
+            m_engaged = false;
+        }
+    }
+
+    //! Checks if the optional holds a value.
+    bool has_value() const WEOS_NOEXCEPT
+    {
+        return m_engaged;
+    }
+
+#if defined(WEOS_USE_CXX11)
+    //! Checks if the optional holds a value.
+    //! Returns \p true, if the optional holds a value.
+    explicit operator bool() const WEOS_NOEXCEPT
+    {
+        return m_engaged;
+    }
+#else
+private:
+    //! A pointer to a member, which converts to bool but not to an integer.
+    typedef bool optional::*safe_bool_type;
+
+public:
+    //! Checks if the optional holds a value.
+    //! Returns a value which converts to \p true, if the optional holds a
+    //! value. Unlike a conversion to bool, this cannot be used in
+    //! arithmetic or compared to an integer.
+    operator safe_bool_type() const WEOS_NOEXCEPT
+    {
+        return m_engaged ? &optional::m_engaged : 0;
+    }
+#endif // WEOS_USE_CXX11
+
+    //! Returns a reference to the value.
+    value_type& operator*()
+    {
+        WEOS_ASSERT(m_engaged);
+        return *static_cast<value_type*>(address());
+    }
+
+    //! Returns a reference to the value.
+    const value_type& operator*() const
+    {
+        WEOS_ASSERT(m_engaged);
+        return *static_cast<const value_type*>(address());
+    }
+
+    //! Accesses the value.
+    value_type* operator->()
+    {
+        WEOS_ASSERT(m_engaged);
+        return static_cast<value_type*>(address());
+    }
+
+    //! Accesses the value.
+    const value_type* operator->() const
+    {
+        WEOS_ASSERT(m_engaged);
+        return static_cast<const value_type*>(address());
+    }
+
+private:
+    //! The storage for the value.
+    typename aligned_storage<sizeof(value_type),
+                             alignment_of<value_type>::value>::type m_storage;
+    //! Set if the storage holds a value.
+    bool m_engaged;
+
+    void* address()
+    {
+        return &m_storage;
+    }
+
+    const void* address() const
+    {
+        return &m_storage;
+    }
+};
+
+WEOS_END_NAMESPACE
+
+#endif // WEOS_COMMON_OPTIONAL_HPP
@@ -0,0 +1,251 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef WEOS_COMMON_TASKSCHEDULER_HPP
+#define WEOS_COMMON_TASKSCHEDULER_HPP
+
+#ifndef WEOS_CONFIG_HPP
+    #error "Do not include this file directly."
+#endif // WEOS_CONFIG_HPP
+
+#include "../atomic.hpp"
+#include "../functional.hpp"
+#include "../mutex.hpp"
+#include "../thread.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+
+WEOS_BEGIN_NAMESPACE
+
+namespace detail
+{
+
+//! Returns the index of the least significant bit which is set in \p x.
+//! The value \p x must not be zero.
+inline
+unsigned lowest_set_bit(std::uint32_t x)
+{
+#if defined(__CC_ARM)
+    return __clz(__rbit(x));
+#elif defined(__GNUC__)
+    return __builtin_ctz(x);
+#else
+    unsigned index = 0;
+    while ((x & 1) == 0)
+    {
+        x >>= 1;
+        ++index;
+    }
+    return index;
+#endif
+}
+
+} // namespace detail
+
+//! A scheduler which runs tasks to completion on a single thread.
+//! The task_scheduler owns one thread on which it executes up to
+//! \p TNumTasks tasks. A task is a function which must not block. It is
+//! executed whenever it has been notified and runs to completion before
+//! the next task is started. Compared to a thread per task, a task needs
+//! neither a stack nor a thread control block.
+//!
+//! The priority of a task is also its id. Priority 0 is the highest one.
+//! This is the reverse of the thread priorities and of the levels of the
+//! priority_message_queue, where larger numbers are more urgent.
+//! The scheduler keeps the ready tasks in a two-level bitmap, so it finds
+//! the ready task with the highest priority in constant time. Notifying a
+//! task only sets two bits and does not lock a mutex. When no task is
+//! ready, the scheduler thread waits for a thread signal.
+//!
+//! As the scheduler thread consumes all of its signals, the tasks must not
+//! use thread signals themselves, e.g. wait for a signal or expect one to
+//! be delivered to them.
+template <std::size_t TNumTasks>
+class task_scheduler
+{
+    static_assert(TNumTasks > 0 && TNumTasks <= 32 * 32,
+                  "The number of tasks must be in the range [1, 1024].");
+
+public:
+    //! The type of the tasks.
+    typedef function<void()> task_type;
+
+    //! Creates a task scheduler and starts its thread.
+    task_scheduler()
+        : m_summary(0),
+          m_sleeping(false),
+          m_stopping(false)
+    {
+        for (std::size_t idx = 0; idx < numGroups; ++idx)
+            m_ready[idx].store(0, memory_order_relaxed);
+        for (std::size_t idx = 0; idx < TNumTasks; ++idx)
+            m_created[idx].store(false, memory_order_relaxed);
+        m_thread = thread(&task_scheduler::threadMain, this);
+    }
+
+    //! Destroys the task scheduler.
+    //! Waits until the current task has finished and stops the scheduler
+    //! thread. Ready tasks are not executed anymore. No task must be
+    //! notified during or after the destruction.
+    ~task_scheduler()
+    {
+        m_stopping.store(true);
+        m_thread.set_signals(1);
+        m_thread.join();
+    }
+
+    //! Returns the maximum number of tasks.
+    static std::size_t capacity()
+    {
+        return TNumTasks;
+    }
+
+    //! Creates a task.
+    //! Registers the \p task with the given \p priority, which is also its
+    //! id. Returns \p false if the priority is used by another task. The
+    //! task does not run until it is notified.
+    bool create_task(std::size_t priority, const task_type& task)
+    {
+        WEOS_ASSERT(priority < TNumTasks);
+        lock_guard<mutex> locker(m_mutex);
+        if (m_created[priority].load(memory_order_relaxed))
+            return false;
+        m_tasks[priority] = task;
+        // Publish the task to notify(), which does not lock the mutex.
+        m_created[priority].store(true, memory_order_release);
+        return true;
+    }
+
+    //! Notifies a task.
+    //! Marks the task with the given \p priority as ready. The task is
+    //! executed once, even if it is notified several times before it runs.
+    //! A task which is notified while it is running is executed again.
+    //! This function does not block and may be called from any thread,
+    //! including the tasks of this scheduler. The task must have been
+    //! created before.
+    void notify(std::size_t priority)
+    {
+        WEOS_ASSERT(priority < TNumTasks);
+        WEOS_ASSERT(m_created[priority].load(memory_order_acquire));
+        std::size_t group = priority / 32;
+        m_ready[group].fetch_or(1u << (priority % 32));
+        // The sequentially consistent update pairs with the store to
+        // m_sleeping in run(). Either the scheduler sees the task or we see
+        // that the scheduler sleeps.
+        m_summary.fetch_or(1u << group);
+        if (m_sleeping.load())
+            m_thread.set_signals(1);
+    }
+
+private:
+    //! The number of 32-bit words of the ready bitmap.
+    static const std::size_t numGroups = (TNumTasks + 31) / 32;
+
+    //! The tasks indexed by their priority.
+    task_type m_tasks[TNumTasks];
+    //! A flag for every priority which is used. It is written under the
+    //! mutex but read by notify() without it.
+    atomic_bool m_created[TNumTasks];
+    //! Protects the creation of tasks.
+    mutex m_mutex;
+
+    //! A bit for every task which is ready.
+    atomic_uint m_ready[numGroups];
+    //! A bit for every word of m_ready which has a ready task.
+    atomic_uint m_summary;
+    //! Set while the scheduler thread is about to wait or is waiting for
+    //! a signal.
+    atomic_bool m_sleeping;
+    //! Set when the scheduler is destroyed.
+    atomic_bool m_stopping;
+    //! The scheduler thread.
+    thread m_thread;
+
+    //! The entry point of the scheduler thread.
+    static void threadMain(task_scheduler* scheduler)
+    {
+        scheduler->run();
+    }
+
+    //! Executes ready tasks until the scheduler is destroyed.
+    void run()
+    {
+        while (!m_stopping.load())
+        {
+            int priority = takeReadyTask();
+            if (priority >= 0)
+            {
+                m_tasks[priority]();
+                continue;
+            }
+
+            m_sleeping.store(true);
+            if (m_summary.load() == 0 && !m_stopping.load())
+                this_thread::wait_for_any_signal();
+            m_sleeping.store(false);
+        }
+    }
+
+    //! Clears the ready flag of the task with the highest priority and
+    //! returns its priority. Returns -1 if no task is ready.
+    int takeReadyTask()
+    {
+        while (true)
+        {
+            unsigned summary = m_summary.load();
+            if (summary == 0)
+                return -1;
+
+            unsigned group = detail::lowest_set_bit(summary);
+            unsigned ready = m_ready[group].load();
+            if (ready == 0)
+            {
+                // The group is empty. Clear its bit in the summary unless
+                // a task has become ready in the meantime.
+                m_summary.fetch_and(~(1u << group));
+                if (m_ready[group].load() != 0)
+                    m_summary.fetch_or(1u << group);
+                continue;
+            }
+
+            unsigned bit = detail::lowest_set_bit(ready);
+            m_ready[group].fetch_and(~(1u << bit));
+            return int(group * 32 + bit);
+        }
+    }
+
+    // ---- Hidden methods.
+    task_scheduler(const task_scheduler&);
+    task_scheduler& operator= (const task_scheduler&);
+};
+
+WEOS_END_NAMESPACE
+
+#endif // WEOS_COMMON_TASKSCHEDULER_HPP
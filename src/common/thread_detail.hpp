@@ -34,6 +34,9 @@
 #include "../atomic.hpp"
 #include "../utility.hpp"
 
+#include <cstddef>
+#include <cstdint>
+
 
 WEOS_BEGIN_NAMESPACE
 
@@ -61,6 +64,15 @@ struct SharedThreadData
     //! thrown if the pool is empty.
     static SharedThreadData* allocate();
 
+    //! Fills the \p stack of \p size bytes with a pattern and remembers it
+    //! for stackUsage().
+    void paintStack(void* stack, std::size_t size);
+
+    //! Returns the number of bytes of the painted stack which have been
+    //! used so far. The stack is expected to grow downwards, so the unused
+    //! part is the painted region at its lower end.
+    std::size_t stackUsage() const;
+
 
 
     //! The bound function which will be called in the new thread.
@@ -82,6 +94,17 @@ struct SharedThreadData
     //! The native thread id.
     native_thread_traits::thread_id_type m_threadId;
 
+    //! The stack which has been painted or a null-pointer.
+    std::uint32_t* m_paintedStack;
+
+    //! The number of words in the painted stack.
+    std::size_t m_paintedStackSize;
+
+    //! The pattern with which a stack is painted. This is the pattern with
+    //! which Keil's RTX fills a stack if OS_STKINIT is set, so the kernel
+    //! does not destroy the painting.
+    static const std::uint32_t stackPaint = 0xCCCCCCCCu;
+
 private:
     //! Creates the shared thread data.
     SharedThreadData();
@@ -90,6 +113,34 @@ private:
     const SharedThreadData& operator= (const SharedThreadData&);
 };
 
+inline
+void SharedThreadData::paintStack(void* stack, std::size_t size)
+{
+    // Only whole, aligned words are painted.
+    std::uintptr_t begin = reinterpret_cast<std::uintptr_t>(stack);
+    std::uintptr_t end = begin + size;
+    begin = (begin + sizeof(std::uint32_t) - 1) & ~(sizeof(std::uint32_t) - 1);
+    end &= ~(sizeof(std::uint32_t) - 1);
+
+    m_paintedStack = reinterpret_cast<std::uint32_t*>(begin);
+    m_paintedStackSize = begin < end ? (end - begin) / sizeof(std::uint32_t)
+                                     : 0;
+    for (std::size_t idx = 0; idx < m_paintedStackSize; ++idx)
+        m_paintedStack[idx] = stackPaint;
+}
+
+inline
+std::size_t SharedThreadData::stackUsage() const
+{
+    // Reading the stack of a running thread is racy. Volatile accesses make
+    // sure that every word is really read from memory.
+    const volatile std::uint32_t* word = m_paintedStack;
+    std::size_t numUnused = 0;
+    while (numUnused < m_paintedStackSize && word[numUnused] == stackPaint)
+        ++numUnused;
+    return (m_paintedStackSize - numUnused) * sizeof(std::uint32_t);
+}
+
 class SharedThreadDataPointer
 {
 public:
@@ -492,6 +543,27 @@ public:
     //! Sets the signals which are specified by the \p flags.
     void set_signals(signal_set flags);
 
+    // -------------------------------------------------------------------------
+    // Stack usage
+    // -------------------------------------------------------------------------
+
+    //! Returns the stack usage.
+    //! Returns the maximum number of bytes of its stack which the thread
+    //! has used so far. The thread must be joinable and must have been
+    //! created with a painted stack. Stack painting is only supported by
+    //! the CMSIS-RTOS backend (see attributes::setStackPainting()).
+    //!
+    //! The measurement relies on the pattern being overwritten. It can
+    //! underestimate the usage if the thread has written the pattern itself
+    //! or reserved stack space without writing to it.
+    std::size_t stack_usage() const
+    {
+        if (!m_data || !m_data->m_paintedStack)
+            WEOS_THROW_SYSTEM_ERROR(errc::operation_not_permitted,
+                                    "thread::stack_usage: no painted stack");
+        return m_data->stackUsage();
+    }
+
 protected:
     //! Invokes the function which is stored in the shared data in a new
     //! thread which is created with the attributes \p attrs.
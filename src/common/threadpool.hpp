@@ -0,0 +1,514 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef WEOS_COMMON_THREADPOOL_HPP
+#define WEOS_COMMON_THREADPOOL_HPP
+
+#ifndef WEOS_CONFIG_HPP
+    #error "Do not include this file directly."
+#endif // WEOS_CONFIG_HPP
+
+#include "../atomic.hpp"
+#include "../functional.hpp"
+#include "../mutex.hpp"
+#include "../semaphore.hpp"
+#include "../thread.hpp"
+
+#include <cstddef>
+
+
+WEOS_BEGIN_NAMESPACE
+
+namespace detail
+{
+
+//! A work-stealing deque of task indices.
+//! This is the deque of Chase and Lev with a fixed capacity. The owner
+//! pushes and takes indices at the bottom, other threads steal them from
+//! the top. The operations which order the bottom against the top are
+//! sequentially consistent, so no fences are needed.
+template <std::size_t TCapacity>
+class work_stealing_deque
+{
+public:
+    //! The value which is returned if no index could be taken.
+    static const int empty = -1;
+
+    work_stealing_deque()
+        : m_top(0),
+          m_bottom(0)
+    {
+        for (std::size_t idx = 0; idx < TCapacity; ++idx)
+            m_buffer[idx].store(empty, memory_order_relaxed);
+    }
+
+    //! Appends the \p index at the bottom. Must only be called by the owner
+    //! and the deque must not be full.
+    void push(int index)
+    {
+        unsigned b = m_bottom.load(memory_order_relaxed);
+        WEOS_ASSERT(b - m_top.load(memory_order_relaxed) < TCapacity);
+        m_buffer[b % TCapacity].store(index, memory_order_relaxed);
+        m_bottom.store(b + 1);
+    }
+
+    //! Removes an index from the bottom and returns it. Must only be called
+    //! by the owner. Returns \p empty if the deque is empty.
+    int take()
+    {
+        unsigned b = m_bottom.load(memory_order_relaxed) - 1;
+        m_bottom.store(b);
+        unsigned t = m_top.load();
+        if (int(b - t) < 0)
+        {
+            // The deque is empty.
+            m_bottom.store(b + 1, memory_order_relaxed);
+            return empty;
+        }
+
+        int index = m_buffer[b % TCapacity].load(memory_order_relaxed);
+        if (b == t)
+        {
+            // This is the last index. Race against the thieves for it.
+            if (!m_top.compare_exchange_strong(t, t + 1))
+                index = empty;
+            m_bottom.store(b + 1, memory_order_relaxed);
+        }
+        return index;
+    }
+
+    //! Removes an index from the top and returns it. May be called by any
+    //! thread. Returns \p empty if the deque is empty or if another thread
+    //! has taken the index concurrently.
+    int steal()
+    {
+        unsigned t = m_top.load();
+        unsigned b = m_bottom.load();
+        if (int(b - t) <= 0)
+            return empty;
+
+        int index = m_buffer[t % TCapacity].load(memory_order_relaxed);
+        if (!m_top.compare_exchange_strong(t, t + 1))
+            return empty;
+        return index;
+    }
+
+    //! Returns \p true if the deque seems to be empty.
+    bool seems_empty() const
+    {
+        unsigned t = m_top.load();
+        unsigned b = m_bottom.load();
+        return int(b - t) <= 0;
+    }
+
+private:
+    //! The index of the next element to steal.
+    atomic_uint m_top;
+    //! The index one past the last element.
+    atomic_uint m_bottom;
+    //! The ring buffer of task indices.
+    atomic_int m_buffer[TCapacity];
+
+    // ---- Hidden methods.
+    work_stealing_deque(const work_stealing_deque&);
+    work_stealing_deque& operator= (const work_stealing_deque&);
+};
+
+template <std::size_t TCapacity>
+const int work_stealing_deque<TCapacity>::empty;
+
+} // namespace detail
+
+//! A pool of worker threads which execute tasks.
+//! The pool has \p TNumWorkers threads and can hold up to \p TCapacity tasks,
+//! which are stored in the pool itself. The pool's own bookkeeping does not
+//! allocate after construction. However, a task is copied into a
+//! function<void()>, which may allocate memory if the callable does not fit
+//! into its internal buffer (e.g. std::function in the C++11 backend).
+//!
+//! Every worker owns a work-stealing deque. A task which is submitted by a
+//! worker is pushed to the worker's own deque. Tasks from other threads go
+//! into a shared queue. A worker executes the tasks of its own deque, then
+//! the ones of the shared queue and finally steals from the other workers.
+//! A worker without work blocks on a semaphore.
+//!
+//! The destructor executes all pending tasks before it joins the workers.
+//!
+//! Tasks should not throw. If a task throws nevertheless, its slot is
+//! freed and the exception leaves the worker. This terminates the program
+//! unless the task has been executed by a worker which waits for a free
+//! slot in submit(). In this case, the exception propagates out of
+//! submit() and the task passed to submit() is not enqueued. Likewise, if
+//! copying the task into the pool throws, the exception propagates out of
+//! submit() or try_submit() and the slot is freed again.
+template <std::size_t TNumWorkers, std::size_t TCapacity>
+class thread_pool
+{
+    static_assert(TNumWorkers > 0, "The pool needs at least one worker.");
+#if defined(WEOS_MAX_NUM_CONCURRENT_THREADS)
+    static_assert(TNumWorkers <= WEOS_MAX_NUM_CONCURRENT_THREADS,
+                  "The pool has more workers than threads are available.");
+#endif // WEOS_MAX_NUM_CONCURRENT_THREADS
+    static_assert(TCapacity > 0, "The pool must be able to hold a task.");
+
+public:
+    //! The type of the tasks.
+    typedef function<void()> task_type;
+
+    //! Creates a thread pool and starts the workers.
+    thread_pool()
+        : m_numSleeping(0),
+          m_stopping(false),
+          m_freeSlots(TCapacity),
+          m_numFreeIndices(TCapacity),
+          m_injectedHead(0),
+          m_numInjected(0)
+    {
+        for (std::size_t idx = 0; idx < TCapacity; ++idx)
+            m_freeIndices[idx] = int(idx);
+
+        for (std::size_t idx = 0; idx < TNumWorkers; ++idx)
+        {
+            m_workers[idx] = thread(&thread_pool::workerMain, this, idx);
+            m_workerIds[idx] = m_workers[idx].get_id();
+        }
+        // The workers look up the ids of each other, so they must not run
+        // before all of them have been created.
+        for (std::size_t idx = 0; idx < TNumWorkers; ++idx)
+            m_startGate.post();
+    }
+
+    //! Destroys the thread pool.
+    //! Waits until all pending tasks have been executed and joins the
+    //! workers. The pool must not be destroyed by one of its workers.
+    ~thread_pool()
+    {
+        m_stopping.store(true);
+        for (std::size_t idx = 0; idx < TNumWorkers; ++idx)
+            m_wakeup.post();
+        for (std::size_t idx = 0; idx < TNumWorkers; ++idx)
+            m_workers[idx].join();
+    }
+
+    //! Returns the number of worker threads.
+    static std::size_t num_workers()
+    {
+        return TNumWorkers;
+    }
+
+    //! Returns the maximum number of tasks which can be pending.
+    static std::size_t capacity()
+    {
+        return TCapacity;
+    }
+
+    //! Submits a task.
+    //! Enqueues the \p task for execution. If the pool is full, the calling
+    //! thread is blocked until a task has finished. A worker of the pool is
+    //! not blocked but executes pending tasks instead because the tasks
+    //! might depend on it.
+    void submit(const task_type& task)
+    {
+        std::size_t self = currentWorker();
+        if (self < TNumWorkers)
+        {
+            while (!m_freeSlots.try_wait())
+            {
+                int index = findTask(self);
+                if (index != detail::work_stealing_deque<TCapacity>::empty)
+                    execute(index);
+                else
+                    this_thread::yield();
+            }
+        }
+        else
+        {
+            m_freeSlots.wait();
+        }
+        enqueue(task, self);
+    }
+
+    //! Tries to submit a task.
+    //! Enqueues the \p task and returns \p true if the pool has space for
+    //! it. Otherwise, \p false is returned.
+    bool try_submit(const task_type& task)
+    {
+        if (!m_freeSlots.try_wait())
+            return false;
+        enqueue(task, currentWorker());
+        return true;
+    }
+
+private:
+    //! The worker threads.
+    thread m_workers[TNumWorkers];
+    //! The ids of the worker threads.
+    thread::id m_workerIds[TNumWorkers];
+    //! The deque of every worker.
+    detail::work_stealing_deque<TCapacity> m_deques[TNumWorkers];
+    //! The storage for the tasks.
+    task_type m_tasks[TCapacity];
+
+    //! The number of workers which want to block on m_wakeup and have not
+    //! been woken up yet.
+    atomic_int m_numSleeping;
+    //! The semaphore on which idle workers block.
+    semaphore m_wakeup;
+    //! Set when the pool is destroyed.
+    atomic_bool m_stopping;
+    //! Released when the workers may start.
+    semaphore m_startGate;
+    //! Counts the free task slots.
+    semaphore m_freeSlots;
+
+    //! Protects the free indices and the shared queue.
+    mutex m_mutex;
+    //! A stack of the indices of the free task slots.
+    int m_freeIndices[TCapacity];
+    std::size_t m_numFreeIndices;
+    //! The ring buffer of task indices submitted by other threads.
+    int m_injected[TCapacity];
+    std::size_t m_injectedHead;
+    std::size_t m_numInjected;
+
+    //! The entry point of a worker.
+    static void workerMain(thread_pool* pool, std::size_t index)
+    {
+        pool->m_startGate.wait();
+        pool->work(index);
+    }
+
+    //! Executes tasks until the pool is destroyed.
+    void work(std::size_t self)
+    {
+        while (true)
+        {
+            int index = findTask(self);
+            if (index != detail::work_stealing_deque<TCapacity>::empty)
+            {
+                execute(index);
+                continue;
+            }
+
+            // Announce that we want to sleep and look for work once more.
+            // The sequentially consistent increment pairs with the load in
+            // wakeOne(). Either we see the task or the submitter sees us.
+            m_numSleeping.fetch_add(1);
+            if (m_stopping.load())
+            {
+                cancelSleep();
+                if (!hasWork())
+                    return;
+            }
+            else if (hasWork())
+                cancelSleep();
+            else
+                m_wakeup.wait();
+        }
+    }
+
+    //! Looks for a task for the worker \p self.
+    int findTask(std::size_t self)
+    {
+        const int empty = detail::work_stealing_deque<TCapacity>::empty;
+
+        int index = m_deques[self].take();
+        if (index != empty)
+            return index;
+
+        {
+            lock_guard<mutex> locker(m_mutex);
+            if (m_numInjected)
+            {
+                index = m_injected[m_injectedHead];
+                m_injectedHead = (m_injectedHead + 1) % TCapacity;
+                --m_numInjected;
+                return index;
+            }
+        }
+
+        for (std::size_t offset = 1; offset < TNumWorkers; ++offset)
+        {
+            index = m_deques[(self + offset) % TNumWorkers].steal();
+            if (index != empty)
+                return index;
+        }
+        return empty;
+    }
+
+    //! Checks if any task is pending.
+    bool hasWork()
+    {
+        {
+            lock_guard<mutex> locker(m_mutex);
+            if (m_numInjected)
+                return true;
+        }
+        for (std::size_t idx = 0; idx < TNumWorkers; ++idx)
+            if (!m_deques[idx].seems_empty())
+                return true;
+        return false;
+    }
+
+    //! Withdraws the announcement to sleep. If a submitter has already
+    //! claimed this worker, the token which it has posted is consumed.
+    void cancelSleep()
+    {
+        int numSleeping = m_numSleeping.load();
+        while (true)
+        {
+            if (numSleeping == 0)
+            {
+                m_wakeup.wait();
+                return;
+            }
+            if (m_numSleeping.compare_exchange_strong(numSleeping,
+                                                      numSleeping - 1))
+                return;
+        }
+    }
+
+    //! Wakes up one sleeping worker, if there is any.
+    void wakeOne()
+    {
+        int numSleeping = m_numSleeping.load();
+        while (numSleeping > 0)
+        {
+            if (m_numSleeping.compare_exchange_strong(numSleeping,
+                                                      numSleeping - 1))
+            {
+                m_wakeup.post();
+                return;
+            }
+        }
+    }
+
+    //! Stores the \p task in a free slot and makes it available to the
+    //! workers. The caller, whose worker index is \p self, must have
+    //! acquired a free slot.
+    void enqueue(const task_type& task, std::size_t self)
+    {
+        int index;
+        {
+            lock_guard<mutex> locker(m_mutex);
+            WEOS_ASSERT(m_numFreeIndices > 0);
+            index = m_freeIndices[--m_numFreeIndices];
+        }
+        {
+            // Free the slot again if the copy throws.
+            slot_guard guard(*this, index);
+            m_tasks[index] = task;
+            guard.dismiss();
+        }
+
+        if (self < TNumWorkers)
+        {
+            m_deques[self].push(index);
+        }
+        else
+        {
+            lock_guard<mutex> locker(m_mutex);
+            m_injected[(m_injectedHead + m_numInjected) % TCapacity] = index;
+            ++m_numInjected;
+        }
+        wakeOne();
+    }
+
+    //! Frees a task slot when it goes out of scope, even if the task
+    //! throws, unless it has been dismissed.
+    class slot_guard
+    {
+    public:
+        slot_guard(thread_pool& pool, int index)
+            : m_pool(pool),
+              m_index(index),
+              m_active(true)
+        {
+        }
+
+        ~slot_guard()
+        {
+            if (m_active)
+                m_pool.releaseSlot(m_index);
+        }
+
+        //! Keeps the slot occupied.
+        void dismiss()
+        {
+            m_active = false;
+        }
+
+    private:
+        thread_pool& m_pool;
+        int m_index;
+        bool m_active;
+
+        // ---- Hidden methods.
+        slot_guard(const slot_guard&);
+        slot_guard& operator= (const slot_guard&);
+    };
+
+    //! Executes the task in the slot \p index and frees the slot.
+    void execute(int index)
+    {
+        slot_guard guard(*this, index);
+        m_tasks[index]();
+    }
+
+    //! Destroys the task in the slot \p index and makes the slot available
+    //! again.
+    void releaseSlot(int index)
+    {
+        // Release the resources held by the task.
+        m_tasks[index] = task_type();
+        {
+            lock_guard<mutex> locker(m_mutex);
+            m_freeIndices[m_numFreeIndices++] = index;
+        }
+        m_freeSlots.post();
+    }
+
+    //! Returns the index of the calling worker or TNumWorkers if the caller
+    //! is not a worker of this pool.
+    std::size_t currentWorker() const
+    {
+        thread::id id = this_thread::get_id();
+        for (std::size_t idx = 0; idx < TNumWorkers; ++idx)
+            if (m_workerIds[idx] == id)
+                return idx;
+        return TNumWorkers;
+    }
+
+    // ---- Hidden methods.
+    thread_pool(const thread_pool&);
+    thread_pool& operator= (const thread_pool&);
+};
+
+WEOS_END_NAMESPACE
+
+#endif // WEOS_COMMON_THREADPOOL_HPP
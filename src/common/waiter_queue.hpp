@@ -0,0 +1,167 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef WEOS_COMMON_WAITER_QUEUE_HPP
+#define WEOS_COMMON_WAITER_QUEUE_HPP
+
+#ifndef WEOS_CONFIG_HPP
+    #error "Do not include this file directly."
+#endif // WEOS_CONFIG_HPP
+
+
+WEOS_BEGIN_NAMESPACE
+
+namespace detail
+{
+
+//! The hook with which a waiting thread is linked into a waiter_queue.
+//! A waiter derives from this hook.
+struct waiter_queue_hook
+{
+    waiter_queue_hook()
+        : previous(0),
+          next(0),
+          queued(false)
+    {
+    }
+
+    //! The previous waiter in the queue.
+    waiter_queue_hook* previous;
+    //! The next waiter in the queue. After waiter_queue::take_all(), this
+    //! is the waiter which has to be woken up after this one.
+    waiter_queue_hook* next;
+    //! Set while the waiter is linked into a queue.
+    bool queued;
+};
+
+//! An intrusive FIFO of waiting threads.
+//! The queue is a doubly-linked list with a tail pointer, so appending a
+//! waiter and removing an arbitrary one (e.g. after a timeout) take
+//! constant time. The queue does not own the waiters and is not
+//! thread-safe; the caller has to protect it.
+class waiter_queue
+{
+public:
+    //! Creates an empty queue.
+    waiter_queue()
+        : m_head(0),
+          m_tail(0)
+    {
+    }
+
+    //! Destroys the queue, which must be empty.
+    ~waiter_queue()
+    {
+        WEOS_ASSERT(empty());
+    }
+
+    //! Returns \p true if no waiter is queued.
+    bool empty() const
+    {
+        return m_head == 0;
+    }
+
+    //! Returns the first waiter or a null-pointer if the queue is empty.
+    waiter_queue_hook* front() const
+    {
+        return m_head;
+    }
+
+    //! Appends the waiter \p w to the queue.
+    void push_back(waiter_queue_hook& w)
+    {
+        WEOS_ASSERT(!w.queued);
+        w.previous = m_tail;
+        w.next = 0;
+        w.queued = true;
+        if (m_tail)
+            m_tail->next = &w;
+        else
+            m_head = &w;
+        m_tail = &w;
+    }
+
+    //! Removes the waiter \p w, which must be queued, from the queue.
+    void remove(waiter_queue_hook& w)
+    {
+        WEOS_ASSERT(w.queued);
+        if (w.previous)
+            w.previous->next = w.next;
+        else
+            m_head = w.next;
+        if (w.next)
+            w.next->previous = w.previous;
+        else
+            m_tail = w.previous;
+        w.previous = w.next = 0;
+        w.queued = false;
+    }
+
+    //! Removes the first waiter from the queue and returns it. If the queue
+    //! is empty, a null-pointer is returned.
+    waiter_queue_hook* pop_front()
+    {
+        waiter_queue_hook* w = m_head;
+        if (w)
+            remove(*w);
+        return w;
+    }
+
+    //! Removes all waiters from the queue and returns the first one. The
+    //! waiters stay chained by their next pointers in the order of the
+    //! queue, so every waiter can wake up its successor. This allows to
+    //! wake them one after another instead of all at once. If the queue is
+    //! empty, a null-pointer is returned.
+    waiter_queue_hook* take_all()
+    {
+        waiter_queue_hook* head = m_head;
+        for (waiter_queue_hook* iter = head; iter; iter = iter->next)
+        {
+            iter->previous = 0;
+            iter->queued = false;
+        }
+        m_head = m_tail = 0;
+        return head;
+    }
+
+private:
+    //! The first waiter.
+    waiter_queue_hook* m_head;
+    //! The last waiter.
+    waiter_queue_hook* m_tail;
+
+    // ---- Hidden methods.
+    waiter_queue(const waiter_queue&);
+    waiter_queue& operator= (const waiter_queue&);
+};
+
+} // namespace detail
+
+WEOS_END_NAMESPACE
+
+#endif // WEOS_COMMON_WAITER_QUEUE_HPP
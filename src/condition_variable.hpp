@@ -43,4 +43,6 @@
     #error "Invalid native OS."
 #endif
 
+#include "common/condition_variable_any.hpp"
+
 #endif // WEOS_CONDITION_VARIABLE_HPP
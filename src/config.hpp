@@ -133,7 +133,10 @@
 
 #else
 
-    #define WEOS_THROW_SYSTEM_ERROR(err, msg)   WEOS_ASSERT(0 && err && msg)
+    // The error is only type-checked. Using it as an operand of && would put
+    // an enum constant into a boolean context.
+    #define WEOS_THROW_SYSTEM_ERROR(err, msg)                                  \
+        WEOS_ASSERT(0 && sizeof(err) && msg)
 
 #endif // WEOS_ENABLE_EXCEPTIONS
 
@@ -35,4 +35,23 @@
 #define WEOS_USE_CXX11
 #include "../common/core.hpp"
 
+// The defaults of the options which are documented in
+// weos_user_config.template.hpp.
+
+#ifndef WEOS_CACHE_LINE_SIZE
+    #define WEOS_CACHE_LINE_SIZE   64
+#endif // WEOS_CACHE_LINE_SIZE
+
+#ifndef WEOS_DEFAULT_SPIN_COUNT
+    #define WEOS_DEFAULT_SPIN_COUNT   0
+#endif // WEOS_DEFAULT_SPIN_COUNT
+
+#ifndef WEOS_ADAPTIVE_MUTEX_SPIN_COUNT
+    #define WEOS_ADAPTIVE_MUTEX_SPIN_COUNT   100
+#endif // WEOS_ADAPTIVE_MUTEX_SPIN_COUNT
+
+#ifndef WEOS_MCS_LOCK_MAX_NESTING
+    #define WEOS_MCS_LOCK_MAX_NESTING   8
+#endif // WEOS_MCS_LOCK_MAX_NESTING
+
 #endif // WEOS_CXX11_CORE_HPP
@@ -40,6 +40,7 @@ namespace placeholders = std::placeholders;
 
 
 using std::bind;
+using std::function;
 
 //! \todo: This should be replaced by a class which never allocates from the heap.
 template <typename TSignature,
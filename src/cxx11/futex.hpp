@@ -0,0 +1,200 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef WEOS_CXX11_FUTEX_HPP
+#define WEOS_CXX11_FUTEX_HPP
+
+#include "core.hpp"
+
+#include "chrono.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+
+#if defined(__linux__)
+    #include <cerrno>
+    #include <ctime>
+    #include <linux/futex.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#else
+    #include <condition_variable>
+    #include <cstddef>
+    #include <mutex>
+#endif
+
+
+WEOS_BEGIN_NAMESPACE
+
+namespace detail
+{
+
+//! The type of a word on which threads can wait with futex_wait().
+typedef std::atomic<std::uint32_t> futex_word;
+
+//! A mask which matches every waiter. Waiters and wakers can pass a mask
+//! to select which threads blocked on the same word are woken up.
+const std::uint32_t futex_match_any = 0xFFFFFFFF;
+
+//! Returns the futex word which overlays the low half of the 64-bit
+//! \p state. This allows to keep more state than fits into a futex word
+//! in a single atomic while waiting for a change of its low half.
+inline
+futex_word& futex_low_half(std::atomic<std::uint64_t>& state)
+{
+    static_assert(sizeof(std::atomic<std::uint64_t>) == 2 * sizeof(futex_word),
+                  "The futex word must overlay half of the state.");
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return reinterpret_cast<futex_word*>(&state)[1];
+#else
+    return reinterpret_cast<futex_word*>(&state)[0];
+#endif
+}
+
+#if defined(__linux__)
+
+static_assert(sizeof(futex_word) == sizeof(std::uint32_t),
+              "A futex word must be a plain 32-bit integer.");
+
+//! Blocks the calling thread while the \p word holds the \p expected
+//! value. The check and the blocking are atomic with respect to
+//! futex_wake(). Only a futex_wake() whose mask shares a bit with the
+//! \p mask wakes the thread. The thread may also wake up spuriously.
+inline
+void futex_wait(futex_word& word, std::uint32_t expected,
+                std::uint32_t mask = futex_match_any)
+{
+    ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word),
+              FUTEX_WAIT_BITSET_PRIVATE, expected, nullptr, nullptr, mask);
+}
+
+//! Blocks the calling thread while the \p word holds the \p expected
+//! value or until the \p deadline has passed. Returns \p false in case of
+//! a timeout.
+inline
+bool futex_wait_until(futex_word& word, std::uint32_t expected,
+                      const chrono::steady_clock::time_point& deadline,
+                      std::uint32_t mask = futex_match_any)
+{
+    // FUTEX_WAIT_BITSET takes an absolute time of CLOCK_MONOTONIC, which
+    // is the clock behind the steady_clock.
+    chrono::nanoseconds ns = chrono::duration_cast<chrono::nanoseconds>(
+                                 deadline.time_since_epoch());
+    if (ns.count() < 0)
+        return false;
+    timespec ts;
+    ts.tv_sec = static_cast<std::time_t>(ns.count() / 1000000000);
+    ts.tv_nsec = static_cast<long>(ns.count() % 1000000000);
+
+    long result = ::syscall(SYS_futex,
+                            reinterpret_cast<std::uint32_t*>(&word),
+                            FUTEX_WAIT_BITSET_PRIVATE, expected, &ts,
+                            nullptr, mask);
+    return result == 0 || errno != ETIMEDOUT;
+}
+
+//! Wakes up to \p count threads which are blocked on the \p word with a
+//! mask which shares a bit with the \p mask. The \p word is not accessed,
+//! so it is fine to wake the waiters of an object which a woken thread may
+//! have destroyed already. At worst, this causes a spurious wakeup.
+inline
+void futex_wake(futex_word& word,
+                int count = std::numeric_limits<int>::max(),
+                std::uint32_t mask = futex_match_any)
+{
+    ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word),
+              FUTEX_WAKE_BITSET_PRIVATE, count, nullptr, nullptr, mask);
+}
+
+#else
+
+//! A bucket of the futex emulation.
+struct futex_bucket
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+};
+
+//! Returns the bucket in which threads waiting on the \p word block.
+//! Without kernel support, futexes are emulated with a fixed table of
+//! mutexes and condition variables indexed by the address of the word.
+inline
+futex_bucket& futex_bucket_for(const futex_word& word)
+{
+    static futex_bucket buckets[64];
+    std::size_t address = reinterpret_cast<std::size_t>(&word);
+    return buckets[(address / sizeof(futex_word)) % 64];
+}
+
+// The emulation ignores the masks and wakes up all threads of a bucket.
+
+inline
+void futex_wait(futex_word& word, std::uint32_t expected,
+                std::uint32_t mask = futex_match_any)
+{
+    (void)mask;
+    futex_bucket& bucket = futex_bucket_for(word);
+    std::unique_lock<std::mutex> lock(bucket.mutex);
+    if (word.load(std::memory_order_relaxed) == expected)
+        bucket.cv.wait(lock);
+}
+
+inline
+bool futex_wait_until(futex_word& word, std::uint32_t expected,
+                      const chrono::steady_clock::time_point& deadline,
+                      std::uint32_t mask = futex_match_any)
+{
+    (void)mask;
+    futex_bucket& bucket = futex_bucket_for(word);
+    std::unique_lock<std::mutex> lock(bucket.mutex);
+    if (word.load(std::memory_order_relaxed) != expected)
+        return true;
+    return bucket.cv.wait_until(lock, deadline) != std::cv_status::timeout;
+}
+
+inline
+void futex_wake(futex_word& word,
+                int count = std::numeric_limits<int>::max(),
+                std::uint32_t mask = futex_match_any)
+{
+    (void)count;
+    (void)mask;
+    // Other words may share the bucket, so everybody has to be woken up.
+    futex_bucket& bucket = futex_bucket_for(word);
+    std::lock_guard<std::mutex> lock(bucket.mutex);
+    bucket.cv.notify_all();
+}
+
+#endif // __linux__
+
+} // namespace detail
+
+WEOS_END_NAMESPACE
+
+#endif // WEOS_CXX11_FUTEX_HPP
@@ -32,23 +32,256 @@
 #include "core.hpp"
 
 #include "chrono.hpp"
+#include "messagequeue_statistics.hpp"
+#include "spin.hpp"
+#include "waitset_detail.hpp"
+#include "../common/messagequeue_tags.hpp"
+#include "../optional.hpp"
 
+#include <atomic>
 #include <condition_variable>
+#include <cstddef>
 #include <cstdint>
-#include <deque>
 #include <mutex>
+#include <new>
+#include <type_traits>
 #include <utility>
 
 
 WEOS_BEGIN_NAMESPACE
 
+namespace detail
+{
+
+//! A place where threads wait for a lock-free queue to change its state.
+//! Threads block on the parking_spot until a predicate becomes true. As long
+//! as no thread is blocked, notifying the spot only costs a memory fence and
+//! an atomic load; the mutex is acquired only if there is a waiter.
+//! A wait_set which observes the spot counts as a permanent waiter.
+//!
+//! The predicate is evaluated without the mutex held, so it may notify
+//! other spots. Every notification advances a generation counter and a
+//! waiter only blocks if the generation has not changed since before it
+//! evaluated the predicate.
+class parking_spot
+{
+public:
+    parking_spot()
+        : m_numWaiters(0),
+          m_generation(0)
+    {
+    }
+
+    parking_spot(const parking_spot&) = delete;
+    parking_spot& operator= (const parking_spot&) = delete;
+
+    //! Blocks the calling thread until \p pred returns \p true. The thread
+    //! spins for up to \p spinCount iterations before it blocks.
+    template <typename PredicateT>
+    void wait(unsigned spinCount, PredicateT pred)
+    {
+        if (spin_until(spinCount, pred))
+            return;
+
+        registration waiter(*this);
+        while (true)
+        {
+            unsigned generation = m_generation.load(std::memory_order_seq_cst);
+            if (pred())
+                return;
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (generation == m_generation.load(std::memory_order_relaxed))
+                m_cv.wait(lock);
+        }
+    }
+
+    //! Blocks the calling thread until \p pred returns \p true or the
+    //! \p deadline has passed. Returns the last result of the predicate.
+    //! The thread spins for up to \p spinCount iterations before it blocks.
+    template <typename PredicateT>
+    bool wait_until(const chrono::steady_clock::time_point& deadline,
+                    unsigned spinCount, PredicateT pred)
+    {
+        if (spin_until(spinCount, pred))
+            return true;
+
+        registration waiter(*this);
+        while (true)
+        {
+            unsigned generation = m_generation.load(std::memory_order_seq_cst);
+            if (pred())
+                return true;
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (generation == m_generation.load(std::memory_order_relaxed))
+            {
+                if (m_cv.wait_until(lock, deadline) == std::cv_status::timeout)
+                {
+                    lock.unlock();
+                    return pred();
+                }
+            }
+        }
+    }
+
+    //! Wakes one thread which is blocked on this spot.
+    //! The caller must have published the state change, which makes the
+    //! predicate true, before calling this function.
+    void notify_one()
+    {
+        // Pairs with the fence in announce(). Either the waiter sees the
+        // new state in its predicate or we see the waiter.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_numWaiters.load(std::memory_order_relaxed) != 0)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            advance();
+            m_cv.notify_one();
+            m_waitSets.signal_all();
+        }
+    }
+
+    //! Wakes all threads which are blocked on this spot.
+    //! The caller must have published the state change, which makes the
+    //! predicate true, before calling this function.
+    void notify_all()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_numWaiters.load(std::memory_order_relaxed) != 0)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            advance();
+            m_cv.notify_all();
+            m_waitSets.signal_all();
+        }
+    }
+
+    //! Wakes the waiters after \p count elements or slots have become
+    //! available. A single wakeup is issued for a whole batch.
+    void notify(std::size_t count)
+    {
+        if (count == 1)
+            notify_one();
+        else if (count > 1)
+            notify_all();
+    }
+
+    //! Adds the \p link of a wait set. The wait set is signalled whenever
+    //! the blocked threads are notified.
+    void attach(wait_set_link* link)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_waitSets.attach(link);
+        announce();
+    }
+
+    //! Removes the \p link of a wait set.
+    void detach(wait_set_link* link)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_waitSets.detach(link);
+        m_numWaiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    //! The number of threads which are about to block or are blocked plus
+    //! the number of attached wait sets.
+    std::atomic<unsigned> m_numWaiters;
+    //! Advanced with every notification while a thread waits. It is only
+    //! modified with the mutex held.
+    std::atomic<unsigned> m_generation;
+    //! The wait sets which observe this spot.
+    wait_set_list m_waitSets;
+
+    //! Registers the calling thread as waiter before the predicate is
+    //! evaluated.
+    void announce()
+    {
+        m_numWaiters.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    //! Starts a new generation. The mutex must be held.
+    void advance()
+    {
+        m_generation.store(m_generation.load(std::memory_order_relaxed) + 1,
+                           std::memory_order_seq_cst);
+    }
+
+    //! Registers a waiting thread for its lifetime. The thread is
+    //! unregistered even if the predicate throws.
+    struct registration
+    {
+        explicit registration(parking_spot& spot)
+            : m_spot(spot)
+        {
+            m_spot.announce();
+        }
+
+        ~registration()
+        {
+            m_spot.m_numWaiters.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        registration(const registration&) = delete;
+        registration& operator= (const registration&) = delete;
+
+    private:
+        parking_spot& m_spot;
+    };
+};
+
+//! Converts the duration \p d to a deadline relative to now.
+template <typename RepT, typename PeriodT>
+inline
+chrono::steady_clock::time_point deadline_from_now(
+        const chrono::duration<RepT, PeriodT>& d)
+{
+    return chrono::steady_clock::now()
+           + chrono::duration_cast<chrono::steady_clock::duration>(d);
+}
+
+//! Wakes the waiters of \p cv after \p count elements or slots have become
+//! available. A single wakeup is issued for a whole batch.
+inline
+void notify(std::condition_variable& cv, std::size_t count)
+{
+    if (count == 1)
+        cv.notify_one();
+    else if (count > 1)
+        cv.notify_all();
+}
+
+} // namespace detail
+
 //! A message queue.
 //! The message_queue is an object to pass elements from one thread to another
 //! in a thread-safe manner. The type of the element which are transfered is
 //! defined by the template parameter \p TypeT. The maximum size of the queue
 //! has to be passed in \p QueueSizeT.
-template <typename TypeT, std::size_t QueueSizeT>
+//!
+//! The elements are stored in a ring buffer which is part of the queue
+//! object, i.e. sending and receiving never allocates memory from the heap.
+//!
+//! Elements are constructed directly in the ring buffer (emplace()) and are
+//! moved out when they are received. Thus, move-only types are supported
+//! and the element type need not be default-constructible.
+//!
+//! The \p TagT selects the implementation. By default (locked_tag), the queue
+//! is protected by a mutex and can be used by any number of threads. The
+//! spsc_tag selects a lock-free queue for one sender and one receiver and
+//! the mpmc_tag a lock-free queue for any number of senders and receivers.
+//!
+//! If WEOS_ENABLE_MESSAGE_QUEUE_STATISTICS is defined, every queue records
+//! its occupancy, the time which threads spend blocked in it and the latency
+//! of the elements. The statistics() are updated with relaxed atomic
+//! operations. Otherwise, nothing is recorded.
+template <typename TypeT, std::size_t QueueSizeT, typename TagT = locked_tag>
 class message_queue
+        : private detail::message_queue_recorder<QueueSizeT>
 {
     //! \todo Removed the size check for now because 64-bit pointers must
     //! work, too.
@@ -57,10 +290,38 @@ class message_queue
 
     static_assert(QueueSizeT > 0, "The queue size must be nonzero.");
 
+    typedef detail::message_queue_recorder<QueueSizeT> recorder_type;
+
 public:
     //! The type of the elements transfered via this message queue.
     typedef TypeT element_type;
 
+#if defined(WEOS_ENABLE_MESSAGE_QUEUE_STATISTICS)
+    using recorder_type::statistics;
+    using recorder_type::reset_statistics;
+#endif // WEOS_ENABLE_MESSAGE_QUEUE_STATISTICS
+
+    //! Creates a message queue.
+    //! Creates an empty message queue.
+    message_queue()
+        : m_head(0),
+          m_size(0),
+          m_spinCount(WEOS_DEFAULT_SPIN_COUNT)
+    {
+    }
+
+    //! Destroys the message queue.
+    //! Destroys the message queue and all elements which are still stored
+    //! in it.
+    ~message_queue()
+    {
+        while (size() != 0)
+            removeFirst();
+    }
+
+    message_queue(const message_queue&) = delete;
+    message_queue& operator= (const message_queue&) = delete;
+
     //! Returns the capacity.
     //! Returns the maximum number of elements which the queue can hold.
     std::size_t capacity() const
@@ -68,19 +329,37 @@ public:
         return QueueSizeT;
     }
 
+    //! Returns the number of iterations a thread spins before it blocks.
+    unsigned spin_count() const
+    {
+        return m_spinCount;
+    }
+
+    //! Sets the number of iterations a thread spins before it blocks on an
+    //! empty or full queue to \p spinCount. Zero disables spinning. The
+    //! default is WEOS_DEFAULT_SPIN_COUNT.
+    void set_spin_count(unsigned spinCount)
+    {
+        m_spinCount = spinCount;
+    }
+
     //! Receives an element from the queue.
     //! Returns the first element from the message queue. If the queue is
     //! empty, the calling thread is blocked until an element is added.
     element_type receive()
     {
+        spinWhileEmpty();
         std::unique_lock<std::mutex> lock(m_mutex);
-        while (m_queue.empty())
+        if (size() == 0)
         {
-            m_cv_receive.wait(lock);
+            typename recorder_type::blocked_receive blocked(*this);
+            while (size() == 0)
+                m_cv_receive.wait(lock);
         }
 
-        element_type element = m_queue.front();
-        m_queue.pop_front();
+        wakeup_forwarder forwarder(m_cv_receive);
+        element_type element = pop();
+        forwarder.complete();
         lock.unlock();
         m_cv_send.notify_one();
 
@@ -88,135 +367,1730 @@ public:
     }
 
     //! Tries to receive an element from the queue.
-    //! Tries to receive an element from the message queue.
-    //! The element is returned together with a boolean, which is set if the
-    //! queue was non-empty. If the queue was empty, the boolean is reset and
-    //! the returned element is default-constructed.
-    std::pair<bool, element_type> try_receive()
+    //! Tries to receive an element from the message queue. If the queue was
+    //! non-empty, the first element is moved into the returned optional.
+    //! Otherwise, the returned optional is empty.
+    optional<element_type> try_receive()
     {
+        optional<element_type> result;
         std::unique_lock<std::mutex> lock(m_mutex);
-        if (m_queue.empty())
-        {
-            return std::pair<bool, element_type>(false, element_type());
-        }
+        if (size() == 0)
+            return result;
 
-        element_type element = m_queue.front();
-        m_queue.pop_front();
+        pop(result);
         lock.unlock();
         m_cv_send.notify_one();
 
-        return std::pair<bool, element_type>(true, element);
+        return result;
     }
 
     //! Tries to receive an element from the queue.
     //! Tries to receive an element from the message queue within the timeout
-    //! duration \p d.
-    //! The element is returned together with a boolean, which is set if the
-    //! queue was non-empty. If the queue was empty, the boolean is reset and
-    //! the returned element is default-constructed.
+    //! duration \p d. If an element is available in time, it is moved into
+    //! the returned optional. Otherwise, the returned optional is empty.
     template <typename RepT, typename PeriodT>
-    std::pair<bool, element_type> try_receive_for(
+    optional<element_type> try_receive_for(
             const chrono::duration<RepT, PeriodT>& d)
     {
+        // Note: If we spuriously wakeup, we must not wait again for the
+        // full duration because then we wait too long. Thus, we compute
+        // the deadline once.
+        chrono::steady_clock::time_point deadline
+                = detail::deadline_from_now(d);
+
+        optional<element_type> result;
+        spinWhileEmpty();
         std::unique_lock<std::mutex> lock(m_mutex);
-        while (m_queue.empty())
+        if (size() == 0)
         {
-            // Note: If we spuriously wakeup, we should not wait again for
-            // the same time because then we wait too long.
-            if (m_cv_receive.wait(lock, d) == std::cv_status::timeout)
+            typename recorder_type::blocked_receive blocked(*this);
+            while (size() == 0)
             {
-                if (m_queue.empty())
-                    return std::pair<bool, element_type>(false, element_type());
-                break;
+                if (m_cv_receive.wait_until(lock, deadline)
+                    == std::cv_status::timeout)
+                {
+                    if (size() == 0)
+                        return result;
+                    break;
+                }
             }
         }
 
-        element_type element = m_queue.front();
-        m_queue.pop_front();
+        wakeup_forwarder forwarder(m_cv_receive);
+        pop(result);
+        forwarder.complete();
         lock.unlock();
         m_cv_send.notify_one();
 
-        return std::pair<bool, element_type>(true, element);
+        return result;
+    }
+
+    //! Sends an element via the queue.
+    //! Sends the \p element by appending a copy of it at the end of the
+    //! message queue. If the queue is full, the calling thread is blocked
+    //! until space becomes available.
+    void send(const element_type& element)
+    {
+        emplace(element);
     }
 
     //! Sends an element via the queue.
-    //! Sends the \p element by appending it at the end of the message queue.
-    //! If the queue is full, the calling thread is blocked until space becomes
-    //! available.
-    void send(element_type element)
+    //! Moves the \p element to the end of the message queue. If the queue is
+    //! full, the calling thread is blocked until space becomes available.
+    void send(element_type&& element)
+    {
+        emplace(std::move(element));
+    }
+
+    //! Tries to send an element via the queue.
+    //! Tries to append a copy of the \p element to the queue. If no space
+    //! was available, \p false is returned. Otherwise the method returns
+    //! \p true. The calling thread is never blocked.
+    bool try_send(const element_type& element)
+    {
+        return try_emplace(element);
+    }
+
+    //! Tries to send an element via the queue.
+    //! Tries to move the \p element to the end of the queue. If no space was
+    //! available, \p false is returned and \p element is left untouched.
+    //! Otherwise the method returns \p true. The calling thread is never
+    //! blocked.
+    bool try_send(element_type&& element)
+    {
+        return try_emplace(std::move(element));
+    }
+
+    //! Tries to send an element via the queue.
+    //! Tries to append a copy of the given \p element to the queue and
+    //! returns \p true if successful. If there is no space available within
+    //! the duration \p d, the operation is aborted an \p false is returned.
+    template <typename RepT, typename PeriodT>
+    bool try_send_for(const element_type& element,
+                      const chrono::duration<RepT, PeriodT>& d)
+    {
+        return try_emplace_for(d, element);
+    }
+
+    //! Tries to send an element via the queue.
+    //! Tries to move the given \p element to the end of the queue and
+    //! returns \p true if successful. If there is no space available within
+    //! the duration \p d, the operation is aborted an \p false is returned.
+    template <typename RepT, typename PeriodT>
+    bool try_send_for(element_type&& element,
+                      const chrono::duration<RepT, PeriodT>& d)
+    {
+        return try_emplace_for(d, std::move(element));
+    }
+
+    //! Constructs an element in the queue.
+    //! Constructs an element from the given \p args directly in the queue's
+    //! storage at the end of the message queue. If the queue is full, the
+    //! calling thread is blocked until space becomes available.
+    template <typename... ArgsT>
+    void emplace(ArgsT&&... args)
     {
+        spinWhileFull();
         std::unique_lock<std::mutex> lock(m_mutex);
-        while (isFull())
+        if (isFull())
         {
-            m_cv_send.wait(lock);
+            typename recorder_type::blocked_send blocked(*this);
+            while (isFull())
+                m_cv_send.wait(lock);
         }
 
-        m_queue.push_back(element);
+        wakeup_forwarder forwarder(m_cv_send);
+        push(std::forward<ArgsT>(args)...);
+        forwarder.complete();
+        m_waitSets.signal_all();
         lock.unlock();
         m_cv_receive.notify_one();
     }
 
-    //! Tries to send an element via the queue.
-    //! Tries to send the \p element via the queue. If no space was available,
-    //! \p false is returned. Otherwise the method returns \p true. The
-    //! calling thread is never blocked.
-    bool try_send(element_type element)
+    //! Tries to construct an element in the queue.
+    //! Tries to construct an element from the given \p args at the end of
+    //! the message queue. If no space was available, \p false is returned.
+    //! Otherwise the method returns \p true. The calling thread is never
+    //! blocked.
+    template <typename... ArgsT>
+    bool try_emplace(ArgsT&&... args)
     {
         std::unique_lock<std::mutex> lock(m_mutex);
         if (isFull())
             return false;
 
-        m_queue.push_back(element);
+        push(std::forward<ArgsT>(args)...);
+        m_waitSets.signal_all();
         lock.unlock();
         m_cv_receive.notify_one();
 
         return true;
     }
 
-    //! Tries to send an element via the queue.
-    //! Tries to send the given \p element via the queue and returns \p true
-    //! if successful. If there is no space available within the
-    //! duration \p d, the operation is aborted an \p false is returned.
-    template <typename RepT, typename PeriodT>
-    bool try_send_for(element_type element,
-                      const chrono::duration<RepT, PeriodT>& d)
+    //! Tries to construct an element in the queue.
+    //! Tries to construct an element from the given \p args at the end of
+    //! the message queue and returns \p true if successful. If there is no
+    //! space available within the duration \p d, the operation is aborted
+    //! an \p false is returned.
+    template <typename RepT, typename PeriodT, typename... ArgsT>
+    bool try_emplace_for(const chrono::duration<RepT, PeriodT>& d,
+                         ArgsT&&... args)
     {
+        chrono::steady_clock::time_point deadline
+                = detail::deadline_from_now(d);
+
+        spinWhileFull();
         std::unique_lock<std::mutex> lock(m_mutex);
-        while (isFull())
+        if (isFull())
         {
-            // Note: If we spuriously wakeup, we should not wait again for
-            // the same time because then we wait too long.
-            if (m_cv_send.wait_for(lock, d) == std::cv_status::timeout)
+            typename recorder_type::blocked_send blocked(*this);
+            while (isFull())
             {
-                if (isFull())
-                    return false;
-                break;
+                if (m_cv_send.wait_until(lock, deadline)
+                    == std::cv_status::timeout)
+                {
+                    if (isFull())
+                        return false;
+                    break;
+                }
             }
         }
 
-        m_queue.push_back(element);
+        wakeup_forwarder forwarder(m_cv_send);
+        push(std::forward<ArgsT>(args)...);
+        forwarder.complete();
+        m_waitSets.signal_all();
         lock.unlock();
         m_cv_receive.notify_one();
 
         return true;
     }
 
+    //! Sends a range of elements via the queue.
+    //! Sends the elements in the range [\p first, \p last) in order. As many
+    //! elements as fit into the queue are appended under a single lock and
+    //! the receivers are woken once per batch. If the queue is full, the
+    //! calling thread is blocked until space becomes available.
+    template <typename InputIteratorT>
+    void send_n(InputIteratorT first, InputIteratorT last)
+    {
+        while (first != last)
+        {
+            spinWhileFull();
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (isFull())
+            {
+                typename recorder_type::blocked_send blocked(*this);
+                while (isFull())
+                    m_cv_send.wait(lock);
+            }
+
+            wakeup_forwarder forwarder(m_cv_send);
+            std::size_t count = pushRange(first, last);
+            forwarder.complete();
+            m_waitSets.signal_all();
+            lock.unlock();
+            detail::notify(m_cv_receive, count);
+        }
+    }
+
+    //! Tries to send a range of elements via the queue.
+    //! Appends as many elements from the range [\p first, \p last) as fit
+    //! into the queue and returns their number. The calling thread is never
+    //! blocked.
+    template <typename InputIteratorT>
+    std::size_t try_send_n(InputIteratorT first, InputIteratorT last)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        std::size_t count = pushRange(first, last);
+        if (count != 0)
+            m_waitSets.signal_all();
+        lock.unlock();
+        detail::notify(m_cv_receive, count);
+
+        return count;
+    }
+
+    //! Receives a batch of elements from the queue.
+    //! Moves up to \p max elements from the queue to \p out and returns
+    //! their number. If the queue is empty, the calling thread is blocked
+    //! until at least one element is available.
+    template <typename OutputIteratorT>
+    std::size_t receive_n(OutputIteratorT out, std::size_t max)
+    {
+        if (max == 0)
+            return 0;
+
+        spinWhileEmpty();
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (size() == 0)
+        {
+            typename recorder_type::blocked_receive blocked(*this);
+            while (size() == 0)
+                m_cv_receive.wait(lock);
+        }
+
+        wakeup_forwarder forwarder(m_cv_receive);
+        std::size_t count = popRange(out, max);
+        forwarder.complete();
+        lock.unlock();
+        detail::notify(m_cv_send, count);
+
+        return count;
+    }
+
+    //! Tries to receive a batch of elements from the queue.
+    //! Moves up to \p max elements from the queue to \p out and returns
+    //! their number. The calling thread is never blocked.
+    template <typename OutputIteratorT>
+    std::size_t try_receive_n(OutputIteratorT out, std::size_t max)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        std::size_t count = popRange(out, max);
+        lock.unlock();
+        detail::notify(m_cv_send, count);
+
+        return count;
+    }
+
 private:
+    //! The type of one slot in the ring buffer. A slot provides properly
+    //! aligned but uninitialized memory for one element.
+    typedef typename std::aligned_storage<
+                         sizeof(element_type),
+                         std::alignment_of<element_type>::value>::type
+        slot_type;
+
     //! A mutex to protect the queue.
     std::mutex m_mutex;
-    //! The queue to transfer the data.
-    std::deque<element_type> m_queue;
     //! This condition variable is triggered whenever something is added to
     //! the queue (i.e. we can receive from it).
     std::condition_variable m_cv_receive;
     //! This condition variable is triggered whenever seomthing is taken from
     //! the queue (i.e. we can send via it).
     std::condition_variable m_cv_send;
+    //! The index of the slot which holds the first element.
+    std::size_t m_head;
+    //! The number of elements in the queue. It is only modified with the
+    //! mutex held but it is atomic such that spinning threads can poll it.
+    std::atomic<std::size_t> m_size;
+    //! The number of spin iterations before blocking.
+    unsigned m_spinCount;
+    //! The wait sets which observe this queue. The list is protected by the
+    //! mutex.
+    detail::wait_set_list m_waitSets;
+    //! The ring buffer which holds the elements. It starts on a new cache
+    //! line such that the slots do not share a line with the mutex.
+    alignas(WEOS_CACHE_LINE_SIZE) slot_type m_slots[QueueSizeT];
+
+    //! Returns the number of elements in the queue.
+    std::size_t size() const
+    {
+        return m_size.load(std::memory_order_relaxed);
+    }
+
+    //! Spins until the queue seems to be non-empty or the spin count is
+    //! exhausted.
+    void spinWhileEmpty() const
+    {
+        detail::spin_until(m_spinCount, [this] { return size() != 0; });
+    }
+
+    //! Spins until the queue seems to be non-full or the spin count is
+    //! exhausted.
+    void spinWhileFull() const
+    {
+        detail::spin_until(m_spinCount, [this] { return !isFull(); });
+    }
 
     //! Checks if the queue is full.
     bool isFull() const
     {
-        return m_queue.size() >= QueueSizeT;
+        return size() >= QueueSizeT;
+    }
+
+    //! Returns a pointer to the element in the slot with the given \p index.
+    element_type* slot(std::size_t index)
+    {
+        return reinterpret_cast<element_type*>(&m_slots[index]);
+    }
+
+    //! Constructs an element from the \p args at the end of the ring buffer,
+    //! which must not be full.
+    template <typename... ArgsT>
+    void push(ArgsT&&... args)
+    {
+        std::size_t tail = m_head + size();
+        if (tail >= QueueSizeT)
+            tail -= QueueSizeT;
+        ::new (static_cast<void*>(slot(tail)))
+                element_type(std::forward<ArgsT>(args)...);
+        this->recordSend(tail);
+        m_size.store(size() + 1, std::memory_order_relaxed);
+    }
+
+    //! Removes the first element from the ring buffer, which must not be
+    //! empty, and returns it.
+    element_type pop()
+    {
+        element_type* first = slot(m_head);
+        element_type element(std::move(*first));
+        removeFirst();
+        return element;
+    }
+
+    //! Moves the first element from the ring buffer, which must not be
+    //! empty, into the \p result.
+    void pop(optional<element_type>& result)
+    {
+        result.emplace(std::move(*slot(m_head)));
+        removeFirst();
+    }
+
+    //! Destroys the first element in the ring buffer.
+    void removeFirst()
+    {
+        slot(m_head)->~element_type();
+        this->recordReceive(m_head);
+        if (++m_head == QueueSizeT)
+            m_head = 0;
+        m_size.store(size() - 1, std::memory_order_relaxed);
+    }
+
+    //! Passes a wakeup on to the next thread waiting on the \p cv if the
+    //! calling thread leaves by an exception. The calling thread may have
+    //! been woken for the slot or element which it does not use in the end.
+    struct wakeup_forwarder
+    {
+        explicit wakeup_forwarder(std::condition_variable& cv)
+            : m_cv(cv),
+              m_completed(false)
+        {
+        }
+
+        ~wakeup_forwarder()
+        {
+            if (!m_completed)
+                m_cv.notify_one();
+        }
+
+        wakeup_forwarder(const wakeup_forwarder&) = delete;
+        wakeup_forwarder& operator= (const wakeup_forwarder&) = delete;
+
+        //! Marks the operation as completed.
+        void complete()
+        {
+            m_completed = true;
+        }
+
+    private:
+        std::condition_variable& m_cv;
+        bool m_completed;
+    };
+
+    //! Counts the elements transferred by a batch. If copying or moving an
+    //! element throws in the middle of a batch, the threads waiting on the
+    //! \p cv and the \p waitSets are woken for the completed prefix when
+    //! the batch goes out of scope, because the caller cannot do so anymore.
+    struct batch_notifier
+    {
+        batch_notifier(std::condition_variable& cv,
+                       detail::wait_set_list* waitSets)
+            : count(0),
+              m_cv(cv),
+              m_waitSets(waitSets),
+              m_completed(false)
+        {
+        }
+
+        ~batch_notifier()
+        {
+            if (count == 0 || m_completed)
+                return;
+            if (m_waitSets)
+                m_waitSets->signal_all();
+            detail::notify(m_cv, count);
+        }
+
+        batch_notifier(const batch_notifier&) = delete;
+        batch_notifier& operator= (const batch_notifier&) = delete;
+
+        //! Marks the batch as completed. The caller wakes the waiters.
+        void complete()
+        {
+            m_completed = true;
+        }
+
+        //! The number of elements which have been transferred.
+        std::size_t count;
+
+    private:
+        std::condition_variable& m_cv;
+        detail::wait_set_list* m_waitSets;
+        bool m_completed;
+    };
+
+    //! Appends elements from [\p first, \p last) until the queue is full
+    //! and returns their number. \p first is advanced past the last element
+    //! which has been appended.
+    template <typename InputIteratorT>
+    std::size_t pushRange(InputIteratorT& first, InputIteratorT last)
+    {
+        batch_notifier batch(m_cv_receive, &m_waitSets);
+        for (; first != last && !isFull(); ++first)
+        {
+            push(*first);
+            ++batch.count;
+        }
+        batch.complete();
+        return batch.count;
+    }
+
+    //! Moves up to \p max elements to \p out and returns their number. If
+    //! moving an element to \p out throws, this element stays in the queue.
+    template <typename OutputIteratorT>
+    std::size_t popRange(OutputIteratorT& out, std::size_t max)
+    {
+        batch_notifier batch(m_cv_send, 0);
+        for (; batch.count < max && size() != 0; ++out)
+        {
+            *out = std::move(*slot(m_head));
+            removeFirst();
+            ++batch.count;
+        }
+        batch.complete();
+        return batch.count;
+    }
+
+    friend class wait_set;
+
+    //! Checks if an element seems to be available. Used by the wait_set.
+    bool canReceive() const
+    {
+        return size() != 0;
+    }
+
+    //! Registers the \p link of a wait_set, which is signalled whenever an
+    //! element is added.
+    void attachWaitSet(detail::wait_set_link* link)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_waitSets.attach(link);
+    }
+
+    //! Unregisters the \p link of a wait_set.
+    void detachWaitSet(detail::wait_set_link* link)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_waitSets.detach(link);
+    }
+};
+
+//! A single-producer/single-consumer message queue.
+//! This specialization may be used by exactly one sending and one receiving
+//! thread. The head and tail indices are placed on separate cache lines and
+//! are exchanged with acquire/release semantics, so neither sending nor
+//! receiving takes a lock. A thread blocks only if the queue is full
+//! (sender) or empty (receiver).
+template <typename TypeT, std::size_t QueueSizeT>
+class message_queue<TypeT, QueueSizeT, spsc_tag>
+        : private detail::message_queue_recorder<QueueSizeT + 1>
+{
+    static_assert(QueueSizeT > 0, "The queue size must be nonzero.");
+
+    typedef detail::message_queue_recorder<QueueSizeT + 1> recorder_type;
+
+public:
+    //! The type of the elements transfered via this message queue.
+    typedef TypeT element_type;
+
+#if defined(WEOS_ENABLE_MESSAGE_QUEUE_STATISTICS)
+    using recorder_type::statistics;
+    using recorder_type::reset_statistics;
+#endif // WEOS_ENABLE_MESSAGE_QUEUE_STATISTICS
+
+    //! Creates a message queue.
+    //! Creates an empty message queue.
+    message_queue()
+        : m_head(0),
+          m_cachedTail(0),
+          m_tail(0),
+          m_cachedHead(0),
+          m_spinCount(WEOS_DEFAULT_SPIN_COUNT)
+    {
+    }
+
+    //! Destroys the message queue.
+    //! Destroys the message queue and all elements which are still stored
+    //! in it.
+    ~message_queue()
+    {
+        std::size_t tail = m_tail.load(std::memory_order_relaxed);
+        for (std::size_t index = m_head.load(std::memory_order_relaxed);
+             index != tail; index = next(index))
+        {
+            slot(index)->~element_type();
+        }
+    }
+
+    message_queue(const message_queue&) = delete;
+    message_queue& operator= (const message_queue&) = delete;
+
+    //! Returns the capacity.
+    //! Returns the maximum number of elements which the queue can hold.
+    std::size_t capacity() const
+    {
+        return QueueSizeT;
+    }
+
+    //! Returns the number of iterations a thread spins before it blocks.
+    unsigned spin_count() const
+    {
+        return m_spinCount;
+    }
+
+    //! Sets the number of iterations a thread spins before it blocks on an
+    //! empty or full queue to \p spinCount. Zero disables spinning. The
+    //! default is WEOS_DEFAULT_SPIN_COUNT.
+    void set_spin_count(unsigned spinCount)
+    {
+        m_spinCount = spinCount;
+    }
+
+    //! Receives an element from the queue.
+    //! Returns the first element from the message queue. If the queue is
+    //! empty, the calling thread is blocked until an element is added.
+    element_type receive()
+    {
+        optional<element_type> result;
+        if (!tryPop(result))
+        {
+            typename recorder_type::blocked_receive blocked(*this);
+            m_notEmpty.wait(m_spinCount, [&] { return tryPop(result); });
+        }
+        m_notFull.notify_one();
+        return std::move(*result);
+    }
+
+    //! Tries to receive an element from the queue.
+    //! Tries to receive an element from the message queue. If the queue was
+    //! non-empty, the first element is moved into the returned optional.
+    //! Otherwise, the returned optional is empty.
+    optional<element_type> try_receive()
+    {
+        optional<element_type> result;
+        if (tryPop(result))
+            m_notFull.notify_one();
+        return result;
+    }
+
+    //! Tries to receive an element from the queue.
+    //! Tries to receive an element from the message queue within the timeout
+    //! duration \p d. If an element is available in time, it is moved into
+    //! the returned optional. Otherwise, the returned optional is empty.
+    template <typename RepT, typename PeriodT>
+    optional<element_type> try_receive_for(
+            const chrono::duration<RepT, PeriodT>& d)
+    {
+        optional<element_type> result;
+        if (!tryPop(result))
+        {
+            typename recorder_type::blocked_receive blocked(*this);
+            if (!m_notEmpty.wait_until(detail::deadline_from_now(d),
+                                       m_spinCount,
+                                       [&] { return tryPop(result); }))
+            {
+                return result;
+            }
+        }
+        m_notFull.notify_one();
+        return result;
+    }
+
+    //! Sends an element via the queue.
+    //! Sends the \p element by appending a copy of it at the end of the
+    //! message queue. If the queue is full, the calling thread is blocked
+    //! until space becomes available.
+    void send(const element_type& element)
+    {
+        emplace(element);
+    }
+
+    //! Sends an element via the queue.
+    //! Moves the \p element to the end of the message queue. If the queue is
+    //! full, the calling thread is blocked until space becomes available.
+    void send(element_type&& element)
+    {
+        emplace(std::move(element));
+    }
+
+    //! Tries to send an element via the queue.
+    //! Tries to append a copy of the \p element to the queue. If no space
+    //! was available, \p false is returned. Otherwise the method returns
+    //! \p true. The calling thread is never blocked.
+    bool try_send(const element_type& element)
+    {
+        return try_emplace(element);
+    }
+
+    //! Tries to send an element via the queue.
+    //! Tries to move the \p element to the end of the queue. If no space was
+    //! available, \p false is returned and \p element is left untouched.
+    //! Otherwise the method returns \p true. The calling thread is never
+    //! blocked.
+    bool try_send(element_type&& element)
+    {
+        return try_emplace(std::move(element));
+    }
+
+    //! Tries to send an element via the queue.
+    //! Tries to append a copy of the given \p element to the queue and
+    //! returns \p true if successful. If there is no space available within
+    //! the duration \p d, the operation is aborted an \p false is returned.
+    template <typename RepT, typename PeriodT>
+    bool try_send_for(const element_type& element,
+                      const chrono::duration<RepT, PeriodT>& d)
+    {
+        return try_emplace_for(d, element);
+    }
+
+    //! Tries to send an element via the queue.
+    //! Tries to move the given \p element to the end of the queue and
+    //! returns \p true if successful. If there is no space available within
+    //! the duration \p d, the operation is aborted an \p false is returned.
+    template <typename RepT, typename PeriodT>
+    bool try_send_for(element_type&& element,
+                      const chrono::duration<RepT, PeriodT>& d)
+    {
+        return try_emplace_for(d, std::move(element));
+    }
+
+    //! Constructs an element in the queue.
+    //! Constructs an element from the given \p args directly in the queue's
+    //! storage at the end of the message queue. If the queue is full, the
+    //! calling thread is blocked until space becomes available.
+    template <typename... ArgsT>
+    void emplace(ArgsT&&... args)
+    {
+        if (!tryEmplace(std::forward<ArgsT>(args)...))
+        {
+            typename recorder_type::blocked_send blocked(*this);
+            m_notFull.wait(m_spinCount, [&] {
+                return tryEmplace(std::forward<ArgsT>(args)...); });
+        }
+        m_notEmpty.notify_one();
+    }
+
+    //! Tries to construct an element in the queue.
+    //! Tries to construct an element from the given \p args at the end of
+    //! the message queue. If no space was available, \p false is returned.
+    //! Otherwise the method returns \p true. The calling thread is never
+    //! blocked.
+    template <typename... ArgsT>
+    bool try_emplace(ArgsT&&... args)
+    {
+        if (!tryEmplace(std::forward<ArgsT>(args)...))
+            return false;
+        m_notEmpty.notify_one();
+        return true;
+    }
+
+    //! Tries to construct an element in the queue.
+    //! Tries to construct an element from the given \p args at the end of
+    //! the message queue and returns \p true if successful. If there is no
+    //! space available within the duration \p d, the operation is aborted
+    //! an \p false is returned.
+    template <typename RepT, typename PeriodT, typename... ArgsT>
+    bool try_emplace_for(const chrono::duration<RepT, PeriodT>& d,
+                         ArgsT&&... args)
+    {
+        if (!tryEmplace(std::forward<ArgsT>(args)...))
+        {
+            typename recorder_type::blocked_send blocked(*this);
+            if (!m_notFull.wait_until(
+                    detail::deadline_from_now(d), m_spinCount,
+                    [&] { return tryEmplace(std::forward<ArgsT>(args)...); }))
+            {
+                return false;
+            }
+        }
+        m_notEmpty.notify_one();
+        return true;
+    }
+
+    //! Sends a range of elements via the queue.
+    //! Sends the elements in the range [\p first, \p last) in order. As many
+    //! elements as fit into the queue are published with a single store and
+    //! the receiver is woken once per batch. If the queue is full, the
+    //! calling thread is blocked until space becomes available.
+    template <typename InputIteratorT>
+    void send_n(InputIteratorT first, InputIteratorT last)
+    {
+        while (first != last)
+        {
+            std::size_t count = tryPushRange(first, last);
+            if (count == 0)
+            {
+                typename recorder_type::blocked_send blocked(*this);
+                m_notFull.wait(m_spinCount, [&] {
+                    return (count = tryPushRange(first, last)) != 0; });
+            }
+            m_notEmpty.notify_one();
+        }
+    }
+
+    //! Tries to send a range of elements via the queue.
+    //! Appends as many elements from the range [\p first, \p last) as fit
+    //! into the queue and returns their number. The calling thread is never
+    //! blocked.
+    template <typename InputIteratorT>
+    std::size_t try_send_n(InputIteratorT first, InputIteratorT last)
+    {
+        std::size_t count = tryPushRange(first, last);
+        if (count != 0)
+            m_notEmpty.notify_one();
+        return count;
+    }
+
+    //! Receives a batch of elements from the queue.
+    //! Moves up to \p max elements from the queue to \p out and returns
+    //! their number. If the queue is empty, the calling thread is blocked
+    //! until at least one element is available.
+    template <typename OutputIteratorT>
+    std::size_t receive_n(OutputIteratorT out, std::size_t max)
+    {
+        if (max == 0)
+            return 0;
+
+        std::size_t count = tryPopRange(out, max);
+        if (count == 0)
+        {
+            typename recorder_type::blocked_receive blocked(*this);
+            m_notEmpty.wait(m_spinCount, [&] {
+                return (count = tryPopRange(out, max)) != 0; });
+        }
+        m_notFull.notify_one();
+        return count;
+    }
+
+    //! Tries to receive a batch of elements from the queue.
+    //! Moves up to \p max elements from the queue to \p out and returns
+    //! their number. The calling thread is never blocked.
+    template <typename OutputIteratorT>
+    std::size_t try_receive_n(OutputIteratorT out, std::size_t max)
+    {
+        std::size_t count = tryPopRange(out, max);
+        if (count != 0)
+            m_notFull.notify_one();
+        return count;
+    }
+
+private:
+    typedef typename std::aligned_storage<
+                         sizeof(element_type),
+                         std::alignment_of<element_type>::value>::type
+        slot_type;
+
+    // The ring buffer has one more slot than the capacity. This allows to
+    // distinguish between a full and an empty queue by looking only at the
+    // indices.
+    static const std::size_t num_slots = QueueSizeT + 1;
+
+    // ---- Data owned by the receiver.
+    //! The index of the first element.
+    alignas(WEOS_CACHE_LINE_SIZE) std::atomic<std::size_t> m_head;
+    //! The receiver's copy of m_tail. It is refreshed only when the queue
+    //! seems to be empty.
+    std::size_t m_cachedTail;
+
+    // ---- Data owned by the sender.
+    //! The index of the slot in which the next element will be stored.
+    alignas(WEOS_CACHE_LINE_SIZE) std::atomic<std::size_t> m_tail;
+    //! The sender's copy of m_head. It is refreshed only when the queue
+    //! seems to be full.
+    std::size_t m_cachedHead;
+
+    //! The ring buffer which holds the elements.
+    alignas(WEOS_CACHE_LINE_SIZE) slot_type m_slots[num_slots];
+
+    //! The receiver blocks here when the queue is empty.
+    detail::parking_spot m_notEmpty;
+    //! The sender blocks here when the queue is full.
+    detail::parking_spot m_notFull;
+    //! The number of spin iterations before blocking.
+    unsigned m_spinCount;
+
+    //! Returns the index which follows \p index.
+    static std::size_t next(std::size_t index)
+    {
+        return index + 1 == num_slots ? 0 : index + 1;
+    }
+
+    //! Returns a pointer to the element in the slot with the given \p index.
+    element_type* slot(std::size_t index)
+    {
+        return reinterpret_cast<element_type*>(&m_slots[index]);
+    }
+
+    //! Constructs an element from the \p args at the end of the queue unless
+    //! the queue is full. The arguments are only used if there is space. This
+    //! function must only be called by the sender.
+    template <typename... ArgsT>
+    bool tryEmplace(ArgsT&&... args)
+    {
+        std::size_t tail = m_tail.load(std::memory_order_relaxed);
+        std::size_t nextTail = next(tail);
+        if (nextTail == m_cachedHead)
+        {
+            m_cachedHead = m_head.load(std::memory_order_acquire);
+            if (nextTail == m_cachedHead)
+                return false;
+        }
+
+        ::new (static_cast<void*>(slot(tail)))
+                element_type(std::forward<ArgsT>(args)...);
+        this->recordSend(tail);
+        m_tail.store(nextTail, std::memory_order_release);
+        return true;
+    }
+
+    //! Moves the first element into the \p result unless the queue is empty.
+    //! This function must only be called by the receiver.
+    bool tryPop(optional<element_type>& result)
+    {
+        std::size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_cachedTail)
+        {
+            m_cachedTail = m_tail.load(std::memory_order_acquire);
+            if (head == m_cachedTail)
+                return false;
+        }
+
+        element_type* first = slot(head);
+        result.emplace(std::move(*first));
+        first->~element_type();
+        this->recordReceive(head);
+        m_head.store(next(head), std::memory_order_release);
+        return true;
+    }
+
+    //! Publishes the index reached by a batch when it goes out of scope.
+    //! If copying or moving an element throws in the middle of a batch, the
+    //! completed prefix is published nevertheless and the threads blocked
+    //! on the \p spot are woken, because the caller cannot do so anymore.
+    struct batch_publisher
+    {
+        batch_publisher(std::atomic<std::size_t>& index,
+                        detail::parking_spot& spot)
+            : position(index.load(std::memory_order_relaxed)),
+              count(0),
+              m_index(index),
+              m_spot(spot),
+              m_completed(false)
+        {
+        }
+
+        ~batch_publisher()
+        {
+            if (count == 0)
+                return;
+            m_index.store(position, std::memory_order_release);
+            if (!m_completed)
+                m_spot.notify(count);
+        }
+
+        batch_publisher(const batch_publisher&) = delete;
+        batch_publisher& operator= (const batch_publisher&) = delete;
+
+        //! Moves the batch to the \p nextPosition after one element has
+        //! been transferred.
+        void advance(std::size_t nextPosition)
+        {
+            position = nextPosition;
+            ++count;
+        }
+
+        //! Marks the batch as completed. The caller wakes the waiters.
+        void complete()
+        {
+            m_completed = true;
+        }
+
+        //! The index of the next element in the batch.
+        std::size_t position;
+        //! The number of elements which have been transferred.
+        std::size_t count;
+
+    private:
+        std::atomic<std::size_t>& m_index;
+        detail::parking_spot& m_spot;
+        bool m_completed;
+    };
+
+    //! Appends elements from [\p first, \p last) until the queue is full
+    //! and returns their number. The new tail is published once for the
+    //! whole batch. This function must only be called by the sender.
+    template <typename InputIteratorT>
+    std::size_t tryPushRange(InputIteratorT& first, InputIteratorT last)
+    {
+        batch_publisher batch(m_tail, m_notEmpty);
+        for (; first != last; ++first)
+        {
+            std::size_t nextTail = next(batch.position);
+            if (nextTail == m_cachedHead)
+            {
+                m_cachedHead = m_head.load(std::memory_order_acquire);
+                if (nextTail == m_cachedHead)
+                    break;
+            }
+
+            ::new (static_cast<void*>(slot(batch.position)))
+                    element_type(*first);
+            this->recordSend(batch.position);
+            batch.advance(nextTail);
+        }
+
+        batch.complete();
+        return batch.count;
+    }
+
+    //! Moves up to \p max elements to \p out and returns their number. The
+    //! new head is published once for the whole batch. If moving an element
+    //! to \p out throws, this element stays in the queue. This function must
+    //! only be called by the receiver.
+    template <typename OutputIteratorT>
+    std::size_t tryPopRange(OutputIteratorT& out, std::size_t max)
+    {
+        batch_publisher batch(m_head, m_notFull);
+        for (; batch.count < max; ++out)
+        {
+            if (batch.position == m_cachedTail)
+            {
+                m_cachedTail = m_tail.load(std::memory_order_acquire);
+                if (batch.position == m_cachedTail)
+                    break;
+            }
+
+            element_type* first = slot(batch.position);
+            *out = std::move(*first);
+            first->~element_type();
+            this->recordReceive(batch.position);
+            batch.advance(next(batch.position));
+        }
+
+        batch.complete();
+        return batch.count;
+    }
+
+    friend class wait_set;
+
+    //! Checks if an element seems to be available. Used by the wait_set.
+    bool canReceive() const
+    {
+        return m_head.load(std::memory_order_relaxed)
+               != m_tail.load(std::memory_order_acquire);
+    }
+
+    //! Registers the \p link of a wait_set, which is signalled whenever an
+    //! element is added.
+    void attachWaitSet(detail::wait_set_link* link)
+    {
+        m_notEmpty.attach(link);
+    }
+
+    //! Unregisters the \p link of a wait_set.
+    void detachWaitSet(detail::wait_set_link* link)
+    {
+        m_notEmpty.detach(link);
+    }
+};
+
+//! A multi-producer/multi-consumer message queue.
+//! This specialization may be used by any number of sending and receiving
+//! threads. It is a bounded queue where every slot carries a sequence number
+//! (Vyukov's algorithm). A sender claims a slot by advancing the enqueue
+//! position with a compare-and-swap and publishes the element by bumping the
+//! slot's sequence number; receivers proceed likewise. Thus, neither sending
+//! nor receiving takes a lock. A thread blocks only if the queue is full
+//! (sender) or empty (receiver).
+//!
+//! A sender has claimed its slot before it constructs the element. If the
+//! constructor throws, the slot is published as a tombstone, which receivers
+//! skip. Thus, the queue stays usable.
+//!
+//! Likewise, a receiver has claimed its slot before it moves the element
+//! out. If this throws and no other receiver has claimed a later slot yet,
+//! the claim is revoked and the element stays at the front of the queue.
+//! Otherwise, the slot is handed to the sender of the next round with the
+//! element still in it. This sender forwards the element to the receivers,
+//! i.e. the element is appended to the queue again.
+template <typename TypeT, std::size_t QueueSizeT>
+class message_queue<TypeT, QueueSizeT, mpmc_tag>
+        : private detail::message_queue_recorder<QueueSizeT>
+{
+    static_assert(QueueSizeT > 0, "The queue size must be nonzero.");
+
+    typedef detail::message_queue_recorder<QueueSizeT> recorder_type;
+
+public:
+    //! The type of the elements transfered via this message queue.
+    typedef TypeT element_type;
+
+#if defined(WEOS_ENABLE_MESSAGE_QUEUE_STATISTICS)
+    using recorder_type::statistics;
+    using recorder_type::reset_statistics;
+#endif // WEOS_ENABLE_MESSAGE_QUEUE_STATISTICS
+
+    //! Creates a message queue.
+    //! Creates an empty message queue.
+    message_queue()
+        : m_enqueuePosition(0),
+          m_dequeuePosition(0),
+          m_spinCount(WEOS_DEFAULT_SPIN_COUNT)
+    {
+        for (std::size_t index = 0; index < QueueSizeT; ++index)
+        {
+            m_cells[index].sequence.store(2 * index, std::memory_order_relaxed);
+            m_cells[index].constructed = false;
+        }
+    }
+
+    //! Destroys the message queue.
+    //! Destroys the message queue and all elements which are still stored
+    //! in it.
+    ~message_queue()
+    {
+        // An element which a receiver has given back may sit in a cell
+        // outside of [dequeue position, enqueue position).
+        for (std::size_t index = 0; index < QueueSizeT; ++index)
+        {
+            if (m_cells[index].constructed)
+                m_cells[index].element()->~element_type();
+        }
+    }
+
+    message_queue(const message_queue&) = delete;
+    message_queue& operator= (const message_queue&) = delete;
+
+    //! Returns the capacity.
+    //! Returns the maximum number of elements which the queue can hold.
+    std::size_t capacity() const
+    {
+        return QueueSizeT;
+    }
+
+    //! Returns the number of iterations a thread spins before it blocks.
+    unsigned spin_count() const
+    {
+        return m_spinCount;
+    }
+
+    //! Sets the number of iterations a thread spins before it blocks on an
+    //! empty or full queue to \p spinCount. Zero disables spinning. The
+    //! default is WEOS_DEFAULT_SPIN_COUNT.
+    void set_spin_count(unsigned spinCount)
+    {
+        m_spinCount = spinCount;
+    }
+
+    //! Receives an element from the queue.
+    //! Returns the first element from the message queue. If the queue is
+    //! empty, the calling thread is blocked until an element is added.
+    element_type receive()
+    {
+        optional<element_type> result;
+        if (!tryPop(result))
+        {
+            typename recorder_type::blocked_receive blocked(*this);
+            m_notEmpty.wait(m_spinCount, [&] { return tryPop(result); });
+        }
+        m_notFull.notify_one();
+        return std::move(*result);
+    }
+
+    //! Tries to receive an element from the queue.
+    //! Tries to receive an element from the message queue. If the queue was
+    //! non-empty, the first element is moved into the returned optional.
+    //! Otherwise, the returned optional is empty.
+    optional<element_type> try_receive()
+    {
+        optional<element_type> result;
+        if (tryPop(result))
+            m_notFull.notify_one();
+        return result;
+    }
+
+    //! Tries to receive an element from the queue.
+    //! Tries to receive an element from the message queue within the timeout
+    //! duration \p d. If an element is available in time, it is moved into
+    //! the returned optional. Otherwise, the returned optional is empty.
+    template <typename RepT, typename PeriodT>
+    optional<element_type> try_receive_for(
+            const chrono::duration<RepT, PeriodT>& d)
+    {
+        optional<element_type> result;
+        if (!tryPop(result))
+        {
+            typename recorder_type::blocked_receive blocked(*this);
+            if (!m_notEmpty.wait_until(detail::deadline_from_now(d),
+                                       m_spinCount,
+                                       [&] { return tryPop(result); }))
+            {
+                return result;
+            }
+        }
+        m_notFull.notify_one();
+        return result;
+    }
+
+    //! Sends an element via the queue.
+    //! Sends the \p element by appending a copy of it at the end of the
+    //! message queue. If the queue is full, the calling thread is blocked
+    //! until space becomes available.
+    void send(const element_type& element)
+    {
+        emplace(element);
+    }
+
+    //! Sends an element via the queue.
+    //! Moves the \p element to the end of the message queue. If the queue is
+    //! full, the calling thread is blocked until space becomes available.
+    void send(element_type&& element)
+    {
+        emplace(std::move(element));
+    }
+
+    //! Tries to send an element via the queue.
+    //! Tries to append a copy of the \p element to the queue. If no space
+    //! was available, \p false is returned. Otherwise the method returns
+    //! \p true. The calling thread is never blocked.
+    bool try_send(const element_type& element)
+    {
+        return try_emplace(element);
+    }
+
+    //! Tries to send an element via the queue.
+    //! Tries to move the \p element to the end of the queue. If no space was
+    //! available, \p false is returned and \p element is left untouched.
+    //! Otherwise the method returns \p true. The calling thread is never
+    //! blocked.
+    bool try_send(element_type&& element)
+    {
+        return try_emplace(std::move(element));
+    }
+
+    //! Tries to send an element via the queue.
+    //! Tries to append a copy of the given \p element to the queue and
+    //! returns \p true if successful. If there is no space available within
+    //! the duration \p d, the operation is aborted an \p false is returned.
+    template <typename RepT, typename PeriodT>
+    bool try_send_for(const element_type& element,
+                      const chrono::duration<RepT, PeriodT>& d)
+    {
+        return try_emplace_for(d, element);
+    }
+
+    //! Tries to send an element via the queue.
+    //! Tries to move the given \p element to the end of the queue and
+    //! returns \p true if successful. If there is no space available within
+    //! the duration \p d, the operation is aborted an \p false is returned.
+    template <typename RepT, typename PeriodT>
+    bool try_send_for(element_type&& element,
+                      const chrono::duration<RepT, PeriodT>& d)
+    {
+        return try_emplace_for(d, std::move(element));
+    }
+
+    //! Constructs an element in the queue.
+    //! Constructs an element from the given \p args directly in the queue's
+    //! storage at the end of the message queue. If the queue is full, the
+    //! calling thread is blocked until space becomes available.
+    template <typename... ArgsT>
+    void emplace(ArgsT&&... args)
+    {
+        if (!tryEmplace(std::forward<ArgsT>(args)...))
+        {
+            typename recorder_type::blocked_send blocked(*this);
+            m_notFull.wait(m_spinCount, [&] {
+                return tryEmplace(std::forward<ArgsT>(args)...); });
+        }
+        m_notEmpty.notify_one();
+    }
+
+    //! Tries to construct an element in the queue.
+    //! Tries to construct an element from the given \p args at the end of
+    //! the message queue. If no space was available, \p false is returned.
+    //! Otherwise the method returns \p true. The calling thread is never
+    //! blocked.
+    template <typename... ArgsT>
+    bool try_emplace(ArgsT&&... args)
+    {
+        if (!tryEmplace(std::forward<ArgsT>(args)...))
+            return false;
+        m_notEmpty.notify_one();
+        return true;
+    }
+
+    //! Tries to construct an element in the queue.
+    //! Tries to construct an element from the given \p args at the end of
+    //! the message queue and returns \p true if successful. If there is no
+    //! space available within the duration \p d, the operation is aborted
+    //! an \p false is returned.
+    template <typename RepT, typename PeriodT, typename... ArgsT>
+    bool try_emplace_for(const chrono::duration<RepT, PeriodT>& d,
+                         ArgsT&&... args)
+    {
+        if (!tryEmplace(std::forward<ArgsT>(args)...))
+        {
+            typename recorder_type::blocked_send blocked(*this);
+            if (!m_notFull.wait_until(
+                    detail::deadline_from_now(d), m_spinCount,
+                    [&] { return tryEmplace(std::forward<ArgsT>(args)...); }))
+            {
+                return false;
+            }
+        }
+        m_notEmpty.notify_one();
+        return true;
+    }
+
+    //! Sends a range of elements via the queue.
+    //! Sends the elements in the range [\p first, \p last) in order. The
+    //! receivers are woken once per batch of elements which fit into the
+    //! queue. If the queue is full, the calling thread is blocked until
+    //! space becomes available. Elements from concurrent senders may be
+    //! interleaved with the range.
+    template <typename InputIteratorT>
+    void send_n(InputIteratorT first, InputIteratorT last)
+    {
+        while (first != last)
+        {
+            std::size_t count = tryPushRange(first, last);
+            if (count == 0)
+            {
+                typename recorder_type::blocked_send blocked(*this);
+                m_notFull.wait(m_spinCount, [&] {
+                    return (count = tryPushRange(first, last)) != 0; });
+            }
+            m_notEmpty.notify(count);
+        }
+    }
+
+    //! Tries to send a range of elements via the queue.
+    //! Appends as many elements from the range [\p first, \p last) as fit
+    //! into the queue and returns their number. The calling thread is never
+    //! blocked.
+    template <typename InputIteratorT>
+    std::size_t try_send_n(InputIteratorT first, InputIteratorT last)
+    {
+        std::size_t count = tryPushRange(first, last);
+        m_notEmpty.notify(count);
+        return count;
+    }
+
+    //! Receives a batch of elements from the queue.
+    //! Moves up to \p max elements from the queue to \p out and returns
+    //! their number. If the queue is empty, the calling thread is blocked
+    //! until at least one element is available.
+    template <typename OutputIteratorT>
+    std::size_t receive_n(OutputIteratorT out, std::size_t max)
+    {
+        if (max == 0)
+            return 0;
+
+        std::size_t count = tryPopRange(out, max);
+        if (count == 0)
+        {
+            typename recorder_type::blocked_receive blocked(*this);
+            m_notEmpty.wait(m_spinCount, [&] {
+                return (count = tryPopRange(out, max)) != 0; });
+        }
+        m_notFull.notify(count);
+        return count;
+    }
+
+    //! Tries to receive a batch of elements from the queue.
+    //! Moves up to \p max elements from the queue to \p out and returns
+    //! their number. The calling thread is never blocked.
+    template <typename OutputIteratorT>
+    std::size_t try_receive_n(OutputIteratorT out, std::size_t max)
+    {
+        std::size_t count = tryPopRange(out, max);
+        m_notFull.notify(count);
+        return count;
+    }
+
+private:
+    //! The type of the enqueue and dequeue positions and of the sequence
+    //! numbers. They are 64 bits wide even on 32-bit targets because they
+    //! grow forever. A narrower counter would wrap after 2^31 elements.
+    //! Then the slot index would jump unless the queue size is a power of
+    //! two, and the signed sequence comparison would overflow.
+    typedef std::uint64_t position_type;
+
+    //! A slot of the queue.
+    struct cell
+    {
+        //! The sequence number of this cell. If it equals twice the enqueue
+        //! position, the cell is free. If it equals twice the dequeue
+        //! position plus one, the cell holds an element. Keeping free and
+        //! occupied cells at even and odd numbers makes the sequence numbers
+        //! unambiguous even for a queue with a single slot.
+        std::atomic<position_type> sequence;
+        //! Set if the storage holds an element. A cell whose sequence number
+        //! marks it as occupied but which holds no element is a tombstone.
+        //! A cell whose sequence number marks it as free but which holds an
+        //! element has been given back by a receiver.
+        bool constructed;
+        //! The storage for the element.
+        typename std::aligned_storage<
+                     sizeof(element_type),
+                     std::alignment_of<element_type>::value>::type storage;
+
+        element_type* element()
+        {
+            return reinterpret_cast<element_type*>(&storage);
+        }
+    };
+
+    //! Stores a sequence number to a cell when it goes out of scope. This
+    //! publishes the cell even if constructing an element throws. In this
+    //! case, a thread blocked on the \p spot is woken, because the caller
+    //! cannot do so anymore. Otherwise, a receiver would never skip the
+    //! tombstone.
+    struct sequence_publisher
+    {
+        sequence_publisher(std::atomic<position_type>& sequence,
+                           position_type value, detail::parking_spot& spot)
+            : m_sequence(sequence),
+              m_value(value),
+              m_spot(spot),
+              m_completed(false)
+        {
+        }
+
+        ~sequence_publisher()
+        {
+            m_sequence.store(m_value, std::memory_order_release);
+            if (!m_completed)
+                m_spot.notify_one();
+        }
+
+        sequence_publisher(const sequence_publisher&) = delete;
+        sequence_publisher& operator= (const sequence_publisher&) = delete;
+
+        //! Marks the operation as completed. The caller wakes the waiters.
+        void complete()
+        {
+            m_completed = true;
+        }
+
+    private:
+        std::atomic<position_type>& m_sequence;
+        position_type m_value;
+        detail::parking_spot& m_spot;
+        bool m_completed;
+    };
+
+    //! Gives the element of a claimed cell back to the queue if it goes out
+    //! of scope before the element has been handed out.
+    struct element_returner
+    {
+        element_returner(message_queue& queue, cell& c, position_type position)
+            : m_queue(queue),
+              m_cell(c),
+              m_position(position),
+              m_completed(false)
+        {
+        }
+
+        ~element_returner()
+        {
+            if (!m_completed)
+                m_queue.giveBack(m_cell, m_position);
+        }
+
+        element_returner(const element_returner&) = delete;
+        element_returner& operator= (const element_returner&) = delete;
+
+        //! Marks the element as handed out.
+        void complete()
+        {
+            m_completed = true;
+        }
+
+    private:
+        message_queue& m_queue;
+        cell& m_cell;
+        position_type m_position;
+        bool m_completed;
+    };
+
+    //! The position at which the next element will be enqueued.
+    alignas(WEOS_CACHE_LINE_SIZE) std::atomic<position_type> m_enqueuePosition;
+    //! The position from which the next element will be dequeued.
+    alignas(WEOS_CACHE_LINE_SIZE) std::atomic<position_type> m_dequeuePosition;
+    //! The slots of the queue.
+    alignas(WEOS_CACHE_LINE_SIZE) cell m_cells[QueueSizeT];
+
+    //! Receivers block here when the queue is empty.
+    detail::parking_spot m_notEmpty;
+    //! Senders block here when the queue is full.
+    detail::parking_spot m_notFull;
+    //! The number of spin iterations before blocking.
+    unsigned m_spinCount;
+
+    //! Constructs an element from the \p args at the end of the queue unless
+    //! the queue is full. The arguments are only used if there is space.
+    template <typename... ArgsT>
+    bool tryEmplace(ArgsT&&... args)
+    {
+        while (true)
+        {
+            position_type position
+                    = m_enqueuePosition.load(std::memory_order_relaxed);
+            cell* c;
+            while (true)
+            {
+                c = &m_cells[position % QueueSizeT];
+                position_type sequence
+                        = c->sequence.load(std::memory_order_acquire);
+                std::int64_t difference = std::int64_t(sequence)
+                                          - std::int64_t(2 * position);
+                if (difference == 0)
+                {
+                    // The cell is free. Try to claim it.
+                    if (m_enqueuePosition.compare_exchange_weak(
+                            position, position + 1, std::memory_order_relaxed))
+                    {
+                        break;
+                    }
+                }
+                else if (difference < 0)
+                {
+                    // The cell still holds the element from the previous
+                    // round.
+                    return false;
+                }
+                else
+                {
+                    // Another sender has claimed the cell.
+                    position = m_enqueuePosition.load(
+                                   std::memory_order_relaxed);
+                }
+            }
+
+            if (c->constructed)
+            {
+                // A receiver has given the element back. Forward it to the
+                // receivers and look for another cell.
+                c->sequence.store(2 * position + 1, std::memory_order_release);
+                m_notEmpty.notify_one();
+                continue;
+            }
+
+            // If the constructor throws, the cell is published as a
+            // tombstone. Otherwise, receivers would wait for it forever.
+            sequence_publisher publisher(c->sequence, 2 * position + 1,
+                                         m_notEmpty);
+            ::new (static_cast<void*>(c->element()))
+                    element_type(std::forward<ArgsT>(args)...);
+            c->constructed = true;
+            this->recordSend(position % QueueSizeT);
+            publisher.complete();
+            return true;
+        }
+    }
+
+    //! Moves the first element into the \p result unless the queue is
+    //! empty.
+    bool tryPop(optional<element_type>& result)
+    {
+        return tryConsume([&](element_type& element) {
+            result.emplace(std::move(element)); });
+    }
+
+    //! Passes the first element to \p consume and removes it unless the
+    //! queue is empty. If \p consume throws, the element is given back.
+    template <typename ConsumerT>
+    bool tryConsume(ConsumerT&& consume)
+    {
+        while (true)
+        {
+            position_type position
+                    = m_dequeuePosition.load(std::memory_order_relaxed);
+            cell* c;
+            while (true)
+            {
+                c = &m_cells[position % QueueSizeT];
+                position_type sequence
+                        = c->sequence.load(std::memory_order_acquire);
+                std::int64_t difference = std::int64_t(sequence)
+                                          - std::int64_t(2 * position + 1);
+                if (difference == 0)
+                {
+                    // The cell holds an element. Try to claim it. Acquire
+                    // the element of a receiver which has given it back.
+                    if (m_dequeuePosition.compare_exchange_weak(
+                            position, position + 1, std::memory_order_acquire,
+                            std::memory_order_relaxed))
+                    {
+                        break;
+                    }
+                }
+                else if (difference < 0)
+                {
+                    // The cell has not been filled, yet.
+                    return false;
+                }
+                else
+                {
+                    // Another receiver has claimed the cell.
+                    position = m_dequeuePosition.load(
+                                   std::memory_order_relaxed);
+                }
+            }
+
+            if (!c->constructed)
+            {
+                // Skip the tombstone and give the cell back to the senders.
+                c->sequence.store(2 * (position + QueueSizeT),
+                                  std::memory_order_release);
+                m_notFull.notify_one();
+                continue;
+            }
+
+            element_returner returner(*this, *c, position);
+            consume(*c->element());
+            returner.complete();
+            c->element()->~element_type();
+            c->constructed = false;
+            this->recordReceive(position % QueueSizeT);
+            // Release the cell for the sender in the next round.
+            c->sequence.store(2 * (position + QueueSizeT),
+                              std::memory_order_release);
+            return true;
+        }
+    }
+
+    //! Gives the element in the cell \p c back to the queue. The cell has
+    //! been claimed for the dequeue \p position. If no other receiver has
+    //! claimed a later position, the claim is revoked. Otherwise, the cell
+    //! is released to the sender of the next round, which forwards the
+    //! element.
+    void giveBack(cell& c, position_type position)
+    {
+        position_type expected = position + 1;
+        if (m_dequeuePosition.compare_exchange_strong(
+                expected, position, std::memory_order_release,
+                std::memory_order_relaxed))
+        {
+            m_notEmpty.notify_one();
+        }
+        else
+        {
+            c.sequence.store(2 * (position + QueueSizeT),
+                             std::memory_order_release);
+            m_notFull.notify_one();
+        }
+    }
+
+    //! Counts the elements transferred by a batch. If copying or moving an
+    //! element throws in the middle of a batch, the threads blocked on the
+    //! \p spot are woken for the completed prefix when the batch goes out
+    //! of scope, because the caller cannot do so anymore.
+    struct batch_notifier
+    {
+        explicit batch_notifier(detail::parking_spot& spot)
+            : count(0),
+              m_spot(spot),
+              m_completed(false)
+        {
+        }
+
+        ~batch_notifier()
+        {
+            if (!m_completed)
+                m_spot.notify(count);
+        }
+
+        batch_notifier(const batch_notifier&) = delete;
+        batch_notifier& operator= (const batch_notifier&) = delete;
+
+        //! Marks the batch as completed. The caller wakes the waiters.
+        void complete()
+        {
+            m_completed = true;
+        }
+
+        //! The number of elements which have been transferred.
+        std::size_t count;
+
+    private:
+        detail::parking_spot& m_spot;
+        bool m_completed;
+    };
+
+    //! Appends elements from [\p first, \p last) until the queue is full
+    //! and returns their number.
+    template <typename InputIteratorT>
+    std::size_t tryPushRange(InputIteratorT& first, InputIteratorT last)
+    {
+        batch_notifier batch(m_notEmpty);
+        for (; first != last && tryEmplace(*first); ++first)
+            ++batch.count;
+        batch.complete();
+        return batch.count;
+    }
+
+    //! Moves up to \p max elements to \p out and returns their number. If
+    //! moving an element to \p out throws, this element is given back to
+    //! the queue.
+    template <typename OutputIteratorT>
+    std::size_t tryPopRange(OutputIteratorT& out, std::size_t max)
+    {
+        auto moveToOut = [&](element_type& element) {
+            *out = std::move(element); };
+        batch_notifier batch(m_notFull);
+        for (; batch.count < max && tryConsume(moveToOut); ++out)
+            ++batch.count;
+        batch.complete();
+        return batch.count;
+    }
+
+    friend class wait_set;
+
+    //! Checks if an element seems to be available. Used by the wait_set.
+    bool canReceive() const
+    {
+        position_type position
+                = m_dequeuePosition.load(std::memory_order_relaxed);
+        while (true)
+        {
+            position_type sequence = m_cells[position % QueueSizeT].sequence.load(
+                                       std::memory_order_acquire);
+            std::int64_t difference = std::int64_t(sequence)
+                                      - std::int64_t(2 * position + 1);
+            if (difference == 0)
+                return true;
+            if (difference < 0)
+                return false;
+            // Another receiver has taken the element. Look at the next one.
+            position = m_dequeuePosition.load(std::memory_order_relaxed);
+        }
+    }
+
+    //! Registers the \p link of a wait_set, which is signalled whenever an
+    //! element is added.
+    void attachWaitSet(detail::wait_set_link* link)
+    {
+        m_notEmpty.attach(link);
+    }
+
+    //! Unregisters the \p link of a wait_set.
+    void detachWaitSet(detail::wait_set_link* link)
+    {
+        m_notEmpty.detach(link);
     }
 };
 
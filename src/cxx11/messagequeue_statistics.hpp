@@ -0,0 +1,264 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef WEOS_CXX11_MESSAGEQUEUE_STATISTICS_HPP
+#define WEOS_CXX11_MESSAGEQUEUE_STATISTICS_HPP
+
+#include "core.hpp"
+
+#include "chrono.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+
+WEOS_BEGIN_NAMESPACE
+
+//! A snapshot of the statistics of a message_queue.
+//! The statistics are only recorded if WEOS_ENABLE_MESSAGE_QUEUE_STATISTICS
+//! is defined.
+struct message_queue_statistics
+{
+    //! The number of buckets in the latency histogram.
+    static const std::size_t num_latency_buckets = 20;
+
+    //! The number of elements in the queue.
+    std::size_t size;
+    //! The maximum number of elements which have been in the queue at once.
+    std::size_t high_watermark;
+    //! The number of times a sender had to wait for a full queue.
+    std::uint32_t blocked_sends;
+    //! The number of times a receiver had to wait for an empty queue.
+    std::uint32_t blocked_receives;
+    //! The total time senders have waited for a full queue.
+    chrono::nanoseconds blocked_send_time;
+    //! The total time receivers have waited for an empty queue.
+    chrono::nanoseconds blocked_receive_time;
+    //! The time from sending to receiving an element. Bucket 0 counts the
+    //! elements which have been received within 1 us. Bucket i counts the
+    //! latencies in [2^(i-1), 2^i) us. The last bucket counts all larger
+    //! latencies, too.
+    std::uint32_t latency_histogram[num_latency_buckets];
+};
+
+namespace detail
+{
+
+#if defined(WEOS_ENABLE_MESSAGE_QUEUE_STATISTICS)
+
+//! Records the statistics of a message queue with \p NumSlotsT slots.
+//! All counters are updated with relaxed atomic operations. The message
+//! queue derives from this class and calls the record functions.
+template <std::size_t NumSlotsT>
+class message_queue_recorder
+{
+public:
+    message_queue_recorder()
+        : m_size(0)
+    {
+        reset_statistics();
+    }
+
+    //! Returns the statistics.
+    //! Returns a snapshot of the statistics. As the counters are read one
+    //! after the other, the snapshot need not be consistent if the queue is
+    //! used concurrently.
+    message_queue_statistics statistics() const
+    {
+        message_queue_statistics stats;
+        stats.size = m_size.load(std::memory_order_relaxed);
+        stats.high_watermark = m_highWatermark.load(std::memory_order_relaxed);
+        stats.blocked_sends = m_blockedSends.load(std::memory_order_relaxed);
+        stats.blocked_receives
+                = m_blockedReceives.load(std::memory_order_relaxed);
+        stats.blocked_send_time = chrono::nanoseconds(
+                m_blockedSendTime.load(std::memory_order_relaxed));
+        stats.blocked_receive_time = chrono::nanoseconds(
+                m_blockedReceiveTime.load(std::memory_order_relaxed));
+        for (std::size_t index = 0;
+             index < message_queue_statistics::num_latency_buckets; ++index)
+        {
+            stats.latency_histogram[index]
+                    = m_latencyHistogram[index].load(std::memory_order_relaxed);
+        }
+        return stats;
+    }
+
+    //! Resets the statistics.
+    //! Resets all counters and the latency histogram. The high watermark is
+    //! set to the current size.
+    void reset_statistics()
+    {
+        m_highWatermark.store(m_size.load(std::memory_order_relaxed),
+                              std::memory_order_relaxed);
+        m_blockedSends.store(0, std::memory_order_relaxed);
+        m_blockedReceives.store(0, std::memory_order_relaxed);
+        m_blockedSendTime.store(0, std::memory_order_relaxed);
+        m_blockedReceiveTime.store(0, std::memory_order_relaxed);
+        for (auto& bucket : m_latencyHistogram)
+            bucket.store(0, std::memory_order_relaxed);
+    }
+
+protected:
+    //! Measures the time a thread is blocked in a scope.
+    class blocking_scope
+    {
+    public:
+        blocking_scope(std::atomic<std::uint32_t>& count,
+                       std::atomic<std::int64_t>& time)
+            : m_count(count),
+              m_time(time),
+              m_start(chrono::steady_clock::now())
+        {
+        }
+
+        ~blocking_scope()
+        {
+            m_count.fetch_add(1, std::memory_order_relaxed);
+            m_time.fetch_add(
+                chrono::duration_cast<chrono::nanoseconds>(
+                    chrono::steady_clock::now() - m_start).count(),
+                std::memory_order_relaxed);
+        }
+
+        blocking_scope(const blocking_scope&) = delete;
+        blocking_scope& operator= (const blocking_scope&) = delete;
+
+    private:
+        std::atomic<std::uint32_t>& m_count;
+        std::atomic<std::int64_t>& m_time;
+        chrono::steady_clock::time_point m_start;
+    };
+
+    //! A scope in which a sender waits for a full queue.
+    class blocked_send : public blocking_scope
+    {
+    public:
+        explicit blocked_send(message_queue_recorder& recorder)
+            : blocking_scope(recorder.m_blockedSends,
+                             recorder.m_blockedSendTime)
+        {
+        }
+    };
+
+    //! A scope in which a receiver waits for an empty queue.
+    class blocked_receive : public blocking_scope
+    {
+    public:
+        explicit blocked_receive(message_queue_recorder& recorder)
+            : blocking_scope(recorder.m_blockedReceives,
+                             recorder.m_blockedReceiveTime)
+        {
+        }
+    };
+
+    //! Records that an element has been stored in the slot \p index. This
+    //! must be called before the element is published to the receivers.
+    void recordSend(std::size_t index)
+    {
+        m_sendTime[index] = chrono::steady_clock::now();
+        std::size_t size = m_size.fetch_add(1, std::memory_order_relaxed) + 1;
+        std::size_t watermark = m_highWatermark.load(std::memory_order_relaxed);
+        while (size > watermark
+               && !m_highWatermark.compare_exchange_weak(
+                       watermark, size, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    //! Records that the element in the slot \p index has been received. This
+    //! must be called before the slot is handed back to the senders.
+    void recordReceive(std::size_t index)
+    {
+        m_size.fetch_sub(1, std::memory_order_relaxed);
+        std::int64_t latency = chrono::duration_cast<chrono::microseconds>(
+                    chrono::steady_clock::now() - m_sendTime[index]).count();
+        std::size_t bucket = 0;
+        for (; latency > 0; latency >>= 1)
+            ++bucket;
+        if (bucket >= message_queue_statistics::num_latency_buckets)
+            bucket = message_queue_statistics::num_latency_buckets - 1;
+        m_latencyHistogram[bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<std::size_t> m_size;
+    std::atomic<std::size_t> m_highWatermark;
+    std::atomic<std::uint32_t> m_blockedSends;
+    std::atomic<std::uint32_t> m_blockedReceives;
+    std::atomic<std::int64_t> m_blockedSendTime;
+    std::atomic<std::int64_t> m_blockedReceiveTime;
+    std::atomic<std::uint32_t>
+        m_latencyHistogram[message_queue_statistics::num_latency_buckets];
+    //! The time at which the element in a slot has been sent. Each entry is
+    //! handed from the sender to the receiver along with the element.
+    chrono::steady_clock::time_point m_sendTime[NumSlotsT];
+};
+
+#else
+
+//! Records nothing. A message queue which derives from this class does not
+//! grow because of the empty base optimization and the record functions
+//! compile to nothing.
+template <std::size_t NumSlotsT>
+class message_queue_recorder
+{
+protected:
+    class blocked_send
+    {
+    public:
+        explicit blocked_send(message_queue_recorder&)
+        {
+        }
+    };
+
+    class blocked_receive
+    {
+    public:
+        explicit blocked_receive(message_queue_recorder&)
+        {
+        }
+    };
+
+    void recordSend(std::size_t)
+    {
+    }
+
+    void recordReceive(std::size_t)
+    {
+    }
+};
+
+#endif // WEOS_ENABLE_MESSAGE_QUEUE_STATISTICS
+
+} // namespace detail
+
+WEOS_END_NAMESPACE
+
+#endif // WEOS_CXX11_MESSAGEQUEUE_STATISTICS_HPP
@@ -31,8 +31,21 @@
 
 #include "core.hpp"
 
+#include "chrono.hpp"
+#include "futex.hpp"
+#include "spin.hpp"
+#include "../common/mutexlocks.hpp"
+
+#include <cstdint>
+#include <limits>
 #include <mutex>
 
+#if defined(__unix__) || defined(__APPLE__)
+    #include <cerrno>
+    #include <pthread.h>
+    #include <unistd.h>
+#endif
+
 
 WEOS_BEGIN_NAMESPACE
 
@@ -41,17 +54,627 @@ using std::timed_mutex;
 using std::recursive_mutex;
 using std::recursive_timed_mutex;
 
-using std::lock_guard;
-using std::unique_lock;
+//! A mutex which spins before it blocks.
+//! The adaptive_mutex is meant for short critical sections. The state of the
+//! mutex is an atomic word, so locking a free mutex and unlocking a mutex
+//! without waiters is a single atomic operation. If the mutex is locked, the
+//! calling thread spins for a bounded number of iterations, hoping that the
+//! owner releases the mutex soon. Only then it parks on a futex. unlock()
+//! enters the kernel only if a thread is parked.
+//!
+//! The adaptive_mutex satisfies the Lockable concept. It is neither
+//! recursive nor does it support priority inheritance.
+class adaptive_mutex
+{
+public:
+    //! Creates an unlocked mutex.
+    adaptive_mutex()
+        : m_state(unlocked),
+          m_spinCount(WEOS_ADAPTIVE_MUTEX_SPIN_COUNT)
+    {
+    }
+
+    adaptive_mutex(const adaptive_mutex&) = delete;
+    adaptive_mutex& operator= (const adaptive_mutex&) = delete;
+
+    //! Locks the mutex.
+    //! Blocks the current thread until this mutex has been locked by it.
+    void lock()
+    {
+        std::uint32_t expected = unlocked;
+        if (!m_state.compare_exchange_strong(expected, locked,
+                                             std::memory_order_acquire,
+                                             std::memory_order_relaxed))
+        {
+            lockSlow();
+        }
+    }
+
+    //! Tests and locks the mutex if it is available.
+    //! If this mutex is available, it is locked by the calling thread and
+    //! \p true is returned. If the mutex is already locked, the method
+    //! returns \p false without blocking.
+    bool try_lock()
+    {
+        std::uint32_t expected = unlocked;
+        return m_state.compare_exchange_strong(expected, locked,
+                                               std::memory_order_acquire,
+                                               std::memory_order_relaxed);
+    }
+
+    //! Unlocks the mutex.
+    //! Unlocks this mutex which must have been locked previously by the
+    //! calling thread.
+    void unlock()
+    {
+        if (m_state.exchange(unlocked, std::memory_order_release) == contended)
+            detail::futex_wake(m_state, 1);
+    }
+
+    //! Returns the number of iterations a thread spins before it blocks.
+    unsigned spin_count() const
+    {
+        return m_spinCount;
+    }
+
+    //! Sets the number of iterations a thread spins on a locked mutex before
+    //! it blocks to \p spinCount. Zero disables spinning. The default is
+    //! WEOS_ADAPTIVE_MUTEX_SPIN_COUNT.
+    void set_spin_count(unsigned spinCount)
+    {
+        m_spinCount = spinCount;
+    }
+
+private:
+    enum
+    {
+        //! The mutex is free.
+        unlocked = 0,
+        //! The mutex is locked and no thread is parked.
+        locked = 1,
+        //! The mutex is locked and threads may be parked.
+        contended = 2
+    };
+
+    //! The state of the mutex. This is the futex word, too.
+    detail::futex_word m_state;
+    //! The number of spin iterations before blocking.
+    unsigned m_spinCount;
+
+    void lockSlow()
+    {
+        if (detail::spin_until(m_spinCount, [this] { return try_lock(); }))
+            return;
+
+        // Mark the mutex as contended before parking, such that the owner
+        // wakes us up. As we cannot know if other threads are parked, the
+        // mutex stays contended once we have acquired it.
+        while (m_state.exchange(contended, std::memory_order_acquire)
+               != unlocked)
+        {
+            detail::futex_wait(m_state, contended);
+        }
+    }
+};
+
+//! A reader-writer mutex.
+//! The shared_mutex can be locked exclusively by one writer or shared by
+//! many readers. Writers are preferred: as soon as a writer waits, no new
+//! reader enters, so a steady stream of readers cannot starve a writer. As
+//! a consequence, a reader must not lock the mutex a second time.
+//!
+//! The mutex is an atomic word holding the number of readers, the number
+//! of waiting writers, a flag for parked readers and a flag for the owning
+//! writer. Readers which do not meet a writer only update this word and
+//! never enter the kernel. Blocked readers and writers park on this word
+//! with different futex masks. Unlocking changes the word once and then
+//! only wakes threads by its address, so a thread which locks the mutex
+//! afterwards may destroy it right away.
+class shared_mutex
+{
+public:
+    //! Creates an unlocked mutex.
+    shared_mutex()
+        : m_state(0)
+    {
+    }
+
+    shared_mutex(const shared_mutex&) = delete;
+    shared_mutex& operator= (const shared_mutex&) = delete;
+
+    //! Locks the mutex exclusively.
+    //! Blocks the current thread until it owns the mutex exclusively.
+    void lock()
+    {
+        if (!try_lock())
+            lockSlow();
+    }
+
+    //! Tries to lock the mutex exclusively.
+    //! Returns \p true if the mutex was free and has been locked. Otherwise,
+    //! \p false is returned without blocking.
+    bool try_lock()
+    {
+        std::uint32_t state = m_state.load(std::memory_order_relaxed);
+        // A reader which has timed out may have left its flag behind.
+        while ((state & ~readers_parked) == 0)
+        {
+            if (m_state.compare_exchange_weak(state, state | writer_bit,
+                                              std::memory_order_acquire,
+                                              std::memory_order_relaxed))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //! Unlocks the mutex, which the calling thread must own exclusively.
+    void unlock()
+    {
+        release(writer_bit);
+    }
+
+    //! Locks the mutex shared.
+    //! Blocks the current thread until neither a writer owns the mutex nor
+    //! waits for it.
+    void lock_shared()
+    {
+        std::uint32_t state = m_state.load(std::memory_order_relaxed);
+        if (   (state & blocks_readers) != 0
+            || !m_state.compare_exchange_weak(state, state + 1,
+                                              std::memory_order_acquire,
+                                              std::memory_order_relaxed))
+        {
+            lockSharedSlow();
+        }
+    }
+
+    //! Tries to lock the mutex shared.
+    //! Returns \p true if the mutex has been locked shared. If a writer owns
+    //! the mutex or waits for it, \p false is returned without blocking.
+    bool try_lock_shared()
+    {
+        std::uint32_t state = m_state.load(std::memory_order_relaxed);
+        while ((state & blocks_readers) == 0)
+        {
+            WEOS_ASSERT((state & reader_mask) != reader_mask);
+            if (m_state.compare_exchange_weak(state, state + 1,
+                                              std::memory_order_acquire,
+                                              std::memory_order_relaxed))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //! Unlocks the mutex, which the calling thread must own shared.
+    void unlock_shared()
+    {
+        std::uint32_t state = m_state.fetch_sub(1, std::memory_order_release);
+        // The last reader hands the mutex over to the writer which waits
+        // for the readers to leave.
+        if ((state & writer_bit) != 0 && (state & reader_mask) == 1)
+            detail::futex_wake(m_state, 1, drain_waiter);
+    }
+
+protected:
+    //! The writer which owns the mutex.
+    static constexpr std::uint32_t writer_bit = 0x80000000;
+    //! The increment for a waiting writer.
+    static constexpr std::uint32_t waiting_writer = 0x00100000;
+    //! The number of waiting writers.
+    static constexpr std::uint32_t waiting_mask = 0x7FF00000;
+    //! Set while readers may be parked.
+    static constexpr std::uint32_t readers_parked = 0x00080000;
+    //! The number of readers.
+    static constexpr std::uint32_t reader_mask = 0x0007FFFF;
+    //! New readers are blocked by an owning or a waiting writer.
+    static constexpr std::uint32_t blocks_readers = writer_bit | waiting_mask;
+
+    //! The futex mask of parked readers.
+    static constexpr std::uint32_t reader_waiter = 1;
+    //! The futex mask of writers which park until the owning writer leaves.
+    static constexpr std::uint32_t writer_waiter = 2;
+    //! The futex mask of the owning writer which waits for the readers.
+    static constexpr std::uint32_t drain_waiter = 4;
+
+    //! The state of the mutex. All blocked threads park on this futex.
+    detail::futex_word m_state;
+
+    //! Tries to lock the mutex exclusively before the \p deadline.
+    bool tryLockUntil(const chrono::steady_clock::time_point& deadline)
+    {
+        if (try_lock())
+            return true;
+
+        std::uint32_t state = announceWriter();
+        while (!tryAcquireWriterBit(state))
+        {
+            if (!detail::futex_wait_until(m_state, state, deadline,
+                                          writer_waiter))
+            {
+                // The owner may have left meanwhile and its wake-up must not
+                // get lost.
+                release(waiting_writer);
+                return false;
+            }
+            state = m_state.load(std::memory_order_relaxed);
+        }
+
+        while (((state = m_state.load(std::memory_order_acquire))
+                & reader_mask) != 0)
+        {
+            if (!detail::futex_wait_until(m_state, state, deadline,
+                                          drain_waiter))
+            {
+                // Give up unless the last reader has left in the meantime.
+                state = m_state.load(std::memory_order_acquire);
+                while ((state & reader_mask) != 0)
+                {
+                    std::uint32_t newState = releasedState(state, writer_bit);
+                    if (m_state.compare_exchange_weak(
+                            state, newState,
+                            std::memory_order_seq_cst,
+                            std::memory_order_acquire))
+                    {
+                        wakeAfterRelease(state, newState);
+                        return false;
+                    }
+                }
+                return true;
+            }
+        }
+        return true;
+    }
+
+    //! Tries to lock the mutex shared before the \p deadline.
+    bool tryLockSharedUntil(const chrono::steady_clock::time_point& deadline)
+    {
+        std::uint32_t state;
+        while (!tryLockSharedOrPark(state))
+        {
+            if (!detail::futex_wait_until(m_state, state, deadline,
+                                          reader_waiter))
+            {
+                return try_lock_shared();
+            }
+        }
+        return true;
+    }
+
+private:
+    //! Registers a waiting writer, which blocks new readers, and returns
+    //! the new state.
+    std::uint32_t announceWriter()
+    {
+        return m_state.fetch_add(waiting_writer, std::memory_order_seq_cst)
+               + waiting_writer;
+    }
+
+    //! Turns the calling waiting writer into the owner if no other writer
+    //! owns the mutex. The \p state is updated to the one which has been
+    //! seen.
+    bool tryAcquireWriterBit(std::uint32_t& state)
+    {
+        while ((state & writer_bit) == 0)
+        {
+            if (m_state.compare_exchange_weak(
+                    state, state - waiting_writer + writer_bit,
+                    std::memory_order_acquire, std::memory_order_relaxed))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //! Locks the mutex shared if no writer blocks new readers. Otherwise,
+    //! sets the flag for parked readers and returns \p false. The \p state
+    //! is set to the one on which the reader has to park.
+    bool tryLockSharedOrPark(std::uint32_t& state)
+    {
+        state = m_state.load(std::memory_order_relaxed);
+        while (true)
+        {
+            if ((state & blocks_readers) == 0)
+            {
+                WEOS_ASSERT((state & reader_mask) != reader_mask);
+                if (m_state.compare_exchange_weak(state, state + 1,
+                                                  std::memory_order_acquire,
+                                                  std::memory_order_relaxed))
+                {
+                    return true;
+                }
+            }
+            else if ((state & readers_parked) != 0)
+            {
+                return false;
+            }
+            else if (m_state.compare_exchange_weak(
+                         state, state | readers_parked,
+                         std::memory_order_seq_cst,
+                         std::memory_order_relaxed))
+            {
+                state |= readers_parked;
+                return false;
+            }
+        }
+    }
+
+    void lockSlow()
+    {
+        std::uint32_t state = announceWriter();
+        while (!tryAcquireWriterBit(state))
+        {
+            detail::futex_wait(m_state, state, writer_waiter);
+            state = m_state.load(std::memory_order_relaxed);
+        }
+
+        // No new reader can enter. Wait until the current ones have left.
+        while (((state = m_state.load(std::memory_order_acquire))
+                & reader_mask) != 0)
+        {
+            detail::futex_wait(m_state, state, drain_waiter);
+        }
+    }
+
+    void lockSharedSlow()
+    {
+        std::uint32_t state;
+        while (!tryLockSharedOrPark(state))
+            detail::futex_wait(m_state, state, reader_waiter);
+    }
+
+    //! Returns the state after a writer has removed \p delta from the
+    //! \p state. If no writer blocks the readers anymore, the flag for
+    //! parked readers is cleared because they are going to be woken up.
+    static std::uint32_t releasedState(std::uint32_t state,
+                                       std::uint32_t delta)
+    {
+        std::uint32_t newState = state - delta;
+        if ((newState & blocks_readers) == 0)
+            newState &= ~readers_parked;
+        return newState;
+    }
+
+    //! Removes \p delta, which is the owning or a waiting writer, from the
+    //! state and wakes up the successors.
+    void release(std::uint32_t delta)
+    {
+        std::uint32_t state = m_state.load(std::memory_order_relaxed);
+        std::uint32_t newState;
+        do
+        {
+            newState = releasedState(state, delta);
+        } while (!m_state.compare_exchange_weak(state, newState,
+                                                std::memory_order_seq_cst,
+                                                std::memory_order_relaxed));
+        wakeAfterRelease(state, newState);
+    }
+
+    //! Wakes up the next writer or, if no writer waits, all readers after
+    //! a writer has changed the \p state to the \p newState. Only the
+    //! address of the futex is used because the mutex may have been
+    //! destroyed meanwhile.
+    void wakeAfterRelease(std::uint32_t state, std::uint32_t newState)
+    {
+        // An owning writer wakes the successors when it leaves.
+        if ((newState & writer_bit) != 0)
+            return;
+        if ((newState & waiting_mask) != 0)
+            detail::futex_wake(m_state, 1, writer_waiter);
+        else if ((state & readers_parked) != 0)
+            detail::futex_wake(m_state, std::numeric_limits<int>::max(),
+                               reader_waiter);
+    }
+};
+
+//! A reader-writer mutex with timeout support.
+class shared_timed_mutex : public shared_mutex
+{
+public:
+    shared_timed_mutex() = default;
+
+    //! Tries to lock the mutex exclusively within the duration \p d.
+    //! Returns \p true if the mutex has been locked.
+    template <typename RepT, typename PeriodT>
+    bool try_lock_for(const chrono::duration<RepT, PeriodT>& d)
+    {
+        return tryLockUntil(
+                   chrono::steady_clock::now()
+                   + chrono::duration_cast<chrono::steady_clock::duration>(d));
+    }
+
+    //! Tries to lock the mutex exclusively before the time point \p tp.
+    //! Returns \p true if the mutex has been locked.
+    template <typename ClockT, typename DurationT>
+    bool try_lock_until(const chrono::time_point<ClockT, DurationT>& tp)
+    {
+        return try_lock_for(tp - ClockT::now());
+    }
+
+    //! Tries to lock the mutex shared within the duration \p d.
+    //! Returns \p true if the mutex has been locked.
+    template <typename RepT, typename PeriodT>
+    bool try_lock_shared_for(const chrono::duration<RepT, PeriodT>& d)
+    {
+        return tryLockSharedUntil(
+                   chrono::steady_clock::now()
+                   + chrono::duration_cast<chrono::steady_clock::duration>(d));
+    }
+
+    //! Tries to lock the mutex shared before the time point \p tp.
+    //! Returns \p true if the mutex has been locked.
+    template <typename ClockT, typename DurationT>
+    bool try_lock_shared_until(const chrono::time_point<ClockT, DurationT>& tp)
+    {
+        return try_lock_shared_for(tp - ClockT::now());
+    }
+};
+
+#if defined(_POSIX_THREAD_PRIO_INHERIT) && (_POSIX_THREAD_PRIO_INHERIT > 0)
+
+namespace detail
+{
+
+//! A pthread mutex with a priority protocol.
+class pthread_protocol_mutex
+{
+public:
+    typedef pthread_mutex_t* native_handle_type;
+
+    pthread_protocol_mutex(const pthread_protocol_mutex&) = delete;
+    pthread_protocol_mutex& operator= (const pthread_protocol_mutex&) = delete;
+
+    //! Locks the mutex.
+    void lock()
+    {
+        int result = pthread_mutex_lock(&m_mutex);
+        if (result != 0)
+            throwError(result, "pthread_protocol_mutex::lock failed");
+    }
+
+    //! Tries to lock the mutex without blocking. Returns \p true if the
+    //! mutex has been locked.
+    bool try_lock()
+    {
+        int result = pthread_mutex_trylock(&m_mutex);
+        if (result == 0)
+            return true;
+        if (result != EBUSY)
+            throwError(result, "pthread_protocol_mutex::try_lock failed");
+        return false;
+    }
+
+    //! Unlocks the mutex.
+    //! This function is called from the destructors of the lock guards and
+    //! must not throw. Unlocking can only fail if the calling thread does
+    //! not own the mutex, which is asserted.
+    void unlock()
+    {
+        int result = pthread_mutex_unlock(&m_mutex);
+        WEOS_ASSERT(result == 0);
+        (void)result;
+    }
+
+    //! Returns the native pthread mutex.
+    native_handle_type native_handle()
+    {
+        return &m_mutex;
+    }
+
+protected:
+    //! Creates a mutex with the given \p protocol. The \p priorityCeiling
+    //! is only used by the protocol PTHREAD_PRIO_PROTECT.
+    pthread_protocol_mutex(int protocol, int priorityCeiling)
+    {
+        pthread_mutexattr_t attributes;
+        int result = pthread_mutexattr_init(&attributes);
+        if (result == 0)
+            result = pthread_mutexattr_setprotocol(&attributes, protocol);
+        if (result == 0 && protocol == PTHREAD_PRIO_PROTECT)
+        {
+            result = pthread_mutexattr_setprioceiling(&attributes,
+                                                      priorityCeiling);
+        }
+        if (result == 0)
+            result = pthread_mutex_init(&m_mutex, &attributes);
+        pthread_mutexattr_destroy(&attributes);
+        if (result != 0)
+            throwError(result, "pthread_protocol_mutex: creation failed");
+    }
+
+    ~pthread_protocol_mutex()
+    {
+        pthread_mutex_destroy(&m_mutex);
+    }
+
+    //! Throws a system_error for the pthread error code \p result.
+    static void throwError(int result, const char* message)
+    {
+        switch (result)
+        {
+        case EINVAL:
+            WEOS_THROW_SYSTEM_ERROR(errc::invalid_argument, message);
+            break;
+        case ENOMEM:
+        case EAGAIN:
+            WEOS_THROW_SYSTEM_ERROR(errc::not_enough_memory, message);
+            break;
+        case EDEADLK:
+            WEOS_THROW_SYSTEM_ERROR(errc::resource_deadlock_would_occur,
+                                    message);
+            break;
+        default:
+            WEOS_THROW_SYSTEM_ERROR(errc::operation_not_permitted, message);
+            break;
+        }
+    }
+
+    //! The native mutex.
+    pthread_mutex_t m_mutex;
+};
+
+} // namespace detail
+
+//! A mutex with priority inheritance.
+//! While a thread waits for the pi_mutex, the owner runs with the priority
+//! of the waiter if this is higher than its own. Thus, a thread of medium
+//! priority cannot delay a high-priority thread by preempting a
+//! low-priority owner (priority inversion). This bounds the time for which
+//! a high-priority thread waits to the duration of the critical section.
+//! Priorities only matter for threads with a real-time policy such as
+//! SCHED_FIFO.
+//!
+//! The pi_mutex is a pthread mutex with the protocol PTHREAD_PRIO_INHERIT.
+//! It satisfies the Lockable concept and is not recursive.
+class pi_mutex : public detail::pthread_protocol_mutex
+{
+public:
+    //! Creates an unlocked mutex.
+    pi_mutex()
+        : detail::pthread_protocol_mutex(PTHREAD_PRIO_INHERIT, 0)
+    {
+    }
+};
+
+#if defined(_POSIX_THREAD_PRIO_PROTECT) && (_POSIX_THREAD_PRIO_PROTECT > 0)
+
+//! A mutex with a priority ceiling.
+//! A thread which locks the priority_ceiling_mutex runs with the priority
+//! ceiling of the mutex until it unlocks it. If the ceiling is at least the
+//! priority of every thread which uses the mutex, no thread of medium
+//! priority can preempt the owner. Unlike priority inheritance, the boost
+//! happens when the mutex is locked, even if there is no contention.
+//!
+//! The priority_ceiling_mutex is a pthread mutex with the protocol
+//! PTHREAD_PRIO_PROTECT. A thread whose priority is above the ceiling
+//! cannot lock it. The mutex satisfies the Lockable concept and is not
+//! recursive.
+class priority_ceiling_mutex : public detail::pthread_protocol_mutex
+{
+public:
+    //! Creates an unlocked mutex with the given \p priorityCeiling, which
+    //! must be a valid SCHED_FIFO priority.
+    explicit priority_ceiling_mutex(int priorityCeiling)
+        : detail::pthread_protocol_mutex(PTHREAD_PRIO_PROTECT, priorityCeiling)
+    {
+    }
 
-using std::adopt_lock_t;
-using std::adopt_lock;
+    //! Returns the priority ceiling.
+    int priority_ceiling() const
+    {
+        int ceiling = 0;
+        pthread_mutex_getprioceiling(&m_mutex, &ceiling);
+        return ceiling;
+    }
+};
 
-using std::defer_lock_t;
-using std::defer_lock;
+#endif // _POSIX_THREAD_PRIO_PROTECT
 
-using std::try_to_lock_t;
-using std::try_to_lock;
+#endif // _POSIX_THREAD_PRIO_INHERIT
 
 WEOS_END_NAMESPACE
 
@@ -30,13 +30,34 @@
 #define WEOS_CXX11_SEMAPHORE_HPP
 
 #include "core.hpp"
+#include "chrono.hpp"
+#include "futex.hpp"
+#include "spin.hpp"
+#include "waitset_detail.hpp"
 
-#include <condition_variable>
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <limits>
 #include <mutex>
 
 WEOS_BEGIN_NAMESPACE
 
+//! A counting semaphore.
+//! The number of tokens and the number of blocked threads are kept in a
+//! single 64-bit atomic word. post() and a wait() which finds a token only
+//! update this word. A thread which has to wait blocks on a futex which
+//! overlays the tokens and post() enters the kernel only if such a thread
+//! is parked.
+//!
+//! post() does not access the semaphore after it has published the tokens
+//! except for waking the blocked threads by the address of the futex. Thus,
+//! a thread which takes a token may destroy the semaphore right away even
+//! if post() has not returned, yet.
+//!
+//! Several tokens can be released and acquired at once. A thread which
+//! waits for n tokens takes all of them atomically once they are available.
+//! Threads which wait for fewer tokens can overtake it.
 class semaphore
 {
 public:
@@ -46,25 +67,71 @@ public:
     //! Creates a semaphore.
     //! Creates a semaphore with an initial number of \p value tokens.
     semaphore(value_type value = 0)
-        : m_value(value)
+        : m_state(value),
+          m_spinCount(WEOS_DEFAULT_SPIN_COUNT)
     {
     }
 
+    semaphore(const semaphore&) = delete;
+    semaphore& operator= (const semaphore&) = delete;
+
     //! Releases a semaphore token.
     void post()
     {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        ++m_value;
-        m_conditionVariable.notify_one();
+        post(1);
+    }
+
+    //! Releases semaphore tokens.
+    //! Increases the semaphore's value by \p n. At most \p n waiting threads
+    //! are woken up unless a thread waits for more than one token.
+    void post(value_type n)
+    {
+        if (n == 0)
+            return;
+
+        std::uint64_t state = m_state.load(std::memory_order_relaxed);
+        while (true)
+        {
+            WEOS_ASSERT(tokens(state) <= max_tokens - n);
+            if ((state & wait_set_flag) != 0)
+            {
+                if (postObserved(n))
+                    return;
+                state = m_state.load(std::memory_order_relaxed);
+            }
+            // The sequentially consistent exchange pairs with the one in
+            // block(). Either a waiter sees the tokens or we see the waiter.
+            else if (m_state.compare_exchange_weak(state, state + n,
+                                                   std::memory_order_seq_cst,
+                                                   std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        wakeWaiters(state, n);
     }
 
     //! Waits until a semaphore token is available.
+    //! If the spin count is non-zero, the calling thread spins for a while
+    //! before it blocks.
     void wait()
     {
-        std::unique_lock<std::mutex> lock(m_mutex);
-        while (m_value == 0)
-            m_conditionVariable.wait(lock);
-        --m_value;
+        wait(1);
+    }
+
+    //! Waits until semaphore tokens are available.
+    //! Blocks the calling thread until \p n tokens are available and takes
+    //! them at once.
+    void wait(value_type n)
+    {
+        if (tryDecrement(n) || spin(n))
+            return;
+
+        block(n);
+        value_type value;
+        while (!tryDecrement(n, value))
+            detail::futex_wait(futexWord(), value);
+        unblock();
     }
 
     //! Tries to acquire a semaphore token.
@@ -73,7 +140,16 @@ public:
     //! \p false is returned.
     bool try_wait()
     {
-        return try_wait_for(std::chrono::seconds(0));
+        return tryDecrement(1);
+    }
+
+    //! Tries to acquire semaphore tokens.
+    //! Takes \p n tokens and returns \p true if they are available.
+    //! Otherwise, no token is taken and \p false is returned. The calling
+    //! thread is never blocked.
+    bool try_wait(value_type n)
+    {
+        return tryDecrement(n);
     }
 
     //! Tries to acquire a semaphore token within a timeout.
@@ -82,26 +158,226 @@ public:
     template <typename RepT, typename PeriodT>
     bool try_wait_for(const std::chrono::duration<RepT, PeriodT>& d)
     {
-        std::unique_lock<std::mutex> lock(m_mutex);
-        if (m_conditionVariable.wait_for(lock, d,
-                                         [this](){return m_value != 0;}))
-        {
-            --m_value;
+        return try_wait_for(1, d);
+    }
+
+    //! Tries to acquire semaphore tokens within a timeout.
+    //! Tries for a timeout period \p d to acquire \p n tokens at once and
+    //! returns \p true upon success. In case of a timeout, no token is
+    //! taken and \p false is returned.
+    template <typename RepT, typename PeriodT>
+    bool try_wait_for(value_type n,
+                      const std::chrono::duration<RepT, PeriodT>& d)
+    {
+        chrono::steady_clock::time_point deadline
+                = chrono::steady_clock::now()
+                  + chrono::duration_cast<chrono::steady_clock::duration>(d);
+
+        if (tryDecrement(n) || spin(n))
             return true;
+
+        block(n);
+        bool result;
+        value_type value;
+        while (!(result = tryDecrement(n, value)))
+        {
+            if (!detail::futex_wait_until(futexWord(), value, deadline))
+            {
+                result = tryDecrement(n);
+                break;
+            }
         }
-        return false;
+        unblock();
+        return result;
     }
 
     //! Returns the numer of semaphore tokens.
     value_type value() const
     {
-        return m_value;
+        return tokens(m_state.load(std::memory_order_relaxed));
+    }
+
+    //! Returns the number of iterations a waiting thread spins before it
+    //! blocks.
+    unsigned spin_count() const
+    {
+        return m_spinCount;
+    }
+
+    //! Sets the number of iterations a waiting thread spins before it
+    //! blocks to \p spinCount. Zero disables spinning. The default is
+    //! WEOS_DEFAULT_SPIN_COUNT.
+    void set_spin_count(unsigned spinCount)
+    {
+        m_spinCount = spinCount;
     }
 
 private:
-    std::mutex m_mutex;
-    std::condition_variable m_conditionVariable;
-    value_type m_value;
+    //! The largest number of tokens.
+    static constexpr std::uint64_t max_tokens = 0xFFFFFFFF;
+    //! The increment for a thread which is about to block or is blocked.
+    static constexpr std::uint64_t waiter = std::uint64_t(1) << 32;
+    //! The number of these threads.
+    static constexpr std::uint64_t waiter_mask
+            = std::uint64_t(0x3FFFFFFF) << 32;
+    //! Set while one of these threads waits for more than one token.
+    static constexpr std::uint64_t bulk_waiter_flag = std::uint64_t(1) << 62;
+    //! Set while a wait set observes this semaphore.
+    static constexpr std::uint64_t wait_set_flag = std::uint64_t(1) << 63;
+
+    //! The number of tokens in the low half, the number of threads which are
+    //! about to block or are blocked and the flags in the high half. The low
+    //! half is the futex word on which waiting threads block.
+    std::atomic<std::uint64_t> m_state;
+    //! The number of spin iterations before blocking.
+    unsigned m_spinCount;
+    //! Protects the list of wait sets.
+    std::mutex m_waitSetMutex;
+    //! The wait sets which observe this semaphore.
+    detail::wait_set_list m_waitSets;
+
+    friend class wait_set;
+
+    //! Returns the number of tokens in the \p state.
+    static value_type tokens(std::uint64_t state)
+    {
+        return value_type(state & max_tokens);
+    }
+
+    //! Returns the futex word on which waiting threads block.
+    detail::futex_word& futexWord()
+    {
+        return detail::futex_low_half(m_state);
+    }
+
+    //! Takes \p n tokens if they are available. Otherwise, \p value is
+    //! set to the number of tokens which have been seen.
+    bool tryDecrement(value_type n, value_type& value)
+    {
+        std::uint64_t state = m_state.load(std::memory_order_relaxed);
+        while ((value = tokens(state)) >= n)
+        {
+            if (m_state.compare_exchange_weak(state, state - n,
+                                              std::memory_order_acquire,
+                                              std::memory_order_relaxed))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //! Takes \p n tokens if they are available.
+    bool tryDecrement(value_type n)
+    {
+        value_type value;
+        return tryDecrement(n, value);
+    }
+
+    //! Spins until \p n tokens have been taken or the spin count is
+    //! exhausted.
+    bool spin(value_type n)
+    {
+        return detail::spin_until(m_spinCount, [this, n] {
+            return value() >= n && tryDecrement(n); });
+    }
+
+    //! Registers the calling thread, which waits for \p n tokens, before it
+    //! checks for tokens the last time.
+    void block(value_type n)
+    {
+        std::uint64_t state = m_state.load(std::memory_order_relaxed);
+        std::uint64_t newState;
+        do
+        {
+            WEOS_ASSERT((state & waiter_mask) != waiter_mask);
+            newState = state + waiter;
+            if (n > 1)
+                newState |= bulk_waiter_flag;
+        } while (!m_state.compare_exchange_weak(state, newState,
+                                                std::memory_order_seq_cst,
+                                                std::memory_order_relaxed));
+    }
+
+    //! Unregisters the calling thread. The last thread also clears the
+    //! flag for the threads which wait for more than one token.
+    void unblock()
+    {
+        std::uint64_t state = m_state.load(std::memory_order_relaxed);
+        std::uint64_t newState;
+        do
+        {
+            newState = state - waiter;
+            if ((newState & waiter_mask) == 0)
+                newState &= ~bulk_waiter_flag;
+        } while (!m_state.compare_exchange_weak(state, newState,
+                                                std::memory_order_relaxed));
+    }
+
+    //! Wakes the threads which have been blocked in the \p state before
+    //! \p n tokens have been released. Only the address of the futex is
+    //! used because a woken thread may have destroyed the semaphore.
+    void wakeWaiters(std::uint64_t state, value_type n)
+    {
+        std::uint64_t numWaiters = (state & waiter_mask) >> 32;
+        if (numWaiters == 0)
+            return;
+
+        // A thread which waits for several tokens may be unable to proceed
+        // while a thread behind it could. Thus, everybody is woken up in
+        // this case. Otherwise, at most n threads can take a token.
+        if ((state & bulk_waiter_flag) != 0)
+            detail::futex_wake(futexWord());
+        else
+            detail::futex_wake(futexWord(),
+                               wakeCount(std::min<std::uint64_t>(n,
+                                                                 numWaiters)));
+    }
+
+    //! Releases \p n tokens while wait sets observe the semaphore. The
+    //! tokens are published with the mutex held, so no wait set can detach
+    //! and the semaphore cannot be destroyed before the wait sets have been
+    //! signalled. Returns \p false without releasing the tokens if the last
+    //! wait set has gone meanwhile.
+    bool postObserved(value_type n)
+    {
+        std::lock_guard<std::mutex> lock(m_waitSetMutex);
+        // The flag only changes with the mutex held.
+        std::uint64_t state = m_state.load(std::memory_order_relaxed);
+        if ((state & wait_set_flag) == 0)
+            return false;
+
+        state = m_state.fetch_add(n, std::memory_order_seq_cst);
+        wakeWaiters(state, n);
+        m_waitSets.signal_all();
+        return true;
+    }
+
+    //! Converts the number of threads to wake to the type of futex_wake().
+    static int wakeCount(std::uint64_t count)
+    {
+        return count > std::uint64_t(std::numeric_limits<int>::max())
+               ? std::numeric_limits<int>::max() : int(count);
+    }
+
+    //! Registers the \p link of a wait_set, which is signalled whenever a
+    //! token is released.
+    void attachWaitSet(detail::wait_set_link* link)
+    {
+        std::lock_guard<std::mutex> lock(m_waitSetMutex);
+        if (m_waitSets.empty())
+            m_state.fetch_or(wait_set_flag, std::memory_order_seq_cst);
+        m_waitSets.attach(link);
+    }
+
+    //! Unregisters the \p link of a wait_set.
+    void detachWaitSet(detail::wait_set_link* link)
+    {
+        std::lock_guard<std::mutex> lock(m_waitSetMutex);
+        m_waitSets.detach(link);
+        if (m_waitSets.empty())
+            m_state.fetch_and(~wait_set_flag, std::memory_order_relaxed);
+    }
 };
 
 WEOS_END_NAMESPACE
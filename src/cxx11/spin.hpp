@@ -0,0 +1,99 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef WEOS_CXX11_SPIN_HPP
+#define WEOS_CXX11_SPIN_HPP
+
+#include "core.hpp"
+
+#include <thread>
+
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#endif
+
+
+WEOS_BEGIN_NAMESPACE
+
+namespace detail
+{
+
+//! Tells the CPU that the calling thread is in a spin-wait loop.
+//! On x86 this is the PAUSE instruction and on ARM the YIELD hint. Both
+//! reduce the power consumption and free resources for a sibling hardware
+//! thread.
+inline
+void cpu_relax()
+{
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+    _mm_pause();
+#elif defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#elif defined(__arm__) || defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+//! The number of iterations after which a spinning thread yields.
+static const unsigned spin_yield_interval = 64;
+
+//! Pauses a spin-wait loop in its \p iteration, which starts at 1. Every
+//! iteration issues a CPU pause hint and every spin_yield_interval-th
+//! iteration yields the processor, such that the thread for which the
+//! caller waits can run on the same core.
+inline
+void spin_pause(unsigned iteration)
+{
+    if (iteration % spin_yield_interval == 0)
+        std::this_thread::yield();
+    else
+        cpu_relax();
+}
+
+//! Spins until \p pred returns \p true but at most for \p spinCount
+//! iterations, which are paused with spin_pause().
+//! Returns \p true if the predicate became true while spinning. If
+//! \p spinCount is zero, the predicate is not evaluated at all.
+template <typename PredicateT>
+inline
+bool spin_until(unsigned spinCount, PredicateT&& pred)
+{
+    for (unsigned iteration = 1; iteration <= spinCount; ++iteration)
+    {
+        if (pred())
+            return true;
+        spin_pause(iteration);
+    }
+    return false;
+}
+
+} // namespace detail
+
+WEOS_END_NAMESPACE
+
+#endif // WEOS_CXX11_SPIN_HPP
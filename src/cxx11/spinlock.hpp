@@ -0,0 +1,252 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef WEOS_CXX11_SPINLOCK_HPP
+#define WEOS_CXX11_SPINLOCK_HPP
+
+#include "core.hpp"
+
+#include "spin.hpp"
+
+#include <atomic>
+#include <cstdint>
+
+
+WEOS_BEGIN_NAMESPACE
+
+//! A fair spinlock.
+//! The spinlock is a ticket lock: a thread which wants to lock it draws a
+//! ticket and spins until this ticket is served. Thus, the threads acquire
+//! the lock in the order of their arrival. A waiting thread never blocks
+//! but yields the processor from time to time. The spinlock is meant for
+//! critical sections which are much shorter than a sleep/wake-up round
+//! trip and for threads which run on separate cores. If more threads
+//! contend than there are cores, the lock is often handed over to a thread
+//! which is not running and the throughput collapses.
+//!
+//! The spinlock satisfies the Lockable concept. It is padded to a cache
+//! line, such that it does not share a line with unrelated data.
+class alignas(WEOS_CACHE_LINE_SIZE) spinlock
+{
+public:
+    //! Creates an unlocked spinlock.
+    spinlock()
+        : m_nextTicket(0),
+          m_servedTicket(0)
+    {
+    }
+
+    spinlock(const spinlock&) = delete;
+    spinlock& operator= (const spinlock&) = delete;
+
+    //! Locks the spinlock.
+    //! Spins until the calling thread has locked the spinlock.
+    void lock()
+    {
+        std::uint32_t ticket = m_nextTicket.fetch_add(
+                                   1, std::memory_order_relaxed);
+        for (unsigned iteration = 1;
+             m_servedTicket.load(std::memory_order_acquire) != ticket;
+             ++iteration)
+        {
+            detail::spin_pause(iteration);
+        }
+    }
+
+    //! Tries to lock the spinlock.
+    //! Returns \p true if the spinlock was free and has been locked.
+    //! Otherwise, \p false is returned immediately.
+    bool try_lock()
+    {
+        std::uint32_t served = m_servedTicket.load(std::memory_order_acquire);
+        std::uint32_t expected = served;
+        return m_nextTicket.compare_exchange_strong(expected, served + 1,
+                                                    std::memory_order_acquire,
+                                                    std::memory_order_relaxed);
+    }
+
+    //! Unlocks the spinlock, which must be held by the calling thread.
+    void unlock()
+    {
+        // Only the owner writes the served ticket.
+        m_servedTicket.store(
+                    m_servedTicket.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_release);
+    }
+
+private:
+    //! The ticket which is drawn by the next thread.
+    std::atomic<std::uint32_t> m_nextTicket;
+    //! The ticket of the thread which owns the lock.
+    std::atomic<std::uint32_t> m_servedTicket;
+};
+
+//! A fair queue spinlock.
+//! The mcs_lock (after Mellor-Crummey and Scott) queues the waiting threads
+//! in a linked list. Every thread spins on a flag in its own queue node,
+//! which resides in a separate cache line. The owner hands the lock over by
+//! clearing the flag of its successor. Thus, unlike the spinlock, a
+//! hand-over only touches the cache line of the next waiter, which scales
+//! better with the number of spinning threads. Like the spinlock, it
+//! should only be contended by threads which run on separate cores.
+//!
+//! The queue nodes are taken from a small thread-local pool, so a thread
+//! can hold up to WEOS_MCS_LOCK_MAX_NESTING mcs_locks at the same time.
+//! The mcs_lock satisfies the Lockable concept.
+class alignas(WEOS_CACHE_LINE_SIZE) mcs_lock
+{
+public:
+    //! Creates an unlocked lock.
+    mcs_lock()
+        : m_tail(nullptr),
+          m_owner(nullptr)
+    {
+    }
+
+    mcs_lock(const mcs_lock&) = delete;
+    mcs_lock& operator= (const mcs_lock&) = delete;
+
+    //! Locks the lock.
+    //! Spins until the calling thread has locked the lock.
+    void lock()
+    {
+        node* self = node::allocate();
+        self->next.store(nullptr, std::memory_order_relaxed);
+        self->locked.store(true, std::memory_order_relaxed);
+
+        node* predecessor = m_tail.exchange(self, std::memory_order_acq_rel);
+        if (predecessor)
+        {
+            predecessor->next.store(self, std::memory_order_release);
+            for (unsigned iteration = 1;
+                 self->locked.load(std::memory_order_acquire);
+                 ++iteration)
+            {
+                detail::spin_pause(iteration);
+            }
+        }
+        m_owner = self;
+    }
+
+    //! Tries to lock the lock.
+    //! Returns \p true if the lock was free and has been locked. Otherwise,
+    //! \p false is returned immediately.
+    bool try_lock()
+    {
+        node* self = node::allocate();
+        self->next.store(nullptr, std::memory_order_relaxed);
+
+        node* expected = nullptr;
+        if (m_tail.compare_exchange_strong(expected, self,
+                                           std::memory_order_acq_rel,
+                                           std::memory_order_relaxed))
+        {
+            m_owner = self;
+            return true;
+        }
+        node::release(self);
+        return false;
+    }
+
+    //! Unlocks the lock, which must be held by the calling thread.
+    void unlock()
+    {
+        node* self = m_owner;
+        node* successor = self->next.load(std::memory_order_acquire);
+        if (!successor)
+        {
+            node* expected = self;
+            if (m_tail.compare_exchange_strong(expected, nullptr,
+                                               std::memory_order_acq_rel,
+                                               std::memory_order_relaxed))
+            {
+                node::release(self);
+                return;
+            }
+
+            // A thread has enqueued itself but not yet linked its node.
+            for (unsigned iteration = 1;
+                 !(successor = self->next.load(std::memory_order_acquire));
+                 ++iteration)
+            {
+                detail::spin_pause(iteration);
+            }
+        }
+        successor->locked.store(false, std::memory_order_release);
+        node::release(self);
+    }
+
+private:
+    //! A queue node. Every waiting thread spins on its own node.
+    struct alignas(WEOS_CACHE_LINE_SIZE) node
+    {
+        //! The thread which waits after this one.
+        std::atomic<node*> next;
+        //! Set while the thread has to wait.
+        std::atomic<bool> locked;
+        //! Set while the node belongs to a lock.
+        bool inUse;
+
+        //! Takes a free node from the calling thread's pool.
+        static node* allocate()
+        {
+            node* nodes = pool();
+            for (unsigned index = 0; index < WEOS_MCS_LOCK_MAX_NESTING; ++index)
+            {
+                if (!nodes[index].inUse)
+                {
+                    nodes[index].inUse = true;
+                    return &nodes[index];
+                }
+            }
+            WEOS_ASSERT(false && "Too many nested mcs_locks.");
+            return nullptr;
+        }
+
+        //! Returns the node \p n to the pool of its thread.
+        static void release(node* n)
+        {
+            n->inUse = false;
+        }
+
+        static node* pool()
+        {
+            static thread_local node nodes[WEOS_MCS_LOCK_MAX_NESTING];
+            return nodes;
+        }
+    };
+
+    //! The last thread in the queue or a null-pointer if the lock is free.
+    std::atomic<node*> m_tail;
+    //! The node of the owner. It is only accessed by the owner.
+    node* m_owner;
+};
+
+WEOS_END_NAMESPACE
+
+#endif // WEOS_CXX11_SPINLOCK_HPP
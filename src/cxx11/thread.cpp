@@ -28,24 +28,70 @@
 
 #include "thread.hpp"
 
+#include <algorithm>
+#include <cstring>
 #include <map>
 
+#if defined(__unix__) || defined(__APPLE__)
+    #include <cerrno>
+    #include <sched.h>
+#endif
+#if defined(__linux__)
+    #include <sys/resource.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
 namespace weos
 {
 namespace detail
 {
 
+namespace
+{
+
+//! The pattern with which a stack is painted.
+const std::uint32_t STACK_PAINT = 0xA5C3A5C3u;
+
+} // anonymous namespace
+
+void ThreadData::paintStack(void* stack, std::size_t size)
+{
+    // Only whole, aligned words are painted.
+    std::uintptr_t begin = reinterpret_cast<std::uintptr_t>(stack);
+    std::uintptr_t end = begin + size;
+    begin = (begin + sizeof(std::uint32_t) - 1) & ~(sizeof(std::uint32_t) - 1);
+    end &= ~(sizeof(std::uint32_t) - 1);
+
+    paintedStack = reinterpret_cast<std::uint32_t*>(begin);
+    paintedStackSize = begin < end ? (end - begin) / sizeof(std::uint32_t) : 0;
+    std::fill(paintedStack, paintedStack + paintedStackSize, STACK_PAINT);
+}
+
+std::size_t ThreadData::stackUsage() const
+{
+    // Reading the stack of a running thread is racy. Volatile accesses make
+    // sure that every word is really read from memory.
+    const volatile std::uint32_t* word = paintedStack;
+    std::size_t numUnused = 0;
+    while (numUnused < paintedStackSize && word[numUnused] == STACK_PAINT)
+        ++numUnused;
+    return (paintedStackSize - numUnused) * sizeof(std::uint32_t);
+}
+
 ThreadDataManager& ThreadDataManager::instance()
 {
     static ThreadDataManager manager;
     return manager;
 }
 
-void ThreadDataManager::add(std::thread::id id, ThreadData* data)
+void ThreadDataManager::add(ThreadData* data)
 {
     std::lock_guard<std::mutex> lock(m_idToDataMutex);
+    std::thread::id id = std::this_thread::get_id();
     WEOS_ASSERT(m_idToData.find(id) == m_idToData.cend());
     m_idToData[id] = data;
+    currentData() = data;
 }
 
 ThreadData* ThreadDataManager::find(std::thread::id id)
@@ -58,13 +104,286 @@ ThreadData* ThreadDataManager::find(std::thread::id id)
         return nullptr;
 }
 
-void ThreadDataManager::remove(std::thread::id id)
+void ThreadDataManager::remove()
 {
     std::lock_guard<std::mutex> lock(m_idToDataMutex);
-    auto iter = m_idToData.find(id);
+    auto iter = m_idToData.find(std::this_thread::get_id());
     if (iter != m_idToData.end())
         m_idToData.erase(iter);
+    currentData() = nullptr;
 }
 
 } // namespace detail
+
+#if defined(__unix__) || defined(__APPLE__)
+
+namespace
+{
+
+//! The maximum length of a thread name including the terminating null.
+const std::size_t MAX_NAME_SIZE = 16;
+
+//! The data which is handed over to a thread created with attributes.
+struct NativeStartData
+{
+    std::shared_ptr<detail::ThreadData> data;
+    std::function<void()> fun;
+    char name[MAX_NAME_SIZE];
+    //! A scheduling policy which the thread has to apply to itself or -1.
+    int policy;
+    //! Set if the thread has to apply the nice value to itself.
+    bool hasNice;
+    //! The nice value of the thread.
+    int nice;
+};
+
+//! Throws a system_error for the pthread error code \p result.
+void throwError(int result, const char* message)
+{
+    switch (result)
+    {
+    case EINVAL:
+        WEOS_THROW_SYSTEM_ERROR(errc::invalid_argument, message);
+        break;
+    case ENOMEM:
+    case EAGAIN:
+        WEOS_THROW_SYSTEM_ERROR(errc::not_enough_memory, message);
+        break;
+    default:
+        WEOS_THROW_SYSTEM_ERROR(errc::operation_not_permitted, message);
+        break;
+    }
+}
+
+//! Converts the \p priority to a scheduling policy, a static priority and
+//! a nice value. The nice value is only meaningful for SCHED_OTHER.
+void toNativePriority(thread::attributes::Priority priority,
+                      int& policy, sched_param& param, int& nice)
+{
+    param.sched_priority = 0;
+    nice = 0;
+    switch (priority)
+    {
+    case thread::attributes::Idle:
+#if defined(SCHED_IDLE)
+        policy = SCHED_IDLE;
+#else
+        policy = SCHED_OTHER;
+#endif
+        break;
+    case thread::attributes::Low:
+        policy = SCHED_OTHER;
+        nice = 10;
+        break;
+    case thread::attributes::BelowNormal:
+        policy = SCHED_OTHER;
+        nice = 5;
+        break;
+    case thread::attributes::Normal:
+        policy = SCHED_OTHER;
+        break;
+    default:
+    {
+        policy = SCHED_FIFO;
+        int min = sched_get_priority_min(SCHED_FIFO);
+        int max = sched_get_priority_max(SCHED_FIFO);
+        int level = priority - thread::attributes::Normal;
+        int numLevels = thread::attributes::Realtime
+                        - thread::attributes::Normal;
+        param.sched_priority = min + (max - min) * level / numLevels;
+        break;
+    }
+    }
+}
+
+} // anonymous namespace
+
+void thread::invokeNative(const attributes& attrs, std::function<void()> fun)
+{
+    if (attrs.m_name && std::strlen(attrs.m_name) >= MAX_NAME_SIZE)
+        WEOS_THROW_SYSTEM_ERROR(errc::invalid_argument,
+                                "thread::invoke: name is too long");
+    if (attrs.m_stackPainting && !attrs.m_customStack)
+        WEOS_THROW_SYSTEM_ERROR(errc::invalid_argument,
+                                "thread::invoke: no custom stack to paint");
+#if !defined(__linux__)
+    if (attrs.m_cpuAffinity)
+        WEOS_THROW_SYSTEM_ERROR(errc::operation_not_permitted,
+                                "thread::invoke: no processor affinity");
+#endif
+
+    pthread_attr_t nativeAttrs;
+    int result = pthread_attr_init(&nativeAttrs);
+    if (result != 0)
+        throwError(result, "thread::invoke: invalid thread attributes");
+
+    // The pthread attributes only accept the POSIX policies. A thread with
+    // any other policy sets it itself before it invokes the function.
+    // Nice values are set by the thread itself, too.
+    int selfPolicy = -1;
+    bool hasNice = false;
+    int nice = 0;
+    if (attrs.m_hasPriority)
+    {
+        int policy;
+        sched_param param;
+        toNativePriority(attrs.m_priority, policy, param, nice);
+#if defined(__linux__)
+        hasNice = policy == SCHED_OTHER && nice != 0;
+#endif
+        if (policy == SCHED_OTHER || policy == SCHED_FIFO)
+        {
+            result = pthread_attr_setinheritsched(&nativeAttrs,
+                                                  PTHREAD_EXPLICIT_SCHED);
+            if (result == 0)
+                result = pthread_attr_setschedpolicy(&nativeAttrs, policy);
+            if (result == 0)
+                result = pthread_attr_setschedparam(&nativeAttrs, &param);
+        }
+        else
+        {
+            selfPolicy = policy;
+        }
+    }
+
+    if (result == 0 && attrs.m_customStack)
+    {
+        result = pthread_attr_setstack(&nativeAttrs, attrs.m_customStack,
+                                       attrs.m_customStackSize);
+    }
+    else if (result == 0 && attrs.m_customStackSize)
+    {
+        result = pthread_attr_setstacksize(&nativeAttrs,
+                                           attrs.m_customStackSize);
+    }
+
+#if defined(__linux__)
+    if (result == 0 && attrs.m_cpuAffinity)
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (int cpu = 0; cpu < 64 && cpu < CPU_SETSIZE; ++cpu)
+            if (attrs.m_cpuAffinity & (std::uint64_t(1) << cpu))
+                CPU_SET(cpu, &cpus);
+        result = pthread_attr_setaffinity_np(&nativeAttrs, sizeof(cpus),
+                                             &cpus);
+    }
+#endif
+
+    if (result != 0)
+    {
+        pthread_attr_destroy(&nativeAttrs);
+        throwError(result, "thread::invoke: invalid thread attributes");
+        return;
+    }
+
+    if (attrs.m_stackPainting)
+        m_data->paintStack(attrs.m_customStack, attrs.m_customStackSize);
+
+    NativeStartData* start = new NativeStartData;
+    start->data = m_data;
+    start->fun = std::move(fun);
+    start->policy = selfPolicy;
+    start->hasNice = hasNice;
+    start->nice = nice;
+    start->name[0] = 0;
+    if (attrs.m_name)
+        std::strcpy(start->name, attrs.m_name);
+
+    result = pthread_create(&m_data->nativeThread, &nativeAttrs,
+                            &thread::nativeEntry, start);
+    pthread_attr_destroy(&nativeAttrs);
+    if (result != 0)
+    {
+        delete start;
+        throwError(result, "thread::invoke: could not create a thread");
+        return;
+    }
+
+    // Wait until the thread has applied the remaining settings. If it
+    // failed, it has terminated without invoking the function.
+    m_data->publishedId();
+    if (m_data->nativeSetupResult != 0)
+    {
+        pthread_join(m_data->nativeThread, 0);
+        throwError(m_data->nativeSetupResult,
+                   "thread::invoke: could not set up the thread");
+        return;
+    }
+    m_nativeJoinable = true;
+}
+
+void* thread::nativeEntry(void* arg)
+{
+    NativeStartData* start = static_cast<NativeStartData*>(arg);
+    int result = 0;
+    if (start->policy != -1)
+    {
+        sched_param param;
+        param.sched_priority = 0;
+        result = pthread_setschedparam(pthread_self(), start->policy, &param);
+    }
+#if defined(__linux__)
+    if (result == 0 && start->hasNice)
+    {
+        // On Linux, the nice value of a thread is set via its thread id.
+        // An inherited nice value is never lowered because this needs a
+        // privilege. Raising it is only a hint, so a failure is ignored.
+        id_t tid = static_cast<id_t>(::syscall(SYS_gettid));
+        errno = 0;
+        int inherited = getpriority(PRIO_PROCESS, tid);
+        if (errno == 0 && inherited < start->nice)
+            setpriority(PRIO_PROCESS, tid, start->nice);
+    }
+#endif
+    if (result == 0 && start->name[0])
+    {
+#if defined(__linux__)
+        result = pthread_setname_np(pthread_self(), start->name);
+#elif defined(__APPLE__)
+        result = pthread_setname_np(start->name);
+#endif
+    }
+
+    std::shared_ptr<detail::ThreadData> data = std::move(start->data);
+    std::function<void()> fun = std::move(start->fun);
+    delete start;
+
+    // Hand the result over to invokeNative(), which waits for the id.
+    data->nativeSetupResult = result;
+    data->publishId();
+    if (result == 0)
+        invoke(std::move(data), std::move(fun));
+    return 0;
+}
+
+void thread::joinNative()
+{
+    int result = pthread_join(m_data->nativeThread, 0);
+    if (result != 0)
+        throwError(result, "thread::join failed");
+    m_nativeJoinable = false;
+}
+
+void thread::detachNative()
+{
+    int result = pthread_detach(m_data->nativeThread);
+    if (result != 0)
+        throwError(result, "thread::detach failed");
+    m_nativeJoinable = false;
+    m_data.reset();
+}
+
+#else
+
+void thread::joinNative()
+{
+}
+
+void thread::detachNative()
+{
+}
+
+#endif // __unix__ || __APPLE__
+
 } // namespace weos
@@ -32,13 +32,25 @@
 #include "core.hpp"
 
 #include "chrono.hpp"
+#include "futex.hpp"
+#include "system_error.hpp"
+#include "waitset_detail.hpp"
 
-#include <condition_variable>
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
+#include <exception>
+#include <functional>
 #include <limits>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <thread>
+#include <type_traits>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <pthread.h>
+#endif
 
 WEOS_BEGIN_NAMESPACE
 
@@ -46,26 +58,193 @@ namespace detail
 {
 typedef std::uint32_t signal_set;
 
+//! The data which is kept for every thread created by weos::thread.
+//! The signal flags are an atomic word. Setting a signal is a single atomic
+//! operation and enters the kernel only if the thread is blocked waiting for
+//! signals. Only the thread itself waits for its signals.
 struct ThreadData
 {
     ThreadData()
-        : signalFlags(0)
+        : signalFlags(0),
+          parked(false),
+          numWaitSets(0),
+          idPublished(0),
+          nativeSetupResult(0),
+          paintedStack(nullptr),
+          paintedStackSize(0)
+    {
+    }
+
+    ThreadData(const ThreadData&) = delete;
+    ThreadData& operator= (const ThreadData&) = delete;
+
+    //! Sets the signals selected by \p flags and wakes up the thread if it
+    //! is blocked.
+    void setSignals(signal_set flags)
+    {
+        // The sequentially consistent update pairs with the store to parked
+        // in park(). Either the thread sees the new flags or we see that it
+        // is parked.
+        signalFlags.fetch_or(flags, std::memory_order_seq_cst);
+        if (parked.load(std::memory_order_seq_cst))
+            futex_wake(signalFlags);
+        if (numWaitSets.load(std::memory_order_seq_cst) != 0)
+        {
+            std::lock_guard<std::mutex> lock(waitSetMutex);
+            waitSets.signal_all();
+        }
+    }
+
+    //! Clears the signals selected by \p flags.
+    void clearSignals(signal_set flags)
     {
+        signalFlags.fetch_and(~flags, std::memory_order_relaxed);
     }
 
-    std::mutex signalMutex;
-    signal_set signalFlags;
-    std::condition_variable signalCv;
+    //! Takes and returns all signals which are set.
+    signal_set takeAnySignals()
+    {
+        if (signalFlags.load(std::memory_order_relaxed) == 0)
+            return 0;
+        return signalFlags.exchange(0, std::memory_order_acquire);
+    }
+
+    //! Takes the signals selected by \p flags if all of them are set.
+    //! Otherwise, \p observed is set to the signals which have been seen.
+    bool takeAllSignals(signal_set flags, signal_set& observed)
+    {
+        observed = signalFlags.load(std::memory_order_relaxed);
+        while ((observed & flags) == flags)
+        {
+            if (signalFlags.compare_exchange_weak(observed, observed & ~flags,
+                                                  std::memory_order_acquire,
+                                                  std::memory_order_relaxed))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //! Blocks the calling thread while the signals are equal to
+    //! \p observed. The thread may return spuriously.
+    void park(signal_set observed)
+    {
+        parked.store(true, std::memory_order_seq_cst);
+        if (signalFlags.load(std::memory_order_seq_cst) == observed)
+            futex_wait(signalFlags, observed);
+        parked.store(false, std::memory_order_relaxed);
+    }
+
+    //! Blocks the calling thread while the signals are equal to
+    //! \p observed or until the \p deadline has passed. Returns \p false
+    //! in case of a timeout.
+    bool parkUntil(signal_set observed,
+                   const chrono::steady_clock::time_point& deadline)
+    {
+        bool result = true;
+        parked.store(true, std::memory_order_seq_cst);
+        if (signalFlags.load(std::memory_order_seq_cst) == observed)
+            result = futex_wait_until(signalFlags, observed, deadline);
+        parked.store(false, std::memory_order_relaxed);
+        return result;
+    }
+
+    //! Registers the \p link of a wait_set, which is signalled whenever a
+    //! signal is set.
+    void attachWaitSet(wait_set_link* link)
+    {
+        std::lock_guard<std::mutex> lock(waitSetMutex);
+        waitSets.attach(link);
+        numWaitSets.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    //! Unregisters the \p link of a wait_set.
+    void detachWaitSet(wait_set_link* link)
+    {
+        std::lock_guard<std::mutex> lock(waitSetMutex);
+        waitSets.detach(link);
+        numWaitSets.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    //! Publishes the id of the calling thread. A thread which has not been
+    //! created by std::thread calls this as soon as it has set itself up.
+    //! This also publishes the nativeSetupResult.
+    void publishId()
+    {
+        id = std::this_thread::get_id();
+        idPublished.store(1, std::memory_order_release);
+        futex_wake(idPublished);
+    }
+
+    //! Returns the id which has been published by the thread. Waits until
+    //! the thread has done so.
+    std::thread::id publishedId()
+    {
+        while (idPublished.load(std::memory_order_acquire) == 0)
+            futex_wait(idPublished, 0);
+        return id;
+    }
+
+    //! Fills the \p stack of \p size bytes with a pattern and remembers it
+    //! for stackUsage().
+    void paintStack(void* stack, std::size_t size);
+
+    //! Returns the number of bytes of the painted stack which have been
+    //! used so far. The stack is expected to grow downwards, so the unused
+    //! part is the painted region at its lower end.
+    std::size_t stackUsage() const;
+
+    //! The signal flags. This is also the futex word on which the thread
+    //! blocks.
+    futex_word signalFlags;
+    //! Set while the thread is about to block or is blocked.
+    std::atomic<bool> parked;
+    //! The number of wait sets which observe the signals.
+    std::atomic<std::uint32_t> numWaitSets;
+    //! Protects the list of wait sets.
+    std::mutex waitSetMutex;
+    //! The wait sets which observe the signals.
+    wait_set_list waitSets;
+    //! The id of a thread which has been created with attributes.
+    std::thread::id id;
+    //! Set to one as soon as the id is valid.
+    futex_word idPublished;
+    //! The error code of the settings which a thread created with
+    //! attributes applies to itself. Valid once the id has been published.
+    int nativeSetupResult;
+    //! The stack which has been painted or a null-pointer.
+    std::uint32_t* paintedStack;
+    //! The number of words in the painted stack.
+    std::size_t paintedStackSize;
+#if defined(__unix__) || defined(__APPLE__)
+    //! The native handle of a thread which has been created with attributes.
+    pthread_t nativeThread;
+#endif
 };
 
+//! Keeps track of the data of the threads created by weos::thread.
+//! A thread finds its own data through a thread-local pointer without any
+//! locking. The map from thread ids to data is only needed to look up the
+//! data of other threads.
 class ThreadDataManager
 {
 public:
     ThreadDataManager() {}
 
-    void add(std::thread::id id, ThreadData* data);
+    //! Registers the \p data of the calling thread.
+    void add(ThreadData* data);
     ThreadData* find(std::thread::id id);
-    void remove(std::thread::id id);
+    //! Unregisters the data of the calling thread.
+    void remove();
+
+    //! Returns the data of the calling thread or a null-pointer if the
+    //! thread has not been created by weos::thread.
+    static ThreadData* current()
+    {
+        return currentData();
+    }
 
     static ThreadDataManager& instance();
 
@@ -73,6 +252,13 @@ private:
     ThreadDataManager(const ThreadDataManager&);
     const ThreadDataManager& operator= (const ThreadDataManager&);
 
+    //! Returns the thread-local pointer to the data of the calling thread.
+    static ThreadData*& currentData()
+    {
+        static thread_local ThreadData* data = nullptr;
+        return data;
+    }
+
     std::mutex m_idToDataMutex;
     std::map<std::thread::id, ThreadData*> m_idToData;
 };
@@ -84,25 +270,193 @@ class thread
 public:
     typedef std::thread::id id;
 
+#if defined(__unix__) || defined(__APPLE__)
+    //! Thread attributes.
+    //! A thread which is created with attributes is a pthread whose
+    //! scheduling, stack, processor affinity and name are set up before the
+    //! threaded function is invoked. Every setting which has not been made
+    //! is inherited from the creating thread or left at the system default.
+    class attributes
+    {
+    public:
+        //! An enumeration of thread priorities.
+        //! Idle maps to SCHED_IDLE where available. Low, BelowNormal and
+        //! Normal map to the time-sharing policy SCHED_OTHER with the nice
+        //! values 10, 5 and 0. A nice value is only applied if it is higher
+        //! than the one inherited from the creating thread, so Normal keeps
+        //! the inherited value. Nice values are per thread only on Linux, so
+        //! the three levels are equal on other systems.
+        //! AboveNormal, High and Realtime map to increasing SCHED_FIFO
+        //! priorities, of which Realtime is the highest.
+        enum Priority
+        {
+            Idle,
+            Low,
+            BelowNormal,
+            Normal,
+            AboveNormal,
+            High,
+            Realtime
+        };
+
+        //! Creates default thread attributes.
+        attributes()
+            : m_priority(Normal),
+              m_hasPriority(false),
+              m_customStackSize(0),
+              m_customStack(0),
+              m_cpuAffinity(0),
+              m_name(0),
+              m_stackPainting(false)
+        {
+        }
+
+        //! Sets the priority.
+        //! Sets the thread priority to \p priority. Real-time priorities
+        //! require the privilege to use SCHED_FIFO.
+        //!
+        //! By default, the thread inherits the scheduling policy and the
+        //! priority of the creating thread.
+        attributes& setPriority(Priority priority)
+        {
+            m_priority = priority;
+            m_hasPriority = true;
+            return *this;
+        }
+
+        //! Provides a custom stack.
+        //! Makes the thread use the memory pointed to by \p stack whose size
+        //! in bytes is passed in \p stackSize rather than the default stack.
+        //! If \p stack is a null-pointer, a stack of \p stackSize bytes is
+        //! allocated by the system.
+        //!
+        //! The default is a null-pointer for the stack and zero for its size,
+        //! which selects the system's default stack.
+        attributes& setStack(void* stack, std::size_t stackSize)
+        {
+            m_customStack = stack;
+            m_customStackSize = stackSize;
+            return *this;
+        }
+
+        //! Sets the size of the stack.
+        //! Makes the system allocate a stack of \p stackSize bytes for the
+        //! thread. This is the same as setStack(0, stackSize).
+        attributes& setStackSize(std::size_t stackSize)
+        {
+            return setStack(0, stackSize);
+        }
+
+        //! Sets the processor affinity.
+        //! Restricts the thread to the processors whose bits are set in
+        //! \p cpuMask. Bit n selects processor n. Processor affinity is only
+        //! supported on Linux.
+        //!
+        //! The default is zero, which keeps the affinity of the creating
+        //! thread.
+        attributes& setCpuAffinity(std::uint64_t cpuMask)
+        {
+            m_cpuAffinity = cpuMask;
+            return *this;
+        }
+
+        //! Sets the name.
+        //! Sets the thread's name to \p name, which must not be longer than
+        //! 15 characters. The name is copied when the thread is created.
+        //!
+        //! The default is a null-pointer, which keeps the name of the
+        //! creating thread.
+        attributes& setName(const char* name)
+        {
+            m_name = name;
+            return *this;
+        }
+
+        //! Enables stack painting.
+        //! If \p enable is set, the custom stack which has been passed to
+        //! setStack() is filled with a pattern before the thread starts.
+        //! The stack usage can then be measured with thread::stack_usage()
+        //! and this_thread::stack_high_watermark(). Painting requires a
+        //! custom stack.
+        //!
+        //! The default is \p false.
+        attributes& setStackPainting(bool enable)
+        {
+            m_stackPainting = enable;
+            return *this;
+        }
+
+    private:
+        //! The thread's priority.
+        Priority m_priority;
+        //! Set if a priority has been selected.
+        bool m_hasPriority;
+        //! The size of the custom stack.
+        std::size_t m_customStackSize;
+        //! A pointer to the custom stack.
+        void* m_customStack;
+        //! The processors on which the thread may run.
+        std::uint64_t m_cpuAffinity;
+        //! The thread's name.
+        const char* m_name;
+        //! Set if the custom stack is painted.
+        bool m_stackPainting;
+
+        friend class WEOS_NAMESPACE::thread;
+    };
+#endif // __unix__ || __APPLE__
+
     thread()
+        : m_nativeJoinable(false)
     {
     }
 
-    template <typename TFunction, typename... TArgs>
+    template <typename TFunction, typename... TArgs,
+              typename = typename std::enable_if<
+                  !std::is_same<typename std::decay<TFunction>::type,
+                                thread>::value
+#if defined(__unix__) || defined(__APPLE__)
+                  && !std::is_same<typename std::decay<TFunction>::type,
+                                   attributes>::value
+#endif
+                  >::type>
     explicit thread(TFunction&& f, TArgs&&... args)
         : m_data(std::make_shared<detail::ThreadData>()),
           m_thread(&thread::invoke, m_data,
                    std::bind(std::forward<TFunction>(f),
-                             std::forward<TArgs>(args)...))
+                             std::forward<TArgs>(args)...)),
+          m_nativeJoinable(false)
     {
     }
 
+#if defined(__unix__) || defined(__APPLE__)
+    //! Creates a thread with attributes.
+    //! Creates a thread with the attributes \p attrs, which invokes \p f
+    //! with the arguments \p args.
+    template <typename TFunction, typename... TArgs>
+    thread(const attributes& attrs, TFunction&& f, TArgs&&... args)
+        : m_data(std::make_shared<detail::ThreadData>()),
+          m_nativeJoinable(false)
+    {
+        invokeNative(attrs, std::bind(std::forward<TFunction>(f),
+                                      std::forward<TArgs>(args)...));
+    }
+#endif // __unix__ || __APPLE__
+
     thread(const thread&) = delete;
 
     thread(thread&& other)
         : m_data(std::move(other.m_data)),
-          m_thread(std::move(other.m_thread))
+          m_thread(std::move(other.m_thread)),
+          m_nativeJoinable(other.m_nativeJoinable)
     {
+        other.m_nativeJoinable = false;
+    }
+
+    ~thread()
+    {
+        if (m_nativeJoinable)
+            std::terminate();
     }
 
     thread& operator= (thread&) = delete;
@@ -111,31 +465,47 @@ public:
     {
         if (this != &other)
         {
+            if (m_nativeJoinable)
+                std::terminate();
             m_data = std::move(other.m_data);
             m_thread = std::move(other.m_thread);
+            m_nativeJoinable = other.m_nativeJoinable;
+            other.m_nativeJoinable = false;
         }
         return *this;
     }
 
     void detach()
     {
+        if (m_nativeJoinable)
+        {
+            detachNative();
+            return;
+        }
         m_data.reset();
         m_thread.detach();
     }
 
     thread::id get_id() const noexcept
     {
+        if (m_nativeJoinable)
+            return m_data->publishedId();
         return m_thread.get_id();
     }
 
     void join()
     {
+        if (m_nativeJoinable)
+        {
+            joinNative();
+            return;
+        }
         m_thread.join();
     }
 
     bool joinable() const noexcept
     {
-        return m_thread.joinable();
+        return m_nativeJoinable || m_thread.joinable();
     }
 
     // -------------------------------------------------------------------------
@@ -168,9 +538,7 @@ public:
             WEOS_THROW_SYSTEM_ERROR(errc::operation_not_permitted,
                                     "thread::clear_signals: no thread");
 
-        std::lock_guard<std::mutex> lock(m_data->signalMutex);
-        m_data->signalFlags &= ~flags;
-        m_data->signalCv.notify_one();
+        m_data->clearSignals(flags);
     }
 
     //! Sets a set of signals.
@@ -182,9 +550,31 @@ public:
             WEOS_THROW_SYSTEM_ERROR(errc::operation_not_permitted,
                                     "thread::set_signals: no thread");
 
-        std::lock_guard<std::mutex> lock(m_data->signalMutex);
-        m_data->signalFlags |= flags;
-        m_data->signalCv.notify_one();
+        m_data->setSignals(flags);
+    }
+
+    // -------------------------------------------------------------------------
+    // Stack usage
+    // -------------------------------------------------------------------------
+
+    //! Returns the stack usage.
+    //! Returns the maximum number of bytes of its stack which the thread
+    //! has used so far. The thread must have been created with a painted
+    //! stack (see attributes::setStackPainting()). The result is also
+    //! available after the thread has been joined. With glibc, this includes
+    //! the thread descriptor and the thread-local storage, which are placed
+    //! at the top of a custom stack.
+    //!
+    //! The measurement relies on the pattern being overwritten. It can
+    //! underestimate the usage if the thread has written the pattern itself
+    //! or reserved stack space without writing to it.
+    std::size_t stack_usage() const
+    {
+        if (!m_data || !m_data->paintedStack)
+            WEOS_THROW_SYSTEM_ERROR(errc::operation_not_permitted,
+                                    "thread::stack_usage: no painted stack");
+
+        return m_data->stackUsage();
     }
 
 private:
@@ -192,17 +582,32 @@ private:
     std::shared_ptr<detail::ThreadData> m_data;
     //! The native thread in which the function executes.
     std::thread m_thread;
+    //! Set if the thread has been created with attributes and is joinable.
+    //! Such a thread is not managed by m_thread.
+    bool m_nativeJoinable;
 
     //! A helper function to invoke the threaded function.
     static void invoke(std::shared_ptr<detail::ThreadData> data,
                        std::function<void()> fun)
     {
-        detail::ThreadDataManager::instance().add(
-                    std::this_thread::get_id(), data.get());
+        detail::ThreadDataManager::instance().add(data.get());
         fun();
-        detail::ThreadDataManager::instance().remove(
-                    std::this_thread::get_id());
+        detail::ThreadDataManager::instance().remove();
     }
+
+#if defined(__unix__) || defined(__APPLE__)
+    //! Creates a pthread with the attributes \p attrs, which invokes
+    //! \p fun.
+    void invokeNative(const attributes& attrs, std::function<void()> fun);
+
+    //! The entry function of a pthread created by invokeNative().
+    static void* nativeEntry(void* arg);
+#endif // __unix__ || __APPLE__
+
+    //! Joins a thread which has been created with attributes.
+    void joinNative();
+    //! Detaches a thread which has been created with attributes.
+    void detachNative();
 };
 
 namespace this_thread
@@ -222,19 +627,19 @@ using std::this_thread::yield;
 inline
 thread::signal_set wait_for_any_signal()
 {
-    detail::ThreadData* data
-            = detail::ThreadDataManager::instance().find(get_id());
+    detail::ThreadData* data = detail::ThreadDataManager::current();
     WEOS_ASSERT(data);
     if (!data)
         WEOS_THROW_SYSTEM_ERROR(errc::operation_not_permitted,
                                 "wait_for_any_signal: no thread");
 
-
-    std::unique_lock<std::mutex> lock(data->signalMutex);
-    data->signalCv.wait(lock, [data]{ return data->signalFlags != 0; });
-    thread::signal_set temp = data->signalFlags;
-    data->signalFlags = 0;
-    return temp;
+    while (true)
+    {
+        thread::signal_set flags = data->takeAnySignals();
+        if (flags)
+            return flags;
+        data->park(0);
+    }
 }
 
 //! Checks if any signal has arrived.
@@ -244,18 +649,13 @@ thread::signal_set wait_for_any_signal()
 inline
 thread::signal_set try_wait_for_any_signal()
 {
-    detail::ThreadData* data
-            = detail::ThreadDataManager::instance().find(get_id());
+    detail::ThreadData* data = detail::ThreadDataManager::current();
     WEOS_ASSERT(data);
     if (!data)
         WEOS_THROW_SYSTEM_ERROR(errc::operation_not_permitted,
                                 "try_wait_for_any_signal: no thread");
 
-    data->signalMutex.lock();
-    thread::signal_set temp = data->signalFlags;
-    data->signalFlags = 0;
-    data->signalMutex.unlock();
-    return temp;
+    return data->takeAnySignals();
 }
 
 //! Waits until any signal arrives or a timeout occurs.
@@ -267,23 +667,23 @@ inline
 thread::signal_set try_wait_for_any_signal_for(
         const chrono::duration<RepT, PeriodT>& duration)
 {
-    detail::ThreadData* data
-            = detail::ThreadDataManager::instance().find(get_id());
+    detail::ThreadData* data = detail::ThreadDataManager::current();
     WEOS_ASSERT(data);
     if (!data)
         WEOS_THROW_SYSTEM_ERROR(errc::operation_not_permitted,
                                 "try_wait_for_any_signal_for: no thread");
 
-
-    std::unique_lock<std::mutex> lock(data->signalMutex);
-    if (!data->signalCv.wait_for(
-            lock, duration, [data]{ return data->signalFlags != 0; }))
+    chrono::steady_clock::time_point deadline
+            = chrono::steady_clock::now()
+              + chrono::duration_cast<chrono::steady_clock::duration>(duration);
+    while (true)
     {
-        return 0;
+        thread::signal_set flags = data->takeAnySignals();
+        if (flags)
+            return flags;
+        if (!data->parkUntil(0, deadline))
+            return data->takeAnySignals();
     }
-    thread::signal_set temp = data->signalFlags;
-    data->signalFlags = 0;
-    return temp;
 }
 
 
@@ -294,19 +694,15 @@ thread::signal_set try_wait_for_any_signal_for(
 inline
 void wait_for_all_signals(thread::signal_set flags)
 {
-    detail::ThreadData* data
-            = detail::ThreadDataManager::instance().find(get_id());
+    detail::ThreadData* data = detail::ThreadDataManager::current();
     WEOS_ASSERT(data);
     if (!data)
         WEOS_THROW_SYSTEM_ERROR(errc::operation_not_permitted,
                                 "wait_for_all_signals: no thread");
 
-    std::unique_lock<std::mutex> lock(data->signalMutex);
-    data->signalCv.wait(
-                lock,
-                [data, flags]{ return (data->signalFlags & flags) == flags; });
-    data->signalFlags &= ~flags;
-    return flags;
+    thread::signal_set observed;
+    while (!data->takeAllSignals(flags, observed))
+        data->park(observed);
 }
 
 //! Checks if a set of signals has been set.
@@ -318,19 +714,14 @@ void wait_for_all_signals(thread::signal_set flags)
 inline
 bool try_wait_for_all_signals(thread::signal_set flags)
 {
-    detail::ThreadData* data
-            = detail::ThreadDataManager::instance().find(get_id());
+    detail::ThreadData* data = detail::ThreadDataManager::current();
     WEOS_ASSERT(data);
     if (!data)
         WEOS_THROW_SYSTEM_ERROR(errc::operation_not_permitted,
                                 "try_wait_for_all_signals: no thread");
 
-    data->signalMutex.lock();
-    thread::signal_set temp = (data->signalFlags & flags) == flags
-                              ? flags : 0;
-    data->signalFlags &= ~temp;
-    data->signalMutex.unlock();
-    return temp != 0;
+    thread::signal_set observed;
+    return data->takeAllSignals(flags, observed);
 }
 
 //! Blocks until a set of signals arrives or a timeout occurs.
@@ -344,24 +735,44 @@ bool try_wait_for_all_signals_for(
         thread::signal_set flags,
         const chrono::duration<RepT, PeriodT>& duration)
 {
-    detail::ThreadData* data
-            = detail::ThreadDataManager::instance().find(get_id());
+    detail::ThreadData* data = detail::ThreadDataManager::current();
     WEOS_ASSERT(data);
     if (!data)
         WEOS_THROW_SYSTEM_ERROR(errc::operation_not_permitted,
                                 "try_wait_for_all_signals_for: no thread");
 
-    std::unique_lock<std::mutex> lock(data->signalMutex);
-    if (!data->signalCv.wait_for(
-            lock, duration,
-            [data, flags]{ return (data->signalFlags & flags) == flags; }))
+    chrono::steady_clock::time_point deadline
+            = chrono::steady_clock::now()
+              + chrono::duration_cast<chrono::steady_clock::duration>(duration);
+    thread::signal_set observed;
+    while (!data->takeAllSignals(flags, observed))
     {
-        return false;
+        if (!data->parkUntil(observed, deadline))
+            return data->takeAllSignals(flags, observed);
     }
-    data->signalFlags &= ~flags;
     return true;
 }
 
+// ----=====================================================================----
+//     Stack usage
+// ----=====================================================================----
+
+//! Returns the stack high watermark.
+//! Returns the maximum number of bytes of its stack which the current
+//! thread has used so far. The thread must have been created with a
+//! painted stack (see thread::attributes::setStackPainting()).
+inline
+std::size_t stack_high_watermark()
+{
+    detail::ThreadData* data = detail::ThreadDataManager::current();
+    WEOS_ASSERT(data);
+    if (!data || !data->paintedStack)
+        WEOS_THROW_SYSTEM_ERROR(errc::operation_not_permitted,
+                                "stack_high_watermark: no painted stack");
+
+    return data->stackUsage();
+}
+
 } // namespace this_thread
 
 WEOS_END_NAMESPACE
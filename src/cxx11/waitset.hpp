@@ -0,0 +1,307 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef WEOS_CXX11_WAITSET_HPP
+#define WEOS_CXX11_WAITSET_HPP
+
+#include "core.hpp"
+
+#include "chrono.hpp"
+#include "messagequeue.hpp"
+#include "semaphore.hpp"
+#include "system_error.hpp"
+#include "thread.hpp"
+#include "waitset_detail.hpp"
+#include "../optional.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+WEOS_BEGIN_NAMESPACE
+
+//! A set of objects on which a thread waits at once.
+//! A wait_set lets one thread block until any of several sources becomes
+//! ready. Sources are message queues (ready if they hold an element),
+//! semaphores (ready if a token is available) and the signals of the calling
+//! thread (ready if one of the selected signals is set).
+//!
+//! Every source keeps a list of the wait sets which observe it. When a
+//! source becomes ready, it signals only these wait sets; a source which is
+//! not observed pays no more than an empty list check.
+//!
+//! Waiting does not consume anything. After wait_any() has returned the
+//! index of a ready source, the caller takes the element, token or signal
+//! with the source's non-blocking function (e.g. try_receive()). If other
+//! threads receive from the same source, this can fail and the caller has to
+//! wait again.
+//!
+//! A wait set must only be used by one thread and it must be destroyed
+//! before the sources which have been added to it.
+class wait_set
+{
+public:
+    //! Creates an empty wait set.
+    wait_set()
+        : m_next(0)
+    {
+    }
+
+    //! Destroys the wait set and unregisters it from all sources.
+    ~wait_set()
+    {
+        for (auto& s : m_sources)
+            s->detach();
+    }
+
+    wait_set(const wait_set&) = delete;
+    wait_set& operator= (const wait_set&) = delete;
+
+    //! Adds a message queue.
+    //! Adds the \p queue to the set and returns its index. The queue is
+    //! ready when it holds an element.
+    template <typename TypeT, std::size_t QueueSizeT, typename TagT>
+    std::size_t add(message_queue<TypeT, QueueSizeT, TagT>& queue)
+    {
+        return addSource(std::unique_ptr<source>(
+                new queue_source<message_queue<TypeT, QueueSizeT, TagT> >(
+                    queue)));
+    }
+
+    //! Adds a semaphore.
+    //! Adds the semaphore \p sem to the set and returns its index. The
+    //! semaphore is ready when a token is available.
+    std::size_t add(semaphore& sem)
+    {
+        return addSource(std::unique_ptr<source>(new semaphore_source(sem)));
+    }
+
+    //! Adds the signals of the calling thread.
+    //! Adds the signals of the calling thread to the set and returns their
+    //! index. They are ready when any of the signals selected by \p flags is
+    //! set.
+    std::size_t add_signals(thread::signal_set flags = thread::all_signals())
+    {
+        detail::ThreadData* data = detail::ThreadDataManager::current();
+        if (!data)
+            WEOS_THROW_SYSTEM_ERROR(errc::operation_not_permitted,
+                                    "wait_set::add_signals: no thread");
+
+        return addSource(std::unique_ptr<source>(
+                             new signal_source(data, flags)));
+    }
+
+    //! Returns the number of sources in the set.
+    std::size_t size() const
+    {
+        return m_sources.size();
+    }
+
+    //! Waits until any source is ready.
+    //! Blocks the calling thread until one of the sources is ready and
+    //! returns its index.
+    std::size_t wait_any()
+    {
+        while (true)
+        {
+            unsigned generation = m_event.generation();
+            optional<std::size_t> index = try_wait_any();
+            if (index)
+                return *index;
+            m_event.wait(generation);
+        }
+    }
+
+    //! Checks if any source is ready.
+    //! Returns the index of a ready source or an empty optional if no source
+    //! is ready. The calling thread is never blocked.
+    optional<std::size_t> try_wait_any()
+    {
+        // Start after the source which has been ready the last time such
+        // that a busy source cannot starve the others.
+        std::size_t numSources = m_sources.size();
+        for (std::size_t count = 0; count < numSources; ++count)
+        {
+            std::size_t index = m_next + count;
+            if (index >= numSources)
+                index -= numSources;
+            if (m_sources[index]->ready())
+            {
+                m_next = index + 1 < numSources ? index + 1 : 0;
+                return optional<std::size_t>(index);
+            }
+        }
+        return optional<std::size_t>();
+    }
+
+    //! Waits until any source is ready or a timeout occurs.
+    //! Blocks the calling thread until one of the sources is ready or the
+    //! timeout duration \p d has expired. Returns the index of the ready
+    //! source or an empty optional in case of a timeout.
+    template <typename RepT, typename PeriodT>
+    optional<std::size_t> try_wait_any_for(
+            const chrono::duration<RepT, PeriodT>& d)
+    {
+        chrono::steady_clock::time_point deadline
+                = detail::deadline_from_now(d);
+
+        while (true)
+        {
+            unsigned generation = m_event.generation();
+            optional<std::size_t> index = try_wait_any();
+            if (index || !m_event.wait_until(generation, deadline))
+                return index ? index : try_wait_any();
+        }
+    }
+
+private:
+    //! An object which has been added to the wait set.
+    class source
+    {
+    public:
+        virtual ~source() {}
+
+        //! Checks if the object is ready.
+        virtual bool ready() = 0;
+        //! Registers the link with the object.
+        virtual void attach() = 0;
+        //! Unregisters the link from the object.
+        virtual void detach() = 0;
+
+        //! The link by which the object signals the wait set.
+        detail::wait_set_link link;
+    };
+
+    template <typename QueueT>
+    class queue_source : public source
+    {
+    public:
+        explicit queue_source(QueueT& queue)
+            : m_queue(queue)
+        {
+        }
+
+        virtual bool ready()
+        {
+            return m_queue.canReceive();
+        }
+
+        virtual void attach()
+        {
+            m_queue.attachWaitSet(&link);
+        }
+
+        virtual void detach()
+        {
+            m_queue.detachWaitSet(&link);
+        }
+
+    private:
+        QueueT& m_queue;
+    };
+
+    class semaphore_source : public source
+    {
+    public:
+        explicit semaphore_source(semaphore& sem)
+            : m_semaphore(sem)
+        {
+        }
+
+        virtual bool ready()
+        {
+            return m_semaphore.value() != 0;
+        }
+
+        virtual void attach()
+        {
+            m_semaphore.attachWaitSet(&link);
+        }
+
+        virtual void detach()
+        {
+            m_semaphore.detachWaitSet(&link);
+        }
+
+    private:
+        semaphore& m_semaphore;
+    };
+
+    class signal_source : public source
+    {
+    public:
+        signal_source(detail::ThreadData* data, thread::signal_set flags)
+            : m_data(data),
+              m_flags(flags)
+        {
+        }
+
+        virtual bool ready()
+        {
+            return (m_data->signalFlags.load(std::memory_order_seq_cst)
+                    & m_flags) != 0;
+        }
+
+        virtual void attach()
+        {
+            m_data->attachWaitSet(&link);
+        }
+
+        virtual void detach()
+        {
+            m_data->detachWaitSet(&link);
+        }
+
+    private:
+        detail::ThreadData* m_data;
+        thread::signal_set m_flags;
+    };
+
+    //! The event which the sources signal.
+    detail::wait_set_event m_event;
+    //! The sources in the order in which they have been added.
+    std::vector<std::unique_ptr<source> > m_sources;
+    //! The index of the source which is checked first.
+    std::size_t m_next;
+
+    //! Registers the source \p s and appends it to the set.
+    std::size_t addSource(std::unique_ptr<source> s)
+    {
+        s->link.event = &m_event;
+        m_sources.reserve(m_sources.size() + 1);
+        s->attach();
+        m_sources.push_back(std::move(s));
+        return m_sources.size() - 1;
+    }
+};
+
+WEOS_END_NAMESPACE
+
+#endif // WEOS_CXX11_WAITSET_HPP
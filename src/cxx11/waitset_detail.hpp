@@ -0,0 +1,181 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef WEOS_CXX11_WAITSET_DETAIL_HPP
+#define WEOS_CXX11_WAITSET_DETAIL_HPP
+
+#include "core.hpp"
+
+#include "chrono.hpp"
+
+#include <condition_variable>
+#include <mutex>
+
+
+WEOS_BEGIN_NAMESPACE
+
+class wait_set;
+
+namespace detail
+{
+
+//! The event on which a wait_set blocks.
+//! Every object which is observed by a wait set signals the event when it
+//! might have become ready. The event only counts the signals; the wait set
+//! checks its sources itself.
+class wait_set_event
+{
+public:
+    wait_set_event()
+        : m_generation(0)
+    {
+    }
+
+    wait_set_event(const wait_set_event&) = delete;
+    wait_set_event& operator= (const wait_set_event&) = delete;
+
+    //! Returns the number of signals so far.
+    unsigned generation()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_generation;
+    }
+
+    //! Signals the event and wakes the thread blocked on it.
+    void signal()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_generation;
+        m_cv.notify_one();
+    }
+
+    //! Blocks until the event has been signalled since generation()
+    //! returned \p generation.
+    void wait(unsigned generation)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (m_generation == generation)
+            m_cv.wait(lock);
+    }
+
+    //! Blocks until the event has been signalled since generation()
+    //! returned \p generation or the \p deadline has passed. Returns
+    //! \p false in case of a timeout.
+    bool wait_until(unsigned generation,
+                    const chrono::steady_clock::time_point& deadline)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (m_generation == generation)
+        {
+            if (m_cv.wait_until(lock, deadline) == std::cv_status::timeout)
+                return m_generation != generation;
+        }
+        return true;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    //! Incremented with every signal.
+    unsigned m_generation;
+};
+
+//! Links a wait_set to one of the objects it observes.
+struct wait_set_link
+{
+    wait_set_link()
+        : previous(0),
+          next(0),
+          event(0)
+    {
+    }
+
+    wait_set_link* previous;
+    wait_set_link* next;
+    //! The event of the wait set which owns this link.
+    wait_set_event* event;
+};
+
+//! The list of wait sets which observe an object.
+//! The list is not thread-safe. The observed object protects it with the
+//! same lock which guards the state that the wait sets are interested in.
+class wait_set_list
+{
+public:
+    wait_set_list()
+        : m_first(0)
+    {
+    }
+
+    wait_set_list(const wait_set_list&) = delete;
+    wait_set_list& operator= (const wait_set_list&) = delete;
+
+    //! Checks if no wait set observes the object.
+    bool empty() const
+    {
+        return m_first == 0;
+    }
+
+    //! Adds the \p link to the list.
+    void attach(wait_set_link* link)
+    {
+        link->previous = 0;
+        link->next = m_first;
+        if (m_first)
+            m_first->previous = link;
+        m_first = link;
+    }
+
+    //! Removes the \p link from the list.
+    void detach(wait_set_link* link)
+    {
+        if (link->previous)
+            link->previous->next = link->next;
+        else
+            m_first = link->next;
+        if (link->next)
+            link->next->previous = link->previous;
+        link->previous = link->next = 0;
+    }
+
+    //! Signals the events of all wait sets in the list.
+    void signal_all() const
+    {
+        for (wait_set_link* link = m_first; link; link = link->next)
+            link->event->signal();
+    }
+
+private:
+    wait_set_link* m_first;
+};
+
+} // namespace detail
+
+WEOS_END_NAMESPACE
+
+#endif // WEOS_CXX11_WAITSET_DETAIL_HPP
@@ -32,49 +32,36 @@
 WEOS_BEGIN_NAMESPACE
 
 condition_variable::condition_variable()
-    : m_waitingThreads(0)
 {
 }
 
 condition_variable::~condition_variable()
 {
-    WEOS_ASSERT(m_waitingThreads == 0);
+    WEOS_ASSERT(m_waiters.empty());
 }
 
 void condition_variable::notify_one() WEOS_NOEXCEPT
 {
     lock_guard<mutex> locker(m_mutex);
 
-    if (m_waitingThreads != 0)
-    {
-        WaitingThread* next = m_waitingThreads->next;
-        m_waitingThreads->dequeued = true;
-        m_waitingThreads->signal.post();
-
-        // Do not access a waiter after sending a signal to it. If the other
-        // thread has received a signal, the WaitingThread instance, which
-        // is located on the stack, will go out of scope and is not accessible
-        // anymore.
-        m_waitingThreads = next;
-    }
+    // The waiter is removed from the queue before the signal is sent. Do not
+    // access a waiter after sending a signal to it. If the other thread has
+    // received a signal, the WaitingThread instance, which is located on the
+    // stack, will go out of scope and is not accessible anymore.
+    detail::waiter_queue_hook* w = m_waiters.pop_front();
+    if (w)
+        static_cast<WaitingThread*>(w)->signal.post();
 }
 
 void condition_variable::notify_all() WEOS_NOEXCEPT
 {
     lock_guard<mutex> locker(m_mutex);
 
-    while (m_waitingThreads)
-    {
-        WaitingThread* next = m_waitingThreads->next;
-        m_waitingThreads->dequeued = true;
-        m_waitingThreads->signal.post();
-
-        // Do not access a waiter after sending a signal to it. If the other
-        // thread has received a signal, the WaitingThread instance, which
-        // is located on the stack, will go out of scope and is not accessible
-        // anymore.
-        m_waitingThreads = next;
-    }
+    // Only the first waiter is signalled. The remaining ones stay chained
+    // and are woken up one after another by wakeSuccessor().
+    detail::waiter_queue_hook* w = m_waiters.take_all();
+    if (w)
+        static_cast<WaitingThread*>(w)->signal.post();
 }
 
 void condition_variable::wait(unique_lock<mutex>& lock)
@@ -83,11 +70,15 @@ void condition_variable::wait(unique_lock<mutex>& lock)
     WaitingThread w;
     enqueue(w);
 
-    // We can only release the lock when we are sure that a signal will
-    // reach our thread.
-    detail::lock_releaser<unique_lock<mutex> > releaser(lock);
-    // Wait until we receive a signal, then re-lock the lock.
-    w.signal.wait();
+    {
+        // We can only release the lock when we are sure that a signal will
+        // reach our thread.
+        detail::lock_releaser<unique_lock<mutex> > releaser(lock);
+        // Wait until we receive a signal, then re-lock the lock.
+        w.signal.wait();
+    }
+
+    wakeSuccessor(w);
 }
 
 // -----------------------------------------------------------------------------
@@ -97,39 +88,26 @@ void condition_variable::wait(unique_lock<mutex>& lock)
 void condition_variable::enqueue(WaitingThread& w)
 {
     lock_guard<mutex> locker(m_mutex);
-
-    if (!m_waitingThreads)
-        m_waitingThreads = &w;
-    else
-    {
-        //! \todo enqueue using priorities
-        WaitingThread* iter = m_waitingThreads;
-        while (iter->next)
-            iter = iter->next;
-        iter->next = &w;
-    }
+    m_waiters.push_back(w);
 }
 
-void condition_variable::maybeDequeue(WaitingThread& w)
+bool condition_variable::maybeDequeue(WaitingThread& w)
 {
     lock_guard<mutex> locker(m_mutex);
-    if (w.dequeued)
-        return;
+    if (!w.queued)
+        return false;
 
-    WEOS_ASSERT(m_waitingThreads);
+    m_waiters.remove(w);
+    return true;
+}
 
-    if (m_waitingThreads == &w)
-        m_waitingThreads = w.next;
-    else
-    {
-        WaitingThread* iter = m_waitingThreads;
-        while (iter->next != &w)
-        {
-            iter = iter->next;
-            WEOS_ASSERT(iter);
-        }
-        iter->next = w.next;
-    }
+void condition_variable::wakeSuccessor(WaitingThread& w)
+{
+    // The successor cannot leave its wait() before it has been signalled.
+    // Thus, it is still alive. Its predecessor owns the lock now, so the
+    // successor will block on the lock rather than on the condition variable.
+    if (w.next)
+        static_cast<WaitingThread*>(w.next)->signal.post();
 }
 
 WEOS_END_NAMESPACE
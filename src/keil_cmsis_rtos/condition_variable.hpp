@@ -34,42 +34,11 @@
 #include "../chrono.hpp"
 #include "../mutex.hpp"
 #include "../semaphore.hpp"
+#include "../common/waiter_queue.hpp"
 
 
 WEOS_BEGIN_NAMESPACE
 
-namespace detail
-{
-//! A helper class for temporarily releasing a lock.
-//! The lock_releaser is a helper class to release a lock until the object
-//! goes out of scope. The constructor calls unlock() and the destructor
-//! calls lock(). It is somehow the dual to the lock_guard which calls lock()
-//! in the constructor and unlock() in the destructor.
-template <typename LockT>
-class lock_releaser
-{
-public:
-    typedef LockT lock_type;
-
-    explicit lock_releaser(lock_type& lock)
-        : m_lock(lock)
-    {
-        m_lock.unlock();
-    }
-
-    ~lock_releaser()
-    {
-        m_lock.lock();
-    }
-
-private:
-    lock_type& m_lock;
-};
-
-} // namespace detail
-
-
-
 namespace cv_status
 {
     enum cv_status
@@ -98,6 +67,13 @@ public:
 
     //! Notifies all threads waiting on this condition variable.
     //! Notifies all threads which are waiting on this condition variable.
+    //!
+    //! The waiters are not woken up at once because they would only
+    //! contend for the mutex. Instead, all of them are removed from the
+    //! condition variable in one go and only the first one is signalled.
+    //! When a waiter has reacquired the mutex, it signals its successor,
+    //! which then blocks on the mutex (wait morphing). Thus, at most one
+    //! of the notified threads waits for the mutex at any time.
     void notify_all() WEOS_NOEXCEPT;
 
     //! Waits on this condition variable.
@@ -122,25 +98,85 @@ public:
         WaitingThread w;
         enqueue(w);
 
-        // We can only unlock the lock when we are sure that a signal will
-        // reach our thread.
-        detail::lock_releaser<unique_lock<mutex> > releaser(lock);
-        // Wait until we receive a signal, then re-lock the lock.
-        bool gotSignal = w.signal.try_wait_for(d);
-
-        // If we have received a signal, we have _always_ been dequeued.
-        // If the other case, we might have been dequeued or might have
-        // been not. In that case, we have to check the dequeued flag.
-        if (!gotSignal)
         {
-            maybeDequeue(w);
-            return cv_status::timeout;
+            // We can only unlock the lock when we are sure that a signal
+            // will reach our thread.
+            detail::lock_releaser<unique_lock<mutex> > releaser(lock);
+            // Wait until we receive a signal, then re-lock the lock.
+            if (!w.signal.try_wait_for(d))
+            {
+                // If we are still in the queue, nobody has notified us.
+                if (maybeDequeue(w))
+                    return cv_status::timeout;
+
+                // Otherwise, we have been notified concurrently and the
+                // signal is on its way. We must consume it because
+                // notify_all() might have made us responsible for waking
+                // our successor.
+                w.signal.wait();
+            }
         }
 
+        wakeSuccessor(w);
         return cv_status::no_timeout;
     }
 
-    // TODO: wait_until()
+    //! Waits on this condition variable until a predicate is satisfied.
+    //! Waits until the predicate \p pred returns \p true. The predicate is
+    //! evaluated with the \p lock held.
+    template <typename PredicateT>
+    void wait(unique_lock<mutex>& lock, PredicateT pred)
+    {
+        while (!pred())
+            wait(lock);
+    }
+
+    //! Waits on this condition variable until a predicate is satisfied or
+    //! a timeout occurs.
+    //! Waits until the predicate \p pred returns \p true or the timeout
+    //! period \p d expires. Returns the value of the predicate.
+    template <typename RepT, typename PeriodT, typename PredicateT>
+    bool wait_for(unique_lock<mutex>& lock,
+                  const chrono::duration<RepT, PeriodT>& d,
+                  PredicateT pred)
+    {
+        return wait_until(lock, chrono::steady_clock::now() + d, pred);
+    }
+
+    //! Waits on this condition variable until a point in time.
+    //! Releases the given \p lock and blocks the calling thread until a
+    //! notification is sent, a spurious wakeup occurs or the time point
+    //! \p t has been reached. The \p lock is reacquired before the
+    //! function returns.
+    template <typename ClockT, typename DurationT>
+    cv_status::cv_status wait_until(
+            unique_lock<mutex>& lock,
+            const chrono::time_point<ClockT, DurationT>& t)
+    {
+        if (wait_for(lock, t - ClockT::now()) == cv_status::no_timeout)
+            return cv_status::no_timeout;
+        // The clock may have been adjusted while we were waiting. An early
+        // return is reported as a spurious wakeup.
+        return ClockT::now() < t ? cv_status::no_timeout : cv_status::timeout;
+    }
+
+    //! Waits on this condition variable until a predicate is satisfied or
+    //! a point in time has been reached.
+    //! Waits until the predicate \p pred returns \p true or the time point
+    //! \p t has been reached. Returns the value of the predicate.
+    template <typename ClockT, typename DurationT, typename PredicateT>
+    bool wait_until(unique_lock<mutex>& lock,
+                    const chrono::time_point<ClockT, DurationT>& t,
+                    PredicateT pred)
+    {
+        while (!pred())
+        {
+            if (wait_until(lock, t) == cv_status::timeout)
+                return pred();
+        }
+        return true;
+    }
+
 
     // TODO: native_handle_type native_handle();
 
@@ -148,32 +184,27 @@ private:
     //! An object to wait on a signal.
     //! A WaitingThread can be enqueued in a list of waiters. The condition
     //! variable can either notify the first waiter or all waiters in the list.
-    struct WaitingThread
+    struct WaitingThread : public detail::waiter_queue_hook
     {
-        WaitingThread()
-            : next(0),
-              dequeued(false)
-        {
-        }
-
-        // The next waiting thread in the list.
-        WaitingThread* next;
         // A semaphore to send a signal to this waiting thread.
         semaphore signal;
-        // A flag which is set when the thread has been removed from the list.
-        bool dequeued;
     };
 
     //! Adds the waiter \p w to the queue.
     void enqueue(WaitingThread& w);
 
-    //! Removes the waiter \p w from the queue.
-    void maybeDequeue(WaitingThread& w);
+    //! Removes the waiter \p w from the queue unless it has been notified
+    //! already. Returns \p true if the waiter has been removed.
+    bool maybeDequeue(WaitingThread& w);
+
+    //! Signals the waiter which follows \p w in a list of waiters notified
+    //! by notify_all(). Must be called after the lock has been reacquired.
+    static void wakeSuccessor(WaitingThread& w);
 
     //! A mutex to protect the list of waiters from concurrent modifications.
     mutex m_mutex;
-    //! A pointer to the first waiter.
-    WaitingThread* m_waitingThreads;
+    //! The threads waiting on this condition variable.
+    detail::waiter_queue m_waiters;
 
 
     // ---- Deleted methods.
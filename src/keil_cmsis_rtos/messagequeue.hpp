@@ -33,6 +33,8 @@
 
 #include "../chrono.hpp"
 #include "../system_error.hpp"
+#include "../common/messagequeue_tags.hpp"
+#include "../optional.hpp"
 
 #include <cstdint>
 #include <cstring>
@@ -44,7 +46,11 @@ WEOS_BEGIN_NAMESPACE
 //! A message queue.
 //! The message_queue is an object to pass elements from one thread to another
 //! in a thread-safe manner. The object statically holds the necessary memory.
-template <typename TypeT, std::size_t QueueSizeT>
+//!
+//! The \p TagT is accepted for compatibility with other backends. CMSIS'
+//! message queues can be used from any number of threads, so every tag
+//! selects the same implementation.
+template <typename TypeT, std::size_t QueueSizeT, typename TagT = locked_tag>
 class message_queue
 {
     // The CMSIS message queue operates on elements of type uint32_t.
@@ -94,16 +100,15 @@ public:
     }
 
     //! Tries to receive an element from the queue.
-    //! Tries to receive an element from the message queue.
-    //! The element is returned together with a boolean, which is set if the
-    //! queue was non-empty. If the queue was empty, the boolean is reset and
-    //! the returned element is default-constructed.
-    std::pair<bool, element_type> try_receive()
+    //! Tries to receive an element from the message queue. If the queue was
+    //! non-empty, the first element is returned in the optional. Otherwise,
+    //! the returned optional is empty.
+    optional<element_type> try_receive()
     {
         osEvent result = osMessageGet(m_id, 0);
         if (result.status == osOK)
         {
-            return std::pair<bool, element_type>(false, element_type());
+            return optional<element_type>();
         }
         else if (result.status != osEventMessage)
         {
@@ -113,17 +118,15 @@ public:
 
         element_type element;
         std::memcpy(&element, &result.value.p, sizeof(element_type));
-        return std::pair<bool, element_type>(true, element);
+        return optional<element_type>(element);
     }
 
     //! Tries to receive an element from the queue.
     //! Tries to receive an element from the message queue within the timeout
-    //! duration \p d.
-    //! The element is returned together with a boolean, which is set if the
-    //! queue was non-empty. If the queue was empty, the boolean is reset and
-    //! the returned element is default-constructed.
+    //! duration \p d. If an element is available in time, it is returned in
+    //! the optional. Otherwise, the returned optional is empty.
     template <typename RepT, typename PeriodT>
-    std::pair<bool, element_type> try_receive_for(
+    optional<element_type> try_receive_for(
             const chrono::duration<RepT, PeriodT>& d)
     {
         try_receiver receiver(m_id);
@@ -132,10 +135,10 @@ public:
         {
             element_type element;
             std::memcpy(&element, &receiver.datum(), sizeof(element_type));
-            return std::pair<bool, element_type>(true, element);
+            return optional<element_type>(element);
         }
 
-        return std::pair<bool, element_type>(false, element_type());
+        return optional<element_type>();
     }
 
     //! Sends an element via the queue.
@@ -189,6 +192,65 @@ public:
                 RepT, PeriodT, try_sender>::wait(d, sender);
     }
 
+    //! Sends a range of elements via the queue.
+    //! Sends the elements in the range [\p first, \p last) in order. If the
+    //! queue is full, the calling thread is blocked until space becomes
+    //! available.
+    //!
+    //! \note CMSIS has no batch API, so the elements are put into the
+    //! queue one by one.
+    template <typename InputIteratorT>
+    void send_n(InputIteratorT first, InputIteratorT last)
+    {
+        for (; first != last; ++first)
+            send(*first);
+    }
+
+    //! Tries to send a range of elements via the queue.
+    //! Appends as many elements from the range [\p first, \p last) as fit
+    //! into the queue and returns their number. The calling thread is never
+    //! blocked.
+    template <typename InputIteratorT>
+    std::size_t try_send_n(InputIteratorT first, InputIteratorT last)
+    {
+        std::size_t count = 0;
+        for (; first != last && try_send(*first); ++first)
+            ++count;
+        return count;
+    }
+
+    //! Receives a batch of elements from the queue.
+    //! Moves up to \p max elements from the queue to \p out and returns
+    //! their number. If the queue is empty, the calling thread is blocked
+    //! until at least one element is available.
+    template <typename OutputIteratorT>
+    std::size_t receive_n(OutputIteratorT out, std::size_t max)
+    {
+        if (max == 0)
+            return 0;
+
+        *out = receive();
+        ++out;
+        return 1 + try_receive_n(out, max - 1);
+    }
+
+    //! Tries to receive a batch of elements from the queue.
+    //! Moves up to \p max elements from the queue to \p out and returns
+    //! their number. The calling thread is never blocked.
+    template <typename OutputIteratorT>
+    std::size_t try_receive_n(OutputIteratorT out, std::size_t max)
+    {
+        std::size_t count = 0;
+        for (; count < max; ++out, ++count)
+        {
+            optional<element_type> result = try_receive();
+            if (!result)
+                break;
+            *out = *result;
+        }
+        return count;
+    }
+
 private:
     //! The storage for the message queue.
     std::uint32_t m_queueData[4 + QueueSizeT];
@@ -31,7 +31,9 @@
 
 #include "core.hpp"
 
+#include "../atomic.hpp"
 #include "../chrono.hpp"
+#include "../semaphore.hpp"
 #include "../system_error.hpp"
 #include "../type_traits.hpp"
 #include "../common/mutexlocks.hpp"
@@ -105,6 +107,12 @@ private:
     const mutex& operator= (const mutex&);
 };
 
+//! A mutex with priority inheritance.
+//! The mutexes of CMSIS-RTOS RTX raise the priority of the owner to the one
+//! of the highest waiting thread, so the plain mutex protects against
+//! priority inversion already.
+typedef mutex pi_mutex;
+
 //! A mutex with timeout support.
 class timed_mutex : public mutex
 {
@@ -274,6 +282,381 @@ public:
     }
 };
 
+//! A mutex with an atomic fast path.
+//! The state of the adaptive_mutex is an atomic word, so locking a free
+//! mutex and unlocking a mutex without waiters does not enter the kernel.
+//! A thread which finds the mutex locked parks on a semaphore. On a single
+//! core, spinning cannot help because the owner does not run while the
+//! caller spins. Thus, this implementation parks immediately.
+//!
+//! The adaptive_mutex satisfies the Lockable concept. It is neither
+//! recursive nor does it support priority inheritance.
+class adaptive_mutex
+{
+public:
+    //! Creates an unlocked mutex.
+    adaptive_mutex()
+        : m_state(unlocked)
+    {
+    }
+
+    //! Locks the mutex.
+    //! Blocks the current thread until this mutex has been locked by it.
+    void lock()
+    {
+        int expected = unlocked;
+        if (m_state.compare_exchange_strong(expected, locked))
+            return;
+
+        // Mark the mutex as contended before parking, such that the owner
+        // wakes us up.
+        while (m_state.exchange(contended) != unlocked)
+            m_parked.wait();
+    }
+
+    //! Tests and locks the mutex if it is available.
+    //! If this mutex is available, it is locked by the calling thread and
+    //! \p true is returned. If the mutex is already locked, the method
+    //! returns \p false without blocking.
+    bool try_lock()
+    {
+        int expected = unlocked;
+        return m_state.compare_exchange_strong(expected, locked);
+    }
+
+    //! Unlocks the mutex.
+    //! Unlocks this mutex which must have been locked previously by the
+    //! calling thread.
+    void unlock()
+    {
+        // A pending token already wakes up the next thread which parks, so
+        // the semaphore never needs more than one.
+        if (m_state.exchange(unlocked) == contended && m_parked.value() == 0)
+            m_parked.post();
+    }
+
+private:
+    enum
+    {
+        //! The mutex is free.
+        unlocked = 0,
+        //! The mutex is locked and no thread is parked.
+        locked = 1,
+        //! The mutex is locked and threads may be parked.
+        contended = 2
+    };
+
+    //! The state of the mutex.
+    atomic_int m_state;
+    //! The semaphore on which threads park.
+    semaphore m_parked;
+
+    // ---- Hidden methods.
+    adaptive_mutex(const adaptive_mutex&);
+    const adaptive_mutex& operator= (const adaptive_mutex&);
+};
+
+//! A reader-writer mutex.
+//! The shared_mutex can be locked exclusively by one writer or shared by
+//! many readers. Writers are preferred: as soon as a writer waits, no new
+//! reader enters, so a steady stream of readers cannot starve a writer. As
+//! a consequence, a reader must not lock the mutex a second time.
+//!
+//! The mutex is an atomic word holding the number of readers, the number
+//! of waiting writers and a flag for the owning writer. Readers which do
+//! not meet a writer only update this word and never call into the kernel.
+//! Blocked threads park on semaphores.
+class shared_mutex
+{
+public:
+    //! Creates an unlocked mutex.
+    shared_mutex()
+        : m_state(0),
+          m_numParkedReaders(0),
+          m_numParkedWriters(0)
+    {
+    }
+
+    //! Locks the mutex exclusively.
+    //! Blocks the current thread until it owns the mutex exclusively.
+    void lock()
+    {
+        if (try_lock())
+            return;
+
+        int state = announceWriter();
+        while (!tryAcquireWriterBit(state))
+        {
+            if (prepareToPark(m_numParkedWriters, writer_bit))
+                m_writerGate.wait();
+            state = m_state.load();
+        }
+
+        // No new reader can enter. The last one of the current readers
+        // posts a token when it leaves.
+        if ((state & reader_mask) != 0)
+            m_drained.wait();
+    }
+
+    //! Tries to lock the mutex exclusively.
+    //! Returns \p true if the mutex was free and has been locked. Otherwise,
+    //! \p false is returned without blocking.
+    bool try_lock()
+    {
+        int expected = 0;
+        return m_state.compare_exchange_strong(expected, writer_bit);
+    }
+
+    //! Unlocks the mutex, which the calling thread must own exclusively.
+    void unlock()
+    {
+        wakeAfterUnlock(m_state.fetch_sub(writer_bit) - writer_bit);
+    }
+
+    //! Locks the mutex shared.
+    //! Blocks the current thread until neither a writer owns the mutex nor
+    //! waits for it.
+    void lock_shared()
+    {
+        while (!try_lock_shared())
+        {
+            if (prepareToPark(m_numParkedReaders, blocks_readers))
+                m_readerGate.wait();
+        }
+    }
+
+    //! Tries to lock the mutex shared.
+    //! Returns \p true if the mutex has been locked shared. If a writer owns
+    //! the mutex or waits for it, \p false is returned without blocking.
+    bool try_lock_shared()
+    {
+        int state = m_state.load();
+        while ((state & blocks_readers) == 0)
+        {
+            WEOS_ASSERT((state & reader_mask) != reader_mask);
+            if (m_state.compare_exchange_strong(state, state + 1))
+                return true;
+        }
+        return false;
+    }
+
+    //! Unlocks the mutex, which the calling thread must own shared.
+    void unlock_shared()
+    {
+        int state = m_state.fetch_sub(1);
+        // The last reader hands the mutex over to the writer which waits
+        // for the readers to leave.
+        if ((state & writer_bit) != 0 && (state & reader_mask) == 1)
+            m_drained.post();
+    }
+
+protected:
+    enum
+    {
+        //! The writer which owns the mutex.
+        writer_bit = 0x40000000,
+        //! The increment for a waiting writer.
+        waiting_writer = 0x00100000,
+        //! The number of waiting writers.
+        waiting_mask = 0x3FF00000,
+        //! The number of readers.
+        reader_mask = 0x000FFFFF,
+        //! New readers are blocked by an owning or a waiting writer.
+        blocks_readers = writer_bit | waiting_mask
+    };
+
+    //! The state of the mutex.
+    atomic_int m_state;
+    //! The number of readers which park on the reader gate.
+    atomic_int m_numParkedReaders;
+    //! The number of writers which park on the writer gate.
+    atomic_int m_numParkedWriters;
+    //! Serializes parking and waking up.
+    mutex m_parkingMutex;
+    //! The semaphore on which readers park.
+    semaphore m_readerGate;
+    //! The semaphore on which writers park until the owning writer leaves.
+    semaphore m_writerGate;
+    //! The semaphore on which the owning writer waits for the readers.
+    semaphore m_drained;
+
+    //! Tries to lock the mutex exclusively before the \p time point.
+    template <typename ClockT, typename DurationT>
+    bool tryLockUntil(const chrono::time_point<ClockT, DurationT>& time)
+    {
+        if (try_lock())
+            return true;
+
+        int state = announceWriter();
+        while (!tryAcquireWriterBit(state))
+        {
+            if (   prepareToPark(m_numParkedWriters, writer_bit)
+                && !m_writerGate.try_wait_until(time)
+                && !unpark(m_numParkedWriters, m_writerGate))
+            {
+                state = m_state.fetch_sub(waiting_writer) - waiting_writer;
+                // The owner may have left meanwhile and its wake-up must not
+                // get lost.
+                if ((state & writer_bit) == 0)
+                    wakeAfterUnlock(state);
+                return false;
+            }
+            state = m_state.load();
+        }
+
+        if (   (state & reader_mask) == 0
+            || m_drained.try_wait_until(time))
+        {
+            return true;
+        }
+
+        // Give up unless the last reader has left in the meantime.
+        state = m_state.load();
+        while ((state & reader_mask) != 0)
+        {
+            if (m_state.compare_exchange_strong(state, state - writer_bit))
+            {
+                wakeAfterUnlock(state - writer_bit);
+                return false;
+            }
+        }
+        // The last reader posts its token right after it has left.
+        m_drained.wait();
+        return true;
+    }
+
+    //! Tries to lock the mutex shared before the \p time point.
+    template <typename ClockT, typename DurationT>
+    bool tryLockSharedUntil(const chrono::time_point<ClockT, DurationT>& time)
+    {
+        while (!try_lock_shared())
+        {
+            if (   prepareToPark(m_numParkedReaders, blocks_readers)
+                && !m_readerGate.try_wait_until(time)
+                && !unpark(m_numParkedReaders, m_readerGate))
+            {
+                return try_lock_shared();
+            }
+        }
+        return true;
+    }
+
+private:
+    //! Registers a waiting writer, which blocks new readers, and returns
+    //! the new state.
+    int announceWriter()
+    {
+        return m_state.fetch_add(waiting_writer) + waiting_writer;
+    }
+
+    //! Turns the calling waiting writer into the owner if no other writer
+    //! owns the mutex. The \p state is updated to the one which has been
+    //! seen.
+    bool tryAcquireWriterBit(int& state)
+    {
+        while ((state & writer_bit) == 0)
+        {
+            if (m_state.compare_exchange_strong(
+                    state, state - waiting_writer + writer_bit))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //! Adds the calling thread to the \p numParked threads if one of the
+    //! \p blockingBits is still set. Returns \p true if the thread has to
+    //! park.
+    bool prepareToPark(atomic_int& numParked, int blockingBits)
+    {
+        lock_guard<mutex> lock(m_parkingMutex);
+        numParked.fetch_add(1);
+        if ((m_state.load() & blockingBits) != 0)
+            return true;
+        numParked.fetch_sub(1);
+        return false;
+    }
+
+    //! Removes a thread whose wait on the \p gate has timed out from the
+    //! \p numParked threads. Returns \p true if a token has been posted
+    //! for it in the meantime.
+    bool unpark(atomic_int& numParked, semaphore& gate)
+    {
+        lock_guard<mutex> lock(m_parkingMutex);
+        if (gate.try_wait())
+            return true;
+        numParked.fetch_sub(1);
+        return false;
+    }
+
+    //! Wakes up the next writer or, if no writer waits, all readers. The
+    //! \p state is the one after the writer has left.
+    void wakeAfterUnlock(int state)
+    {
+        if ((state & waiting_mask) != 0)
+        {
+            if (m_numParkedWriters.load() != 0)
+            {
+                lock_guard<mutex> lock(m_parkingMutex);
+                if (m_numParkedWriters.load() != 0)
+                {
+                    m_numParkedWriters.fetch_sub(1);
+                    m_writerGate.post();
+                }
+            }
+        }
+        else if (m_numParkedReaders.load() != 0)
+        {
+            lock_guard<mutex> lock(m_parkingMutex);
+            int numReaders = m_numParkedReaders.exchange(0);
+            if (numReaders != 0)
+                m_readerGate.post(semaphore::value_type(numReaders));
+        }
+    }
+
+    // ---- Hidden methods.
+    shared_mutex(const shared_mutex&);
+    const shared_mutex& operator= (const shared_mutex&);
+};
+
+//! A reader-writer mutex with timeout support.
+class shared_timed_mutex : public shared_mutex
+{
+public:
+    //! Tries to lock the mutex exclusively within the duration \p timeout.
+    //! Returns \p true if the mutex has been locked.
+    template <typename TRep, typename TPeriod>
+    bool try_lock_for(const chrono::duration<TRep, TPeriod>& timeout)
+    {
+        return tryLockUntil(chrono::steady_clock::now() + timeout);
+    }
+
+    //! Tries to lock the mutex exclusively before the given \p time point.
+    //! Returns \p true if the mutex has been locked.
+    template <typename TClock, typename TDuration>
+    bool try_lock_until(const chrono::time_point<TClock, TDuration>& time)
+    {
+        return tryLockUntil(time);
+    }
+
+    //! Tries to lock the mutex shared within the duration \p timeout.
+    //! Returns \p true if the mutex has been locked.
+    template <typename TRep, typename TPeriod>
+    bool try_lock_shared_for(const chrono::duration<TRep, TPeriod>& timeout)
+    {
+        return tryLockSharedUntil(chrono::steady_clock::now() + timeout);
+    }
+
+    //! Tries to lock the mutex shared before the given \p time point.
+    //! Returns \p true if the mutex has been locked.
+    template <typename TClock, typename TDuration>
+    bool try_lock_shared_until(const chrono::time_point<TClock, TDuration>& time)
+    {
+        return tryLockSharedUntil(time);
+    }
+};
+
 WEOS_END_NAMESPACE
 
 #endif // WEOS_KEIL_CMSIS_RTOS_MUTEX_HPP
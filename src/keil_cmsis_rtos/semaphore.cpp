@@ -32,7 +32,9 @@
 WEOS_BEGIN_NAMESPACE
 
 semaphore::semaphore(value_type value)
-    : m_id(0)
+    : m_id(0),
+      m_bulkWaitId(0),
+      m_bulkWaitState(bulk_wait_absent)
 {
     // Keil's RTOS wants a zero'ed control block type for initialization.
     m_controlBlock._[0] = 0;
@@ -45,6 +47,8 @@ semaphore::semaphore(value_type value)
 
 semaphore::~semaphore()
 {
+    if (m_bulkWaitState.load() == bulk_wait_created)
+        osMutexDelete(m_bulkWaitId);
     if (m_id)
         osSemaphoreDelete(m_id);
 }
@@ -57,6 +61,12 @@ void semaphore::post()
                                 "semaphore::post failed");
 }
 
+void semaphore::post(value_type n)
+{
+    for (; n != 0; --n)
+        post();
+}
+
 void semaphore::wait()
 {
     std::int32_t result = osSemaphoreWait(m_id, osWaitForever);
@@ -75,6 +85,89 @@ bool semaphore::try_wait()
     return result != 0;
 }
 
+void semaphore::wait(value_type n)
+{
+    if (n <= 1)
+    {
+        if (n == 1)
+            wait();
+        return;
+    }
+
+    osMutexId bulkWaitId = bulkWaitMutex();
+    osStatus result = osMutexWait(bulkWaitId, osWaitForever);
+    if (result != osOK)
+        WEOS_THROW_SYSTEM_ERROR(cmsis_error::cmsis_error_t(result),
+                                "semaphore::wait failed");
+
+    bulk_wait_guard guard(bulkWaitId);
+    for (; n != 0; --n)
+        wait();
+}
+
+bool semaphore::try_wait(value_type n)
+{
+    if (n <= 1)
+        return n == 0 || try_wait();
+
+    // Do not take tokens which would have to be returned again.
+    if (value() < n)
+        return false;
+
+    // The rollback below must not interleave with a thread which waits for
+    // tokens. Such a thread holds the mutex and the tokens are left to it.
+    osMutexId bulkWaitId = bulkWaitMutex();
+    osStatus result = osMutexWait(bulkWaitId, 0);
+    if (result == osErrorResource || result == osErrorTimeoutResource)
+        return false;
+    if (result != osOK)
+        WEOS_THROW_SYSTEM_ERROR(cmsis_error::cmsis_error_t(result),
+                                "semaphore::try_wait failed");
+
+    bulk_wait_guard guard(bulkWaitId);
+    for (value_type count = 0; count < n; ++count)
+    {
+        if (!try_wait())
+        {
+            post(count);
+            return false;
+        }
+    }
+    return true;
+}
+
+osMutexId semaphore::bulkWaitMutex()
+{
+    int state = m_bulkWaitState.load();
+    while (state != bulk_wait_created)
+    {
+        if (   state == bulk_wait_absent
+            && m_bulkWaitState.compare_exchange_strong(state,
+                                                       bulk_wait_creating))
+        {
+            // Keil's RTOS wants a zero'ed control block type for
+            // initialization.
+            m_bulkWaitControlBlock[0] = 0;
+            osMutexDef_t mutexDef = { m_bulkWaitControlBlock };
+            m_bulkWaitId = osMutexCreate(&mutexDef);
+            if (m_bulkWaitId == 0)
+            {
+                m_bulkWaitState = bulk_wait_absent;
+                WEOS_THROW_SYSTEM_ERROR(cmsis_error::osErrorOS,
+                                        "semaphore::wait failed");
+            }
+            m_bulkWaitState = bulk_wait_created;
+            return m_bulkWaitId;
+        }
+
+        // Another thread creates the mutex. Sleep instead of yielding, so
+        // that the creator runs even if it has a lower priority.
+        osDelay(1);
+        state = m_bulkWaitState.load();
+    }
+    return m_bulkWaitId;
+}
+
 semaphore::value_type semaphore::value() const
 {
     //! \todo Use an SVC here.
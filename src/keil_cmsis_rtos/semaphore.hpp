@@ -31,6 +31,7 @@
 
 #include "core.hpp"
 
+#include "../atomic.hpp"
 #include "../chrono.hpp"
 #include "../system_error.hpp"
 
@@ -67,6 +68,16 @@ struct SemaphoreControlBlock
 
 
 //! \brief A semaphore.
+//!
+//! CMSIS-RTOS releases and acquires one token at a time. The functions which
+//! take a number of tokens loop over the native calls. A thread waiting for
+//! several tokens holds the ones it has acquired so far; if a timeout
+//! occurs, they are released again. Threads which wait for more than one
+//! token are serialized by an internal mutex. Otherwise, two of them could
+//! each hold a part of the available tokens and wait for the other one
+//! forever. The mutex is created when the first thread waits for more than
+//! one token, so a semaphore which is only used one token at a time (like
+//! the ones of the condition variables) costs no additional kernel calls.
 class semaphore
 {
 public:
@@ -88,12 +99,22 @@ public:
     //! full.
     void post();
 
+    //! \brief Releases semaphore tokens.
+    //!
+    //! Increases the semaphore's value by \p n.
+    void post(value_type n);
+
     //! \brief Waits until a semaphore token is available.
     //!
     //! Blocks the calling thread until the semaphore's value is non-zero.
     //! Then the semaphore is decreased by one and the thread returns.
     void wait();
 
+    //! \brief Waits until semaphore tokens are available.
+    //!
+    //! Blocks the calling thread until it has acquired \p n tokens.
+    void wait(value_type n);
+
     //! \brief Tries to acquire a semaphore token.
     //!
     //! Tries to acquire a semaphore token and returns \p true upon success.
@@ -101,6 +122,14 @@ public:
     //! \p false is returned.
     bool try_wait();
 
+    //! \brief Tries to acquire semaphore tokens.
+    //!
+    //! Tries to acquire \p n tokens without blocking and returns \p true
+    //! upon success. Otherwise, no token is taken and \p false is returned.
+    //! This is also the case while another thread waits for more than one
+    //! token.
+    bool try_wait(value_type n);
+
     //! \brief Tries to acquire a semaphore token within a timeout.
     //!
     //! Tries to acquire a semaphore token within the given \p timeout. The
@@ -145,6 +174,69 @@ public:
         }
     }
 
+    //! \brief Tries to acquire semaphore tokens within a timeout.
+    //!
+    //! Tries to acquire \p n tokens within the given \p timeout. The return
+    //! value is \p true if all tokens could be acquired. Otherwise, no token
+    //! is taken.
+    template <typename RepT, typename PeriodT>
+    inline
+    bool try_wait_for(value_type n,
+                      const chrono::duration<RepT, PeriodT>& timeout)
+    {
+        return try_wait_until(n, chrono::steady_clock::now() + timeout);
+    }
+
+    //! \brief Tries to acquire semaphore tokens up to a time point.
+    //!
+    //! Tries to acquire \p n tokens up to the given \p time point. The
+    //! return value is \p true, if all tokens could be acquired before the
+    //! timeout. Otherwise, no token is taken.
+    template <typename ClockT, typename DurationT>
+    bool try_wait_until(value_type n,
+                        const chrono::time_point<ClockT, DurationT>& time)
+    {
+        if (n <= 1)
+            return n == 0 || try_wait_until(time);
+
+        typedef typename WEOS_NAMESPACE::common_type<
+                             typename ClockT::duration,
+                             DurationT>::type difference_type;
+        typedef chrono::detail::internal_time_cast<difference_type> caster;
+
+        osMutexId bulkWaitId = bulkWaitMutex();
+        while (true)
+        {
+            typename caster::type millisecs
+                    = caster::convert_and_clip(time - ClockT::now());
+
+            osStatus result = osMutexWait(bulkWaitId, millisecs);
+            if (result == osOK)
+                break;
+
+            if (   result != osErrorResource
+                && result != osErrorTimeoutResource)
+            {
+                WEOS_THROW_SYSTEM_ERROR(cmsis_error::cmsis_error_t(result),
+                                        "semaphore::try_wait_until failed");
+            }
+
+            if (millisecs == 0)
+                return false;
+        }
+
+        bulk_wait_guard guard(bulkWaitId);
+        for (value_type count = 0; count < n; ++count)
+        {
+            if (!try_wait_until(time))
+            {
+                post(count);
+                return false;
+            }
+        }
+        return true;
+    }
+
     //! Returns the numer of semaphore tokens.
     value_type value() const;
 
@@ -153,6 +245,48 @@ private:
     detail::SemaphoreControlBlock m_controlBlock;
     //! The native semaphore handle.
     osSemaphoreId m_id;
+    //! Just enough memory to hold a CMSIS mutex. The native API is used
+    //! directly because mutex.hpp depends on this header.
+    std::uint32_t m_bulkWaitControlBlock[4];
+    //! The native handle of the mutex which serializes the threads waiting
+    //! for more than one token. It is valid once m_bulkWaitState is
+    //! bulk_wait_created.
+    osMutexId m_bulkWaitId;
+    //! The creation state of the bulk wait mutex.
+    atomic_int m_bulkWaitState;
+
+    enum
+    {
+        bulk_wait_absent,
+        bulk_wait_creating,
+        bulk_wait_created
+    };
+
+    //! Returns the mutex which serializes the threads waiting for more than
+    //! one token. The mutex is created by the first caller.
+    osMutexId bulkWaitMutex();
+
+    //! Releases the bulk wait mutex when going out of scope.
+    class bulk_wait_guard
+    {
+    public:
+        explicit bulk_wait_guard(osMutexId id)
+            : m_id(id)
+        {
+        }
+
+        ~bulk_wait_guard()
+        {
+            osMutexRelease(m_id);
+        }
+
+    private:
+        osMutexId m_id;
+
+        // ---- Hidden methods.
+        bulk_wait_guard(const bulk_wait_guard&);
+        const bulk_wait_guard& operator= (const bulk_wait_guard&);
+    };
 
     // ---- Hidden methods.
 
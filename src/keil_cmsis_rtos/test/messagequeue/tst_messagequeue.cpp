@@ -42,13 +42,13 @@ TEST(message_queue, Constructor)
 TEST(message_queue, try_get)
 {
     weos::message_queue<std::int32_t, 1> q;
-    std::pair<bool, std::int32_t> result = q.try_receive();
-    ASSERT_FALSE(result.first);
+    weos::optional<std::int32_t> result = q.try_receive();
+    ASSERT_FALSE(result.has_value());
 }
 
 TEST(message_queue, put)
 {
-    std::pair<bool, std::int32_t> result;
+    weos::optional<std::int32_t> result;
 
     weos::message_queue<std::int32_t, 1> q;
     q.send(0x12345678);
@@ -56,13 +56,13 @@ TEST(message_queue, put)
 
     q.send(0x23456789);
     result = q.try_receive();
-    ASSERT_TRUE(result.first);
-    ASSERT_EQ(0x23456789, result.second);
+    ASSERT_TRUE(result.has_value());
+    ASSERT_EQ(0x23456789, *result);
 
     q.send(0x34567890);
     result = q.try_receive_for(weos::chrono::milliseconds(1));
-    ASSERT_TRUE(result.first);
-    ASSERT_EQ(0x34567890, result.second);
+    ASSERT_TRUE(result.has_value());
+    ASSERT_EQ(0x34567890, *result);
 }
 
 #if 0
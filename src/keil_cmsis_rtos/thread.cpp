@@ -35,6 +35,11 @@
 // The stack must be able to hold the registers R0-R15.
 static const std::size_t minimum_custom_stack_size = 64;
 
+// The number of words at the lower end of a custom stack which are written
+// when the thread is created. The kernel stores a magic word in the first
+// one and weos_createTask() writes to word 13. They are not painted.
+static const std::size_t num_unpainted_stack_words = 14;
+
 
 using namespace std;
 
@@ -166,7 +171,9 @@ SharedThreadDataPool& sharedThreadDataPool()
 
 SharedThreadData::SharedThreadData()
     : m_referenceCount(0),
-      m_threadId(0)
+      m_threadId(0),
+      m_paintedStack(0),
+      m_paintedStackSize(0)
 {
 }
 
@@ -258,6 +265,22 @@ void thread::invoke(const attributes& attrs)
                     "thread::invoke: invalid thread attributes");
     }
 
+    if (attrs.m_stackPainting && attrs.m_customStack == 0)
+    {
+        WEOS_THROW_SYSTEM_ERROR(
+                    errc::invalid_argument,
+                    "thread::invoke: no custom stack to paint");
+    }
+
+    // The stack has to be painted before the thread starts because it
+    // might run immediately.
+    if (attrs.m_stackPainting)
+    {
+        std::size_t offset = num_unpainted_stack_words * sizeof(std::uint32_t);
+        m_data->paintStack(static_cast<char*>(attrs.m_customStack) + offset,
+                           attrs.m_customStackSize - offset);
+    }
+
     // Start the new thread.
     if (attrs.m_customStack)
     {
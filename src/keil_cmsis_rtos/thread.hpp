@@ -111,7 +111,8 @@ struct native_thread_traits
         attributes()
             : m_priority(Normal),
               m_customStackSize(0),
-              m_customStack(0)
+              m_customStack(0),
+              m_stackPainting(false)
         {
         }
 
@@ -137,6 +138,20 @@ struct native_thread_traits
             return *this;
         }
 
+        //! Enables stack painting.
+        //! If \p enable is set, the custom stack which has been passed to
+        //! setStack() is filled with a pattern before the thread starts.
+        //! The stack usage can then be measured with thread::stack_usage().
+        //! Painting requires a custom stack. The lowest words of the stack,
+        //! which are written when the thread is created, are not painted.
+        //!
+        //! The default is \p false.
+        attributes& setStackPainting(bool enable)
+        {
+            m_stackPainting = enable;
+            return *this;
+        }
+
     private:
         //! The thread's priority.
         Priority m_priority;
@@ -144,6 +159,8 @@ struct native_thread_traits
         std::size_t m_customStackSize;
         //! A pointer to the custom stack.
         void* m_customStack;
+        //! Set if the custom stack is painted.
+        bool m_stackPainting;
 
         friend class WEOS_NAMESPACE::thread;
     };
@@ -71,7 +71,9 @@ SharedThreadDataPool& sharedThreadDataPool()
 
 SharedThreadData::SharedThreadData()
     : m_referenceCount(0),
-      m_threadId(0)
+      m_threadId(0),
+      m_paintedStack(0),
+      m_paintedStackSize(0)
 {
 }
 
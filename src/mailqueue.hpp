@@ -0,0 +1,196 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef WEOS_MAILQUEUE_HPP
+#define WEOS_MAILQUEUE_HPP
+
+#include "config.hpp"
+
+#include "chrono.hpp"
+#include "messagequeue.hpp"
+#include "objectpool.hpp"
+#include "utility.hpp"
+
+
+WEOS_BEGIN_NAMESPACE
+
+//! A mail queue.
+//! A mail queue transfers large objects (mails) of type \p TypeT from one
+//! thread to another without copying them. It combines a shared_object_pool,
+//! which holds the memory for (\p QueueSizeT) mails, with a message queue
+//! for pointers. A mail is created in the pool, filled by the sender and
+//! its address is transfered to the receiver, which must return the mail
+//! to the pool after processing it:
+//! \code
+//! mail_queue<Packet, 4> mq;
+//! // Sender
+//! Packet* p = mq.emplace(source, length);
+//! mq.send(p);
+//! // Receiver
+//! Packet* q = mq.receive();
+//! process(*q);
+//! mq.free(q);
+//! \endcode
+//!
+//! As the pool and the queue have the same capacity, sending a mail never
+//! blocks. Only allocating a mail blocks if all mails are in use.
+//!
+//! In contrast to the object pools, the allocation functions of the mail
+//! queue always construct the mail and free() always destroys it.
+template <typename TypeT, std::size_t QueueSizeT>
+class mail_queue
+{
+public:
+    //! The type of the mails which are transfered via this queue.
+    typedef TypeT element_type;
+
+    //! Returns the capacity.
+    //! Returns the maximum number of mails which can be allocated from this
+    //! queue.
+    std::size_t capacity() const WEOS_NOEXCEPT
+    {
+        return QueueSizeT;
+    }
+
+    //! Allocates a mail.
+    //! Allocates a default-constructed mail and returns a pointer to it.
+    //! If all mails are in use, the calling thread is blocked until a mail
+    //! is freed.
+    element_type* allocate()
+    {
+        return m_pool.construct();
+    }
+
+    //! Tries to allocate a mail.
+    //! Tries to allocate a default-constructed mail and returns a pointer
+    //! to it. If all mails are in use, a null-pointer is returned.
+    element_type* try_allocate()
+    {
+        return m_pool.try_construct();
+    }
+
+    //! Tries to allocate a mail with timeout.
+    //! Tries to allocate a default-constructed mail and returns a pointer
+    //! to it. If all mails are in use, the calling thread is blocked until
+    //! either a mail is freed or the timeout duration \p d expires. In the
+    //! latter case, a null-pointer is returned.
+    template <typename RepT, typename PeriodT>
+    element_type* try_allocate_for(const chrono::duration<RepT, PeriodT>& d)
+    {
+        return m_pool.try_construct_for(d);
+    }
+
+    //! Constructs a mail in place.
+    //! Allocates a mail and constructs it from the given arguments. If all
+    //! mails are in use, the calling thread is blocked until a mail is freed.
+    template <class T1>
+    element_type* emplace(WEOS_FWD_REF(T1) x1)
+    {
+        return m_pool.construct(weos::forward<T1>(x1));
+    }
+
+    template <class T1, class T2>
+    element_type* emplace(WEOS_FWD_REF(T1) x1, WEOS_FWD_REF(T2) x2)
+    {
+        return m_pool.construct(weos::forward<T1>(x1),
+                                weos::forward<T2>(x2));
+    }
+
+    //! Tries to construct a mail in place.
+    //! Tries to allocate a mail and constructs it from the given arguments.
+    //! If all mails are in use, a null-pointer is returned.
+    template <class T1>
+    element_type* try_emplace(WEOS_FWD_REF(T1) x1)
+    {
+        return m_pool.try_construct(weos::forward<T1>(x1));
+    }
+
+    template <class T1, class T2>
+    element_type* try_emplace(WEOS_FWD_REF(T1) x1, WEOS_FWD_REF(T2) x2)
+    {
+        return m_pool.try_construct(weos::forward<T1>(x1),
+                                    weos::forward<T2>(x2));
+    }
+
+    //! Frees a mail.
+    //! Destroys the \p mail, which must have been allocated from this queue,
+    //! and returns its memory.
+    void free(element_type* const mail)
+    {
+        m_pool.destroy(mail);
+    }
+
+    //! Sends a mail.
+    //! Appends the \p mail, which must have been allocated from this queue,
+    //! to the queue. The ownership of the mail passes to the receiver.
+    void send(element_type* const mail)
+    {
+        WEOS_ASSERT(mail != 0);
+        // There is a slot in the queue for every mail, so this never blocks.
+        m_queue.send(mail);
+    }
+
+    //! Receives a mail.
+    //! Returns the first mail from the queue. If the queue is empty, the
+    //! calling thread is blocked until a mail is sent. The caller has to
+    //! free() the mail after processing it.
+    element_type* receive()
+    {
+        return m_queue.receive();
+    }
+
+    //! Tries to receive a mail.
+    //! Returns the first mail from the queue. If the queue is empty, a
+    //! null-pointer is returned.
+    element_type* try_receive()
+    {
+        optional<element_type*> mail = m_queue.try_receive();
+        return mail ? *mail : 0;
+    }
+
+    //! Tries to receive a mail with timeout.
+    //! Returns the first mail from the queue. If the queue is empty, the
+    //! calling thread is blocked until either a mail is sent or the timeout
+    //! duration \p d expires. In the latter case, a null-pointer is returned.
+    template <typename RepT, typename PeriodT>
+    element_type* try_receive_for(const chrono::duration<RepT, PeriodT>& d)
+    {
+        optional<element_type*> mail = m_queue.try_receive_for(d);
+        return mail ? *mail : 0;
+    }
+
+private:
+    //! The pool which holds the mails.
+    shared_object_pool<element_type, QueueSizeT> m_pool;
+    //! The queue which transfers the addresses of the mails.
+    message_queue<element_type*, QueueSizeT> m_queue;
+};
+
+WEOS_END_NAMESPACE
+
+#endif // WEOS_MAILQUEUE_HPP
@@ -159,6 +159,10 @@ private:
 //! The thread-safe interface brings along some additional functionality. When
 //! allocating from an empty pool, the calling thread can be put to sleep until
 //! another thread returns an element back to the pool.
+//!
+//! Several chunks can be allocated and freed at once with allocate_n() and
+//! free_n(). This takes the lock and updates the semaphore only once per
+//! batch.
 template <typename TElement, std::size_t TNumElem>
 class shared_memory_pool
 {
@@ -256,6 +260,71 @@ public:
         m_numElements.post();
     }
 
+    //! Allocates several chunks of memory.
+    //! Allocates \p n chunks and stores the pointers to them in \p chunks.
+    //! The calling thread is blocked until \p n chunks are available. \p n
+    //! must not exceed the capacity.
+    //!
+    //! \sa free_n(), try_allocate_n(), try_allocate_n_for()
+    void allocate_n(void** chunks, std::size_t n)
+    {
+        WEOS_ASSERT(n <= TNumElem);
+        m_numElements.wait(static_cast<semaphore::value_type>(n));
+        take(chunks, n);
+    }
+
+    //! Tries to allocate several chunks of memory.
+    //! Allocates \p n chunks, stores the pointers to them in \p chunks and
+    //! returns \p true if enough memory is available. Otherwise, nothing is
+    //! allocated and \p false is returned.
+    //!
+    //! \sa allocate_n(), free_n(), try_allocate_n_for()
+    bool try_allocate_n(void** chunks, std::size_t n)
+    {
+        if (n > TNumElem
+            || !m_numElements.try_wait(
+                    static_cast<semaphore::value_type>(n)))
+        {
+            return false;
+        }
+        take(chunks, n);
+        return true;
+    }
+
+    //! Tries to allocate several chunks of memory with timeout.
+    //! Allocates \p n chunks, stores the pointers to them in \p chunks and
+    //! returns \p true if enough memory becomes available within the
+    //! duration \p d. Otherwise, nothing is allocated and \p false is
+    //! returned.
+    //!
+    //! \sa allocate_n(), free_n(), try_allocate_n()
+    template <typename RepT, typename PeriodT>
+    bool try_allocate_n_for(void** chunks, std::size_t n,
+                            const chrono::duration<RepT, PeriodT>& d)
+    {
+        if (n > TNumElem
+            || !m_numElements.try_wait_for(
+                    static_cast<semaphore::value_type>(n), d))
+        {
+            return false;
+        }
+        take(chunks, n);
+        return true;
+    }
+
+    //! Frees several chunks of memory.
+    //! Frees the \p n \p chunks which must have been allocated through this
+    //! pool.
+    //!
+    //! \sa allocate_n(), try_allocate_n(), try_allocate_n_for()
+    void free_n(void* const* chunks, std::size_t n)
+    {
+        lock_guard<mutex> lock(m_mutex);
+        for (std::size_t index = 0; index < n; ++index)
+            m_memoryPool.free(chunks[index]);
+        m_numElements.post(static_cast<semaphore::value_type>(n));
+    }
+
 private:
     typedef memory_pool<TElement, TNumElem> pool_t;
     //! The pool from which the memory for the element is allocated.
@@ -264,6 +333,18 @@ private:
     mutable mutex m_mutex;
     //! The number of available elements.
     semaphore m_numElements;
+
+    //! Takes \p n chunks, for which tokens have been acquired, from the
+    //! pool and stores them in \p chunks.
+    void take(void** chunks, std::size_t n)
+    {
+        lock_guard<mutex> lock(m_mutex);
+        for (std::size_t index = 0; index < n; ++index)
+        {
+            chunks[index] = m_memoryPool.try_allocate();
+            WEOS_ASSERT(chunks[index]);
+        }
+    }
 };
 
 WEOS_END_NAMESPACE
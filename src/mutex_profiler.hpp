@@ -0,0 +1,524 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef WEOS_MUTEX_PROFILER_HPP
+#define WEOS_MUTEX_PROFILER_HPP
+
+#include "config.hpp"
+#include "chrono.hpp"
+#include "mutex.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+
+WEOS_BEGIN_NAMESPACE
+
+//! The statistics of a profiled_mutex.
+struct mutex_profile
+{
+    typedef chrono::high_resolution_clock::duration duration;
+
+    mutex_profile()
+        : name(0),
+          acquisitions(0),
+          contended_acquisitions(0),
+          timed_out_waits(0),
+          total_wait_time(0),
+          max_wait_time(0),
+          total_hold_time(0),
+          max_hold_time(0)
+    {
+    }
+
+    //! The name with which the mutex has been created.
+    const char* name;
+    //! The number of times the mutex has been locked.
+    std::uint32_t acquisitions;
+    //! The number of times a thread had to wait because the mutex was
+    //! locked by another thread.
+    std::uint32_t contended_acquisitions;
+    //! The number of times a thread gave up waiting for the mutex in
+    //! try_lock_for() or try_lock_until() because of a timeout.
+    std::uint32_t timed_out_waits;
+    //! The time threads have been waiting for the mutex in total. This
+    //! includes the waits which timed out.
+    duration total_wait_time;
+    //! The longest time a thread has been waiting for the mutex, whether it
+    //! acquired the mutex or not.
+    duration max_wait_time;
+    //! The time the mutex has been held in total.
+    duration total_hold_time;
+    //! The longest time the mutex has been held at once.
+    duration max_hold_time;
+};
+
+//! The registry of all profiled mutexes.
+//! If WEOS_ENABLE_MUTEX_PROFILING is not defined, the registry is always
+//! empty.
+class mutex_profiler
+{
+public:
+    //! The key by which the profiles are sorted in descending order.
+    enum sort_key
+    {
+        by_total_wait_time,
+        by_max_wait_time,
+        by_total_hold_time,
+        by_max_hold_time,
+        by_contended_acquisitions,
+        by_acquisitions
+    };
+
+    //! Copies the profiles of all mutexes sorted by the given \p key to the
+    //! array \p profiles. At most \p capacity profiles are copied. The
+    //! return value is the number of profiled mutexes, which may be larger
+    //! than the \p capacity.
+    static std::size_t collect(mutex_profile* profiles, std::size_t capacity,
+                               sort_key key = by_total_wait_time);
+
+    //! Prints a table with the profiles of all mutexes sorted by the given
+    //! \p key to the \p file.
+    static void print_report(std::FILE* file = stdout,
+                             sort_key key = by_total_wait_time);
+
+    //! Resets the statistics of all mutexes.
+    static void reset();
+
+private:
+    //! Takes a snapshot of every mutex and sorts the registry by the
+    //! \p key. Returns the number of mutexes. The caller must hold the
+    //! registry mutex.
+    static std::size_t sortRegistry(sort_key key);
+
+    //! Returns \p true if \p x has to be reported before \p y.
+    static bool isBefore(const mutex_profile& x, const mutex_profile& y,
+                         sort_key key);
+};
+
+#if defined(WEOS_ENABLE_MUTEX_PROFILING)
+
+namespace detail
+{
+
+//! The part of a profiled_mutex which does not depend on the mutex type.
+//! The statistics are guarded by a separate profile mutex, so that the
+//! profiler can read them while the profiled mutex is locked. The thread
+//! which holds the profiled mutex locks the profile mutex in unlock() to
+//! publish its hold time. A thread whose timed wait failed locks it
+//! without holding the profiled mutex. The profiler locks it while it
+//! holds the registry mutex. The profile mutex is always the last one to
+//! be locked and nothing else is locked while it is held, which rules out
+//! a deadlock.
+//!
+//! Note that this makes every unlock() of a profiled_mutex lock and unlock
+//! a second, uncontended mutex. With CMSIS-RTOS, these are two more kernel
+//! calls. The statistics cannot be kept in atomics instead because the
+//! portable atomic types are at most as wide as a long, whereas the
+//! durations are 64 bits wide.
+class profiled_mutex_base
+{
+public:
+    //! Returns the name of the mutex.
+    const char* name() const
+    {
+        return m_profile.name;
+    }
+
+protected:
+    typedef chrono::high_resolution_clock clock;
+
+    explicit profiled_mutex_base(const char* name)
+        : m_contended(false),
+          m_waitTime(0),
+          m_previous(0),
+          m_next(0)
+    {
+        m_profile.name = name;
+
+        lock_guard<mutex> lock(registryMutex());
+        m_next = registryHead();
+        if (m_next)
+            m_next->m_previous = this;
+        registryHead() = this;
+    }
+
+    ~profiled_mutex_base()
+    {
+        lock_guard<mutex> lock(registryMutex());
+        if (m_previous)
+            m_previous->m_next = m_next;
+        else
+            registryHead() = m_next;
+        if (m_next)
+            m_next->m_previous = m_previous;
+    }
+
+    //! Called by the thread which has acquired the mutex without waiting.
+    void acquired()
+    {
+        m_contended = false;
+        m_waitTime = mutex_profile::duration(0);
+        m_lockedSince = clock::now();
+    }
+
+    //! Called by the thread which has acquired the mutex after it has been
+    //! waiting since \p start.
+    void acquired(const clock::time_point& start)
+    {
+        m_lockedSince = clock::now();
+        m_contended = true;
+        m_waitTime = m_lockedSince - start;
+    }
+
+    //! Called by a thread which has been waiting for the mutex since
+    //! \p start but gave up because of a timeout.
+    void timedOut(const clock::time_point& start)
+    {
+        mutex_profile::duration waitTime = clock::now() - start;
+
+        lock_guard<mutex> lock(m_profileMutex);
+        ++m_profile.timed_out_waits;
+        m_profile.total_wait_time += waitTime;
+        if (waitTime > m_profile.max_wait_time)
+            m_profile.max_wait_time = waitTime;
+    }
+
+    //! Called by the thread which holds the mutex before it unlocks it.
+    void released()
+    {
+        mutex_profile::duration holdTime = clock::now() - m_lockedSince;
+
+        lock_guard<mutex> lock(m_profileMutex);
+        ++m_profile.acquisitions;
+        if (m_contended)
+        {
+            ++m_profile.contended_acquisitions;
+            m_profile.total_wait_time += m_waitTime;
+            if (m_waitTime > m_profile.max_wait_time)
+                m_profile.max_wait_time = m_waitTime;
+        }
+        m_profile.total_hold_time += holdTime;
+        if (holdTime > m_profile.max_hold_time)
+            m_profile.max_hold_time = holdTime;
+    }
+
+private:
+    //! The statistics of this mutex.
+    mutex_profile m_profile;
+    //! Guards m_profile.
+    mutex m_profileMutex;
+
+    // The following members are only accessed by the thread which holds the
+    // profiled mutex.
+    bool m_contended;
+    mutex_profile::duration m_waitTime;
+    clock::time_point m_lockedSince;
+
+    // The links in the registry, which are guarded by the registry mutex.
+    profiled_mutex_base* m_previous;
+    profiled_mutex_base* m_next;
+    //! A copy of m_profile which the profiler sorts.
+    mutex_profile m_snapshot;
+
+    friend class WEOS_NAMESPACE::mutex_profiler;
+
+    static mutex& registryMutex()
+    {
+        static mutex m;
+        return m;
+    }
+
+    static profiled_mutex_base*& registryHead()
+    {
+        static profiled_mutex_base* head = 0;
+        return head;
+    }
+
+    // ---- Hidden methods.
+    profiled_mutex_base(const profiled_mutex_base&);
+    const profiled_mutex_base& operator= (const profiled_mutex_base&);
+};
+
+} // namespace detail
+
+//! A mutex which records contention statistics.
+//! The profiled_mutex wraps a mutex of type \p MutexT and records how often
+//! it is acquired, how often and how long threads have to wait for it and
+//! how long it is held. The statistics are tagged with a name and can be
+//! inspected with the mutex_profiler. The timestamps are taken from the
+//! high_resolution_clock.
+//!
+//! Profiling is enabled with the macro WEOS_ENABLE_MUTEX_PROFILING.
+//! Otherwise, the profiled_mutex is a plain \p MutexT. The \p MutexT must
+//! not be recursive.
+template <typename MutexT = mutex>
+class profiled_mutex : public detail::profiled_mutex_base
+{
+public:
+    typedef MutexT mutex_type;
+
+    //! Creates a profiled mutex whose statistics are tagged with the
+    //! \p name. The string must outlive the mutex.
+    explicit profiled_mutex(const char* name)
+        : detail::profiled_mutex_base(name)
+    {
+    }
+
+    //! Locks the mutex.
+    void lock()
+    {
+        if (m_mutex.try_lock())
+        {
+            acquired();
+            return;
+        }
+
+        clock::time_point start = clock::now();
+        m_mutex.lock();
+        acquired(start);
+    }
+
+    //! Tries to lock the mutex without blocking.
+    bool try_lock()
+    {
+        if (!m_mutex.try_lock())
+            return false;
+        acquired();
+        return true;
+    }
+
+    //! Tries to lock the mutex within the duration \p d. This requires a
+    //! timed \p MutexT.
+    template <typename RepT, typename PeriodT>
+    bool try_lock_for(const chrono::duration<RepT, PeriodT>& d)
+    {
+        if (try_lock())
+            return true;
+
+        clock::time_point start = clock::now();
+        if (!m_mutex.try_lock_for(d))
+        {
+            timedOut(start);
+            return false;
+        }
+        acquired(start);
+        return true;
+    }
+
+    //! Tries to lock the mutex before the time point \p tp. This requires a
+    //! timed \p MutexT.
+    template <typename ClockT, typename DurationT>
+    bool try_lock_until(const chrono::time_point<ClockT, DurationT>& tp)
+    {
+        if (try_lock())
+            return true;
+
+        clock::time_point start = clock::now();
+        if (!m_mutex.try_lock_until(tp))
+        {
+            timedOut(start);
+            return false;
+        }
+        acquired(start);
+        return true;
+    }
+
+    //! Unlocks the mutex.
+    void unlock()
+    {
+        released();
+        m_mutex.unlock();
+    }
+
+private:
+    //! The wrapped mutex.
+    mutex_type m_mutex;
+};
+
+inline
+bool mutex_profiler::isBefore(const mutex_profile& x, const mutex_profile& y,
+                              sort_key key)
+{
+    switch (key)
+    {
+    case by_max_wait_time:
+        return x.max_wait_time > y.max_wait_time;
+    case by_total_hold_time:
+        return x.total_hold_time > y.total_hold_time;
+    case by_max_hold_time:
+        return x.max_hold_time > y.max_hold_time;
+    case by_contended_acquisitions:
+        return x.contended_acquisitions > y.contended_acquisitions;
+    case by_acquisitions:
+        return x.acquisitions > y.acquisitions;
+    default:
+        return x.total_wait_time > y.total_wait_time;
+    }
+}
+
+inline
+std::size_t mutex_profiler::sortRegistry(sort_key key)
+{
+    typedef detail::profiled_mutex_base base;
+
+    // Insertion sort of the linked list. Equal entries keep their order.
+    base* sorted = 0;
+    std::size_t count = 0;
+    for (base* iter = base::registryHead(); iter; ++count)
+    {
+        base* next = iter->m_next;
+        {
+            lock_guard<mutex> lock(iter->m_profileMutex);
+            iter->m_snapshot = iter->m_profile;
+        }
+
+        base** position = &sorted;
+        while (*position && !isBefore(iter->m_snapshot,
+                                      (*position)->m_snapshot, key))
+        {
+            position = &(*position)->m_next;
+        }
+        iter->m_next = *position;
+        *position = iter;
+        iter = next;
+    }
+
+    base* previous = 0;
+    for (base* iter = sorted; iter; iter = iter->m_next)
+    {
+        iter->m_previous = previous;
+        previous = iter;
+    }
+    base::registryHead() = sorted;
+    return count;
+}
+
+inline
+std::size_t mutex_profiler::collect(mutex_profile* profiles,
+                                    std::size_t capacity, sort_key key)
+{
+    typedef detail::profiled_mutex_base base;
+
+    lock_guard<mutex> registryLock(base::registryMutex());
+    std::size_t count = sortRegistry(key);
+    std::size_t index = 0;
+    for (base* iter = base::registryHead(); iter && index < capacity;
+         iter = iter->m_next)
+    {
+        profiles[index++] = iter->m_snapshot;
+    }
+    return count;
+}
+
+inline
+void mutex_profiler::print_report(std::FILE* file, sort_key key)
+{
+    typedef detail::profiled_mutex_base base;
+    typedef chrono::microseconds us;
+
+    lock_guard<mutex> registryLock(base::registryMutex());
+    sortRegistry(key);
+
+    std::fprintf(file, "%-24s %12s %12s %12s %14s %14s %14s %14s\n",
+                 "mutex", "acquisitions", "contended", "timeouts",
+                 "wait sum [us]", "wait max [us]",
+                 "hold sum [us]", "hold max [us]");
+    for (base* iter = base::registryHead(); iter; iter = iter->m_next)
+    {
+        const mutex_profile& p = iter->m_snapshot;
+        std::fprintf(file,
+                     "%-24s %12lu %12lu %12lu %14lld %14lld %14lld %14lld\n",
+                     p.name ? p.name : "?",
+                     (unsigned long)p.acquisitions,
+                     (unsigned long)p.contended_acquisitions,
+                     (unsigned long)p.timed_out_waits,
+                     (long long)chrono::duration_cast<us>(
+                         p.total_wait_time).count(),
+                     (long long)chrono::duration_cast<us>(
+                         p.max_wait_time).count(),
+                     (long long)chrono::duration_cast<us>(
+                         p.total_hold_time).count(),
+                     (long long)chrono::duration_cast<us>(
+                         p.max_hold_time).count());
+    }
+}
+
+inline
+void mutex_profiler::reset()
+{
+    typedef detail::profiled_mutex_base base;
+
+    lock_guard<mutex> registryLock(base::registryMutex());
+    for (base* iter = base::registryHead(); iter; iter = iter->m_next)
+    {
+        lock_guard<mutex> lock(iter->m_profileMutex);
+        const char* name = iter->m_profile.name;
+        iter->m_profile = mutex_profile();
+        iter->m_profile.name = name;
+    }
+}
+
+#else
+
+//! A mutex which records contention statistics.
+//! As WEOS_ENABLE_MUTEX_PROFILING is not defined, the profiled_mutex is a
+//! plain \p MutexT and records nothing.
+template <typename MutexT = mutex>
+class profiled_mutex : public MutexT
+{
+public:
+    typedef MutexT mutex_type;
+
+    explicit profiled_mutex(const char* /*name*/)
+    {
+    }
+};
+
+inline
+std::size_t mutex_profiler::collect(mutex_profile*, std::size_t, sort_key)
+{
+    return 0;
+}
+
+inline
+void mutex_profiler::print_report(std::FILE*, sort_key)
+{
+}
+
+inline
+void mutex_profiler::reset()
+{
+}
+
+#endif // WEOS_ENABLE_MUTEX_PROFILING
+
+WEOS_END_NAMESPACE
+
+#endif // WEOS_MUTEX_PROFILER_HPP
@@ -30,6 +30,7 @@
 #define WEOS_OBJECTPOOL_HPP
 
 #include "memorypool.hpp"
+#include "utility.hpp"
 
 
 WEOS_BEGIN_NAMESPACE
@@ -0,0 +1,636 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef WEOS_PRIORITYMESSAGEQUEUE_HPP
+#define WEOS_PRIORITYMESSAGEQUEUE_HPP
+
+#include "config.hpp"
+
+#include "chrono.hpp"
+#include "mutex.hpp"
+#include "optional.hpp"
+#include "semaphore.hpp"
+#include "type_traits.hpp"
+#include "utility.hpp"
+
+#include <cstdint>
+#include <new>
+
+
+WEOS_BEGIN_NAMESPACE
+
+namespace detail
+{
+
+//! Returns the number of leading zero bits in the non-zero \p x.
+inline
+unsigned count_leading_zeros(std::uint32_t x)
+{
+    WEOS_ASSERT(x != 0);
+#if defined(__CC_ARM)
+    return __clz(x);
+#elif defined(__GNUC__)
+    return __builtin_clz(x);
+#else
+    unsigned count = 0;
+    for (std::uint32_t mask = 0x80000000u; (x & mask) == 0; mask >>= 1)
+        ++count;
+    return count;
+#endif
+}
+
+} // namespace detail
+
+//! A message queue with priorities.
+//! The priority_message_queue passes elements of type \p TypeT from one
+//! thread to another like a message_queue. In addition, every element is
+//! sent with a priority in the range [0, \p NumLevelsT). The receiver always
+//! gets the oldest element with the highest priority, i.e. urgent elements
+//! overtake less urgent ones but the order within a priority level is FIFO.
+//! Larger numbers denote higher priorities, i.e. \p NumLevelsT - 1 is the
+//! most urgent level and 0 the least urgent one, like the thread
+//! priorities. Note that the task_scheduler uses the opposite order.
+//!
+//! The queue holds at most (\p QueueSizeT) elements in total, regardless of
+//! their priorities. The memory is allocated statically. The levels which
+//! contain elements are tracked in a bitmap, so the highest non-empty level
+//! is found in constant time by counting the leading zeros.
+//!
+//! The API is the one of message_queue with an additional priority
+//! argument. Moving and emplacing elements requires C++11. Everything else
+//! also compiles as C++03, where static_assert is emulated by core.hpp.
+template <typename TypeT, std::size_t QueueSizeT, unsigned NumLevelsT>
+class priority_message_queue
+{
+    static_assert(QueueSizeT > 0, "The queue size must be non-zero.");
+    static_assert(NumLevelsT > 0 && NumLevelsT <= 32,
+                  "The number of priority levels must be in [1, 32].");
+
+public:
+    //! The type of the elements transfered via this message queue.
+    typedef TypeT element_type;
+
+    //! Creates a priority message queue.
+    //! Creates an empty priority message queue.
+    priority_message_queue()
+        : m_freeList(0),
+          m_nonEmptyLevels(0),
+          m_numElements(0),
+          m_numFreeNodes(QueueSizeT)
+    {
+        for (std::size_t index = 0; index < QueueSizeT; ++index)
+            m_nodes[index].next = index + 1;
+        for (unsigned level = 0; level < NumLevelsT; ++level)
+        {
+            m_levels[level].head = null_index;
+            m_levels[level].tail = null_index;
+        }
+    }
+
+    //! Destroys the priority message queue.
+    //! Destroys the queue and all elements which are still stored in it.
+    ~priority_message_queue()
+    {
+        for (unsigned level = 0; level < NumLevelsT; ++level)
+        {
+            for (std::size_t index = m_levels[level].head;
+                 index != null_index; index = m_nodes[index].next)
+            {
+                m_nodes[index].element()->~element_type();
+            }
+        }
+    }
+
+    //! Returns the capacity.
+    //! Returns the maximum number of elements which the queue can hold.
+    std::size_t capacity() const WEOS_NOEXCEPT
+    {
+        return QueueSizeT;
+    }
+
+    //! Returns the number of priority levels.
+    unsigned num_levels() const WEOS_NOEXCEPT
+    {
+        return NumLevelsT;
+    }
+
+    //! Receives an element from the queue.
+    //! Returns the oldest element with the highest priority. If the queue is
+    //! empty, the calling thread is blocked until an element is added.
+    element_type receive()
+    {
+        m_numElements.wait();
+        optional<element_type> result;
+        pop(result);
+        m_numFreeNodes.post();
+        return weos::move(*result);
+    }
+
+    //! Tries to receive an element from the queue.
+    //! Tries to receive the oldest element with the highest priority. If the
+    //! queue was non-empty, the element is returned in the optional.
+    //! Otherwise, the returned optional is empty.
+    optional<element_type> try_receive()
+    {
+        optional<element_type> result;
+        if (m_numElements.try_wait())
+        {
+            pop(result);
+            m_numFreeNodes.post();
+        }
+        return result;
+    }
+
+    //! Tries to receive an element from the queue.
+    //! Tries to receive the oldest element with the highest priority within
+    //! the timeout duration \p d. If an element is available in time, it is
+    //! returned in the optional. Otherwise, the returned optional is empty.
+    template <typename RepT, typename PeriodT>
+    optional<element_type> try_receive_for(
+            const chrono::duration<RepT, PeriodT>& d)
+    {
+        optional<element_type> result;
+        if (m_numElements.try_wait_for(d))
+        {
+            pop(result);
+            m_numFreeNodes.post();
+        }
+        return result;
+    }
+
+    //! Receives a batch of elements from the queue.
+    //! Moves up to \p max elements from the queue to \p out in the order in
+    //! which receive() would return them and returns their number. If the
+    //! queue is empty, the calling thread is blocked until at least one
+    //! element is available.
+    template <typename OutputIteratorT>
+    std::size_t receive_n(OutputIteratorT out, std::size_t max)
+    {
+        if (max == 0)
+            return 0;
+
+        m_numElements.wait();
+        return popRange(out, max);
+    }
+
+    //! Tries to receive a batch of elements from the queue.
+    //! Moves up to \p max elements from the queue to \p out and returns
+    //! their number. The calling thread is never blocked.
+    template <typename OutputIteratorT>
+    std::size_t try_receive_n(OutputIteratorT out, std::size_t max)
+    {
+        if (max == 0 || !m_numElements.try_wait())
+            return 0;
+        return popRange(out, max);
+    }
+
+    //! Sends an element via the queue.
+    //! Appends the \p element to the end of the given \p priority level. If
+    //! the queue is full, the calling thread is blocked until space becomes
+    //! available.
+    void send(const element_type& element, unsigned priority)
+    {
+        WEOS_ASSERT(priority < NumLevelsT);
+        m_numFreeNodes.wait();
+        push(priority, element);
+    }
+
+    //! Tries to send an element via the queue.
+    //! Tries to append the \p element to the end of the given \p priority
+    //! level. If no space was available, \p false is returned. Otherwise the
+    //! method returns \p true. The calling thread is never blocked.
+    bool try_send(const element_type& element, unsigned priority)
+    {
+        WEOS_ASSERT(priority < NumLevelsT);
+        if (!m_numFreeNodes.try_wait())
+            return false;
+        push(priority, element);
+        return true;
+    }
+
+    //! Tries to send an element via the queue.
+    //! Tries to append the \p element to the end of the given \p priority
+    //! level and returns \p true if successful. If there is no space
+    //! available within the duration \p d, the operation is aborted
+    //! and \p false is returned.
+    template <typename RepT, typename PeriodT>
+    bool try_send_for(const element_type& element, unsigned priority,
+                      const chrono::duration<RepT, PeriodT>& d)
+    {
+        WEOS_ASSERT(priority < NumLevelsT);
+        if (!m_numFreeNodes.try_wait_for(d))
+            return false;
+        push(priority, element);
+        return true;
+    }
+
+#if defined(WEOS_USE_CXX11)
+    //! Sends an element via the queue.
+    //! Moves the \p element to the end of the given \p priority level. If
+    //! the queue is full, the calling thread is blocked until space becomes
+    //! available.
+    void send(element_type&& element, unsigned priority)
+    {
+        emplace(priority, std::move(element));
+    }
+
+    //! Tries to send an element via the queue.
+    //! Tries to move the \p element to the end of the given \p priority
+    //! level. If no space was available, \p false is returned and
+    //! \p element is left untouched. Otherwise the method returns \p true.
+    //! The calling thread is never blocked.
+    bool try_send(element_type&& element, unsigned priority)
+    {
+        return try_emplace(priority, std::move(element));
+    }
+
+    //! Tries to send an element via the queue.
+    //! Tries to move the \p element to the end of the given \p priority
+    //! level and returns \p true if successful. If there is no space
+    //! available within the duration \p d, the operation is aborted
+    //! and \p false is returned.
+    template <typename RepT, typename PeriodT>
+    bool try_send_for(element_type&& element, unsigned priority,
+                      const chrono::duration<RepT, PeriodT>& d)
+    {
+        return try_emplace_for(priority, d, std::move(element));
+    }
+
+    //! Constructs an element in the queue.
+    //! Constructs an element from the given \p args directly in the queue's
+    //! storage at the end of the given \p priority level. If the queue is
+    //! full, the calling thread is blocked until space becomes available.
+    template <typename... ArgsT>
+    void emplace(unsigned priority, ArgsT&&... args)
+    {
+        WEOS_ASSERT(priority < NumLevelsT);
+        m_numFreeNodes.wait();
+        push(priority, std::forward<ArgsT>(args)...);
+    }
+
+    //! Tries to construct an element in the queue.
+    //! Tries to construct an element from the given \p args at the end of
+    //! the given \p priority level. If no space was available, \p false is
+    //! returned. Otherwise the method returns \p true. The calling thread
+    //! is never blocked.
+    template <typename... ArgsT>
+    bool try_emplace(unsigned priority, ArgsT&&... args)
+    {
+        WEOS_ASSERT(priority < NumLevelsT);
+        if (!m_numFreeNodes.try_wait())
+            return false;
+        push(priority, std::forward<ArgsT>(args)...);
+        return true;
+    }
+
+    //! Tries to construct an element in the queue.
+    //! Tries to construct an element from the given \p args at the end of
+    //! the given \p priority level and returns \p true if successful. If
+    //! there is no space available within the duration \p d, the operation
+    //! is aborted and \p false is returned.
+    template <typename RepT, typename PeriodT, typename... ArgsT>
+    bool try_emplace_for(unsigned priority,
+                         const chrono::duration<RepT, PeriodT>& d,
+                         ArgsT&&... args)
+    {
+        WEOS_ASSERT(priority < NumLevelsT);
+        if (!m_numFreeNodes.try_wait_for(d))
+            return false;
+        push(priority, std::forward<ArgsT>(args)...);
+        return true;
+    }
+#endif // WEOS_USE_CXX11
+
+    //! Sends a range of elements via the queue.
+    //! Appends copies of the elements in the range [\p first, \p last) to
+    //! the given \p priority level in order. Receivers are woken up once per
+    //! batch of elements which fit into the queue. If the queue is full, the
+    //! calling thread is blocked until space becomes available.
+    template <typename InputIteratorT>
+    void send_n(InputIteratorT first, InputIteratorT last, unsigned priority)
+    {
+        WEOS_ASSERT(priority < NumLevelsT);
+        std::size_t count = 0;
+        for (; first != last; ++first, ++count)
+        {
+            if (!m_numFreeNodes.try_wait())
+            {
+                // The receivers may need the elements which have been
+                // inserted so far to make space.
+                publish(count);
+                count = 0;
+                m_numFreeNodes.wait();
+            }
+            insert(priority, *first);
+        }
+        publish(count);
+    }
+
+    //! Tries to send a range of elements via the queue.
+    //! Appends copies of as many elements from the range [\p first,
+    //! \p last) to the given \p priority level as fit into the queue and
+    //! returns their number. The calling thread is never blocked.
+    template <typename InputIteratorT>
+    std::size_t try_send_n(InputIteratorT first, InputIteratorT last,
+                           unsigned priority)
+    {
+        WEOS_ASSERT(priority < NumLevelsT);
+        std::size_t count = 0;
+        for (; first != last && m_numFreeNodes.try_wait(); ++first, ++count)
+            insert(priority, *first);
+        publish(count);
+        return count;
+    }
+
+private:
+    //! Marks the end of a list.
+    static const std::size_t null_index = QueueSizeT;
+
+    //! A node holds one element and links it to the next node in the
+    //! same list (either a priority level or the free list).
+    struct node
+    {
+        typename aligned_storage<sizeof(element_type),
+                                 alignment_of<element_type>::value>::type
+            storage;
+        std::size_t next;
+
+        element_type* element()
+        {
+            return reinterpret_cast<element_type*>(&storage);
+        }
+    };
+
+    //! A FIFO of nodes with the same priority.
+    struct level
+    {
+        std::size_t head;
+        std::size_t tail;
+    };
+
+    //! The storage for the elements.
+    node m_nodes[QueueSizeT];
+    //! One list per priority level.
+    level m_levels[NumLevelsT];
+    //! The index of the first free node.
+    std::size_t m_freeList;
+    //! Bit i is set if priority level i is non-empty.
+    std::uint32_t m_nonEmptyLevels;
+    //! A mutex to protect the lists.
+    mutex m_mutex;
+    //! The number of elements in the queue.
+    semaphore m_numElements;
+    //! The number of free nodes.
+    semaphore m_numFreeNodes;
+
+    //! Gives a node back to the free list unless it has been dismissed.
+    //! This keeps the node if the construction of an element throws.
+    class node_guard
+    {
+    public:
+        node_guard(priority_message_queue& queue, std::size_t index)
+            : m_queue(queue),
+              m_index(index),
+              m_dismissed(false)
+        {
+        }
+
+        ~node_guard()
+        {
+            if (!m_dismissed)
+            {
+                m_queue.releaseNode(m_index);
+                m_queue.m_numFreeNodes.post();
+            }
+        }
+
+        void dismiss()
+        {
+            m_dismissed = true;
+        }
+
+    private:
+        priority_message_queue& m_queue;
+        std::size_t m_index;
+        bool m_dismissed;
+
+        // ---- Hidden methods.
+        node_guard(const node_guard&);
+        node_guard& operator= (const node_guard&);
+    };
+
+    //! Posts \p count tokens to a semaphore when it goes out of scope. This
+    //! gives acquired tokens back if moving an element out throws.
+    class semaphore_poster
+    {
+    public:
+        semaphore_poster(semaphore& s, std::size_t count)
+            : count(count),
+              m_semaphore(s)
+        {
+        }
+
+        ~semaphore_poster()
+        {
+            if (count != 0)
+                m_semaphore.post(count);
+        }
+
+        //! The number of tokens to post.
+        std::size_t count;
+
+    private:
+        semaphore& m_semaphore;
+
+        // ---- Hidden methods.
+        semaphore_poster(const semaphore_poster&);
+        semaphore_poster& operator= (const semaphore_poster&);
+    };
+
+    //! Takes a node from the free list. The caller must have acquired a free
+    //! node.
+    std::size_t acquireNode()
+    {
+        lock_guard<mutex> lock(m_mutex);
+        std::size_t index = m_freeList;
+        WEOS_ASSERT(index != null_index);
+        m_freeList = m_nodes[index].next;
+        return index;
+    }
+
+    //! Puts the node with the given \p index back to the free list.
+    void releaseNode(std::size_t index)
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_nodes[index].next = m_freeList;
+        m_freeList = index;
+    }
+
+    //! Appends the node with the given \p index, which holds an element, to
+    //! the level with the given \p priority.
+    void link(std::size_t index, unsigned priority)
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_nodes[index].next = null_index;
+        level& l = m_levels[priority];
+        if (l.tail == null_index)
+            l.head = index;
+        else
+            m_nodes[l.tail].next = index;
+        l.tail = index;
+        m_nonEmptyLevels |= std::uint32_t(1) << priority;
+    }
+
+#if defined(WEOS_USE_CXX11)
+    //! Constructs an element from the \p args and appends it to the level
+    //! with the given \p priority without waking up a receiver. The caller
+    //! must have acquired a free node.
+    template <typename... ArgsT>
+    void insert(unsigned priority, ArgsT&&... args)
+    {
+        std::size_t index = acquireNode();
+        node_guard guard(*this, index);
+        ::new (static_cast<void*>(m_nodes[index].element()))
+                element_type(std::forward<ArgsT>(args)...);
+        guard.dismiss();
+        link(index, priority);
+    }
+
+    //! Constructs an element from the \p args and appends it to the level
+    //! with the given \p priority. The caller must have acquired a free
+    //! node.
+    template <typename... ArgsT>
+    void push(unsigned priority, ArgsT&&... args)
+    {
+        insert(priority, std::forward<ArgsT>(args)...);
+        m_numElements.post();
+    }
+#else
+    //! Appends a copy of the \p element to the level with the given
+    //! \p priority without waking up a receiver. The caller must have
+    //! acquired a free node.
+    void insert(unsigned priority, const element_type& element)
+    {
+        std::size_t index = acquireNode();
+        node_guard guard(*this, index);
+        ::new (static_cast<void*>(m_nodes[index].element()))
+                element_type(element);
+        guard.dismiss();
+        link(index, priority);
+    }
+
+    //! Appends a copy of the \p element to the level with the given
+    //! \p priority. The caller must have acquired a free node.
+    void push(unsigned priority, const element_type& element)
+    {
+        insert(priority, element);
+        m_numElements.post();
+    }
+#endif // WEOS_USE_CXX11
+
+    //! Makes \p count inserted elements available to the receivers.
+    void publish(std::size_t count)
+    {
+        if (count != 0)
+            m_numElements.post(count);
+    }
+
+    //! Returns the oldest element with the highest priority. The caller must
+    //! hold the mutex and must have acquired an element.
+    element_type& front()
+    {
+        unsigned priority = 31 - detail::count_leading_zeros(m_nonEmptyLevels);
+        return *m_nodes[m_levels[priority].head].element();
+    }
+
+    //! Destroys the oldest element with the highest priority and puts its
+    //! node back to the free list. The caller must hold the mutex and must
+    //! have acquired an element.
+    void removeFront()
+    {
+        unsigned priority = 31 - detail::count_leading_zeros(m_nonEmptyLevels);
+        level& l = m_levels[priority];
+        std::size_t index = l.head;
+        node& n = m_nodes[index];
+
+        n.element()->~element_type();
+
+        l.head = n.next;
+        if (l.head == null_index)
+        {
+            l.tail = null_index;
+            m_nonEmptyLevels &= ~(std::uint32_t(1) << priority);
+        }
+
+        n.next = m_freeList;
+        m_freeList = index;
+    }
+
+    //! Moves the oldest element with the highest priority into the
+    //! \p result. The caller must have acquired an element and has to post
+    //! the free node. If moving the element throws, it stays in the queue
+    //! and the acquired element is given back.
+    void pop(optional<element_type>& result)
+    {
+        lock_guard<mutex> lock(m_mutex);
+        semaphore_poster acquired(m_numElements, 1);
+        result.emplace(weos::move(front()));
+        acquired.count = 0;
+        removeFront();
+    }
+
+    //! Moves the element which the caller has acquired and up to \p max - 1
+    //! further elements to \p out. Returns their number. If moving an
+    //! element to \p out throws, it stays in the queue and the nodes of the
+    //! elements moved so far are posted nevertheless.
+    template <typename OutputIteratorT>
+    std::size_t popRange(OutputIteratorT& out, std::size_t max)
+    {
+        semaphore_poster freed(m_numFreeNodes, 0);
+        do
+        {
+            {
+                lock_guard<mutex> lock(m_mutex);
+                semaphore_poster acquired(m_numElements, 1);
+                *out = weos::move(front());
+                acquired.count = 0;
+                removeFront();
+            }
+            ++out;
+            ++freed.count;
+        } while (freed.count < max && m_numElements.try_wait());
+        return freed.count;
+    }
+
+    priority_message_queue(const priority_message_queue&);
+    priority_message_queue& operator= (const priority_message_queue&);
+};
+
+WEOS_END_NAMESPACE
+
+#endif // WEOS_PRIORITYMESSAGEQUEUE_HPP
@@ -40,6 +40,39 @@
 // Set this macro to make WEOS wrap the native C++11 STL.
 // #define WEOS_WRAP_CXX11
 
+#if defined(WEOS_WRAP_CXX11)
+
+// The size of a cache line in bytes. Data which is modified concurrently by
+// different threads is aligned to this boundary to avoid false sharing.
+// The default is 64.
+// #  define WEOS_CACHE_LINE_SIZE   64
+
+// The number of iterations a thread spins before it blocks in a
+// message_queue or a semaphore. While spinning, the thread checks the
+// awaited condition, issues a CPU pause hint and yields from time to time.
+// This avoids the sleep/wake-up round trip if the condition becomes true
+// within a few microseconds but burns CPU time. The value can be changed
+// per object with set_spin_count(). A value of 0 disables spinning.
+#  define WEOS_DEFAULT_SPIN_COUNT   0
+
+// If this macro is defined, every message_queue records statistics: its
+// current size and high watermark, the number of blocked sends and receives
+// together with the time spent blocked, and a histogram of the latency
+// from sending to receiving an element. The statistics are updated with
+// relaxed atomic operations. If the macro is not defined, nothing is
+// recorded and the queues have no overhead.
+// #define WEOS_ENABLE_MESSAGE_QUEUE_STATISTICS
+
+// The number of iterations a thread spins on a locked adaptive_mutex before
+// it parks. The value can be changed per mutex with set_spin_count().
+#  define WEOS_ADAPTIVE_MUTEX_SPIN_COUNT   100
+
+// The number of mcs_locks which a thread can hold at the same time. Every
+// thread reserves one queue node per nesting level. The default is 8.
+// #  define WEOS_MCS_LOCK_MAX_NESTING   8
+
+#endif // WEOS_WRAP_CXX11
+
 // -----------------------------------------------------------------------------
 //     Keil CMSIS-RTOS
 // -----------------------------------------------------------------------------
@@ -126,6 +159,16 @@
 // Note: If WEOS_ENABLE_EXCEPTIONS is not defined, this macro has no effect.
 // #define WEOS_CUSTOM_THROW_EXCEPTION
 
+// -----------------------------------------------------------------------------
+//     Profiling
+// -----------------------------------------------------------------------------
+
+// If this macro is defined, every profiled_mutex records how often it is
+// acquired, how often and how long threads wait for it and how long it is
+// held. The statistics can be inspected with the mutex_profiler. If the
+// macro is not defined, a profiled_mutex is a plain mutex.
+// #define WEOS_ENABLE_MUTEX_PROFILING
+
 // -----------------------------------------------------------------------------
 //     Miscellaneous
 // -----------------------------------------------------------------------------
@@ -0,0 +1,104 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace benchmark
+{
+
+typedef std::chrono::high_resolution_clock clock;
+
+// Returns the current time in nanoseconds since the clock's epoch.
+inline
+std::int64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                clock::now().time_since_epoch()).count();
+}
+
+// Returns the sample at the given percentile. The samples are sorted
+// in place.
+inline
+std::int64_t percentile(std::vector<std::int64_t>& samples, double p)
+{
+    if (samples.empty())
+        return 0;
+    std::sort(samples.begin(), samples.end());
+    std::size_t index = static_cast<std::size_t>(p / 100.0 * (samples.size() - 1));
+    return samples[index];
+}
+
+// Prints the header of a result table.
+inline
+void print_header(const char* title)
+{
+    std::printf("\n%s\n", title);
+    std::printf("%-36s %14s %10s %10s %10s\n",
+                "variant", "ops/s", "p50 [ns]", "p99 [ns]", "max [ns]");
+}
+
+// Prints one row of a result table. The \p numOps operations have taken
+// \p elapsedNs nanoseconds. The latency \p samples are optional.
+inline
+void print_row(const char* name, std::uint64_t numOps, std::int64_t elapsedNs,
+               std::vector<std::int64_t>& samples)
+{
+    double opsPerSec = elapsedNs > 0 ? 1e9 * numOps / elapsedNs : 0;
+    if (samples.empty())
+    {
+        std::printf("%-36s %14.0f %10s %10s %10s\n",
+                    name, opsPerSec, "-", "-", "-");
+    }
+    else
+    {
+        std::int64_t p50 = percentile(samples, 50);
+        std::int64_t p99 = percentile(samples, 99);
+        std::int64_t max = samples.back();
+        std::printf("%-36s %14.0f %10lld %10lld %10lld\n",
+                    name, opsPerSec, (long long)p50, (long long)p99,
+                    (long long)max);
+    }
+}
+
+inline
+void print_row(const char* name, std::uint64_t numOps, std::int64_t elapsedNs)
+{
+    std::vector<std::int64_t> noSamples;
+    print_row(name, numOps, elapsedNs, noSamples);
+}
+
+} // namespace benchmark
+
+#endif // BENCHMARK_HPP
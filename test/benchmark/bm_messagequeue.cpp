@@ -0,0 +1,222 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <messagequeue.hpp>
+#include <thread.hpp>
+
+#include "benchmark.hpp"
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+
+namespace
+{
+
+// The message queue implementation which stored its elements in a
+// std::deque. It is kept here as the baseline for the comparison.
+template <typename TypeT, std::size_t QueueSizeT>
+class deque_message_queue
+{
+public:
+    typedef TypeT element_type;
+
+    element_type receive()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (m_queue.empty())
+            m_cv_receive.wait(lock);
+
+        element_type element = m_queue.front();
+        m_queue.pop_front();
+        lock.unlock();
+        m_cv_send.notify_one();
+        return element;
+    }
+
+    void send(element_type element)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (m_queue.size() >= QueueSizeT)
+            m_cv_send.wait(lock);
+
+        m_queue.push_back(element);
+        lock.unlock();
+        m_cv_receive.notify_one();
+    }
+
+private:
+    std::mutex m_mutex;
+    std::deque<element_type> m_queue;
+    std::condition_variable m_cv_receive;
+    std::condition_variable m_cv_send;
+};
+
+const std::uint64_t NUM_MESSAGES = 200000;
+
+// Sends a time stamp through the queue. The consumer records the time
+// between sending and receiving.
+template <typename QueueT>
+void producer(QueueT* queue, std::uint64_t numMessages)
+{
+    for (std::uint64_t i = 0; i < numMessages; ++i)
+        queue->send(benchmark::now_ns());
+}
+
+template <typename QueueT>
+void run(const char* name)
+{
+    QueueT queue;
+    std::vector<std::int64_t> latencies;
+    latencies.reserve(NUM_MESSAGES);
+
+    std::int64_t start = benchmark::now_ns();
+    weos::thread t(&producer<QueueT>, &queue, NUM_MESSAGES);
+    for (std::uint64_t i = 0; i < NUM_MESSAGES; ++i)
+    {
+        std::int64_t sent = queue.receive();
+        latencies.push_back(benchmark::now_ns() - sent);
+    }
+    std::int64_t elapsed = benchmark::now_ns() - start;
+    t.join();
+
+    benchmark::print_row(name, NUM_MESSAGES, elapsed, latencies);
+}
+
+// Sends the messages from several producers to a single consumer. Every
+// producer transfers an equal share of the messages.
+template <typename QueueT>
+void runProducers(const char* name, unsigned numProducers)
+{
+    QueueT queue;
+    std::vector<std::int64_t> latencies;
+    latencies.reserve(NUM_MESSAGES);
+
+    std::uint64_t numPerProducer = NUM_MESSAGES / numProducers;
+    std::uint64_t numMessages = numPerProducer * numProducers;
+
+    std::int64_t start = benchmark::now_ns();
+    std::vector<weos::thread> producers;
+    for (unsigned i = 0; i < numProducers; ++i)
+        producers.push_back(weos::thread(&producer<QueueT>, &queue,
+                                         numPerProducer));
+    for (std::uint64_t i = 0; i < numMessages; ++i)
+    {
+        std::int64_t sent = queue.receive();
+        latencies.push_back(benchmark::now_ns() - sent);
+    }
+    std::int64_t elapsed = benchmark::now_ns() - start;
+    for (unsigned i = 0; i < numProducers; ++i)
+        producers[i].join();
+
+    char label[64];
+    std::snprintf(label, sizeof(label), "%s, %u producer(s)",
+                  name, numProducers);
+    benchmark::print_row(label, numMessages, elapsed, latencies);
+}
+
+// Sends time stamps in batches of \p batchSize elements.
+template <typename QueueT>
+void batchProducer(QueueT* queue, std::size_t batchSize)
+{
+    std::vector<std::int64_t> batch(batchSize);
+    for (std::uint64_t i = 0; i + batchSize <= NUM_MESSAGES; i += batchSize)
+    {
+        std::int64_t timeStamp = benchmark::now_ns();
+        for (std::size_t j = 0; j < batchSize; ++j)
+            batch[j] = timeStamp;
+        queue->send_n(batch.begin(), batch.end());
+    }
+}
+
+// Transfers the messages with send_n() and receive_n().
+template <typename QueueT>
+void runBatches(const char* name, std::size_t batchSize)
+{
+    QueueT queue;
+    std::vector<std::int64_t> latencies;
+    latencies.reserve(NUM_MESSAGES);
+
+    std::uint64_t numMessages = NUM_MESSAGES / batchSize * batchSize;
+    std::vector<std::int64_t> batch(batchSize);
+
+    std::int64_t start = benchmark::now_ns();
+    weos::thread t(&batchProducer<QueueT>, &queue, batchSize);
+    for (std::uint64_t received = 0; received < numMessages; )
+    {
+        std::size_t count = queue.receive_n(batch.begin(), batchSize);
+        std::int64_t now = benchmark::now_ns();
+        for (std::size_t j = 0; j < count; ++j)
+            latencies.push_back(now - batch[j]);
+        received += count;
+    }
+    std::int64_t elapsed = benchmark::now_ns() - start;
+    t.join();
+
+    char label[64];
+    std::snprintf(label, sizeof(label), "%s, batch %u",
+                  name, unsigned(batchSize));
+    benchmark::print_row(label, numMessages, elapsed, latencies);
+}
+
+} // anonymous namespace
+
+int main()
+{
+    benchmark::print_header("message_queue: 1 producer, 1 consumer");
+    run<deque_message_queue<std::int64_t, 16> >("std::deque, capacity 16");
+    run<weos::message_queue<std::int64_t, 16> >("ring buffer, capacity 16");
+    run<weos::message_queue<std::int64_t, 16, weos::spsc_tag> >(
+                "spsc, capacity 16");
+    run<deque_message_queue<std::int64_t, 1024> >("std::deque, capacity 1024");
+    run<weos::message_queue<std::int64_t, 1024> >("ring buffer, capacity 1024");
+    run<weos::message_queue<std::int64_t, 1024, weos::spsc_tag> >(
+                "spsc, capacity 1024");
+
+    benchmark::print_header("message_queue: N producers, 1 consumer");
+    for (unsigned n = 1; n <= 8; n *= 2)
+    {
+        runProducers<weos::message_queue<std::int64_t, 256> >(
+                    "ring buffer", n);
+        runProducers<weos::message_queue<std::int64_t, 256, weos::mpmc_tag> >(
+                    "mpmc", n);
+    }
+
+    benchmark::print_header("message_queue: send_n/receive_n, capacity 256");
+    for (std::size_t n = 1; n <= 64; n *= 4)
+    {
+        runBatches<weos::message_queue<std::int64_t, 256> >(
+                    "ring buffer", n);
+        runBatches<weos::message_queue<std::int64_t, 256, weos::spsc_tag> >(
+                    "spsc", n);
+        runBatches<weos::message_queue<std::int64_t, 256, weos::mpmc_tag> >(
+                    "mpmc", n);
+    }
+    return 0;
+}
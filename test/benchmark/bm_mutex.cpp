@@ -0,0 +1,124 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <memorypool.hpp>
+#include <mutex.hpp>
+#include <thread.hpp>
+
+#include "benchmark.hpp"
+
+#include <cstdio>
+#include <memory>
+
+namespace
+{
+
+const std::uint64_t NUM_OPERATIONS = 2000000;
+
+// A short critical section like the one in shared_memory_pool: a chunk is
+// taken from a free list and put back.
+template <typename MutexT>
+struct SharedPool
+{
+    MutexT mutex;
+    weos::memory_pool<std::uint64_t, 16> pool;
+};
+
+template <typename MutexT>
+void worker(SharedPool<MutexT>* shared, std::uint64_t numOperations)
+{
+    for (std::uint64_t i = 0; i < numOperations; ++i)
+    {
+        void* chunk;
+        {
+            weos::lock_guard<MutexT> lock(shared->mutex);
+            chunk = shared->pool.try_allocate();
+        }
+        {
+            weos::lock_guard<MutexT> lock(shared->mutex);
+            shared->pool.free(chunk);
+        }
+    }
+}
+
+template <typename MutexT>
+void configure(MutexT&, int)
+{
+}
+
+void configure(weos::adaptive_mutex& mutex, int spinCount)
+{
+    if (spinCount >= 0)
+        mutex.set_spin_count(spinCount);
+}
+
+template <typename MutexT>
+void run(const char* name, unsigned numThreads, int spinCount = -1)
+{
+    SharedPool<MutexT> shared;
+    configure(shared.mutex, spinCount);
+    std::uint64_t perThread = NUM_OPERATIONS / numThreads;
+
+    std::int64_t start = benchmark::now_ns();
+    std::unique_ptr<weos::thread> threads[8];
+    for (unsigned i = 1; i < numThreads; ++i)
+        threads[i].reset(new weos::thread(&worker<MutexT>, &shared, perThread));
+    worker(&shared, perThread);
+    for (unsigned i = 1; i < numThreads; ++i)
+        threads[i]->join();
+    std::int64_t elapsed = benchmark::now_ns() - start;
+
+    char label[64];
+    std::snprintf(label, sizeof(label), "%s, %u thread(s)", name, numThreads);
+    benchmark::print_row(label, 2 * perThread * numThreads, elapsed);
+}
+
+void doNothing()
+{
+}
+
+} // anonymous namespace
+
+int main()
+{
+    // The C library elides atomic operations in a process which has never
+    // started a thread. Start one such that all runs are measured alike.
+    weos::thread(&doNothing).join();
+
+    const unsigned threadCounts[] = {1, 2, 4};
+
+    benchmark::print_header("mutex: lock + unlock around a free-list update");
+    for (unsigned i = 0; i < 3; ++i)
+    {
+        run<weos::mutex>("mutex", threadCounts[i]);
+        run<weos::adaptive_mutex>("adaptive_mutex, spin 0",
+                                  threadCounts[i], 0);
+        run<weos::adaptive_mutex>("adaptive_mutex", threadCounts[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,144 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <messagequeue.hpp>
+#include <prioritymessagequeue.hpp>
+#include <thread.hpp>
+
+#include "benchmark.hpp"
+
+#include <cstdio>
+
+namespace
+{
+
+const std::uint64_t NUM_MESSAGES = 100000;
+// Every URGENT_INTERVAL-th message is urgent, all others are bulk data.
+const std::uint64_t URGENT_INTERVAL = 10;
+// The time which the consumer spends on every message. This keeps the queue
+// filled such that urgent messages have something to overtake.
+const std::int64_t PROCESSING_TIME_NS = 500;
+
+struct Message
+{
+    std::int64_t timeStamp;
+    unsigned priority;
+};
+
+bool isUrgent(std::uint64_t index)
+{
+    return index % URGENT_INTERVAL == 0;
+}
+
+// Adapts the FIFO message_queue to the interface of the priority queue by
+// ignoring the priority.
+template <std::size_t QueueSizeT>
+class fifo_queue
+{
+public:
+    Message receive()
+    {
+        return m_queue.receive();
+    }
+
+    void send(const Message& message, unsigned /*priority*/)
+    {
+        m_queue.send(message);
+    }
+
+private:
+    weos::message_queue<Message, QueueSizeT> m_queue;
+};
+
+template <typename QueueT>
+void producer(QueueT* queue)
+{
+    for (std::uint64_t i = 0; i < NUM_MESSAGES; ++i)
+    {
+        Message message;
+        message.priority = isUrgent(i) ? 1 : 0;
+        message.timeStamp = benchmark::now_ns();
+        queue->send(message, message.priority);
+    }
+}
+
+void process()
+{
+    std::int64_t end = benchmark::now_ns() + PROCESSING_TIME_NS;
+    while (benchmark::now_ns() < end)
+    {
+    }
+}
+
+template <typename QueueT>
+void run(const char* name)
+{
+    QueueT queue;
+    std::vector<std::int64_t> urgentLatencies;
+    std::vector<std::int64_t> bulkLatencies;
+    urgentLatencies.reserve(NUM_MESSAGES / URGENT_INTERVAL + 1);
+    bulkLatencies.reserve(NUM_MESSAGES);
+
+    std::int64_t start = benchmark::now_ns();
+    weos::thread t(&producer<QueueT>, &queue);
+    for (std::uint64_t i = 0; i < NUM_MESSAGES; ++i)
+    {
+        Message message = queue.receive();
+        std::int64_t latency = benchmark::now_ns() - message.timeStamp;
+        if (message.priority != 0)
+            urgentLatencies.push_back(latency);
+        else
+            bulkLatencies.push_back(latency);
+        process();
+    }
+    std::int64_t elapsed = benchmark::now_ns() - start;
+    t.join();
+
+    char label[64];
+    std::snprintf(label, sizeof(label), "%s, urgent", name);
+    benchmark::print_row(label, NUM_MESSAGES, elapsed, urgentLatencies);
+    std::snprintf(label, sizeof(label), "%s, bulk", name);
+    benchmark::print_row(label, NUM_MESSAGES, elapsed, bulkLatencies);
+}
+
+} // anonymous namespace
+
+int main()
+{
+    benchmark::print_header(
+                "priority_message_queue: 10% urgent, 90% bulk messages");
+    run<fifo_queue<16> >("fifo, capacity 16");
+    run<weos::priority_message_queue<Message, 16, 2> >(
+                "priority, capacity 16");
+    run<fifo_queue<256> >("fifo, capacity 256");
+    run<weos::priority_message_queue<Message, 256, 2> >(
+                "priority, capacity 256");
+    run<weos::priority_message_queue<Message, 256, 32> >(
+                "priority/32, capacity 256");
+    return 0;
+}
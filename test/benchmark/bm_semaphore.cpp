@@ -0,0 +1,163 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <memorypool.hpp>
+#include <semaphore.hpp>
+#include <thread.hpp>
+
+#include "benchmark.hpp"
+
+namespace
+{
+
+const std::uint64_t NUM_OPERATIONS = 1000000;
+const std::uint64_t NUM_ROUND_TRIPS = 20000;
+
+// Posts and takes a token without ever blocking.
+void runUncontended()
+{
+    weos::semaphore sem;
+
+    std::int64_t start = benchmark::now_ns();
+    for (std::uint64_t i = 0; i < NUM_OPERATIONS; ++i)
+    {
+        sem.post();
+        sem.wait();
+    }
+    std::int64_t elapsed = benchmark::now_ns() - start;
+    benchmark::print_row("post + wait, uncontended", NUM_OPERATIONS, elapsed);
+}
+
+// Allocates and frees a chunk from a pool which never runs empty.
+void runMemoryPool()
+{
+    weos::shared_memory_pool<std::uint64_t, 16> pool;
+
+    std::int64_t start = benchmark::now_ns();
+    for (std::uint64_t i = 0; i < NUM_OPERATIONS; ++i)
+        pool.free(pool.allocate());
+    std::int64_t elapsed = benchmark::now_ns() - start;
+    benchmark::print_row("shared_memory_pool allocate + free",
+                         NUM_OPERATIONS, elapsed);
+}
+
+// Posts tokens from two threads and takes them in a third one.
+void poster(weos::semaphore* sem)
+{
+    for (std::uint64_t i = 0; i < NUM_OPERATIONS / 2; ++i)
+        sem->post();
+}
+
+void runProducers()
+{
+    weos::semaphore sem;
+
+    std::int64_t start = benchmark::now_ns();
+    weos::thread t1(&poster, &sem);
+    weos::thread t2(&poster, &sem);
+    for (std::uint64_t i = 0; i < NUM_OPERATIONS; ++i)
+        sem.wait();
+    std::int64_t elapsed = benchmark::now_ns() - start;
+    t1.join();
+    t2.join();
+    benchmark::print_row("2 posters, 1 waiter", NUM_OPERATIONS, elapsed);
+}
+
+// Releases tokens in batches of 32, either with a single post(32) or with
+// 32 calls to post().
+void batchPoster(weos::semaphore* sem, bool bulk)
+{
+    for (std::uint64_t i = 0; i < NUM_OPERATIONS / 32; ++i)
+    {
+        if (bulk)
+            sem->post(32);
+        else
+            for (int j = 0; j < 32; ++j)
+                sem->post();
+    }
+}
+
+void runBatches(bool bulk)
+{
+    weos::semaphore sem;
+
+    std::int64_t start = benchmark::now_ns();
+    weos::thread t(&batchPoster, &sem, bulk);
+    for (std::uint64_t i = 0; i < NUM_OPERATIONS / 32; ++i)
+        sem.wait(32);
+    std::int64_t elapsed = benchmark::now_ns() - start;
+    t.join();
+    benchmark::print_row(bulk ? "batch of 32, post(32) + wait(32)"
+                              : "batch of 32, 32x post() + wait(32)",
+                         NUM_OPERATIONS, elapsed);
+}
+
+// Answers every token on \p ping with a token on \p pong.
+void ponger(weos::semaphore* ping, weos::semaphore* pong)
+{
+    for (std::uint64_t i = 0; i < NUM_ROUND_TRIPS; ++i)
+    {
+        ping->wait();
+        pong->post();
+    }
+}
+
+void runPingPong()
+{
+    weos::semaphore ping;
+    weos::semaphore pong;
+    std::vector<std::int64_t> roundTrips;
+    roundTrips.reserve(NUM_ROUND_TRIPS);
+
+    std::int64_t start = benchmark::now_ns();
+    weos::thread t(&ponger, &ping, &pong);
+    for (std::uint64_t i = 0; i < NUM_ROUND_TRIPS; ++i)
+    {
+        std::int64_t begin = benchmark::now_ns();
+        ping.post();
+        pong.wait();
+        roundTrips.push_back(benchmark::now_ns() - begin);
+    }
+    std::int64_t elapsed = benchmark::now_ns() - start;
+    t.join();
+    benchmark::print_row("ping-pong", NUM_ROUND_TRIPS, elapsed, roundTrips);
+}
+
+} // anonymous namespace
+
+int main()
+{
+    benchmark::print_header("semaphore");
+    runUncontended();
+    runMemoryPool();
+    runProducers();
+    runBatches(false);
+    runBatches(true);
+    runPingPong();
+    return 0;
+}
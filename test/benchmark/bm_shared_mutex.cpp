@@ -0,0 +1,152 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <mutex.hpp>
+#include <thread.hpp>
+
+#include "benchmark.hpp"
+
+#include <cstdio>
+#include <memory>
+
+namespace
+{
+
+const std::uint64_t NUM_OPERATIONS = 2000000;
+
+// Read-mostly state: a small routing table which readers look up and which
+// is rewritten from time to time.
+template <typename MutexT>
+struct SharedTable
+{
+    SharedTable()
+    {
+        for (unsigned i = 0; i < 16; ++i)
+            entries[i] = i;
+    }
+
+    MutexT mutex;
+    unsigned entries[16];
+};
+
+// The lock with which a reader enters. A plain mutex can only be locked
+// exclusively.
+template <typename MutexT>
+struct ReadLock
+{
+    typedef weos::lock_guard<MutexT> type;
+};
+
+template <>
+struct ReadLock<weos::shared_mutex>
+{
+    typedef weos::shared_lock<weos::shared_mutex> type;
+};
+
+struct Job
+{
+    std::uint64_t numOperations;
+    // Every writeInterval-th operation is a write. Zero means no writes.
+    std::uint64_t writeInterval;
+    volatile unsigned result;
+};
+
+template <typename MutexT>
+void worker(SharedTable<MutexT>* table, Job* job)
+{
+    unsigned sum = 0;
+    for (std::uint64_t i = 0; i < job->numOperations; ++i)
+    {
+        if (job->writeInterval != 0 && i % job->writeInterval == 0)
+        {
+            weos::lock_guard<MutexT> lock(table->mutex);
+            table->entries[i % 16] += 1;
+        }
+        else
+        {
+            typename ReadLock<MutexT>::type lock(table->mutex);
+            sum += table->entries[i % 16];
+        }
+    }
+    job->result = sum;
+}
+
+template <typename MutexT>
+void run(const char* name, unsigned numThreads, std::uint64_t writeInterval)
+{
+    SharedTable<MutexT> table;
+    Job jobs[8];
+    for (unsigned i = 0; i < numThreads; ++i)
+    {
+        jobs[i].numOperations = NUM_OPERATIONS / numThreads;
+        jobs[i].writeInterval = writeInterval;
+    }
+
+    std::int64_t start = benchmark::now_ns();
+    std::unique_ptr<weos::thread> threads[8];
+    for (unsigned i = 1; i < numThreads; ++i)
+        threads[i].reset(new weos::thread(&worker<MutexT>, &table, &jobs[i]));
+    worker(&table, &jobs[0]);
+    for (unsigned i = 1; i < numThreads; ++i)
+        threads[i]->join();
+    std::int64_t elapsed = benchmark::now_ns() - start;
+
+    char label[64];
+    std::snprintf(label, sizeof(label), "%s, %u reader(s)", name, numThreads);
+    benchmark::print_row(label, jobs[0].numOperations * numThreads, elapsed);
+}
+
+void doNothing()
+{
+}
+
+} // anonymous namespace
+
+int main()
+{
+    // The C library elides atomic operations in a process which has never
+    // started a thread. Start one such that all runs are measured alike.
+    weos::thread(&doNothing).join();
+
+    const unsigned threadCounts[] = {1, 2, 4, 8};
+
+    benchmark::print_header("reader-writer lock: table lookups only");
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        run<weos::mutex>("mutex", threadCounts[i], 0);
+        run<weos::shared_mutex>("shared_mutex", threadCounts[i], 0);
+    }
+
+    benchmark::print_header("reader-writer lock: 1% table updates");
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        run<weos::mutex>("mutex", threadCounts[i], 100);
+        run<weos::shared_mutex>("shared_mutex", threadCounts[i], 100);
+    }
+    return 0;
+}
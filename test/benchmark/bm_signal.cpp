@@ -0,0 +1,95 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <thread.hpp>
+
+#include "benchmark.hpp"
+
+#include <cstdio>
+#include <memory>
+
+namespace
+{
+
+const std::uint64_t NUM_OPERATIONS = 4000000;
+
+// Polls the signals of the calling thread. Every poll has to look up the
+// data of the calling thread.
+void pollAny(std::uint64_t numOperations)
+{
+    for (std::uint64_t i = 0; i < numOperations; ++i)
+        weos::this_thread::try_wait_for_any_signal();
+}
+
+void pollAll(std::uint64_t numOperations)
+{
+    for (std::uint64_t i = 0; i < numOperations; ++i)
+        weos::this_thread::try_wait_for_all_signals(1);
+}
+
+void run(const char* name, void (*poll)(std::uint64_t), unsigned numThreads)
+{
+    std::uint64_t perThread = NUM_OPERATIONS / numThreads;
+
+    // The signal functions work only in threads created by weos::thread,
+    // so the main thread does not take part.
+    std::int64_t start = benchmark::now_ns();
+    std::unique_ptr<weos::thread> threads[8];
+    for (unsigned i = 0; i < numThreads; ++i)
+        threads[i].reset(new weos::thread(poll, perThread));
+    for (unsigned i = 0; i < numThreads; ++i)
+        threads[i]->join();
+    std::int64_t elapsed = benchmark::now_ns() - start;
+
+    char label[64];
+    std::snprintf(label, sizeof(label), "%s, %u thread(s)", name, numThreads);
+    benchmark::print_row(label, perThread * numThreads, elapsed);
+}
+
+void doNothing()
+{
+}
+
+} // anonymous namespace
+
+int main()
+{
+    // The C library elides atomic operations in a process which has never
+    // started a thread. Start one such that all runs are measured alike.
+    weos::thread(&doNothing).join();
+
+    const unsigned threadCounts[] = {1, 2, 4, 8};
+
+    benchmark::print_header("thread signals: polling the own signals");
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        run("try_wait_for_any_signal", &pollAny, threadCounts[i]);
+        run("try_wait_for_all_signals", &pollAll, threadCounts[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,113 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <thread.hpp>
+
+#include "benchmark.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+
+const int NUM_ROUND_TRIPS = 100000;
+
+// The two players of the ping-pong. Each one knows the thread of its peer.
+struct Table
+{
+    Table()
+        : ready(0)
+    {
+    }
+
+    weos::thread ping;
+    weos::thread pong;
+    std::atomic<int> ready;
+    std::vector<std::int64_t> samples;
+};
+
+void waitForTable(Table* table)
+{
+    while (table->ready.load() == 0)
+        weos::this_thread::yield();
+}
+
+// Sends a signal to the peer and waits for the answer. Every round trip is
+// timed.
+void ping(Table* table)
+{
+    waitForTable(table);
+    table->samples.reserve(NUM_ROUND_TRIPS);
+    for (int i = 0; i < NUM_ROUND_TRIPS; ++i)
+    {
+        std::int64_t start = benchmark::now_ns();
+        table->pong.set_signals(1);
+        weos::this_thread::wait_for_any_signal();
+        table->samples.push_back(benchmark::now_ns() - start);
+    }
+}
+
+void pong(Table* table)
+{
+    waitForTable(table);
+    for (int i = 0; i < NUM_ROUND_TRIPS; ++i)
+    {
+        weos::this_thread::wait_for_all_signals(1);
+        table->ping.set_signals(1);
+    }
+}
+
+void doNothing()
+{
+}
+
+} // anonymous namespace
+
+int main()
+{
+    // The C library elides atomic operations in a process which has never
+    // started a thread. Start one such that all runs are measured alike.
+    weos::thread(&doNothing).join();
+
+    benchmark::print_header("thread signals: ping-pong round trip between two threads");
+
+    Table table;
+    std::int64_t start = benchmark::now_ns();
+    table.ping = weos::thread(&ping, &table);
+    table.pong = weos::thread(&pong, &table);
+    table.ready = 1;
+    table.ping.join();
+    table.pong.join();
+    std::int64_t elapsed = benchmark::now_ns() - start;
+
+    benchmark::print_row("set_signals + wait_for_*_signal(s)",
+                         NUM_ROUND_TRIPS, elapsed, table.samples);
+    return 0;
+}
@@ -0,0 +1,145 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <messagequeue.hpp>
+#include <semaphore.hpp>
+#include <thread.hpp>
+
+#include "benchmark.hpp"
+
+#include <cstdio>
+
+namespace
+{
+
+const std::uint64_t NUM_MESSAGES = 20000;
+// The gap between two messages. It is short enough that a spinning
+// receiver sees the next message before its spin count is exhausted.
+const std::int64_t GAP_NS = 2000;
+
+void busyWait(std::int64_t ns)
+{
+    std::int64_t end = benchmark::now_ns() + ns;
+    while (benchmark::now_ns() < end)
+    {
+    }
+}
+
+// Sends time stamps with a small gap in between such that the receiver
+// has to wait for every message.
+template <typename QueueT>
+void producer(QueueT* queue)
+{
+    for (std::uint64_t i = 0; i < NUM_MESSAGES; ++i)
+    {
+        busyWait(GAP_NS);
+        queue->send(benchmark::now_ns());
+    }
+}
+
+template <typename QueueT>
+void runQueue(const char* name, unsigned spinCount)
+{
+    QueueT queue;
+    queue.set_spin_count(spinCount);
+    std::vector<std::int64_t> latencies;
+    latencies.reserve(NUM_MESSAGES);
+
+    std::int64_t start = benchmark::now_ns();
+    weos::thread t(&producer<QueueT>, &queue);
+    for (std::uint64_t i = 0; i < NUM_MESSAGES; ++i)
+    {
+        std::int64_t sent = queue.receive();
+        latencies.push_back(benchmark::now_ns() - sent);
+    }
+    std::int64_t elapsed = benchmark::now_ns() - start;
+    t.join();
+
+    char label[64];
+    std::snprintf(label, sizeof(label), "%s, spin %u", name, spinCount);
+    benchmark::print_row(label, NUM_MESSAGES, elapsed, latencies);
+}
+
+// Answers every token on \p ping with a token on \p pong.
+void ponger(weos::semaphore* ping, weos::semaphore* pong)
+{
+    for (std::uint64_t i = 0; i < NUM_MESSAGES; ++i)
+    {
+        ping->wait();
+        pong->post();
+    }
+}
+
+void runSemaphore(unsigned spinCount)
+{
+    weos::semaphore ping;
+    weos::semaphore pong;
+    ping.set_spin_count(spinCount);
+    pong.set_spin_count(spinCount);
+    std::vector<std::int64_t> roundTrips;
+    roundTrips.reserve(NUM_MESSAGES);
+
+    std::int64_t start = benchmark::now_ns();
+    weos::thread t(&ponger, &ping, &pong);
+    for (std::uint64_t i = 0; i < NUM_MESSAGES; ++i)
+    {
+        std::int64_t begin = benchmark::now_ns();
+        ping.post();
+        pong.wait();
+        roundTrips.push_back(benchmark::now_ns() - begin);
+    }
+    std::int64_t elapsed = benchmark::now_ns() - start;
+    t.join();
+
+    char label[64];
+    std::snprintf(label, sizeof(label), "ping-pong, spin %u", spinCount);
+    benchmark::print_row(label, NUM_MESSAGES, elapsed, roundTrips);
+}
+
+} // anonymous namespace
+
+int main()
+{
+    const unsigned spinCounts[] = {0, 1000, 10000};
+
+    benchmark::print_header("message_queue: handoff latency");
+    for (unsigned i = 0; i < 3; ++i)
+    {
+        runQueue<weos::message_queue<std::int64_t, 16> >(
+                    "ring buffer", spinCounts[i]);
+        runQueue<weos::message_queue<std::int64_t, 16, weos::spsc_tag> >(
+                    "spsc", spinCounts[i]);
+        runQueue<weos::message_queue<std::int64_t, 16, weos::mpmc_tag> >(
+                    "mpmc", spinCounts[i]);
+    }
+
+    benchmark::print_header("semaphore: round trip latency");
+    for (unsigned i = 0; i < 3; ++i)
+        runSemaphore(spinCounts[i]);
+    return 0;
+}
@@ -0,0 +1,254 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <atomic.hpp>
+#include <functional.hpp>
+#include <semaphore.hpp>
+#include <taskscheduler.hpp>
+#include <thread.hpp>
+
+#include "benchmark.hpp"
+
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#if defined(__unix__)
+    #include <pthread.h>
+#endif
+
+namespace
+{
+
+const int NUM_MACHINES = 100;
+const int NUM_HOPS = 200000;
+const int NUM_ROUND_TRIPS = 20000;
+
+typedef weos::task_scheduler<NUM_MACHINES> scheduler_type;
+
+// ---- A ring of state machines which pass a token around.
+
+struct Ring
+{
+    Ring()
+        : scheduler(0),
+          numHops(0),
+          stop(false)
+    {
+    }
+
+    scheduler_type* scheduler;
+    std::unique_ptr<weos::thread> threads[NUM_MACHINES];
+    int numHops;
+    weos::atomic_bool stop;
+    weos::semaphore started;
+    weos::semaphore done;
+};
+
+void schedulerHop(Ring* ring, int self)
+{
+    if (++ring->numHops == NUM_HOPS)
+        ring->done.post();
+    else
+        ring->scheduler->notify((self + 1) % NUM_MACHINES);
+}
+
+void threadHop(Ring* ring, int self)
+{
+    ring->started.wait();
+    while (true)
+    {
+        weos::this_thread::wait_for_any_signal();
+        if (ring->stop.load())
+            return;
+        if (++ring->numHops == NUM_HOPS)
+            ring->done.post();
+        else
+            ring->threads[(self + 1) % NUM_MACHINES]->set_signals(1);
+    }
+}
+
+void runSchedulerRing()
+{
+    Ring ring;
+    scheduler_type scheduler;
+    ring.scheduler = &scheduler;
+    for (int i = 0; i < NUM_MACHINES; ++i)
+        scheduler.create_task(i, weos::bind(&schedulerHop, &ring, i));
+
+    std::int64_t start = benchmark::now_ns();
+    scheduler.notify(0);
+    ring.done.wait();
+    std::int64_t elapsed = benchmark::now_ns() - start;
+
+    benchmark::print_row("task_scheduler ring", NUM_HOPS, elapsed);
+}
+
+void runThreadRing()
+{
+    Ring ring;
+    for (int i = 0; i < NUM_MACHINES; ++i)
+        ring.threads[i].reset(new weos::thread(&threadHop, &ring, i));
+    for (int i = 0; i < NUM_MACHINES; ++i)
+        ring.started.post();
+
+    std::int64_t start = benchmark::now_ns();
+    ring.threads[0]->set_signals(1);
+    ring.done.wait();
+    std::int64_t elapsed = benchmark::now_ns() - start;
+
+    ring.stop.store(true);
+    for (int i = 0; i < NUM_MACHINES; ++i)
+    {
+        ring.threads[i]->set_signals(1);
+        ring.threads[i]->join();
+    }
+
+    benchmark::print_row("thread per state machine ring", NUM_HOPS, elapsed);
+}
+
+// ---- The latency from an external event to the state machine.
+
+struct Echo
+{
+    Echo()
+        : stop(false)
+    {
+    }
+
+    weos::atomic_bool stop;
+    weos::semaphore reply;
+};
+
+void schedulerEcho(Echo* echo)
+{
+    echo->reply.post();
+}
+
+void threadEcho(Echo* echo)
+{
+    while (true)
+    {
+        weos::this_thread::wait_for_any_signal();
+        if (echo->stop.load())
+            return;
+        echo->reply.post();
+    }
+}
+
+void printLatency(const char* name, std::vector<std::int64_t>& samples,
+                  std::int64_t elapsed)
+{
+    benchmark::print_row(name, samples.size(), elapsed, samples);
+}
+
+void runSchedulerEcho()
+{
+    Echo echo;
+    scheduler_type scheduler;
+    scheduler.create_task(0, weos::bind(&schedulerEcho, &echo));
+
+    std::vector<std::int64_t> samples;
+    samples.reserve(NUM_ROUND_TRIPS);
+    std::int64_t start = benchmark::now_ns();
+    for (int i = 0; i < NUM_ROUND_TRIPS; ++i)
+    {
+        std::int64_t t0 = benchmark::now_ns();
+        scheduler.notify(0);
+        echo.reply.wait();
+        samples.push_back(benchmark::now_ns() - t0);
+    }
+    printLatency("task_scheduler echo", samples, benchmark::now_ns() - start);
+}
+
+void runThreadEcho()
+{
+    Echo echo;
+    weos::thread t(&threadEcho, &echo);
+
+    std::vector<std::int64_t> samples;
+    samples.reserve(NUM_ROUND_TRIPS);
+    std::int64_t start = benchmark::now_ns();
+    for (int i = 0; i < NUM_ROUND_TRIPS; ++i)
+    {
+        std::int64_t t0 = benchmark::now_ns();
+        t.set_signals(1);
+        echo.reply.wait();
+        samples.push_back(benchmark::now_ns() - t0);
+    }
+    printLatency("thread per state machine echo", samples,
+                 benchmark::now_ns() - start);
+
+    echo.stop.store(true);
+    t.set_signals(1);
+    t.join();
+}
+
+// Returns the default stack size of a thread.
+std::size_t defaultStackSize()
+{
+#if defined(__unix__)
+    pthread_attr_t attr;
+    std::size_t size = 0;
+    pthread_attr_init(&attr);
+    pthread_attr_getstacksize(&attr, &size);
+    pthread_attr_destroy(&attr);
+    return size;
+#else
+    return 0;
+#endif
+}
+
+void doNothing()
+{
+}
+
+} // anonymous namespace
+
+int main()
+{
+    // The C library elides atomic operations in a process which has never
+    // started a thread. Start one such that all runs are measured alike.
+    weos::thread(&doNothing).join();
+
+    std::printf("\nMemory per state machine\n");
+    std::printf("%-36s %14u bytes\n", "task_scheduler task",
+                unsigned(sizeof(scheduler_type) / NUM_MACHINES));
+    std::printf("%-36s %14u bytes + %u bytes stack\n", "thread per state machine",
+                unsigned(sizeof(weos::thread) + sizeof(weos::detail::ThreadData)),
+                unsigned(defaultStackSize()));
+
+    benchmark::print_header("Passing a token around 100 state machines");
+    runSchedulerRing();
+    runThreadRing();
+
+    benchmark::print_header("Round trip from another thread to a state machine");
+    runSchedulerEcho();
+    runThreadEcho();
+    return 0;
+}
@@ -0,0 +1,122 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <atomic.hpp>
+#include <functional.hpp>
+#include <semaphore.hpp>
+#include <thread.hpp>
+#include <threadpool.hpp>
+
+#include "benchmark.hpp"
+
+#include <cstdio>
+
+namespace
+{
+
+const int NUM_TASKS = 200000;
+const int NUM_THREAD_PER_TASK = 20000;
+
+typedef weos::thread_pool<4, 256> pool_type;
+
+struct Job
+{
+    Job()
+        : counter(0),
+          numTasks(0)
+    {
+    }
+
+    weos::atomic_int counter;
+    int numTasks;
+    weos::semaphore done;
+};
+
+// A tiny task. The last one signals the end of the job.
+void task(Job* job)
+{
+    if (job->counter.fetch_add(1) + 1 == job->numTasks)
+        job->done.post();
+}
+
+// Submits all tasks of the job from within the pool.
+void fanOut(pool_type* pool, Job* job)
+{
+    for (int i = 0; i < job->numTasks; ++i)
+        pool->submit(weos::bind(&task, job));
+}
+
+void runThreadPerTask()
+{
+    Job job;
+    job.numTasks = NUM_THREAD_PER_TASK;
+
+    std::int64_t start = benchmark::now_ns();
+    for (int i = 0; i < job.numTasks; ++i)
+        weos::thread(&task, &job).join();
+    job.done.wait();
+    std::int64_t elapsed = benchmark::now_ns() - start;
+
+    benchmark::print_row("thread per task", job.numTasks, elapsed);
+}
+
+void runPool(const char* name, bool submitFromWorker)
+{
+    pool_type pool;
+    Job job;
+    job.numTasks = NUM_TASKS;
+
+    std::int64_t start = benchmark::now_ns();
+    if (submitFromWorker)
+        pool.submit(weos::bind(&fanOut, &pool, &job));
+    else
+        fanOut(&pool, &job);
+    job.done.wait();
+    std::int64_t elapsed = benchmark::now_ns() - start;
+
+    benchmark::print_row(name, job.numTasks, elapsed);
+}
+
+void doNothing()
+{
+}
+
+} // anonymous namespace
+
+int main()
+{
+    // The C library elides atomic operations in a process which has never
+    // started a thread. Start one such that all runs are measured alike.
+    weos::thread(&doNothing).join();
+
+    benchmark::print_header("thread_pool: task throughput (4 workers, 256 slots)");
+    runThreadPerTask();
+    runPool("thread_pool, submit from outside", false);
+    runPool("thread_pool, submit from a worker", true);
+    return 0;
+}
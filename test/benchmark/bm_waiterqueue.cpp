@@ -0,0 +1,140 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <config.hpp>
+#include <common/waiter_queue.hpp>
+
+#include "benchmark.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using weos::detail::waiter_queue;
+using weos::detail::waiter_queue_hook;
+
+namespace
+{
+
+const std::uint64_t NUM_OPERATIONS = 4000000;
+
+// The singly-linked waiter list, which the CMSIS condition variable used
+// before. Appending and removing a waiter walk the list.
+struct ListWaiter
+{
+    ListWaiter()
+        : next(0)
+    {
+    }
+
+    ListWaiter* next;
+};
+
+class WaiterList
+{
+public:
+    WaiterList()
+        : m_head(0)
+    {
+    }
+
+    void push_back(ListWaiter& w)
+    {
+        w.next = 0;
+        if (!m_head)
+        {
+            m_head = &w;
+            return;
+        }
+        ListWaiter* iter = m_head;
+        while (iter->next)
+            iter = iter->next;
+        iter->next = &w;
+    }
+
+    void remove(ListWaiter& w)
+    {
+        if (m_head == &w)
+        {
+            m_head = w.next;
+            return;
+        }
+        ListWaiter* iter = m_head;
+        while (iter->next != &w)
+            iter = iter->next;
+        iter->next = w.next;
+    }
+
+private:
+    ListWaiter* m_head;
+};
+
+// Enqueues \p numWaiters waiters and removes them in a random order as if
+// all of them timed out. Every enqueue and every removal is one operation.
+template <typename QueueT, typename WaiterT>
+void run(const char* name, unsigned numWaiters)
+{
+    std::vector<WaiterT> waiters(numWaiters);
+    std::vector<unsigned> order(numWaiters);
+    for (unsigned idx = 0; idx < numWaiters; ++idx)
+        order[idx] = idx;
+    std::mt19937 random(numWaiters);
+    std::shuffle(order.begin(), order.end(), random);
+
+    std::uint64_t numRounds = NUM_OPERATIONS / (2 * numWaiters);
+    QueueT queue;
+
+    std::int64_t start = benchmark::now_ns();
+    for (std::uint64_t round = 0; round < numRounds; ++round)
+    {
+        for (unsigned idx = 0; idx < numWaiters; ++idx)
+            queue.push_back(waiters[idx]);
+        for (unsigned idx = 0; idx < numWaiters; ++idx)
+            queue.remove(waiters[order[idx]]);
+    }
+    std::int64_t elapsed = benchmark::now_ns() - start;
+
+    char label[64];
+    std::snprintf(label, sizeof(label), "%s, %u waiters", name, numWaiters);
+    benchmark::print_row(label, numRounds * 2 * numWaiters, elapsed);
+}
+
+} // anonymous namespace
+
+int main()
+{
+    benchmark::print_header("Condition variable waiter queue (enqueue + timeout removal)");
+    const unsigned numWaiters[] = {1, 8, 64, 512};
+    for (unsigned idx = 0; idx < 4; ++idx)
+    {
+        run<WaiterList, ListWaiter>("singly-linked list", numWaiters[idx]);
+        run<waiter_queue, waiter_queue_hook>("waiter_queue", numWaiters[idx]);
+    }
+    return 0;
+}
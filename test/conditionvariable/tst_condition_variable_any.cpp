@@ -0,0 +1,325 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <condition_variable.hpp>
+#include <mutex.hpp>
+#include <semaphore.hpp>
+#include <thread.hpp>
+
+#include "gtest/gtest.h"
+
+namespace
+{
+
+// A lock which only provides lock() and unlock() and counts the calls.
+class CountingLock
+{
+public:
+    CountingLock()
+        : numLocks(0),
+          numUnlocks(0)
+    {
+    }
+
+    void lock()
+    {
+        m_mutex.lock();
+        ++numLocks;
+    }
+
+    void unlock()
+    {
+        ++numUnlocks;
+        m_mutex.unlock();
+    }
+
+    int numLocks;
+    int numUnlocks;
+
+private:
+    weos::mutex m_mutex;
+};
+
+template <typename LockT>
+struct SharedData
+{
+    SharedData()
+        : flag(false),
+          numWaiting(0),
+          numWoken(0)
+    {
+    }
+
+    bool isFlagSet() const
+    {
+        return flag;
+    }
+
+    LockT lock;
+    weos::condition_variable_any cv;
+    bool flag;
+    int numWaiting;
+    int numWoken;
+};
+
+// A predicate which checks the flag of the shared data.
+template <typename LockT>
+struct FlagSet
+{
+    explicit FlagSet(SharedData<LockT>* data)
+        : m_data(data)
+    {
+    }
+
+    bool operator() () const
+    {
+        return m_data->flag;
+    }
+
+private:
+    SharedData<LockT>* m_data;
+};
+
+template <typename LockT>
+void waitForFlag(SharedData<LockT>* data)
+{
+    weos::unique_lock<LockT> locker(data->lock);
+    ++data->numWaiting;
+    data->cv.wait(locker, FlagSet<LockT>(data));
+    ++data->numWoken;
+}
+
+template <typename LockT>
+void waitForNumWaiting(SharedData<LockT>& data, int numWaiting)
+{
+    while (true)
+    {
+        {
+            weos::unique_lock<LockT> locker(data.lock);
+            if (data.numWaiting == numWaiting)
+                return;
+        }
+        weos::this_thread::sleep_for(weos::chrono::milliseconds(1));
+    }
+}
+
+template <typename LockT>
+void setFlag(SharedData<LockT>& data, bool all)
+{
+    weos::unique_lock<LockT> locker(data.lock);
+    data.flag = true;
+    if (all)
+        data.cv.notify_all();
+    else
+        data.cv.notify_one();
+}
+
+// Waits with a short timeout over and over again until the flag is set.
+void waitForFlagTimed(SharedData<weos::mutex>* data)
+{
+    weos::unique_lock<weos::mutex> locker(data->lock);
+    ++data->numWaiting;
+    while (!data->flag)
+        data->cv.wait_for(locker, weos::chrono::microseconds(500));
+    ++data->numWoken;
+}
+
+// Two waiters which use different locks on the same condition variable.
+struct DifferentLocks
+{
+    weos::mutex first;
+    weos::mutex second;
+    weos::condition_variable_any cv;
+    weos::semaphore started;
+    weos::semaphore woken;
+};
+
+void waitWithLock(DifferentLocks* data, weos::mutex* lock)
+{
+    weos::unique_lock<weos::mutex> locker(*lock);
+    data->started.post();
+    data->cv.wait(locker);
+    data->woken.post();
+}
+
+// Waits until the thread which waits with the \p lock has been enqueued.
+// The waiter releases the lock only in wait().
+void waitUntilEnqueued(DifferentLocks& data, weos::mutex& lock)
+{
+    data.started.wait();
+    weos::lock_guard<weos::mutex> locker(lock);
+}
+
+} // anonymous namespace
+
+TEST(condition_variable_any, wait_for_timeout)
+{
+    weos::mutex m;
+    weos::condition_variable_any cv;
+    weos::unique_lock<weos::mutex> locker(m);
+
+    weos::chrono::steady_clock::time_point start
+            = weos::chrono::steady_clock::now();
+    ASSERT_TRUE(cv.wait_for(locker, weos::chrono::milliseconds(10))
+                == weos::cv_status::timeout);
+    ASSERT_TRUE(weos::chrono::steady_clock::now() - start
+                >= weos::chrono::milliseconds(10));
+    ASSERT_TRUE(locker.owns_lock());
+}
+
+TEST(condition_variable_any, wait_until_timeout)
+{
+    weos::mutex m;
+    weos::condition_variable_any cv;
+    weos::unique_lock<weos::mutex> locker(m);
+
+    weos::chrono::steady_clock::time_point deadline
+            = weos::chrono::steady_clock::now()
+              + weos::chrono::milliseconds(10);
+    ASSERT_TRUE(cv.wait_until(locker, deadline) == weos::cv_status::timeout);
+    ASSERT_TRUE(weos::chrono::steady_clock::now() >= deadline);
+    ASSERT_TRUE(locker.owns_lock());
+}
+
+TEST(condition_variable_any, wait_with_predicate_timeout)
+{
+    SharedData<weos::mutex> data;
+    weos::unique_lock<weos::mutex> locker(data.lock);
+
+    ASSERT_FALSE(data.cv.wait_for(locker, weos::chrono::milliseconds(5),
+                                  FlagSet<weos::mutex>(&data)));
+    ASSERT_FALSE(data.cv.wait_until(
+                     locker,
+                     weos::chrono::steady_clock::now()
+                     + weos::chrono::milliseconds(5),
+                     FlagSet<weos::mutex>(&data)));
+
+    // A satisfied predicate returns immediately.
+    data.flag = true;
+    ASSERT_TRUE(data.cv.wait_for(locker, weos::chrono::seconds(100),
+                                 FlagSet<weos::mutex>(&data)));
+    data.cv.wait(locker, FlagSet<weos::mutex>(&data));
+    ASSERT_TRUE(locker.owns_lock());
+}
+
+TEST(condition_variable_any, notify_one_with_basic_lockable)
+{
+    SharedData<CountingLock> data;
+    weos::thread t(&waitForFlag<CountingLock>, &data);
+    waitForNumWaiting(data, 1);
+
+    setFlag(data, false);
+    t.join();
+    ASSERT_EQ(1, data.numWoken);
+    ASSERT_EQ(data.lock.numLocks, data.lock.numUnlocks);
+}
+
+TEST(condition_variable_any, notify_one_wakes_one_thread)
+{
+    SharedData<weos::mutex> data;
+    weos::thread t1(&waitForFlag<weos::mutex>, &data);
+    weos::thread t2(&waitForFlag<weos::mutex>, &data);
+    waitForNumWaiting(data, 2);
+
+    {
+        weos::unique_lock<weos::mutex> locker(data.lock);
+        data.flag = true;
+        data.cv.notify_one();
+    }
+    weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+    {
+        weos::unique_lock<weos::mutex> locker(data.lock);
+        ASSERT_EQ(1, data.numWoken);
+        data.cv.notify_one();
+    }
+    t1.join();
+    t2.join();
+    ASSERT_EQ(2, data.numWoken);
+}
+
+TEST(condition_variable_any, notify_all)
+{
+    const int numThreads = 5;
+    SharedData<weos::adaptive_mutex> data;
+    weos::thread threads[numThreads];
+    for (int idx = 0; idx < numThreads; ++idx)
+        threads[idx] = weos::thread(&waitForFlag<weos::adaptive_mutex>, &data);
+    waitForNumWaiting(data, numThreads);
+
+    setFlag(data, true);
+    for (int idx = 0; idx < numThreads; ++idx)
+        threads[idx].join();
+    ASSERT_EQ(numThreads, data.numWoken);
+}
+
+TEST(condition_variable_any, notify_all_races_with_timeouts)
+{
+    const int numThreads = 4;
+    for (int round = 0; round < 20; ++round)
+    {
+        SharedData<weos::mutex> data;
+        weos::thread threads[numThreads];
+        for (int idx = 0; idx < numThreads; ++idx)
+            threads[idx] = weos::thread(&waitForFlagTimed, &data);
+        waitForNumWaiting(data, numThreads);
+
+        // Notify everybody repeatedly while the waiters time out. If a
+        // waiter dropped its successor, the latter would still time out,
+        // so check that every notified thread terminates.
+        for (int count = 0; count < 20; ++count)
+        {
+            data.cv.notify_all();
+            weos::this_thread::sleep_for(weos::chrono::microseconds(200));
+        }
+        setFlag(data, true);
+        for (int idx = 0; idx < numThreads; ++idx)
+            threads[idx].join();
+        ASSERT_EQ(numThreads, data.numWoken);
+    }
+}
+
+TEST(condition_variable_any, notify_all_with_different_locks)
+{
+    DifferentLocks data;
+    weos::thread t1(&waitWithLock, &data, &data.first);
+    waitUntilEnqueued(data, data.first);
+    weos::thread t2(&waitWithLock, &data, &data.second);
+    waitUntilEnqueued(data, data.second);
+
+    {
+        // The first waiter cannot reacquire its lock. This must not keep
+        // the second waiter from waking up.
+        weos::lock_guard<weos::mutex> locker(data.first);
+        data.cv.notify_all();
+        ASSERT_TRUE(data.woken.try_wait_for(weos::chrono::seconds(1)));
+    }
+
+    data.woken.wait();
+    t1.join();
+    t2.join();
+}
@@ -40,6 +40,14 @@
 // Set this macro to make WEOS wrap the native C++11 STL.
 #define WEOS_WRAP_CXX11
 
+#if defined(WEOS_WRAP_CXX11)
+
+// The options are documented in src/weos_user_config.template.hpp.
+#  define WEOS_DEFAULT_SPIN_COUNT   0
+#  define WEOS_ADAPTIVE_MUTEX_SPIN_COUNT   100
+
+#endif // WEOS_WRAP_CXX11
+
 // -----------------------------------------------------------------------------
 //     Keil CMSIS-RTOS
 // -----------------------------------------------------------------------------
@@ -126,6 +134,16 @@
 // Note: If WEOS_ENABLE_EXCEPTIONS is not defined, this macro has no effect.
 // #define WEOS_CUSTOM_THROW_EXCEPTION
 
+// -----------------------------------------------------------------------------
+//     Profiling
+// -----------------------------------------------------------------------------
+
+// If this macro is defined, every profiled_mutex records how often it is
+// acquired, how often and how long threads wait for it and how long it is
+// held. The statistics can be inspected with the mutex_profiler. If the
+// macro is not defined, a profiled_mutex is a plain mutex.
+// #define WEOS_ENABLE_MUTEX_PROFILING
+
 // -----------------------------------------------------------------------------
 //     Miscellaneous
 // -----------------------------------------------------------------------------
@@ -126,6 +126,16 @@
 // Note: If WEOS_ENABLE_EXCEPTIONS is not defined, this macro has no effect.
 // #define WEOS_CUSTOM_THROW_EXCEPTION
 
+// -----------------------------------------------------------------------------
+//     Profiling
+// -----------------------------------------------------------------------------
+
+// If this macro is defined, every profiled_mutex records how often it is
+// acquired, how often and how long threads wait for it and how long it is
+// held. The statistics can be inspected with the mutex_profiler. If the
+// macro is not defined, a profiled_mutex is a plain mutex.
+// #define WEOS_ENABLE_MUTEX_PROFILING
+
 // -----------------------------------------------------------------------------
 //     Miscellaneous
 // -----------------------------------------------------------------------------
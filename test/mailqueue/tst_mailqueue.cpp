@@ -0,0 +1,211 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <mailqueue.hpp>
+#include <thread.hpp>
+
+#include "../common/testutils.hpp"
+#include "gtest/gtest.h"
+
+namespace
+{
+
+// A mail which is too large for a message queue on CMSIS.
+struct Mail
+{
+    Mail()
+        : id(-1),
+          length(0)
+    {
+        ++numInstances;
+    }
+
+    explicit Mail(std::int32_t id)
+        : id(id),
+          length(0)
+    {
+        ++numInstances;
+    }
+
+    Mail(std::int32_t id, std::int32_t length)
+        : id(id),
+          length(length)
+    {
+        for (std::int32_t i = 0; i < length; ++i)
+            payload[i] = std::uint8_t(id + i);
+        ++numInstances;
+    }
+
+    ~Mail()
+    {
+        --numInstances;
+    }
+
+    std::int32_t id;
+    std::int32_t length;
+    std::uint8_t payload[32];
+
+    static int numInstances;
+
+private:
+    Mail(const Mail&);
+    Mail& operator= (const Mail&);
+};
+
+int Mail::numInstances = 0;
+
+// Sends mails with the ids [0, count) via the queue.
+template <typename QueueT>
+void sendMails(QueueT* queue, std::int32_t count)
+{
+    for (std::int32_t i = 0; i < count; ++i)
+        queue->send(queue->emplace(i, std::int32_t(i % 32)));
+}
+
+} // anonymous namespace
+
+TEST(mail_queue, capacity)
+{
+    weos::mail_queue<Mail, 1> q1;
+    ASSERT_EQ(1u, q1.capacity());
+
+    weos::mail_queue<Mail, 13> q13;
+    ASSERT_EQ(13u, q13.capacity());
+}
+
+TEST(mail_queue, try_receive_from_empty_queue)
+{
+    weos::mail_queue<Mail, 2> q;
+    ASSERT_TRUE(q.try_receive() == 0);
+    ASSERT_TRUE(q.try_receive_for(weos::chrono::milliseconds(1)) == 0);
+}
+
+TEST(mail_queue, allocate_constructs_mail)
+{
+    ASSERT_EQ(0, Mail::numInstances);
+    {
+        weos::mail_queue<Mail, 3> q;
+
+        Mail* m1 = q.allocate();
+        ASSERT_EQ(-1, m1->id);
+        Mail* m2 = q.emplace(2);
+        ASSERT_EQ(2, m2->id);
+        Mail* m3 = q.emplace(3, 4);
+        ASSERT_EQ(3, m3->id);
+        ASSERT_EQ(4, m3->length);
+        ASSERT_EQ(3, Mail::numInstances);
+
+        q.free(m1);
+        q.free(m2);
+        q.free(m3);
+        ASSERT_EQ(0, Mail::numInstances);
+    }
+}
+
+TEST(mail_queue, try_allocate_from_exhausted_queue)
+{
+    weos::mail_queue<Mail, 2> q;
+    Mail* m1 = q.try_allocate();
+    Mail* m2 = q.try_emplace(2);
+    ASSERT_TRUE(m1 != 0);
+    ASSERT_TRUE(m2 != 0);
+    ASSERT_TRUE(m1 != m2);
+
+    ASSERT_TRUE(q.try_allocate() == 0);
+    ASSERT_TRUE(q.try_emplace(3) == 0);
+    ASSERT_TRUE(q.try_emplace(3, 4) == 0);
+    ASSERT_TRUE(q.try_allocate_for(weos::chrono::milliseconds(1)) == 0);
+
+    // A mail which has been sent is still in use.
+    q.send(m1);
+    ASSERT_TRUE(q.try_allocate() == 0);
+
+    ASSERT_EQ(m1, q.receive());
+    q.free(m1);
+    Mail* m3 = q.try_allocate_for(weos::chrono::milliseconds(1));
+    ASSERT_TRUE(m3 != 0);
+
+    q.free(m2);
+    q.free(m3);
+}
+
+TEST(mail_queue, send_and_receive_without_copy)
+{
+    weos::mail_queue<Mail, 3> q;
+    for (std::int32_t round = 0; round < 10; ++round)
+    {
+        Mail* sent = q.emplace(round, 16);
+        q.send(sent);
+
+        Mail* received = q.receive();
+        ASSERT_EQ(sent, received);
+        ASSERT_EQ(round, received->id);
+        for (std::int32_t i = 0; i < 16; ++i)
+            ASSERT_EQ(std::uint8_t(round + i), received->payload[i]);
+        q.free(received);
+    }
+    ASSERT_EQ(0, Mail::numInstances);
+}
+
+TEST(mail_queue, fifo_order)
+{
+    weos::mail_queue<Mail, 4> q;
+    for (std::int32_t i = 0; i < 4; ++i)
+        q.send(q.emplace(i));
+
+    for (std::int32_t i = 0; i < 4; ++i)
+    {
+        Mail* m = q.try_receive();
+        ASSERT_TRUE(m != 0);
+        ASSERT_EQ(i, m->id);
+        q.free(m);
+    }
+    ASSERT_TRUE(q.try_receive() == 0);
+}
+
+TEST(mail_queue, transfer_between_threads)
+{
+    typedef weos::mail_queue<Mail, 3> queue_type;
+    const std::int32_t count = 10000;
+
+    queue_type q;
+    weos::thread t(&sendMails<queue_type>, &q, count);
+    for (std::int32_t i = 0; i < count; ++i)
+    {
+        Mail* m = q.receive();
+        ASSERT_EQ(i, m->id);
+        ASSERT_EQ(i % 32, m->length);
+        for (std::int32_t j = 0; j < m->length; ++j)
+            ASSERT_EQ(std::uint8_t(i + j), m->payload[j]);
+        q.free(m);
+    }
+    t.join();
+
+    ASSERT_TRUE(q.try_receive() == 0);
+    ASSERT_EQ(0, Mail::numInstances);
+}
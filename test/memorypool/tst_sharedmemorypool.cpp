@@ -118,6 +118,38 @@ TYPED_TEST(SharedMemoryPoolTestFixture, try_allocate)
     }
 }
 
+TYPED_TEST(SharedMemoryPoolTestFixture, allocate_n_and_free_n)
+{
+    const unsigned POOL_SIZE = 10;
+    weos::shared_memory_pool<TypeParam, POOL_SIZE> p;
+    void* chunks[POOL_SIZE];
+
+    p.allocate_n(chunks, 4);
+    ASSERT_EQ(POOL_SIZE - 4, p.size());
+    ASSERT_TRUE(p.try_allocate_n(chunks + 4, 6));
+    ASSERT_TRUE(p.empty());
+    for (unsigned i = 0; i < POOL_SIZE; ++i)
+    {
+        ASSERT_TRUE(chunks[i] != 0);
+        for (unsigned j = 0; j < i; ++j)
+            ASSERT_TRUE(chunks[i] != chunks[j]);
+    }
+
+    p.free_n(chunks, 3);
+    ASSERT_EQ(3u, p.size());
+    ASSERT_FALSE(p.try_allocate_n(chunks, 4));
+    ASSERT_FALSE(p.try_allocate_n_for(chunks, 4,
+                                      weos::chrono::milliseconds(5)));
+    ASSERT_EQ(3u, p.size());
+    ASSERT_TRUE(p.try_allocate_n_for(chunks, 3,
+                                     weos::chrono::milliseconds(5)));
+    ASSERT_TRUE(p.empty());
+
+    p.free_n(chunks, POOL_SIZE);
+    ASSERT_EQ(POOL_SIZE, p.size());
+    ASSERT_FALSE(p.try_allocate_n(chunks, POOL_SIZE + 1));
+}
+
 TYPED_TEST(SharedMemoryPoolTestFixture, allocate_and_free)
 {
     const unsigned POOL_SIZE = 10;
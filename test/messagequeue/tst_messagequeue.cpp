@@ -0,0 +1,1080 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <messagequeue.hpp>
+#include <mutex.hpp>
+#include <semaphore.hpp>
+#include <thread.hpp>
+
+#include "../common/testutils.hpp"
+#include "gtest/gtest.h"
+
+#include <memory>
+
+namespace
+{
+
+template <typename TagT>
+struct SparringData
+{
+    enum Action
+    {
+        None,
+        Receive,
+        Send,
+        Terminate
+    };
+
+    SparringData()
+        : action(None),
+          busy(false),
+          received(0),
+          sparringStarted(false)
+    {
+    }
+
+    weos::message_queue<std::int32_t, 4, TagT> queue;
+    volatile Action action;
+    volatile bool busy;
+    volatile std::int32_t received;
+    volatile bool sparringStarted;
+};
+
+template <typename TagT>
+void sparring(SparringData<TagT>* data)
+{
+    typedef SparringData<TagT> data_type;
+
+    data->sparringStarted = true;
+
+    while (1)
+    {
+        if (data->action == data_type::None)
+        {
+            weos::this_thread::sleep_for(weos::chrono::milliseconds(1));
+            continue;
+        }
+        else if (data->action == data_type::Terminate)
+            break;
+
+        data->busy = true;
+        switch (data->action)
+        {
+            case data_type::Receive:
+                data->received = data->queue.receive();
+                break;
+            case data_type::Send:
+                data->queue.send(0x12345678);
+                break;
+            default:
+                break;
+        }
+        data->busy = false;
+        data->action = data_type::None;
+    }
+}
+
+// Sends the numbers [0, count) via the queue.
+template <typename QueueT>
+void sendSequence(QueueT* queue, std::int32_t count)
+{
+    for (std::int32_t i = 0; i < count; ++i)
+        queue->send(i);
+}
+
+} // anonymous namespace
+
+template <typename TagT>
+class MessageQueueTestFixture : public testing::Test
+{
+};
+
+// The queue implementations which are tested.
+typedef testing::Types<weos::locked_tag, weos::spsc_tag, weos::mpmc_tag>
+        TagsToTest;
+TYPED_TEST_CASE(MessageQueueTestFixture, TagsToTest);
+
+TYPED_TEST(MessageQueueTestFixture, capacity)
+{
+    weos::message_queue<std::int32_t, 1, TypeParam> q1;
+    ASSERT_EQ(1u, q1.capacity());
+
+    weos::message_queue<std::int32_t, 13, TypeParam> q13;
+    ASSERT_EQ(13u, q13.capacity());
+}
+
+TYPED_TEST(MessageQueueTestFixture, try_receive_from_empty_queue)
+{
+    weos::message_queue<std::int32_t, 1, TypeParam> q;
+    weos::optional<std::int32_t> result = q.try_receive();
+    ASSERT_FALSE(result.has_value());
+
+    result = q.try_receive_for(weos::chrono::milliseconds(1));
+    ASSERT_FALSE(result.has_value());
+}
+
+TYPED_TEST(MessageQueueTestFixture, send_and_receive)
+{
+    weos::optional<std::int32_t> result;
+
+    weos::message_queue<std::int32_t, 1, TypeParam> q;
+    q.send(0x12345678);
+    ASSERT_EQ(0x12345678, q.receive());
+
+    q.send(0x23456789);
+    result = q.try_receive();
+    ASSERT_TRUE(result.has_value());
+    ASSERT_EQ(0x23456789, *result);
+
+    q.send(0x34567890);
+    result = q.try_receive_for(weos::chrono::milliseconds(1));
+    ASSERT_TRUE(result.has_value());
+    ASSERT_EQ(0x34567890, *result);
+}
+
+TYPED_TEST(MessageQueueTestFixture, try_send_to_full_queue)
+{
+    weos::message_queue<std::int32_t, 3, TypeParam> q;
+    for (std::int32_t i = 0; i < 3; ++i)
+        ASSERT_TRUE(q.try_send(i));
+    ASSERT_FALSE(q.try_send(3));
+    ASSERT_FALSE(q.try_send_for(3, weos::chrono::milliseconds(1)));
+
+    ASSERT_EQ(0, q.receive());
+    ASSERT_TRUE(q.try_send_for(3, weos::chrono::milliseconds(1)));
+}
+
+TYPED_TEST(MessageQueueTestFixture, fifo_order_with_wrap_around)
+{
+    weos::message_queue<std::int32_t, 5, TypeParam> q;
+    std::int32_t sent = 0;
+    std::int32_t received = 0;
+
+    for (int round = 0; round < 100; ++round)
+    {
+        int numSend = 1 + testing::random() % 5;
+        for (int i = 0; i < numSend; ++i)
+        {
+            if (!q.try_send(sent))
+                break;
+            ++sent;
+        }
+
+        int numReceive = 1 + testing::random() % 5;
+        for (int i = 0; i < numReceive; ++i)
+        {
+            weos::optional<std::int32_t> result = q.try_receive();
+            if (!result)
+                break;
+            ASSERT_EQ(received, *result);
+            ++received;
+        }
+    }
+}
+
+TYPED_TEST(MessageQueueTestFixture, transfer_between_threads)
+{
+    typedef weos::message_queue<std::int32_t, 3, TypeParam> queue_type;
+    const std::int32_t count = 20000;
+
+    queue_type q;
+    weos::thread t(&sendSequence<queue_type>, &q, count);
+    for (std::int32_t i = 0; i < count; ++i)
+        ASSERT_EQ(i, q.receive());
+    t.join();
+
+    ASSERT_FALSE(q.try_receive());
+}
+
+TYPED_TEST(MessageQueueTestFixture, try_send_n_to_full_queue)
+{
+    weos::message_queue<std::int32_t, 5, TypeParam> q;
+    std::int32_t values[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+    ASSERT_EQ(3u, q.try_send_n(values, values + 3));
+    ASSERT_EQ(2u, q.try_send_n(values + 3, values + 8));
+    ASSERT_EQ(0u, q.try_send_n(values + 5, values + 8));
+
+    std::int32_t received[8] = {0};
+    ASSERT_EQ(0u, q.try_receive_n(received, 0));
+    ASSERT_EQ(2u, q.try_receive_n(received, 2));
+    ASSERT_EQ(3u, q.receive_n(received + 2, 8));
+    for (std::int32_t i = 0; i < 5; ++i)
+        ASSERT_EQ(i, received[i]);
+    ASSERT_EQ(0u, q.try_receive_n(received, 8));
+}
+
+TYPED_TEST(MessageQueueTestFixture, send_n_mixed_with_single_elements)
+{
+    weos::message_queue<std::int32_t, 4, TypeParam> q;
+    std::int32_t values[3] = {1, 2, 3};
+    q.send(0);
+    q.send_n(values, values + 3);
+    ASSERT_EQ(0, q.receive());
+
+    std::int32_t received[4] = {0};
+    ASSERT_EQ(1u, q.receive_n(received, 1));
+    ASSERT_EQ(1, received[0]);
+    q.send(4);
+    ASSERT_EQ(3u, q.receive_n(received, 4));
+    ASSERT_EQ(2, received[0]);
+    ASSERT_EQ(3, received[1]);
+    ASSERT_EQ(4, received[2]);
+}
+
+namespace
+{
+
+// Sends the numbers [0, count) via the queue in batches of random size.
+template <typename QueueT>
+void sendSequenceInBatches(QueueT* queue, std::int32_t count)
+{
+    std::int32_t batch[16];
+    std::int32_t sent = 0;
+    while (sent < count)
+    {
+        std::int32_t size = 1 + testing::random() % 16;
+        if (size > count - sent)
+            size = count - sent;
+        for (std::int32_t i = 0; i < size; ++i)
+            batch[i] = sent + i;
+        queue->send_n(batch, batch + size);
+        sent += size;
+    }
+}
+
+} // anonymous namespace
+
+TYPED_TEST(MessageQueueTestFixture, batch_transfer_between_threads)
+{
+    typedef weos::message_queue<std::int32_t, 5, TypeParam> queue_type;
+    const std::int32_t count = 20000;
+
+    queue_type q;
+    weos::thread t(&sendSequenceInBatches<queue_type>, &q, count);
+    std::int32_t batch[7];
+    std::int32_t received = 0;
+    while (received < count)
+    {
+        std::size_t size = q.receive_n(batch, 7);
+        ASSERT_TRUE(size >= 1 && size <= 7);
+        for (std::size_t i = 0; i < size; ++i, ++received)
+            ASSERT_EQ(received, batch[i]);
+    }
+    t.join();
+
+    ASSERT_FALSE(q.try_receive());
+}
+
+#if defined(WEOS_WRAP_CXX11)
+
+namespace
+{
+
+// An element type which counts its live instances.
+struct Counted
+{
+    Counted(int v = 0)
+        : value(v)
+    {
+        ++numInstances;
+    }
+
+    Counted(const Counted& other)
+        : value(other.value)
+    {
+        ++numInstances;
+    }
+
+    ~Counted()
+    {
+        --numInstances;
+    }
+
+    Counted& operator= (const Counted& other)
+    {
+        value = other.value;
+        return *this;
+    }
+
+    int value;
+    static int numInstances;
+};
+
+int Counted::numInstances = 0;
+
+} // anonymous namespace
+
+TYPED_TEST(MessageQueueTestFixture, elements_are_destroyed)
+{
+    {
+        weos::message_queue<Counted, 4, TypeParam> q;
+        ASSERT_EQ(0, Counted::numInstances);
+
+        q.send(Counted(1));
+        q.send(Counted(2));
+        ASSERT_EQ(2, Counted::numInstances);
+
+        ASSERT_EQ(1, q.receive().value);
+        ASSERT_EQ(1, Counted::numInstances);
+
+        q.send(Counted(3));
+        ASSERT_EQ(2, Counted::numInstances);
+    }
+    ASSERT_EQ(0, Counted::numInstances);
+}
+
+TYPED_TEST(MessageQueueTestFixture, large_elements)
+{
+    struct Large
+    {
+        double values[16];
+    };
+
+    weos::message_queue<Large, 3, TypeParam> q;
+    for (int round = 0; round < 10; ++round)
+    {
+        Large l;
+        for (int i = 0; i < 16; ++i)
+            l.values[i] = round * 16 + i;
+        q.send(l);
+
+        Large r = q.receive();
+        for (int i = 0; i < 16; ++i)
+            ASSERT_EQ(round * 16 + i, r.values[i]);
+    }
+}
+
+namespace
+{
+
+// An element type which is neither default-constructible nor copyable.
+struct MoveOnly
+{
+    MoveOnly(int a, int b)
+        : value(a + b)
+    {
+    }
+
+    MoveOnly(MoveOnly&& other)
+        : value(other.value)
+    {
+        other.value = -1;
+        ++numMoves;
+    }
+
+    MoveOnly& operator= (MoveOnly&& other)
+    {
+        value = other.value;
+        other.value = -1;
+        ++numMoves;
+        return *this;
+    }
+
+    MoveOnly(const MoveOnly&) = delete;
+    MoveOnly& operator= (const MoveOnly&) = delete;
+
+    int value;
+    static int numMoves;
+};
+
+int MoveOnly::numMoves = 0;
+
+} // anonymous namespace
+
+TYPED_TEST(MessageQueueTestFixture, unique_ptr_elements)
+{
+    weos::message_queue<std::unique_ptr<int>, 2, TypeParam> q;
+    q.send(std::unique_ptr<int>(new int(1)));
+
+    std::unique_ptr<int> p(new int(2));
+    ASSERT_TRUE(q.try_send(std::move(p)));
+    ASSERT_TRUE(p == nullptr);
+
+    // A failed send must not take the element.
+    std::unique_ptr<int> r(new int(3));
+    ASSERT_FALSE(q.try_send(std::move(r)));
+    ASSERT_FALSE(q.try_send_for(std::move(r), weos::chrono::milliseconds(1)));
+    ASSERT_TRUE(r != nullptr);
+
+    ASSERT_EQ(1, *q.receive());
+    weos::optional<std::unique_ptr<int> > result = q.try_receive();
+    ASSERT_TRUE(result.has_value());
+    ASSERT_EQ(2, **result);
+    ASSERT_FALSE(q.try_receive_for(weos::chrono::milliseconds(1)));
+}
+
+TYPED_TEST(MessageQueueTestFixture, emplace_constructs_in_queue)
+{
+    weos::message_queue<MoveOnly, 3, TypeParam> q;
+    MoveOnly::numMoves = 0;
+
+    q.emplace(1, 2);
+    ASSERT_TRUE(q.try_emplace(3, 4));
+    ASSERT_TRUE(q.try_emplace_for(weos::chrono::milliseconds(1), 5, 6));
+    ASSERT_FALSE(q.try_emplace(7, 8));
+    ASSERT_FALSE(q.try_emplace_for(weos::chrono::milliseconds(1), 7, 8));
+    ASSERT_EQ(0, MoveOnly::numMoves);
+
+    ASSERT_EQ(3, q.receive().value);
+    weos::optional<MoveOnly> result = q.try_receive();
+    ASSERT_TRUE(result.has_value());
+    ASSERT_EQ(7, result->value);
+    result = q.try_receive_for(weos::chrono::milliseconds(1));
+    ASSERT_TRUE(result.has_value());
+    ASSERT_EQ(11, result->value);
+    ASSERT_FALSE(q.try_receive());
+}
+
+namespace
+{
+
+// An element type whose constructor throws for negative values.
+struct ThrowsIfNegative
+{
+    explicit ThrowsIfNegative(int v)
+        : value(v)
+    {
+        if (v < 0)
+            throw v;
+    }
+
+    int value;
+};
+
+struct CopyThrowsIfNegative
+{
+    explicit CopyThrowsIfNegative(int v)
+        : value(v)
+    {
+    }
+
+    CopyThrowsIfNegative(const CopyThrowsIfNegative& other)
+        : value(other.value)
+    {
+        if (value < 0)
+            throw value;
+    }
+
+    CopyThrowsIfNegative& operator= (const CopyThrowsIfNegative&) = default;
+
+    int value;
+};
+
+// An output target whose assignment throws for the value zero.
+struct RejectsZero
+{
+    RejectsZero()
+        : value(-1)
+    {
+    }
+
+    RejectsZero& operator= (const ThrowsIfNegative& element)
+    {
+        if (element.value == 0)
+            throw element.value;
+        value = element.value;
+        return *this;
+    }
+
+    int value;
+};
+
+// A queue from which every receiving thread takes a single element. The
+// received values are summed up.
+template <typename QueueT>
+struct BlockedReceiver
+{
+    BlockedReceiver()
+        : sum(0)
+    {
+    }
+
+    QueueT queue;
+    weos::semaphore received;
+    weos::mutex mutex;
+    int sum;
+};
+
+template <typename QueueT>
+void receiveValue(BlockedReceiver<QueueT>* data)
+{
+    int value = data->queue.receive().value;
+    {
+        weos::lock_guard<weos::mutex> lock(data->mutex);
+        data->sum += value;
+    }
+    data->received.post();
+}
+
+} // anonymous namespace
+
+TYPED_TEST(MessageQueueTestFixture, throwing_copy_in_send_n_keeps_prefix)
+{
+    weos::message_queue<CopyThrowsIfNegative, 5, TypeParam> q;
+    const CopyThrowsIfNegative values[] = {
+        CopyThrowsIfNegative(1), CopyThrowsIfNegative(2),
+        CopyThrowsIfNegative(-1), CopyThrowsIfNegative(3)
+    };
+
+    for (int round = 0; round < 5; ++round)
+    {
+        bool caught = false;
+        try
+        {
+            if (round % 2 == 0)
+                q.send_n(values, values + 4);
+            else
+                q.try_send_n(values, values + 4);
+        }
+        catch (int)
+        {
+            caught = true;
+        }
+        ASSERT_TRUE(caught);
+
+        ASSERT_EQ(1, q.receive().value);
+        ASSERT_EQ(2, q.receive().value);
+        ASSERT_FALSE(q.try_receive());
+
+        ASSERT_EQ(2u, q.try_send_n(values, values + 2));
+        ASSERT_EQ(1, q.receive().value);
+        ASSERT_EQ(2, q.receive().value);
+        ASSERT_FALSE(q.try_receive());
+    }
+}
+
+TYPED_TEST(MessageQueueTestFixture, throwing_copy_in_send_n_wakes_blocked_receiver)
+{
+    typedef weos::message_queue<CopyThrowsIfNegative, 4, TypeParam> queue_type;
+    const CopyThrowsIfNegative values[] = {
+        CopyThrowsIfNegative(1), CopyThrowsIfNegative(-1)
+    };
+
+    for (int round = 0; round < 2; ++round)
+    {
+        BlockedReceiver<queue_type> data;
+        weos::thread t(&receiveValue<queue_type>, &data);
+        // Let the receiver block before the copy throws.
+        weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+
+        bool caught = false;
+        try
+        {
+            if (round == 0)
+                data.queue.send_n(values, values + 2);
+            else
+                data.queue.try_send_n(values, values + 2);
+        }
+        catch (int)
+        {
+            caught = true;
+        }
+        ASSERT_TRUE(caught);
+
+        ASSERT_TRUE(data.received.try_wait_for(
+                        weos::chrono::milliseconds(500)));
+        t.join();
+        ASSERT_EQ(1, data.sum);
+        ASSERT_FALSE(data.queue.try_receive());
+    }
+}
+
+TYPED_TEST(MessageQueueTestFixture, throwing_constructor_keeps_queue_usable)
+{
+    weos::message_queue<ThrowsIfNegative, 3, TypeParam> q;
+
+    for (int round = 0; round < 5; ++round)
+    {
+        q.emplace(2 * round);
+        bool caught = false;
+        try
+        {
+            q.try_emplace(-1);
+        }
+        catch (int)
+        {
+            caught = true;
+        }
+        ASSERT_TRUE(caught);
+        ASSERT_TRUE(q.try_emplace(2 * round + 1));
+
+        ASSERT_EQ(2 * round, q.receive().value);
+        weos::optional<ThrowsIfNegative> result
+                = q.try_receive_for(weos::chrono::milliseconds(1));
+        ASSERT_TRUE(result.has_value());
+        ASSERT_EQ(2 * round + 1, result->value);
+        ASSERT_FALSE(q.try_receive());
+    }
+}
+
+TYPED_TEST(MessageQueueTestFixture, throwing_emplace_wakes_blocked_receiver)
+{
+    typedef weos::message_queue<ThrowsIfNegative, 1, TypeParam> queue_type;
+
+    BlockedReceiver<queue_type> data;
+    weos::thread t(&receiveValue<queue_type>, &data);
+    // Let the receiver block before the constructor throws.
+    weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+
+    bool caught = false;
+    try
+    {
+        data.queue.emplace(-1);
+    }
+    catch (int)
+    {
+        caught = true;
+    }
+    ASSERT_TRUE(caught);
+
+    ASSERT_TRUE(data.queue.try_send_for(ThrowsIfNegative(5),
+                                        weos::chrono::milliseconds(500)));
+    ASSERT_TRUE(data.received.try_wait_for(weos::chrono::milliseconds(500)));
+    t.join();
+    ASSERT_EQ(5, data.sum);
+    ASSERT_FALSE(data.queue.try_receive());
+}
+
+TYPED_TEST(MessageQueueTestFixture, throwing_receive_n_keeps_element)
+{
+    weos::message_queue<ThrowsIfNegative, 5, TypeParam> q;
+    q.emplace(1);
+    q.emplace(0);
+    q.emplace(2);
+
+    RejectsZero out[3];
+    bool caught = false;
+    try
+    {
+        q.try_receive_n(out, 3);
+    }
+    catch (int)
+    {
+        caught = true;
+    }
+    ASSERT_TRUE(caught);
+    ASSERT_EQ(1, out[0].value);
+
+    // The rejected element is still at the front of the queue.
+    weos::optional<ThrowsIfNegative> result = q.try_receive();
+    ASSERT_TRUE(result.has_value());
+    ASSERT_EQ(0, result->value);
+    q.emplace(3);
+    ASSERT_EQ(2u, q.receive_n(out, 3));
+    ASSERT_EQ(2, out[0].value);
+    ASSERT_EQ(3, out[1].value);
+    ASSERT_FALSE(q.try_receive());
+}
+
+TYPED_TEST(MessageQueueTestFixture, transfer_between_threads_with_spinning)
+{
+    typedef weos::message_queue<std::int32_t, 3, TypeParam> queue_type;
+    const std::int32_t count = 20000;
+
+    queue_type q;
+    ASSERT_EQ(unsigned(WEOS_DEFAULT_SPIN_COUNT), q.spin_count());
+    q.set_spin_count(1000);
+    ASSERT_EQ(1000u, q.spin_count());
+
+    weos::thread t(&sendSequence<queue_type>, &q, count);
+    for (std::int32_t i = 0; i < count; ++i)
+        ASSERT_EQ(i, q.receive());
+    t.join();
+
+    ASSERT_FALSE(q.try_receive_for(weos::chrono::milliseconds(1)));
+}
+
+#endif // WEOS_WRAP_CXX11
+
+// ----=====================================================================----
+//     Tests together with a sparring thread
+// ----=====================================================================----
+
+TYPED_TEST(MessageQueueTestFixture, sparring_receive_blocks_until_send)
+{
+    typedef SparringData<TypeParam> data_type;
+
+    data_type data;
+    weos::thread sparringThread(&sparring<TypeParam>, &data);
+    weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+    ASSERT_TRUE(data.sparringStarted);
+
+    data.action = data_type::Receive;
+    weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+    ASSERT_TRUE(data.busy);
+
+    data.queue.send(0x23456789);
+    weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+    ASSERT_FALSE(data.busy);
+    ASSERT_EQ(0x23456789, data.received);
+
+    data.action = data_type::Terminate;
+    sparringThread.join();
+}
+
+TYPED_TEST(MessageQueueTestFixture, sparring_send_blocks_until_receive)
+{
+    typedef SparringData<TypeParam> data_type;
+
+    data_type data;
+    weos::thread sparringThread(&sparring<TypeParam>, &data);
+    weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+    ASSERT_TRUE(data.sparringStarted);
+
+    // Let the sparring thread fill the queue. Only it may send because
+    // a single-producer queue must not be sent to from the main thread.
+    for (int i = 0; i < 4; ++i)
+    {
+        data.action = data_type::Send;
+        weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+        ASSERT_FALSE(data.busy);
+    }
+
+    data.action = data_type::Send;
+    weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+    ASSERT_TRUE(data.busy);
+
+    ASSERT_EQ(0x12345678, data.queue.receive());
+    weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+    ASSERT_FALSE(data.busy);
+
+    for (int i = 0; i < 4; ++i)
+        ASSERT_EQ(0x12345678, data.queue.receive());
+    ASSERT_FALSE(data.queue.try_receive());
+
+    data.action = data_type::Terminate;
+    sparringThread.join();
+}
+
+// ----=====================================================================----
+//     Stress tests with multiple senders and receivers
+// ----=====================================================================----
+
+namespace
+{
+
+template <typename QueueT>
+struct StressData
+{
+    explicit StressData(std::int32_t numPerSender)
+        : numPerSender(numPerSender),
+          nextSenderId(0),
+          numReceived(0),
+          numOrderViolations(0),
+          sum(0)
+    {
+    }
+
+    QueueT queue;
+    const std::int32_t numPerSender;
+
+    weos::mutex mutex;
+    std::int32_t nextSenderId;
+    std::int32_t numReceived;
+    std::int32_t numOrderViolations;
+    std::int64_t sum;
+};
+
+// Sends the numbers [0, numPerSender) tagged with a unique sender id in the
+// upper 8 bits.
+template <typename QueueT>
+void stressSender(StressData<QueueT>* data)
+{
+    std::int32_t id;
+    {
+        weos::lock_guard<weos::mutex> lock(data->mutex);
+        id = data->nextSenderId++;
+    }
+    for (std::int32_t i = 0; i < data->numPerSender; ++i)
+        data->queue.send((id << 24) | i);
+}
+
+// Receives elements until a negative element is encountered. Checks that the
+// elements of every sender arrive in order and accumulates the statistics
+// in \p data.
+template <typename QueueT>
+void stressReceiver(StressData<QueueT>* data)
+{
+    std::int32_t last[16];
+    for (int i = 0; i < 16; ++i)
+        last[i] = -1;
+    std::int32_t numReceived = 0;
+    std::int32_t numOrderViolations = 0;
+    std::int64_t sum = 0;
+
+    while (true)
+    {
+        std::int32_t element = data->queue.receive();
+        if (element < 0)
+            break;
+
+        std::int32_t id = element >> 24;
+        std::int32_t value = element & 0xFFFFFF;
+        if (value <= last[id])
+            ++numOrderViolations;
+        last[id] = value;
+        ++numReceived;
+        sum += value;
+    }
+
+    weos::lock_guard<weos::mutex> lock(data->mutex);
+    data->numReceived += numReceived;
+    data->numOrderViolations += numOrderViolations;
+    data->sum += sum;
+}
+
+template <typename QueueT>
+void stressTest(int numSenders, int numReceivers)
+{
+    typedef StressData<QueueT> data_type;
+    const std::int32_t numPerSender = 20000;
+
+    data_type data(numPerSender);
+
+    weos::thread receivers[4];
+    for (int i = 0; i < numReceivers; ++i)
+        receivers[i] = weos::thread(&stressReceiver<QueueT>, &data);
+    weos::thread senders[4];
+    for (int i = 0; i < numSenders; ++i)
+        senders[i] = weos::thread(&stressSender<QueueT>, &data);
+
+    for (int i = 0; i < numSenders; ++i)
+        senders[i].join();
+    for (int i = 0; i < numReceivers; ++i)
+        data.queue.send(-1);
+    for (int i = 0; i < numReceivers; ++i)
+        receivers[i].join();
+
+    ASSERT_EQ(numSenders * numPerSender, data.numReceived);
+    ASSERT_EQ(0, data.numOrderViolations);
+    ASSERT_EQ(std::int64_t(numSenders) * numPerSender * (numPerSender - 1) / 2,
+              data.sum);
+    ASSERT_FALSE(data.queue.try_receive());
+}
+
+} // anonymous namespace
+
+template <typename TagT>
+class MultiProducerMessageQueueTestFixture : public testing::Test
+{
+};
+
+// The queue implementations which support multiple senders and receivers.
+typedef testing::Types<weos::locked_tag, weos::mpmc_tag> MultiProducerTags;
+TYPED_TEST_CASE(MultiProducerMessageQueueTestFixture, MultiProducerTags);
+
+TYPED_TEST(MultiProducerMessageQueueTestFixture, stress_1_sender_3_receivers)
+{
+    stressTest<weos::message_queue<std::int32_t, 8, TypeParam> >(1, 3);
+}
+
+TYPED_TEST(MultiProducerMessageQueueTestFixture, stress_3_senders_1_receiver)
+{
+    stressTest<weos::message_queue<std::int32_t, 8, TypeParam> >(3, 1);
+}
+
+TYPED_TEST(MultiProducerMessageQueueTestFixture, stress_4_senders_4_receivers)
+{
+    stressTest<weos::message_queue<std::int32_t, 8, TypeParam> >(4, 4);
+}
+
+TYPED_TEST(MultiProducerMessageQueueTestFixture, stress_with_tiny_queue)
+{
+    stressTest<weos::message_queue<std::int32_t, 1, TypeParam> >(4, 4);
+}
+
+#if defined(WEOS_WRAP_CXX11)
+
+namespace
+{
+
+// Sends the value 1 \p count times. Every third element throws when it is
+// constructed.
+template <typename QueueT>
+void sendSometimesThrowing(QueueT* queue, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        try
+        {
+            queue->emplace(i % 3 == 2 ? -1 : 1);
+        }
+        catch (int)
+        {
+        }
+    }
+}
+
+// Receives elements until a zero arrives and adds them to the sum.
+template <typename QueueT>
+void receiveUntilZero(BlockedReceiver<QueueT>* data)
+{
+    int sum = 0;
+    while (int value = data->queue.receive().value)
+        sum += value;
+
+    weos::lock_guard<weos::mutex> lock(data->mutex);
+    data->sum += sum;
+}
+
+} // anonymous namespace
+
+TYPED_TEST(MultiProducerMessageQueueTestFixture,
+           throwing_senders_and_blocking_receivers)
+{
+    typedef weos::message_queue<ThrowsIfNegative, 1, TypeParam> queue_type;
+    const int count = 3000;
+
+    // Without spinning, senders and receivers block all the time, so
+    // discarding a tombstone and publishing one notify each other's spots.
+    BlockedReceiver<queue_type> data;
+    data.queue.set_spin_count(0);
+    weos::thread receivers[2];
+    weos::thread senders[2];
+    for (int i = 0; i < 2; ++i)
+    {
+        receivers[i] = weos::thread(&receiveUntilZero<queue_type>, &data);
+        senders[i] = weos::thread(&sendSometimesThrowing<queue_type>,
+                                  &data.queue, count);
+    }
+
+    for (int i = 0; i < 2; ++i)
+        senders[i].join();
+    for (int i = 0; i < 2; ++i)
+        data.queue.emplace(0);
+    for (int i = 0; i < 2; ++i)
+        receivers[i].join();
+
+    ASSERT_EQ(2 * (count - count / 3), data.sum);
+    ASSERT_FALSE(data.queue.try_receive());
+}
+
+TYPED_TEST(MultiProducerMessageQueueTestFixture,
+           throwing_copy_in_send_n_wakes_all_blocked_receivers)
+{
+    typedef weos::message_queue<CopyThrowsIfNegative, 4, TypeParam> queue_type;
+    const CopyThrowsIfNegative values[] = {
+        CopyThrowsIfNegative(1), CopyThrowsIfNegative(2),
+        CopyThrowsIfNegative(-1)
+    };
+
+    BlockedReceiver<queue_type> data;
+    weos::thread t1(&receiveValue<queue_type>, &data);
+    weos::thread t2(&receiveValue<queue_type>, &data);
+    // Let the receivers block before the copy throws.
+    weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+
+    bool caught = false;
+    try
+    {
+        data.queue.send_n(values, values + 3);
+    }
+    catch (int)
+    {
+        caught = true;
+    }
+    ASSERT_TRUE(caught);
+
+    // Both elements of the prefix must wake a receiver.
+    for (int count = 0; count < 2; ++count)
+    {
+        ASSERT_TRUE(data.received.try_wait_for(
+                        weos::chrono::milliseconds(500)));
+    }
+    t1.join();
+    t2.join();
+    ASSERT_EQ(3, data.sum);
+    ASSERT_FALSE(data.queue.try_receive());
+}
+
+namespace
+{
+
+typedef weos::message_queue<ThrowsIfNegative, 3, weos::mpmc_tag>
+    small_mpmc_queue;
+
+// An output target which rejects the value zero. Before it throws, it
+// receives the next element from the \p queue, so that the rejected
+// element cannot be put back to the front.
+struct ReceivesThenRejectsZero
+{
+    explicit ReceivesThenRejectsZero(small_mpmc_queue* queue)
+        : queue(queue),
+          value(-1),
+          stolen(-1)
+    {
+    }
+
+    ReceivesThenRejectsZero& operator= (const ThrowsIfNegative& element)
+    {
+        if (element.value == 0)
+        {
+            stolen = queue->receive().value;
+            throw element.value;
+        }
+        value = element.value;
+        return *this;
+    }
+
+    small_mpmc_queue* queue;
+    int value;
+    int stolen;
+};
+
+} // anonymous namespace
+
+TEST(mpmc_message_queue, throwing_receive_n_forwards_element_via_sender)
+{
+    small_mpmc_queue q;
+    q.emplace(0);
+    q.emplace(2);
+
+    ReceivesThenRejectsZero out(&q);
+    bool caught = false;
+    try
+    {
+        q.try_receive_n(&out, 1);
+    }
+    catch (int)
+    {
+        caught = true;
+    }
+    ASSERT_TRUE(caught);
+    ASSERT_EQ(2, out.stolen);
+
+    // The rejected element is appended again when a sender reaches its
+    // slot.
+    q.emplace(3);
+    q.emplace(4);
+    ASSERT_EQ(3, q.receive().value);
+    ASSERT_EQ(0, q.receive().value);
+    ASSERT_EQ(4, q.receive().value);
+    ASSERT_FALSE(q.try_receive());
+}
+
+#endif // WEOS_WRAP_CXX11
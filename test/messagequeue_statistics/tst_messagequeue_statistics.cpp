@@ -0,0 +1,174 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#define WEOS_ENABLE_MESSAGE_QUEUE_STATISTICS
+
+#include <messagequeue.hpp>
+#include <thread.hpp>
+
+#include "gtest/gtest.h"
+
+namespace
+{
+
+std::uint32_t numLatencies(const weos::message_queue_statistics& stats)
+{
+    std::uint32_t sum = 0;
+    for (std::size_t index = 0;
+         index < weos::message_queue_statistics::num_latency_buckets; ++index)
+    {
+        sum += stats.latency_histogram[index];
+    }
+    return sum;
+}
+
+} // anonymous namespace
+
+template <typename TagT>
+class MessageQueueStatisticsTestFixture : public testing::Test
+{
+};
+
+typedef testing::Types<weos::locked_tag,
+                       weos::spsc_tag,
+                       weos::mpmc_tag> MessageQueueTags;
+TYPED_TEST_CASE(MessageQueueStatisticsTestFixture, MessageQueueTags);
+
+TYPED_TEST(MessageQueueStatisticsTestFixture, Constructor)
+{
+    weos::message_queue<int, 4, TypeParam> queue;
+    weos::message_queue_statistics stats = queue.statistics();
+    ASSERT_EQ(0u, stats.size);
+    ASSERT_EQ(0u, stats.high_watermark);
+    ASSERT_EQ(0u, stats.blocked_sends);
+    ASSERT_EQ(0u, stats.blocked_receives);
+    ASSERT_EQ(0, stats.blocked_send_time.count());
+    ASSERT_EQ(0, stats.blocked_receive_time.count());
+    ASSERT_EQ(0u, numLatencies(stats));
+}
+
+TYPED_TEST(MessageQueueStatisticsTestFixture, size_and_high_watermark)
+{
+    weos::message_queue<int, 4, TypeParam> queue;
+    queue.send(1);
+    queue.send(2);
+    queue.send(3);
+    ASSERT_EQ(3u, queue.statistics().size);
+    ASSERT_EQ(3u, queue.statistics().high_watermark);
+
+    queue.receive();
+    queue.try_receive();
+    weos::message_queue_statistics stats = queue.statistics();
+    ASSERT_EQ(1u, stats.size);
+    ASSERT_EQ(3u, stats.high_watermark);
+    ASSERT_EQ(2u, numLatencies(stats));
+
+    int values[] = {4, 5, 6};
+    ASSERT_EQ(3u, queue.try_send_n(values, values + 3));
+    ASSERT_EQ(4u, queue.statistics().size);
+    ASSERT_EQ(4u, queue.statistics().high_watermark);
+
+    int received[4];
+    ASSERT_EQ(4u, queue.receive_n(received, 4));
+    stats = queue.statistics();
+    ASSERT_EQ(0u, stats.size);
+    ASSERT_EQ(4u, stats.high_watermark);
+    ASSERT_EQ(6u, numLatencies(stats));
+    ASSERT_EQ(0u, stats.blocked_sends);
+    ASSERT_EQ(0u, stats.blocked_receives);
+}
+
+TYPED_TEST(MessageQueueStatisticsTestFixture, reset_statistics)
+{
+    weos::message_queue<int, 4, TypeParam> queue;
+    queue.send(1);
+    queue.send(2);
+    queue.receive();
+    queue.reset_statistics();
+
+    weos::message_queue_statistics stats = queue.statistics();
+    ASSERT_EQ(1u, stats.size);
+    ASSERT_EQ(1u, stats.high_watermark);
+    ASSERT_EQ(0u, numLatencies(stats));
+}
+
+TYPED_TEST(MessageQueueStatisticsTestFixture, latency_histogram)
+{
+    weos::message_queue<int, 4, TypeParam> queue;
+    queue.send(1);
+    weos::this_thread::sleep_for(weos::chrono::milliseconds(5));
+    queue.receive();
+
+    // 5 ms are at least 2^12 us, i.e. the latency is in bucket 13 or above.
+    weos::message_queue_statistics stats = queue.statistics();
+    for (std::size_t index = 0; index < 13; ++index)
+        ASSERT_EQ(0u, stats.latency_histogram[index]);
+    ASSERT_EQ(1u, numLatencies(stats));
+}
+
+TYPED_TEST(MessageQueueStatisticsTestFixture, blocked_receive)
+{
+    typedef weos::message_queue<int, 4, TypeParam> queue_type;
+    queue_type queue;
+
+    weos::thread t([&] {
+        weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+        queue.send(1);
+    });
+    ASSERT_EQ(1, queue.receive());
+    t.join();
+
+    ASSERT_FALSE(queue.try_receive_for(weos::chrono::milliseconds(5)));
+
+    weos::message_queue_statistics stats = queue.statistics();
+    ASSERT_EQ(2u, stats.blocked_receives);
+    ASSERT_TRUE(stats.blocked_receive_time >= weos::chrono::milliseconds(5));
+    ASSERT_EQ(0u, stats.blocked_sends);
+}
+
+TYPED_TEST(MessageQueueStatisticsTestFixture, blocked_send)
+{
+    typedef weos::message_queue<int, 1, TypeParam> queue_type;
+    queue_type queue;
+    queue.send(1);
+
+    ASSERT_FALSE(queue.try_send_for(2, weos::chrono::milliseconds(5)));
+
+    weos::thread t([&] {
+        weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+        queue.receive();
+    });
+    queue.send(3);
+    t.join();
+
+    weos::message_queue_statistics stats = queue.statistics();
+    ASSERT_EQ(2u, stats.blocked_sends);
+    ASSERT_TRUE(stats.blocked_send_time >= weos::chrono::milliseconds(5));
+    ASSERT_EQ(1u, stats.size);
+    ASSERT_EQ(1u, stats.high_watermark);
+}
@@ -0,0 +1,162 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <mutex.hpp>
+#include <thread.hpp>
+
+#include "gtest/gtest.h"
+
+namespace
+{
+
+struct SparringData
+{
+    SparringData()
+        : locking(false),
+          locked(false)
+    {
+    }
+
+    weos::adaptive_mutex mutex;
+    volatile bool locking;
+    volatile bool locked;
+};
+
+void lockAndUnlock(SparringData* data)
+{
+    data->locking = true;
+    data->mutex.lock();
+    data->locked = true;
+    data->mutex.unlock();
+}
+
+struct CounterData
+{
+    CounterData()
+        : counter(0)
+    {
+    }
+
+    weos::adaptive_mutex mutex;
+    int counter;
+};
+
+const int NUM_INCREMENTS = 100000;
+
+void increment(CounterData* data)
+{
+    for (int i = 0; i < NUM_INCREMENTS; ++i)
+    {
+        weos::lock_guard<weos::adaptive_mutex> lock(data->mutex);
+        ++data->counter;
+    }
+}
+
+} // anonymous namespace
+
+TEST(adaptive_mutex, construct_and_destruct)
+{
+    weos::adaptive_mutex m;
+}
+
+TEST(adaptive_mutex, lock)
+{
+    weos::adaptive_mutex m;
+    m.lock();
+    m.unlock();
+    m.lock();
+    m.unlock();
+}
+
+TEST(adaptive_mutex, try_lock)
+{
+    weos::adaptive_mutex m;
+    ASSERT_TRUE(m.try_lock());
+    ASSERT_FALSE(m.try_lock());
+    m.unlock();
+    ASSERT_TRUE(m.try_lock());
+    m.unlock();
+}
+
+TEST(adaptive_mutex, lock_guard)
+{
+    weos::adaptive_mutex m;
+    {
+        weos::lock_guard<weos::adaptive_mutex> lock(m);
+        ASSERT_FALSE(m.try_lock());
+    }
+    ASSERT_TRUE(m.try_lock());
+    m.unlock();
+}
+
+TEST(adaptive_mutex, unique_lock)
+{
+    weos::adaptive_mutex m;
+    {
+        weos::unique_lock<weos::adaptive_mutex> lock(m);
+        ASSERT_TRUE(lock.owns_lock());
+        ASSERT_FALSE(m.try_lock());
+        lock.unlock();
+        ASSERT_TRUE(m.try_lock());
+        m.unlock();
+    }
+    {
+        weos::unique_lock<weos::adaptive_mutex> lock(m, weos::try_to_lock);
+        ASSERT_TRUE(lock.owns_lock());
+    }
+    ASSERT_TRUE(m.try_lock());
+    m.unlock();
+}
+
+TEST(adaptive_mutex, lock_blocks_until_unlocked)
+{
+    SparringData data;
+    data.mutex.lock();
+
+    weos::thread t(lockAndUnlock, &data);
+    weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+    ASSERT_TRUE(data.locking);
+    ASSERT_FALSE(data.locked);
+
+    data.mutex.unlock();
+    t.join();
+    ASSERT_TRUE(data.locked);
+    ASSERT_TRUE(data.mutex.try_lock());
+    data.mutex.unlock();
+}
+
+TEST(adaptive_mutex, mutual_exclusion)
+{
+    CounterData data;
+    weos::thread t1(increment, &data);
+    weos::thread t2(increment, &data);
+    increment(&data);
+    t1.join();
+    t2.join();
+    ASSERT_EQ(3 * NUM_INCREMENTS, data.counter);
+}
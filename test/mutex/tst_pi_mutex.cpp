@@ -0,0 +1,277 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <mutex.hpp>
+#include <semaphore.hpp>
+#include <thread.hpp>
+
+#include "gtest/gtest.h"
+
+#if defined(WEOS_WRAP_CXX11)
+    #include <chrono>
+    #include <cstdio>
+    #include <ctime>
+    #include <pthread.h>
+    #include <sched.h>
+#endif // WEOS_WRAP_CXX11
+
+namespace
+{
+
+struct CounterData
+{
+    CounterData()
+        : counter(0)
+    {
+    }
+
+    weos::pi_mutex mutex;
+    int counter;
+};
+
+const int NUM_INCREMENTS = 100000;
+
+void increment(CounterData* data)
+{
+    for (int i = 0; i < NUM_INCREMENTS; ++i)
+    {
+        weos::lock_guard<weos::pi_mutex> lock(data->mutex);
+        ++data->counter;
+    }
+}
+
+} // anonymous namespace
+
+TEST(pi_mutex, construct_and_destruct)
+{
+    weos::pi_mutex m;
+}
+
+TEST(pi_mutex, lock)
+{
+    weos::pi_mutex m;
+    m.lock();
+    m.unlock();
+    m.lock();
+    m.unlock();
+}
+
+TEST(pi_mutex, try_lock)
+{
+    weos::pi_mutex m;
+    ASSERT_TRUE(m.try_lock());
+    m.unlock();
+    ASSERT_TRUE(m.try_lock());
+    m.unlock();
+}
+
+TEST(pi_mutex, mutual_exclusion)
+{
+    CounterData data;
+    weos::thread t1(increment, &data);
+    weos::thread t2(increment, &data);
+    increment(&data);
+    t1.join();
+    t2.join();
+    ASSERT_EQ(3 * NUM_INCREMENTS, data.counter);
+}
+
+#if defined(WEOS_WRAP_CXX11)
+
+namespace
+{
+
+// The SCHED_FIFO priorities of the threads in the inversion scenario.
+const int LOW_PRIORITY = 10;
+const int MEDIUM_PRIORITY = 20;
+const int HIGH_PRIORITY = 30;
+const int MAIN_PRIORITY = 40;
+
+// How long the low-priority thread holds the mutex and how long the
+// medium-priority thread hogs the processor.
+const std::chrono::milliseconds CRITICAL_SECTION(20);
+const std::chrono::milliseconds MEDIUM_BUSY_TIME(200);
+
+// Makes the calling thread a SCHED_FIFO thread with the given priority,
+// which runs on the same processor as all other threads of the scenario.
+// Returns false if the process is not allowed to do so.
+bool makeRealTime(int priority)
+{
+    cpu_set_t cpus;
+    if (pthread_getaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0)
+        return false;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+        if (CPU_ISSET(cpu, &cpus))
+        {
+            CPU_ZERO(&cpus);
+            CPU_SET(cpu, &cpus);
+            break;
+        }
+    }
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0)
+        return false;
+
+    sched_param param;
+    param.sched_priority = priority;
+    return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+}
+
+void makeNormal()
+{
+    sched_param param;
+    param.sched_priority = 0;
+    pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+}
+
+std::chrono::nanoseconds threadCpuTime()
+{
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+}
+
+template <typename MutexT>
+struct InversionScenario
+{
+    MutexT mutex;
+    weos::semaphore lowHasLocked;
+    std::chrono::steady_clock::duration highWaitTime;
+};
+
+// The low-priority thread holds the mutex for some processor time.
+template <typename MutexT>
+void lowPriorityThread(InversionScenario<MutexT>* scenario)
+{
+    makeRealTime(LOW_PRIORITY);
+    scenario->mutex.lock();
+    scenario->lowHasLocked.post();
+    std::chrono::nanoseconds end = threadCpuTime() + CRITICAL_SECTION;
+    while (threadCpuTime() < end)
+    {
+    }
+    scenario->mutex.unlock();
+}
+
+// The medium-priority thread does not need the mutex but hogs the processor.
+template <typename MutexT>
+void mediumPriorityThread(InversionScenario<MutexT>*)
+{
+    makeRealTime(MEDIUM_PRIORITY);
+    std::chrono::steady_clock::time_point end
+            = std::chrono::steady_clock::now() + MEDIUM_BUSY_TIME;
+    while (std::chrono::steady_clock::now() < end)
+    {
+    }
+}
+
+// The high-priority thread measures how long it waits for the mutex.
+template <typename MutexT>
+void highPriorityThread(InversionScenario<MutexT>* scenario)
+{
+    makeRealTime(HIGH_PRIORITY);
+    std::chrono::steady_clock::time_point start
+            = std::chrono::steady_clock::now();
+    scenario->mutex.lock();
+    scenario->highWaitTime = std::chrono::steady_clock::now() - start;
+    scenario->mutex.unlock();
+}
+
+// Runs the classic priority inversion on a single processor: a low-priority
+// thread owns the mutex, a high-priority thread blocks on it and a
+// medium-priority thread, which does not need the mutex at all, hogs the
+// processor. Returns false if real-time scheduling is not permitted.
+template <typename MutexT>
+bool runInversionScenario(std::chrono::steady_clock::duration& highWaitTime)
+{
+    if (!makeRealTime(MAIN_PRIORITY))
+    {
+        std::printf("SCHED_FIFO is not permitted. Skipping the scenario.\n");
+        return false;
+    }
+
+    InversionScenario<MutexT> scenario;
+    weos::thread low(lowPriorityThread<MutexT>, &scenario);
+    scenario.lowHasLocked.wait();
+
+    weos::thread high(highPriorityThread<MutexT>, &scenario);
+    // Let the high-priority thread block on the mutex.
+    weos::this_thread::sleep_for(weos::chrono::milliseconds(5));
+    weos::thread medium(mediumPriorityThread<MutexT>, &scenario);
+
+    high.join();
+    medium.join();
+    low.join();
+    makeNormal();
+
+    highWaitTime = scenario.highWaitTime;
+    return true;
+}
+
+} // anonymous namespace
+
+TEST(pi_mutex, plain_mutex_suffers_from_priority_inversion)
+{
+    std::chrono::steady_clock::duration highWaitTime;
+    if (!runInversionScenario<weos::mutex>(highWaitTime))
+        return;
+
+    // The high-priority thread has to wait for the medium-priority one.
+    ASSERT_TRUE(highWaitTime >= MEDIUM_BUSY_TIME * 3 / 4);
+}
+
+TEST(pi_mutex, bounds_the_waiting_time_of_high_priority_threads)
+{
+    std::chrono::steady_clock::duration highWaitTime;
+    if (!runInversionScenario<weos::pi_mutex>(highWaitTime))
+        return;
+
+    // The owner inherits the high priority and is not preempted by the
+    // medium-priority thread. Thus, the high-priority thread waits roughly
+    // for the critical section only.
+    ASSERT_TRUE(highWaitTime < MEDIUM_BUSY_TIME / 2);
+}
+
+TEST(priority_ceiling_mutex, lock)
+{
+    weos::priority_ceiling_mutex m(HIGH_PRIORITY);
+    ASSERT_EQ(HIGH_PRIORITY, m.priority_ceiling());
+
+    if (!makeRealTime(LOW_PRIORITY))
+        return;
+    m.lock();
+    // The owner runs with the priority ceiling. Ask the kernel because the
+    // C library reports the priority which has been set by the user.
+    sched_param param;
+    sched_getparam(0, &param);
+    m.unlock();
+    makeNormal();
+    ASSERT_EQ(HIGH_PRIORITY, param.sched_priority);
+}
+
+#endif // WEOS_WRAP_CXX11
@@ -0,0 +1,201 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#define WEOS_ENABLE_MUTEX_PROFILING
+
+#include <mutex_profiler.hpp>
+#include <semaphore.hpp>
+#include <thread.hpp>
+
+#include "gtest/gtest.h"
+
+#include <cstring>
+
+namespace
+{
+
+void lockAndUnlock(weos::profiled_mutex<>* mutex)
+{
+    mutex->lock();
+    mutex->unlock();
+}
+
+void lockAndWait(weos::profiled_mutex<weos::timed_mutex>* mutex,
+                 weos::semaphore* locked, weos::semaphore* release)
+{
+    mutex->lock();
+    locked->post();
+    release->wait();
+    mutex->unlock();
+}
+
+} // anonymous namespace
+
+TEST(profiled_mutex, construct_and_destruct)
+{
+    weos::profiled_mutex<> m("m");
+    ASSERT_STREQ("m", m.name());
+}
+
+TEST(profiled_mutex, uncontended_acquisitions)
+{
+    weos::profiled_mutex<> m("uncontended");
+    for (int i = 0; i < 3; ++i)
+    {
+        weos::lock_guard<weos::profiled_mutex<> > lock(m);
+    }
+    ASSERT_TRUE(m.try_lock());
+    ASSERT_FALSE(m.try_lock());
+    m.unlock();
+
+    weos::mutex_profile profile;
+    ASSERT_EQ(1u, weos::mutex_profiler::collect(&profile, 1));
+    ASSERT_STREQ("uncontended", profile.name);
+    ASSERT_EQ(4u, profile.acquisitions);
+    ASSERT_EQ(0u, profile.contended_acquisitions);
+    ASSERT_EQ(0, profile.total_wait_time.count());
+}
+
+TEST(profiled_mutex, contended_acquisition)
+{
+    weos::profiled_mutex<> m("contended");
+    m.lock();
+    weos::thread t(lockAndUnlock, &m);
+    weos::this_thread::sleep_for(weos::chrono::milliseconds(20));
+    m.unlock();
+    t.join();
+
+    weos::mutex_profile profile;
+    ASSERT_EQ(1u, weos::mutex_profiler::collect(&profile, 1));
+    ASSERT_EQ(2u, profile.acquisitions);
+    ASSERT_EQ(1u, profile.contended_acquisitions);
+    ASSERT_TRUE(profile.max_wait_time >= weos::chrono::milliseconds(10));
+    ASSERT_TRUE(profile.total_wait_time == profile.max_wait_time);
+    ASSERT_TRUE(profile.max_hold_time >= weos::chrono::milliseconds(10));
+    ASSERT_TRUE(profile.total_hold_time >= profile.max_hold_time);
+}
+
+TEST(profiled_mutex, try_lock_for)
+{
+    weos::profiled_mutex<weos::timed_mutex> m("timed");
+    ASSERT_TRUE(m.try_lock_for(weos::chrono::milliseconds(1)));
+    m.unlock();
+
+    weos::mutex_profile profile;
+    ASSERT_EQ(1u, weos::mutex_profiler::collect(&profile, 1));
+    ASSERT_EQ(1u, profile.acquisitions);
+    ASSERT_EQ(0u, profile.timed_out_waits);
+}
+
+TEST(profiled_mutex, timed_out_waits_are_recorded)
+{
+    weos::profiled_mutex<weos::timed_mutex> m("timeout");
+    weos::semaphore locked;
+    weos::semaphore release;
+    weos::thread holder(lockAndWait, &m, &locked, &release);
+    locked.wait();
+    ASSERT_FALSE(m.try_lock_for(weos::chrono::milliseconds(10)));
+    ASSERT_FALSE(m.try_lock_until(weos::chrono::steady_clock::now()
+                                  + weos::chrono::milliseconds(10)));
+    release.post();
+    holder.join();
+
+    weos::mutex_profile profile;
+    ASSERT_EQ(1u, weos::mutex_profiler::collect(&profile, 1));
+    ASSERT_EQ(1u, profile.acquisitions);
+    ASSERT_EQ(0u, profile.contended_acquisitions);
+    ASSERT_EQ(2u, profile.timed_out_waits);
+    ASSERT_TRUE(profile.max_wait_time >= weos::chrono::milliseconds(5));
+    ASSERT_TRUE(profile.total_wait_time >= weos::chrono::milliseconds(10));
+}
+
+TEST(mutex_profiler, collect_sorts_profiles)
+{
+    weos::profiled_mutex<> a("a");
+    weos::profiled_mutex<> b("b");
+    weos::profiled_mutex<> c("c");
+    for (int i = 0; i < 1; ++i)
+        lockAndUnlock(&a);
+    for (int i = 0; i < 3; ++i)
+        lockAndUnlock(&b);
+    for (int i = 0; i < 2; ++i)
+        lockAndUnlock(&c);
+
+    weos::mutex_profile profiles[3];
+    ASSERT_EQ(3u, weos::mutex_profiler::collect(
+                      profiles, 3, weos::mutex_profiler::by_acquisitions));
+    ASSERT_STREQ("b", profiles[0].name);
+    ASSERT_STREQ("c", profiles[1].name);
+    ASSERT_STREQ("a", profiles[2].name);
+
+    // Only the hottest mutex fits.
+    ASSERT_EQ(3u, weos::mutex_profiler::collect(
+                      profiles, 1, weos::mutex_profiler::by_acquisitions));
+    ASSERT_STREQ("b", profiles[0].name);
+}
+
+TEST(mutex_profiler, unregisters_destroyed_mutexes)
+{
+    weos::mutex_profile profile;
+    {
+        weos::profiled_mutex<> m("temporary");
+        ASSERT_EQ(1u, weos::mutex_profiler::collect(&profile, 1));
+    }
+    ASSERT_EQ(0u, weos::mutex_profiler::collect(&profile, 1));
+}
+
+TEST(mutex_profiler, reset)
+{
+    weos::profiled_mutex<> m("reset");
+    lockAndUnlock(&m);
+    weos::mutex_profiler::reset();
+
+    weos::mutex_profile profile;
+    ASSERT_EQ(1u, weos::mutex_profiler::collect(&profile, 1));
+    ASSERT_STREQ("reset", profile.name);
+    ASSERT_EQ(0u, profile.acquisitions);
+    ASSERT_EQ(0, profile.total_hold_time.count());
+}
+
+TEST(mutex_profiler, print_report)
+{
+    weos::profiled_mutex<> m("reported");
+    lockAndUnlock(&m);
+
+    char buffer[512] = {0};
+    std::FILE* file = std::tmpfile();
+    ASSERT_TRUE(file != 0);
+    weos::mutex_profiler::print_report(file);
+    std::rewind(file);
+    std::size_t size = std::fread(buffer, 1, sizeof(buffer) - 1, file);
+    std::fclose(file);
+
+    ASSERT_TRUE(size > 0);
+    ASSERT_TRUE(std::strstr(buffer, "acquisitions") != 0);
+    ASSERT_TRUE(std::strstr(buffer, "reported") != 0);
+}
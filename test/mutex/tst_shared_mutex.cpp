@@ -0,0 +1,364 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <mutex.hpp>
+#include <thread.hpp>
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <utility>
+
+namespace
+{
+
+struct SparringData
+{
+    SparringData()
+        : locking(false),
+          locked(false)
+    {
+    }
+
+    weos::shared_timed_mutex mutex;
+    volatile bool locking;
+    volatile bool locked;
+};
+
+void lockAndUnlock(SparringData* data)
+{
+    data->locking = true;
+    data->mutex.lock();
+    data->locked = true;
+    data->mutex.unlock();
+}
+
+void lockSharedAndUnlock(SparringData* data)
+{
+    data->locking = true;
+    data->mutex.lock_shared();
+    data->locked = true;
+    data->mutex.unlock_shared();
+}
+
+void readBriefly(SparringData* data)
+{
+    data->mutex.lock_shared();
+    data->locked = true;
+    weos::this_thread::sleep_for(weos::chrono::milliseconds(20));
+    data->mutex.unlock_shared();
+}
+
+struct ConsistencyData
+{
+    ConsistencyData()
+        : first(0),
+          second(0),
+          inconsistent(false)
+    {
+    }
+
+    weos::shared_mutex mutex;
+    int first;
+    int second;
+    volatile bool inconsistent;
+};
+
+const int NUM_ITERATIONS = 20000;
+
+void writeConsistently(ConsistencyData* data)
+{
+    for (int i = 0; i < NUM_ITERATIONS; ++i)
+    {
+        weos::lock_guard<weos::shared_mutex> lock(data->mutex);
+        ++data->first;
+        ++data->second;
+    }
+}
+
+void readConsistently(ConsistencyData* data)
+{
+    for (int i = 0; i < NUM_ITERATIONS; ++i)
+    {
+        weos::shared_lock<weos::shared_mutex> lock(data->mutex);
+        if (data->first != data->second)
+            data->inconsistent = true;
+    }
+}
+
+} // anonymous namespace
+
+TEST(shared_mutex, construct_and_destruct)
+{
+    weos::shared_mutex m;
+    weos::shared_timed_mutex tm;
+}
+
+TEST(shared_mutex, lock)
+{
+    weos::shared_mutex m;
+    m.lock();
+    ASSERT_FALSE(m.try_lock());
+    ASSERT_FALSE(m.try_lock_shared());
+    m.unlock();
+    m.lock();
+    m.unlock();
+}
+
+TEST(shared_mutex, lock_shared)
+{
+    weos::shared_mutex m;
+    m.lock_shared();
+    ASSERT_TRUE(m.try_lock_shared());
+    ASSERT_FALSE(m.try_lock());
+    m.unlock_shared();
+    ASSERT_FALSE(m.try_lock());
+    m.unlock_shared();
+    ASSERT_TRUE(m.try_lock());
+    m.unlock();
+}
+
+TEST(shared_mutex, shared_lock)
+{
+    weos::shared_mutex m;
+    {
+        weos::shared_lock<weos::shared_mutex> lock(m);
+        ASSERT_TRUE(lock.owns_lock());
+        ASSERT_TRUE(lock.mutex() == &m);
+        ASSERT_FALSE(m.try_lock());
+
+        weos::shared_lock<weos::shared_mutex> other(m, weos::try_to_lock);
+        ASSERT_TRUE(other.owns_lock());
+        other.unlock();
+        ASSERT_FALSE(other.owns_lock());
+    }
+    ASSERT_TRUE(m.try_lock());
+    {
+        weos::shared_lock<weos::shared_mutex> lock(m, weos::try_to_lock);
+        ASSERT_FALSE(lock.owns_lock());
+    }
+    m.unlock();
+    {
+        weos::shared_lock<weos::shared_mutex> lock(m, weos::defer_lock);
+        ASSERT_FALSE(lock.owns_lock());
+        ASSERT_TRUE(lock.try_lock());
+        ASSERT_FALSE(m.try_lock());
+
+        weos::shared_lock<weos::shared_mutex> moved(std::move(lock));
+        ASSERT_FALSE(lock.owns_lock());
+        ASSERT_TRUE(moved.owns_lock());
+        ASSERT_TRUE(moved.release() == &m);
+        ASSERT_FALSE(m.try_lock());
+        m.unlock_shared();
+    }
+    ASSERT_TRUE(m.try_lock());
+    m.unlock();
+}
+
+TEST(shared_mutex, lock_blocks_while_read_locked)
+{
+    SparringData data;
+    data.mutex.lock_shared();
+
+    weos::thread t(lockAndUnlock, &data);
+    weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+    ASSERT_TRUE(data.locking);
+    ASSERT_FALSE(data.locked);
+
+    data.mutex.unlock_shared();
+    t.join();
+    ASSERT_TRUE(data.locked);
+    ASSERT_TRUE(data.mutex.try_lock());
+    data.mutex.unlock();
+}
+
+TEST(shared_mutex, lock_shared_blocks_while_write_locked)
+{
+    SparringData data;
+    data.mutex.lock();
+
+    weos::thread t(lockSharedAndUnlock, &data);
+    weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+    ASSERT_TRUE(data.locking);
+    ASSERT_FALSE(data.locked);
+
+    data.mutex.unlock();
+    t.join();
+    ASSERT_TRUE(data.locked);
+    ASSERT_TRUE(data.mutex.try_lock());
+    data.mutex.unlock();
+}
+
+TEST(shared_mutex, waiting_writer_blocks_new_readers)
+{
+    SparringData data;
+    data.mutex.lock_shared();
+
+    weos::thread t(lockAndUnlock, &data);
+    weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+    ASSERT_TRUE(data.locking);
+    ASSERT_FALSE(data.mutex.try_lock_shared());
+
+    data.mutex.unlock_shared();
+    t.join();
+    ASSERT_TRUE(data.locked);
+    ASSERT_TRUE(data.mutex.try_lock_shared());
+    data.mutex.unlock_shared();
+}
+
+TEST(shared_mutex, readers_and_writers)
+{
+    ConsistencyData data;
+    weos::thread w1(writeConsistently, &data);
+    weos::thread r1(readConsistently, &data);
+    weos::thread w2(writeConsistently, &data);
+    weos::thread r2(readConsistently, &data);
+    readConsistently(&data);
+    w1.join();
+    r1.join();
+    w2.join();
+    r2.join();
+    ASSERT_FALSE(data.inconsistent);
+    ASSERT_EQ(2 * NUM_ITERATIONS, data.first);
+    ASSERT_EQ(2 * NUM_ITERATIONS, data.second);
+}
+
+TEST(shared_timed_mutex, try_lock_for)
+{
+    weos::shared_timed_mutex m;
+    ASSERT_TRUE(m.try_lock_for(weos::chrono::milliseconds(1)));
+    m.unlock();
+
+    m.lock_shared();
+    ASSERT_FALSE(m.try_lock_for(weos::chrono::milliseconds(10)));
+    // The writer which has given up must not block readers any longer.
+    ASSERT_TRUE(m.try_lock_shared());
+    m.unlock_shared();
+    m.unlock_shared();
+
+    m.lock();
+    ASSERT_FALSE(m.try_lock_for(weos::chrono::milliseconds(10)));
+    m.unlock();
+    ASSERT_TRUE(m.try_lock());
+    m.unlock();
+}
+
+TEST(shared_timed_mutex, try_lock_shared_for)
+{
+    weos::shared_timed_mutex m;
+    ASSERT_TRUE(m.try_lock_shared_for(weos::chrono::milliseconds(1)));
+    ASSERT_TRUE(m.try_lock_shared_for(weos::chrono::milliseconds(1)));
+    m.unlock_shared();
+    m.unlock_shared();
+
+    m.lock();
+    ASSERT_FALSE(m.try_lock_shared_for(weos::chrono::milliseconds(10)));
+    m.unlock();
+
+    weos::shared_lock<weos::shared_timed_mutex> lock(
+                m, weos::chrono::milliseconds(1));
+    ASSERT_TRUE(lock.owns_lock());
+}
+
+TEST(shared_timed_mutex, try_lock_for_waits_for_readers)
+{
+    SparringData data;
+    weos::thread reader(readBriefly, &data);
+    while (!data.locked)
+        weos::this_thread::sleep_for(weos::chrono::milliseconds(1));
+
+    ASSERT_TRUE(data.mutex.try_lock_for(weos::chrono::seconds(1)));
+    data.mutex.unlock();
+    reader.join();
+}
+
+#if defined(WEOS_WRAP_CXX11)
+
+namespace
+{
+
+// Locks and destroys the mutexes which the other thread publishes one after
+// another while it holds them exclusively.
+void lockAndDestroy(std::atomic<weos::shared_mutex*>* published, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        weos::shared_mutex* m;
+        while ((m = published->exchange(0)) == 0)
+            weos::this_thread::yield();
+        switch (i % 4)
+        {
+            case 0:
+                m->lock();
+                m->unlock();
+                break;
+            case 1:
+                m->lock_shared();
+                m->unlock_shared();
+                break;
+            case 2:
+                // Grab the mutex as soon as it is released.
+                while (!m->try_lock())
+                {
+                }
+                m->unlock();
+                break;
+            default:
+                while (!m->try_lock_shared())
+                {
+                }
+                m->unlock_shared();
+                break;
+        }
+        delete m;
+    }
+}
+
+} // anonymous namespace
+
+TEST(shared_mutex, destroy_right_after_unlock)
+{
+    const int count = 5000;
+    std::atomic<weos::shared_mutex*> published(0);
+    weos::thread t(&lockAndDestroy, &published, count);
+
+    // The other thread destroys every mutex as soon as it has been able to
+    // lock it, which may be before unlock() has returned.
+    for (int i = 0; i < count; ++i)
+    {
+        while (published.load() != 0)
+            weos::this_thread::yield();
+        weos::shared_mutex* m = new weos::shared_mutex;
+        m->lock();
+        published.store(m);
+        m->unlock();
+    }
+    t.join();
+}
+
+#endif // WEOS_WRAP_CXX11
@@ -0,0 +1,144 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <optional.hpp>
+
+#include "../common/testutils.hpp"
+#include "gtest/gtest.h"
+
+#include <type_traits>
+
+namespace
+{
+
+// A type which counts its live instances.
+struct Counted
+{
+    explicit Counted(int v)
+        : value(v)
+    {
+        ++numInstances;
+    }
+
+    Counted(const Counted& other)
+        : value(other.value)
+    {
+        ++numInstances;
+    }
+
+    ~Counted()
+    {
+        --numInstances;
+    }
+
+    int value;
+    static int numInstances;
+
+private:
+    Counted& operator= (const Counted&);
+};
+
+int Counted::numInstances = 0;
+
+} // anonymous namespace
+
+TEST(optional, default_constructed_is_empty)
+{
+    weos::optional<Counted> o;
+    ASSERT_FALSE(o.has_value());
+    ASSERT_FALSE(static_cast<bool>(o));
+    ASSERT_EQ(0, Counted::numInstances);
+}
+
+TEST(optional, construct_from_value)
+{
+    {
+        weos::optional<Counted> o(Counted(42));
+        ASSERT_TRUE(o.has_value());
+        ASSERT_TRUE(static_cast<bool>(o));
+        ASSERT_EQ(42, (*o).value);
+        ASSERT_EQ(42, o->value);
+        ASSERT_EQ(1, Counted::numInstances);
+    }
+    ASSERT_EQ(0, Counted::numInstances);
+}
+
+TEST(optional, emplace_and_reset)
+{
+    weos::optional<Counted> o;
+    o.emplace(1);
+    ASSERT_TRUE(o.has_value());
+    ASSERT_EQ(1, o->value);
+
+    o.emplace(2);
+    ASSERT_EQ(2, o->value);
+    ASSERT_EQ(1, Counted::numInstances);
+
+    o.reset();
+    ASSERT_FALSE(o.has_value());
+    ASSERT_EQ(0, Counted::numInstances);
+}
+
+TEST(optional, copy)
+{
+    {
+        weos::optional<Counted> o1(Counted(1));
+        weos::optional<Counted> o2(o1);
+        ASSERT_TRUE(o2.has_value());
+        ASSERT_EQ(1, o2->value);
+        ASSERT_EQ(2, Counted::numInstances);
+
+        weos::optional<Counted> o3;
+        o2 = o3;
+        ASSERT_FALSE(o2.has_value());
+        ASSERT_EQ(1, Counted::numInstances);
+
+        o3 = o1;
+        ASSERT_TRUE(o3.has_value());
+        ASSERT_EQ(1, o3->value);
+        ASSERT_EQ(2, Counted::numInstances);
+    }
+    ASSERT_EQ(0, Counted::numInstances);
+}
+
+#if defined(WEOS_USE_CXX11)
+TEST(optional, bool_conversion_is_explicit)
+{
+    static_assert(!std::is_convertible<weos::optional<int>, bool>::value,
+                  "An optional must not convert to bool implicitly.");
+    static_assert(!std::is_convertible<weos::optional<int>, int>::value,
+                  "An optional must not convert to int.");
+
+    // The conversion checks for a value and not the value itself.
+    weos::optional<bool> o(false);
+    bool engaged = false;
+    if (o)
+        engaged = true;
+    ASSERT_TRUE(engaged);
+}
+#endif // WEOS_USE_CXX11
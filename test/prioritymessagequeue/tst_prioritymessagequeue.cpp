@@ -0,0 +1,492 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <prioritymessagequeue.hpp>
+#include <thread.hpp>
+
+#include "../common/testutils.hpp"
+#include "gtest/gtest.h"
+
+#include <memory>
+
+namespace
+{
+
+// Sends the numbers [0, count) with a priority of number % 4 via the queue.
+template <typename QueueT>
+void sendWithPriorities(QueueT* queue, std::int32_t count)
+{
+    for (std::int32_t i = 0; i < count; ++i)
+        queue->send(i, i % 4);
+}
+
+} // anonymous namespace
+
+TEST(priority_message_queue, capacity)
+{
+    weos::priority_message_queue<std::int32_t, 1, 1> q1;
+    ASSERT_EQ(1u, q1.capacity());
+    ASSERT_EQ(1u, q1.num_levels());
+
+    weos::priority_message_queue<std::int32_t, 13, 32> q13;
+    ASSERT_EQ(13u, q13.capacity());
+    ASSERT_EQ(32u, q13.num_levels());
+}
+
+TEST(priority_message_queue, try_receive_from_empty_queue)
+{
+    weos::priority_message_queue<std::int32_t, 2, 4> q;
+    ASSERT_FALSE(q.try_receive());
+    ASSERT_FALSE(q.try_receive_for(weos::chrono::milliseconds(1)));
+}
+
+TEST(priority_message_queue, send_and_receive)
+{
+    weos::priority_message_queue<std::int32_t, 1, 4> q;
+    q.send(0x12345678, 2);
+    ASSERT_EQ(0x12345678, q.receive());
+
+    ASSERT_TRUE(q.try_send(0x23456789, 0));
+    weos::optional<std::int32_t> result = q.try_receive();
+    ASSERT_TRUE(result.has_value());
+    ASSERT_EQ(0x23456789, *result);
+
+    ASSERT_TRUE(q.try_send_for(0x34567890, 3, weos::chrono::milliseconds(1)));
+    result = q.try_receive_for(weos::chrono::milliseconds(1));
+    ASSERT_TRUE(result.has_value());
+    ASSERT_EQ(0x34567890, *result);
+}
+
+TEST(priority_message_queue, try_send_to_full_queue)
+{
+    weos::priority_message_queue<std::int32_t, 3, 4> q;
+    ASSERT_TRUE(q.try_send(0, 0));
+    ASSERT_TRUE(q.try_send(1, 1));
+    ASSERT_TRUE(q.try_send(2, 2));
+    ASSERT_FALSE(q.try_send(3, 3));
+    ASSERT_FALSE(q.try_send_for(3, 3, weos::chrono::milliseconds(1)));
+
+    ASSERT_EQ(2, q.receive());
+    ASSERT_TRUE(q.try_send_for(3, 3, weos::chrono::milliseconds(1)));
+    ASSERT_EQ(3, q.receive());
+}
+
+TEST(priority_message_queue, higher_priority_overtakes)
+{
+    weos::priority_message_queue<std::int32_t, 8, 4> q;
+    q.send(10, 0);
+    q.send(11, 0);
+    q.send(20, 1);
+    q.send(30, 3);
+    q.send(21, 1);
+    q.send(31, 3);
+    q.send(12, 0);
+
+    const std::int32_t expected[] = {30, 31, 20, 21, 10, 11, 12};
+    for (unsigned i = 0; i < sizeof(expected) / sizeof(expected[0]); ++i)
+        ASSERT_EQ(expected[i], q.receive());
+    ASSERT_FALSE(q.try_receive());
+}
+
+TEST(priority_message_queue, all_32_levels)
+{
+    weos::priority_message_queue<std::int32_t, 32, 32> q;
+    for (std::int32_t level = 0; level < 32; ++level)
+        q.send(level, level);
+
+    for (std::int32_t level = 31; level >= 0; --level)
+        ASSERT_EQ(level, q.receive());
+}
+
+TEST(priority_message_queue, fifo_order_with_random_priorities)
+{
+    weos::priority_message_queue<std::int32_t, 5, 3> q;
+    std::int32_t sent[3] = {0, 0, 0};
+    std::int32_t received[3] = {0, 0, 0};
+
+    for (int round = 0; round < 100; ++round)
+    {
+        int numSend = 1 + testing::random() % 5;
+        for (int i = 0; i < numSend; ++i)
+        {
+            unsigned priority = testing::random() % 3;
+            if (!q.try_send(priority * 1000 + sent[priority], priority))
+                break;
+            ++sent[priority];
+        }
+
+        int numReceive = 1 + testing::random() % 5;
+        for (int i = 0; i < numReceive; ++i)
+        {
+            weos::optional<std::int32_t> result = q.try_receive();
+            if (!result)
+                break;
+            unsigned priority = *result / 1000;
+            ASSERT_EQ(received[priority], *result % 1000);
+            ++received[priority];
+        }
+    }
+}
+
+TEST(priority_message_queue, transfer_between_threads)
+{
+    typedef weos::priority_message_queue<std::int32_t, 3, 4> queue_type;
+    const std::int32_t count = 20000;
+
+    queue_type q;
+    weos::thread t(&sendWithPriorities<queue_type>, &q, count);
+    std::int32_t last[4] = {-1, -1, -1, -1};
+    for (std::int32_t i = 0; i < count; ++i)
+    {
+        std::int32_t element = q.receive();
+        // The elements of one priority level must arrive in order.
+        ASSERT_TRUE(element > last[element % 4]);
+        last[element % 4] = element;
+    }
+    t.join();
+
+    for (std::int32_t priority = 0; priority < 4; ++priority)
+        ASSERT_EQ(count - 4 + priority, last[priority]);
+    ASSERT_FALSE(q.try_receive());
+}
+
+TEST(priority_message_queue, send_n_and_receive_n)
+{
+    weos::priority_message_queue<std::int32_t, 8, 4> q;
+    const std::int32_t low[] = {10, 11, 12};
+    const std::int32_t high[] = {30, 31};
+    q.send_n(low, low + 3, 0);
+    q.send_n(high, high + 2, 3);
+
+    std::int32_t received[8] = {0};
+    ASSERT_EQ(4u, q.receive_n(received, 4));
+    ASSERT_EQ(30, received[0]);
+    ASSERT_EQ(31, received[1]);
+    ASSERT_EQ(10, received[2]);
+    ASSERT_EQ(11, received[3]);
+
+    ASSERT_EQ(1u, q.try_receive_n(received, 8));
+    ASSERT_EQ(12, received[0]);
+    ASSERT_EQ(0u, q.try_receive_n(received, 8));
+    ASSERT_EQ(0u, q.receive_n(received, 0));
+}
+
+TEST(priority_message_queue, try_send_n_to_full_queue)
+{
+    weos::priority_message_queue<std::int32_t, 4, 2> q;
+    const std::int32_t elements[] = {0, 1, 2, 3, 4, 5};
+    ASSERT_EQ(4u, q.try_send_n(elements, elements + 6, 1));
+    ASSERT_EQ(0u, q.try_send_n(elements + 4, elements + 6, 1));
+
+    std::int32_t received[6] = {0};
+    ASSERT_EQ(4u, q.try_receive_n(received, 6));
+    for (std::int32_t i = 0; i < 4; ++i)
+        ASSERT_EQ(i, received[i]);
+}
+
+namespace
+{
+
+// Receives count elements in batches and checks their order.
+template <typename QueueT>
+void receiveInBatches(QueueT* queue, std::int32_t count, bool* inOrder)
+{
+    std::int32_t expected = 0;
+    std::int32_t batch[5];
+    while (expected < count)
+    {
+        std::size_t n = queue->receive_n(batch, 5);
+        for (std::size_t i = 0; i < n; ++i, ++expected)
+            if (batch[i] != expected)
+                *inOrder = false;
+    }
+}
+
+} // anonymous namespace
+
+TEST(priority_message_queue, batch_transfer_between_threads)
+{
+    typedef weos::priority_message_queue<std::int32_t, 4, 2> queue_type;
+    const std::int32_t count = 10000;
+
+    std::int32_t elements[100];
+    queue_type q;
+    bool inOrder = true;
+    weos::thread t(&receiveInBatches<queue_type>, &q, count, &inOrder);
+    for (std::int32_t first = 0; first < count; first += 100)
+    {
+        for (std::int32_t i = 0; i < 100; ++i)
+            elements[i] = first + i;
+        q.send_n(elements, elements + 100, 1);
+    }
+    t.join();
+
+    ASSERT_TRUE(inOrder);
+    ASSERT_FALSE(q.try_receive().has_value());
+}
+
+#if defined(WEOS_WRAP_CXX11)
+
+namespace
+{
+
+// An element type which counts its live instances.
+struct Counted
+{
+    Counted(int v = 0)
+        : value(v)
+    {
+        ++numInstances;
+    }
+
+    Counted(const Counted& other)
+        : value(other.value)
+    {
+        ++numInstances;
+    }
+
+    ~Counted()
+    {
+        --numInstances;
+    }
+
+    int value;
+    static int numInstances;
+};
+
+int Counted::numInstances = 0;
+
+} // anonymous namespace
+
+TEST(priority_message_queue, elements_are_destroyed)
+{
+    {
+        weos::priority_message_queue<Counted, 4, 2> q;
+        q.send(Counted(1), 0);
+        q.send(Counted(2), 1);
+        q.send(Counted(3), 1);
+        ASSERT_EQ(3, Counted::numInstances);
+
+        ASSERT_EQ(2, q.receive().value);
+        ASSERT_EQ(2, Counted::numInstances);
+    }
+    ASSERT_EQ(0, Counted::numInstances);
+}
+
+TEST(priority_message_queue, move_only_elements)
+{
+    weos::priority_message_queue<std::unique_ptr<int>, 3, 2> q;
+    q.send(std::unique_ptr<int>(new int(1)), 0);
+    ASSERT_TRUE(q.try_send(std::unique_ptr<int>(new int(2)), 1));
+
+    std::unique_ptr<int> p(new int(3));
+    ASSERT_TRUE(q.try_send_for(std::move(p), 1,
+                               weos::chrono::milliseconds(1)));
+    ASSERT_FALSE(p);
+
+    p.reset(new int(4));
+    ASSERT_FALSE(q.try_send(std::move(p), 0));
+    ASSERT_TRUE(p != nullptr);
+
+    ASSERT_EQ(2, *q.receive());
+    ASSERT_EQ(3, **q.try_receive());
+    ASSERT_EQ(1, **q.try_receive_for(weos::chrono::milliseconds(1)));
+}
+
+namespace
+{
+
+// An element which can only be constructed in place.
+struct Pair
+{
+    Pair(int a, int b)
+        : first(a),
+          second(b)
+    {
+    }
+
+    Pair(Pair&& other) = default;
+    Pair& operator= (Pair&& other) = default;
+
+    int first;
+    int second;
+};
+
+} // anonymous namespace
+
+TEST(priority_message_queue, emplace_constructs_in_queue)
+{
+    weos::priority_message_queue<Pair, 3, 2> q;
+    q.emplace(0, 1, 2);
+    ASSERT_TRUE(q.try_emplace(1, 3, 4));
+    ASSERT_TRUE(q.try_emplace_for(1, weos::chrono::milliseconds(1), 5, 6));
+    ASSERT_FALSE(q.try_emplace(1, 7, 8));
+    ASSERT_FALSE(q.try_emplace_for(1, weos::chrono::milliseconds(1), 7, 8));
+
+    Pair p = q.receive();
+    ASSERT_EQ(3, p.first);
+    ASSERT_EQ(4, p.second);
+    ASSERT_EQ(5, q.receive().first);
+    ASSERT_EQ(2, q.receive().second);
+}
+
+namespace
+{
+
+// An element type whose constructor throws for negative values.
+struct ThrowsIfNegative
+{
+    explicit ThrowsIfNegative(int v)
+        : value(v)
+    {
+        if (v < 0)
+            throw v;
+    }
+
+    int value;
+};
+
+// An element type whose copy constructor throws while \p armed is set.
+struct CopyThrowsIfArmed
+{
+    static bool armed;
+
+    explicit CopyThrowsIfArmed(int v)
+        : value(v)
+    {
+    }
+
+    CopyThrowsIfArmed(const CopyThrowsIfArmed& other)
+        : value(other.value)
+    {
+        if (armed)
+            throw value;
+    }
+
+    CopyThrowsIfArmed& operator= (const CopyThrowsIfArmed&) = default;
+
+    int value;
+};
+
+bool CopyThrowsIfArmed::armed = false;
+
+// An output target whose assignment throws for the value zero.
+struct RejectsZero
+{
+    RejectsZero()
+        : value(-1)
+    {
+    }
+
+    RejectsZero& operator= (const ThrowsIfNegative& element)
+    {
+        if (element.value == 0)
+            throw element.value;
+        value = element.value;
+        return *this;
+    }
+
+    int value;
+};
+
+} // anonymous namespace
+
+TEST(priority_message_queue, throwing_constructor_keeps_node)
+{
+    weos::priority_message_queue<ThrowsIfNegative, 1, 2> q;
+    bool caught = false;
+    try
+    {
+        q.emplace(0, -1);
+    }
+    catch (int)
+    {
+        caught = true;
+    }
+    ASSERT_TRUE(caught);
+    ASSERT_FALSE(q.try_receive().has_value());
+
+    ASSERT_TRUE(q.try_emplace(1, 1));
+    ASSERT_EQ(1, q.receive().value);
+}
+
+TEST(priority_message_queue, throwing_receive_keeps_element)
+{
+    weos::priority_message_queue<CopyThrowsIfArmed, 2, 2> q;
+    q.emplace(1, 1);
+
+    CopyThrowsIfArmed::armed = true;
+    bool caught = false;
+    try
+    {
+        q.receive();
+    }
+    catch (int)
+    {
+        caught = true;
+    }
+    CopyThrowsIfArmed::armed = false;
+    ASSERT_TRUE(caught);
+
+    weos::optional<CopyThrowsIfArmed> result = q.try_receive();
+    ASSERT_TRUE(result.has_value());
+    ASSERT_EQ(1, result->value);
+    ASSERT_FALSE(q.try_receive().has_value());
+}
+
+TEST(priority_message_queue, throwing_receive_n_keeps_element)
+{
+    weos::priority_message_queue<ThrowsIfNegative, 3, 2> q;
+    q.emplace(1, 1);
+    q.emplace(1, 0);
+    q.emplace(0, 2);
+
+    RejectsZero out[3];
+    bool caught = false;
+    try
+    {
+        q.try_receive_n(out, 3);
+    }
+    catch (int)
+    {
+        caught = true;
+    }
+    ASSERT_TRUE(caught);
+    ASSERT_EQ(1, out[0].value);
+
+    // The rejected element is still the next one and the node of the
+    // received element is free again.
+    ASSERT_TRUE(q.try_emplace(0, 3));
+    ASSERT_FALSE(q.try_emplace(0, 4));
+    ASSERT_EQ(0, q.receive().value);
+    ASSERT_EQ(2, q.receive().value);
+    ASSERT_EQ(3, q.receive().value);
+    ASSERT_FALSE(q.try_receive().has_value());
+}
+
+#endif // WEOS_WRAP_CXX11
@@ -29,6 +29,7 @@
 #include <semaphore.hpp>
 #include <thread.hpp>
 
+#include <atomic>
 #include <limits>
 
 #include "gtest/gtest.h"
@@ -157,6 +158,272 @@ TEST(semaphore, wait)
     }
 }
 
+TEST(semaphore, post_and_wait_multiple_tokens)
+{
+    weos::semaphore s;
+    s.post(0);
+    ASSERT_EQ(0u, s.value());
+    s.post(32);
+    ASSERT_EQ(32u, s.value());
+    s.wait(30);
+    ASSERT_EQ(2u, s.value());
+    s.wait(0);
+    ASSERT_EQ(2u, s.value());
+    s.wait(2);
+    ASSERT_EQ(0u, s.value());
+}
+
+TEST(semaphore, try_wait_multiple_tokens)
+{
+    weos::semaphore s(3);
+    ASSERT_FALSE(s.try_wait(4));
+    ASSERT_EQ(3u, s.value());
+    ASSERT_TRUE(s.try_wait(3));
+    ASSERT_EQ(0u, s.value());
+
+    s.post(2);
+    ASSERT_FALSE(s.try_wait_for(3, weos::chrono::milliseconds(5)));
+    ASSERT_EQ(2u, s.value());
+    ASSERT_TRUE(s.try_wait_for(2, weos::chrono::milliseconds(5)));
+    ASSERT_EQ(0u, s.value());
+}
+
+namespace
+{
+
+void waitForBulk(weos::semaphore* s, int count, weos::semaphore* done)
+{
+    s->wait(count);
+    done->post();
+}
+
+void tryWaitForBulk(weos::semaphore* s, int count, weos::semaphore* done)
+{
+    while (!s->try_wait_for(count, weos::chrono::milliseconds(1)));
+    done->post();
+}
+
+} // anonymous namespace
+
+TEST(semaphore, concurrent_bulk_waiters_do_not_deadlock)
+{
+    weos::semaphore s;
+    weos::semaphore done;
+    weos::thread t1(&waitForBulk, &s, 3, &done);
+    weos::thread t2(&waitForBulk, &s, 3, &done);
+    weos::this_thread::sleep_for(weos::chrono::milliseconds(5));
+
+    // Four tokens are enough for one of the waiters, even if they arrive
+    // one after the other.
+    for (int i = 0; i < 4; ++i)
+    {
+        s.post();
+        weos::this_thread::sleep_for(weos::chrono::milliseconds(1));
+    }
+    ASSERT_TRUE(done.try_wait_for(weos::chrono::seconds(1)));
+    ASSERT_FALSE(done.try_wait_for(weos::chrono::milliseconds(10)));
+
+    s.post(2);
+    ASSERT_TRUE(done.try_wait_for(weos::chrono::seconds(1)));
+    t1.join();
+    t2.join();
+    ASSERT_EQ(0u, s.value());
+}
+
+TEST(semaphore, concurrent_timed_bulk_waiters_do_not_deadlock)
+{
+    weos::semaphore s;
+    weos::semaphore done;
+    weos::thread t1(&tryWaitForBulk, &s, 3, &done);
+    weos::thread t2(&tryWaitForBulk, &s, 3, &done);
+
+    for (int i = 0; i < 4; ++i)
+    {
+        s.post();
+        weos::this_thread::sleep_for(weos::chrono::milliseconds(1));
+    }
+    ASSERT_TRUE(done.try_wait_for(weos::chrono::seconds(1)));
+
+    s.post(2);
+    ASSERT_TRUE(done.try_wait_for(weos::chrono::seconds(1)));
+    t1.join();
+    t2.join();
+    ASSERT_EQ(0u, s.value());
+}
+
+#if defined(WEOS_WRAP_CXX11)
+
+namespace
+{
+
+// Answers every token on \p ping with a token on \p pong.
+void pingPong(weos::semaphore* ping, weos::semaphore* pong, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        ping->wait();
+        pong->post();
+    }
+}
+
+void postMany(weos::semaphore* s, int count)
+{
+    for (int i = 0; i < count; ++i)
+        s->post();
+}
+
+// Takes tokens with wait() and try_wait_for() alternately.
+void waitMany(weos::semaphore* s, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        if (i % 2 == 0)
+            s->wait();
+        else
+            while (!s->try_wait_for(weos::chrono::microseconds(50)));
+    }
+}
+
+void waitForTokens(weos::semaphore* s, int count, weos::semaphore* done)
+{
+    s->wait(count);
+    done->post();
+}
+
+} // anonymous namespace
+
+TEST(semaphore, wait_for_multiple_tokens_blocks)
+{
+    weos::semaphore s;
+    weos::semaphore done;
+    weos::thread t(&waitForTokens, &s, 5, &done);
+
+    s.post(2);
+    s.post(2);
+    ASSERT_FALSE(done.try_wait_for(weos::chrono::milliseconds(10)));
+    ASSERT_EQ(4u, s.value());
+
+    s.post(3);
+    done.wait();
+    t.join();
+    ASSERT_EQ(2u, s.value());
+}
+
+TEST(semaphore, single_token_waiter_overtakes_bulk_waiter)
+{
+    weos::semaphore s;
+    weos::semaphore done;
+    weos::thread bulk(&waitForTokens, &s, 5, &done);
+    weos::this_thread::sleep_for(weos::chrono::milliseconds(5));
+    weos::thread single(&waitForTokens, &s, 1, &done);
+    weos::this_thread::sleep_for(weos::chrono::milliseconds(5));
+
+    // The bulk waiter cannot proceed with one token but the other one must.
+    s.post(1);
+    done.wait();
+    single.join();
+    ASSERT_EQ(0u, s.value());
+
+    s.post(5);
+    done.wait();
+    bulk.join();
+    ASSERT_EQ(0u, s.value());
+}
+
+TEST(semaphore, many_posters_and_waiters)
+{
+    const int count = 20000;
+    weos::semaphore s;
+
+    weos::thread waiter1(&waitMany, &s, count);
+    weos::thread waiter2(&waitMany, &s, count);
+    weos::thread poster1(&postMany, &s, count);
+    weos::thread poster2(&postMany, &s, count);
+    waiter1.join();
+    waiter2.join();
+    poster1.join();
+    poster2.join();
+
+    ASSERT_EQ(0u, s.value());
+}
+
+TEST(semaphore, spin_count)
+{
+    weos::semaphore s;
+    ASSERT_EQ(unsigned(WEOS_DEFAULT_SPIN_COUNT), s.spin_count());
+    s.set_spin_count(100);
+    ASSERT_EQ(100u, s.spin_count());
+}
+
+TEST(semaphore, try_wait_for_with_spinning)
+{
+    weos::semaphore s;
+    s.set_spin_count(1000);
+    ASSERT_FALSE(s.try_wait_for(weos::chrono::milliseconds(1)));
+    s.post();
+    ASSERT_TRUE(s.try_wait_for(weos::chrono::milliseconds(1)));
+    ASSERT_EQ(0u, s.value());
+}
+
+TEST(semaphore, ping_pong_with_spinning)
+{
+    const int count = 10000;
+    weos::semaphore ping;
+    weos::semaphore pong;
+    ping.set_spin_count(1000);
+    pong.set_spin_count(1000);
+
+    weos::thread t(&pingPong, &ping, &pong, count);
+    for (int i = 0; i < count; ++i)
+    {
+        ping.post();
+        pong.wait();
+    }
+    t.join();
+
+    ASSERT_EQ(0u, ping.value());
+    ASSERT_EQ(0u, pong.value());
+}
+
+namespace
+{
+
+// Posts to the semaphores which the receiver publishes one after another.
+void postToPublished(std::atomic<weos::semaphore*>* published, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        weos::semaphore* s;
+        while ((s = published->exchange(0)) == 0)
+            weos::this_thread::yield();
+        s->post();
+    }
+}
+
+} // anonymous namespace
+
+TEST(semaphore, destroy_right_after_wait)
+{
+    const int count = 20000;
+    std::atomic<weos::semaphore*> published(0);
+    weos::thread t(&postToPublished, &published, count);
+
+    // Every semaphore is destroyed as soon as the token has arrived, which
+    // may be before post() has returned. The next semaphore will likely
+    // occupy the same memory.
+    for (int i = 0; i < count; ++i)
+    {
+        weos::semaphore* s = new weos::semaphore;
+        s->set_spin_count(i % 2 == 0 ? 0 : 1000);
+        published.store(s);
+        s->wait();
+        delete s;
+    }
+    t.join();
+}
+
+#endif // WEOS_WRAP_CXX11
+
 // ----=====================================================================----
 //     Tests together with a sparring thread
 // ----=====================================================================----
@@ -0,0 +1,146 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <spinlock.hpp>
+#include <mutex.hpp>
+#include <thread.hpp>
+
+#include "gtest/gtest.h"
+
+namespace
+{
+
+template <typename LockT>
+struct CounterData
+{
+    CounterData()
+        : counter(0)
+    {
+    }
+
+    LockT lock;
+    int counter;
+};
+
+const int NUM_INCREMENTS = 20000;
+
+template <typename LockT>
+void increment(CounterData<LockT>* data)
+{
+    for (int i = 0; i < NUM_INCREMENTS; ++i)
+    {
+        weos::lock_guard<LockT> guard(data->lock);
+        ++data->counter;
+    }
+}
+
+} // anonymous namespace
+
+template <typename LockT>
+class spinlock_test : public testing::Test
+{
+};
+
+typedef testing::Types<weos::spinlock, weos::mcs_lock> spinlock_types;
+TYPED_TEST_CASE(spinlock_test, spinlock_types);
+
+TYPED_TEST(spinlock_test, construct_and_destruct)
+{
+    TypeParam lock;
+    ASSERT_EQ(0u, sizeof(lock) % WEOS_CACHE_LINE_SIZE);
+    ASSERT_EQ(std::size_t(WEOS_CACHE_LINE_SIZE), alignof(TypeParam));
+}
+
+TYPED_TEST(spinlock_test, lock)
+{
+    TypeParam lock;
+    lock.lock();
+    lock.unlock();
+    lock.lock();
+    lock.unlock();
+}
+
+TYPED_TEST(spinlock_test, try_lock)
+{
+    TypeParam lock;
+    ASSERT_TRUE(lock.try_lock());
+    ASSERT_FALSE(lock.try_lock());
+    lock.unlock();
+    ASSERT_TRUE(lock.try_lock());
+    lock.unlock();
+}
+
+TYPED_TEST(spinlock_test, unique_lock)
+{
+    TypeParam lock;
+    {
+        weos::unique_lock<TypeParam> guard(lock);
+        ASSERT_TRUE(guard.owns_lock());
+        ASSERT_FALSE(lock.try_lock());
+        guard.unlock();
+        ASSERT_TRUE(lock.try_lock());
+        lock.unlock();
+    }
+    {
+        weos::unique_lock<TypeParam> guard(lock, weos::try_to_lock);
+        ASSERT_TRUE(guard.owns_lock());
+    }
+    ASSERT_TRUE(lock.try_lock());
+    lock.unlock();
+}
+
+TYPED_TEST(spinlock_test, mutual_exclusion)
+{
+    CounterData<TypeParam> data;
+    weos::thread t1(increment<TypeParam>, &data);
+    weos::thread t2(increment<TypeParam>, &data);
+    increment(&data);
+    t1.join();
+    t2.join();
+    ASSERT_EQ(3 * NUM_INCREMENTS, data.counter);
+}
+
+TEST(mcs_lock, nested_locks)
+{
+    weos::mcs_lock a;
+    weos::mcs_lock b;
+
+    a.lock();
+    b.lock();
+    // Unlock in the order of locking, which frees the nodes out of order.
+    a.unlock();
+    ASSERT_TRUE(a.try_lock());
+    b.unlock();
+    a.unlock();
+
+    for (int i = 0; i < 2 * WEOS_MCS_LOCK_MAX_NESTING; ++i)
+    {
+        weos::lock_guard<weos::mcs_lock> guardA(a);
+        weos::lock_guard<weos::mcs_lock> guardB(b);
+    }
+}
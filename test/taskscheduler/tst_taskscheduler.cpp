@@ -0,0 +1,191 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <taskscheduler.hpp>
+
+#include <functional.hpp>
+#include <semaphore.hpp>
+#include <thread.hpp>
+
+#include "gtest/gtest.h"
+
+namespace
+{
+
+typedef weos::task_scheduler<100> test_scheduler;
+
+// Records the order in which tasks are executed. The tasks run on the
+// scheduler thread, which hands the data over via the done semaphore.
+struct Recorder
+{
+    Recorder()
+        : numEntries(0)
+    {
+    }
+
+    int entries[200];
+    int numEntries;
+    weos::semaphore done;
+};
+
+void record(Recorder* recorder, int value)
+{
+    recorder->entries[recorder->numEntries++] = value;
+    recorder->done.post();
+}
+
+void blockOn(weos::semaphore* gate, weos::semaphore* started)
+{
+    started->post();
+    gate->wait();
+}
+
+// A task which notifies itself until it has run \p limit times.
+void countTo(test_scheduler* scheduler, int priority, int* count, int limit,
+             weos::semaphore* done)
+{
+    if (++*count < limit)
+        scheduler->notify(priority);
+    else
+        done->post();
+}
+
+void notifyRange(test_scheduler* scheduler, int first, int last)
+{
+    for (int priority = first; priority < last; ++priority)
+        scheduler->notify(priority);
+}
+
+} // anonymous namespace
+
+TEST(task_scheduler, construct_and_destruct)
+{
+    test_scheduler scheduler;
+    ASSERT_EQ(100u, scheduler.capacity());
+}
+
+TEST(task_scheduler, create_task)
+{
+    Recorder recorder;
+    test_scheduler scheduler;
+    ASSERT_TRUE(scheduler.create_task(5, weos::bind(&record, &recorder, 5)));
+    ASSERT_FALSE(scheduler.create_task(5, weos::bind(&record, &recorder, 6)));
+    ASSERT_TRUE(scheduler.create_task(99, weos::bind(&record, &recorder, 99)));
+
+    scheduler.notify(5);
+    recorder.done.wait();
+    scheduler.notify(99);
+    recorder.done.wait();
+    ASSERT_EQ(2, recorder.numEntries);
+    ASSERT_EQ(5, recorder.entries[0]);
+    ASSERT_EQ(99, recorder.entries[1]);
+}
+
+TEST(task_scheduler, priorities)
+{
+    weos::semaphore gate;
+    weos::semaphore started;
+    Recorder recorder;
+    test_scheduler scheduler;
+    scheduler.create_task(0, weos::bind(&blockOn, &gate, &started));
+    const int priorities[] = {70, 3, 31, 32, 64, 1, 99};
+    for (int idx = 0; idx < 7; ++idx)
+    {
+        scheduler.create_task(priorities[idx],
+                              weos::bind(&record, &recorder, priorities[idx]));
+    }
+
+    // Block the scheduler, make all tasks ready and release it again.
+    scheduler.notify(0);
+    started.wait();
+    for (int idx = 0; idx < 7; ++idx)
+        scheduler.notify(priorities[idx]);
+    gate.post();
+
+    for (int idx = 0; idx < 7; ++idx)
+        recorder.done.wait();
+    const int expected[] = {1, 3, 31, 32, 64, 70, 99};
+    ASSERT_EQ(7, recorder.numEntries);
+    for (int idx = 0; idx < 7; ++idx)
+        ASSERT_EQ(expected[idx], recorder.entries[idx]);
+}
+
+TEST(task_scheduler, notifications_are_coalesced)
+{
+    weos::semaphore gate;
+    weos::semaphore started;
+    Recorder recorder;
+    test_scheduler scheduler;
+    scheduler.create_task(0, weos::bind(&blockOn, &gate, &started));
+    scheduler.create_task(10, weos::bind(&record, &recorder, 10));
+
+    scheduler.notify(0);
+    started.wait();
+    scheduler.notify(10);
+    scheduler.notify(10);
+    scheduler.notify(10);
+    gate.post();
+
+    recorder.done.wait();
+    ASSERT_FALSE(recorder.done.try_wait_for(weos::chrono::milliseconds(20)));
+    ASSERT_EQ(1, recorder.numEntries);
+}
+
+TEST(task_scheduler, task_notifies_itself)
+{
+    int count = 0;
+    weos::semaphore done;
+    test_scheduler scheduler;
+    scheduler.create_task(42, weos::bind(&countTo, &scheduler, 42, &count,
+                                         1000, &done));
+    scheduler.notify(42);
+    done.wait();
+    ASSERT_EQ(1000, count);
+}
+
+TEST(task_scheduler, notify_from_several_threads)
+{
+    Recorder recorder;
+    test_scheduler scheduler;
+    for (int priority = 0; priority < 100; ++priority)
+        scheduler.create_task(priority, weos::bind(&record, &recorder, priority));
+
+    weos::thread t1(&notifyRange, &scheduler, 0, 50);
+    weos::thread t2(&notifyRange, &scheduler, 50, 100);
+    t1.join();
+    t2.join();
+
+    for (int idx = 0; idx < 100; ++idx)
+        recorder.done.wait();
+    ASSERT_EQ(100, recorder.numEntries);
+    bool seen[100] = {false};
+    for (int idx = 0; idx < 100; ++idx)
+        seen[recorder.entries[idx]] = true;
+    for (int idx = 0; idx < 100; ++idx)
+        ASSERT_TRUE(seen[idx]);
+}
@@ -388,3 +388,37 @@ TEST(signal, wait_for_all_signals_randomly)
     data.action = SparringData::Terminate;
     t.join();
 }
+
+TEST(signal, signals_are_per_thread)
+{
+    weos::thread threads[MAX_NUM_PARALLEL_TEST_THREADS];
+    SparringData data[MAX_NUM_PARALLEL_TEST_THREADS];
+
+    for (int idx = 0; idx < MAX_NUM_PARALLEL_TEST_THREADS; ++idx)
+        threads[idx] = weos::thread(sparring, &data[idx]);
+    weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+
+    // Every thread gets a different signal and must catch only its own.
+    for (int idx = 0; idx < MAX_NUM_PARALLEL_TEST_THREADS; ++idx)
+    {
+        ASSERT_TRUE(data[idx].sparringStarted);
+        threads[idx].set_signals(1 << idx);
+    }
+    for (int idx = 0; idx < MAX_NUM_PARALLEL_TEST_THREADS; ++idx)
+    {
+        data[idx].caughtSignals = 0;
+        data[idx].action = SparringData::TryWaitForAnySignal;
+    }
+    weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+    for (int idx = 0; idx < MAX_NUM_PARALLEL_TEST_THREADS; ++idx)
+    {
+        ASSERT_FALSE(data[idx].busy);
+        ASSERT_EQ(weos::thread::signal_set(1 << idx), data[idx].caughtSignals);
+    }
+
+    for (int idx = 0; idx < MAX_NUM_PARALLEL_TEST_THREADS; ++idx)
+    {
+        data[idx].action = SparringData::Terminate;
+        threads[idx].join();
+    }
+}
@@ -0,0 +1,466 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <semaphore.hpp>
+#include <thread.hpp>
+
+#include "gtest/gtest.h"
+
+#if defined(WEOS_WRAP_CXX11) && defined(__linux__)
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+
+//! The settings which a thread observes from inside.
+struct Observed
+{
+    Observed()
+        : policy(-1),
+          priority(-1),
+          stackAddress(0),
+          stackSize(0),
+          localAddress(0),
+          numCpus(0),
+          nice(-100),
+          signals(0)
+    {
+        std::memset(name, 0, sizeof(name));
+        CPU_ZERO(&cpus);
+    }
+
+    weos::thread::id id;
+    int policy;
+    int priority;
+    void* stackAddress;
+    std::size_t stackSize;
+    void* localAddress;
+    cpu_set_t cpus;
+    int numCpus;
+    char name[16];
+    int nice;
+    weos::thread::signal_set signals;
+};
+
+void observe(Observed* observed)
+{
+    int local;
+    observed->localAddress = &local;
+    observed->id = weos::this_thread::get_id();
+
+    sched_param param;
+    pthread_getschedparam(pthread_self(), &observed->policy, &param);
+    observed->priority = param.sched_priority;
+
+    pthread_attr_t attrs;
+    pthread_getattr_np(pthread_self(), &attrs);
+    pthread_attr_getstack(&attrs, &observed->stackAddress,
+                          &observed->stackSize);
+    pthread_attr_destroy(&attrs);
+
+    pthread_getaffinity_np(pthread_self(), sizeof(observed->cpus),
+                           &observed->cpus);
+    observed->numCpus = CPU_COUNT(&observed->cpus);
+
+    pthread_getname_np(pthread_self(), observed->name,
+                       sizeof(observed->name));
+
+    errno = 0;
+    int nice = getpriority(PRIO_PROCESS,
+                           static_cast<id_t>(::syscall(SYS_gettid)));
+    if (errno == 0)
+        observed->nice = nice;
+}
+
+void waitForSignal(Observed* observed)
+{
+    observed->signals = weos::this_thread::wait_for_any_signal();
+}
+
+//! Recurses \p depth times with 1 KiB of stack per call and takes the
+//! stack high watermark at the deepest point.
+void useStack(int depth, std::size_t* highWatermark)
+{
+    volatile char buffer[1024];
+    for (std::size_t i = 0; i < sizeof(buffer); ++i)
+        buffer[i] = char(i);
+    if (depth > 1)
+        useStack(depth - 1, highWatermark);
+    else
+        *highWatermark = weos::this_thread::stack_high_watermark();
+    buffer[0] = buffer[1];
+}
+
+//! The size of a custom stack.
+const std::size_t STACK_SIZE = 64 * 1024;
+
+//! A custom stack whose begin is aligned to a page.
+struct Stack
+{
+    Stack()
+        : memory(new char[STACK_SIZE + 4096]),
+          begin(reinterpret_cast<char*>(
+                    (reinterpret_cast<std::uintptr_t>(memory.get()) + 4095)
+                    & ~std::uintptr_t(4095)))
+    {
+    }
+
+    std::unique_ptr<char[]> memory;
+    char* begin;
+};
+
+void postSemaphore(weos::semaphore* sem)
+{
+    sem->post();
+}
+
+//! Returns true if the process may create SCHED_FIFO threads.
+bool realTimeIsPermitted()
+{
+    pthread_attr_t attrs;
+    pthread_attr_init(&attrs);
+    pthread_attr_setinheritsched(&attrs, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attrs, SCHED_FIFO);
+    sched_param param;
+    param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+    pthread_attr_setschedparam(&attrs, &param);
+
+    pthread_t probe;
+    int result = pthread_create(&probe, &attrs, [](void*) -> void* {
+        return 0; }, 0);
+    pthread_attr_destroy(&attrs);
+    if (result != 0)
+        return false;
+    pthread_join(probe, 0);
+    return true;
+}
+
+} // anonymous namespace
+
+TEST(thread_attributes, default_attributes)
+{
+    Observed observed;
+    weos::thread t(weos::thread::attributes(), &observe, &observed);
+    ASSERT_TRUE(t.joinable());
+    weos::thread::id id = t.get_id();
+    t.join();
+    ASSERT_FALSE(t.joinable());
+
+    ASSERT_TRUE(id == observed.id);
+    ASSERT_TRUE(weos::thread::id() == t.get_id());
+    ASSERT_EQ(SCHED_OTHER, observed.policy);
+}
+
+TEST(thread_attributes, name)
+{
+    Observed observed;
+    weos::thread::attributes attrs;
+    attrs.setName("weos-worker");
+    weos::thread t(attrs, &observe, &observed);
+    t.join();
+
+    ASSERT_STREQ("weos-worker", observed.name);
+}
+
+TEST(thread_attributes, stack_size)
+{
+    const std::size_t stackSize = 256 * 1024;
+    Observed observed;
+    weos::thread::attributes attrs;
+    attrs.setStackSize(stackSize);
+    weos::thread t(attrs, &observe, &observed);
+    t.join();
+
+    ASSERT_GE(observed.stackSize, stackSize);
+    ASSERT_LT(observed.stackSize, 2 * stackSize);
+}
+
+TEST(thread_attributes, custom_stack)
+{
+    const std::size_t stackSize = 128 * 1024;
+    std::unique_ptr<char[]> memory(new char[stackSize + 4096]);
+    char* stack = reinterpret_cast<char*>(
+            (reinterpret_cast<std::uintptr_t>(memory.get()) + 4095)
+            & ~std::uintptr_t(4095));
+
+    Observed observed;
+    weos::thread::attributes attrs;
+    attrs.setStack(stack, stackSize);
+    weos::thread t(attrs, &observe, &observed);
+    t.join();
+
+    ASSERT_TRUE(observed.stackAddress == stack);
+    ASSERT_EQ(stackSize, observed.stackSize);
+    ASSERT_TRUE(static_cast<char*>(observed.localAddress) > stack);
+    ASSERT_TRUE(static_cast<char*>(observed.localAddress) < stack + stackSize);
+}
+
+TEST(thread_attributes, cpu_affinity)
+{
+    cpu_set_t available;
+    pthread_getaffinity_np(pthread_self(), sizeof(available), &available);
+    int cpu = 0;
+    while (cpu < 64 && !CPU_ISSET(cpu, &available))
+        ++cpu;
+    ASSERT_LT(cpu, 64);
+
+    Observed observed;
+    weos::thread::attributes attrs;
+    attrs.setCpuAffinity(std::uint64_t(1) << cpu);
+    weos::thread t(attrs, &observe, &observed);
+    t.join();
+
+    ASSERT_EQ(1, observed.numCpus);
+    ASSERT_TRUE(CPU_ISSET(cpu, &observed.cpus));
+}
+
+TEST(thread_attributes, idle_priority)
+{
+    Observed observed;
+    weos::thread::attributes attrs;
+    attrs.setPriority(weos::thread::attributes::Idle);
+    weos::thread t(attrs, &observe, &observed);
+    t.join();
+
+    ASSERT_EQ(SCHED_IDLE, observed.policy);
+}
+
+TEST(thread_attributes, time_sharing_priorities_map_to_nice_values)
+{
+    // A nice value is only applied if it is higher than the inherited one.
+    Observed self;
+    observe(&self);
+
+    Observed low;
+    weos::thread t1(weos::thread::attributes().setPriority(
+                        weos::thread::attributes::Low),
+                    &observe, &low);
+    t1.join();
+
+    Observed belowNormal;
+    weos::thread t2(weos::thread::attributes().setPriority(
+                        weos::thread::attributes::BelowNormal),
+                    &observe, &belowNormal);
+    t2.join();
+
+    Observed normal;
+    weos::thread t3(weos::thread::attributes().setPriority(
+                        weos::thread::attributes::Normal),
+                    &observe, &normal);
+    t3.join();
+
+    ASSERT_EQ(SCHED_OTHER, low.policy);
+    ASSERT_EQ(SCHED_OTHER, belowNormal.policy);
+    ASSERT_EQ(SCHED_OTHER, normal.policy);
+    ASSERT_EQ(std::max(10, self.nice), low.nice);
+    ASSERT_EQ(std::max(5, self.nice), belowNormal.nice);
+    ASSERT_EQ(self.nice, normal.nice);
+}
+
+TEST(thread_attributes, real_time_priority)
+{
+    if (!realTimeIsPermitted())
+    {
+        std::printf("SCHED_FIFO is not permitted. Skipping the test.\n");
+        return;
+    }
+
+    Observed high;
+    weos::thread t1(weos::thread::attributes().setPriority(
+                        weos::thread::attributes::High),
+                    &observe, &high);
+    t1.join();
+
+    Observed realtime;
+    weos::thread t2(weos::thread::attributes().setPriority(
+                        weos::thread::attributes::Realtime),
+                    &observe, &realtime);
+    t2.join();
+
+    ASSERT_EQ(SCHED_FIFO, high.policy);
+    ASSERT_EQ(SCHED_FIFO, realtime.policy);
+    ASSERT_GT(high.priority, sched_get_priority_min(SCHED_FIFO));
+    ASSERT_LT(high.priority, realtime.priority);
+    ASSERT_EQ(sched_get_priority_max(SCHED_FIFO), realtime.priority);
+}
+
+TEST(thread_attributes, signals)
+{
+    Observed observed;
+    weos::thread t(weos::thread::attributes(), &waitForSignal, &observed);
+    t.set_signals(0x21);
+    t.join();
+
+    ASSERT_EQ(0x21u, observed.signals);
+}
+
+TEST(thread_attributes, move)
+{
+    Observed observed;
+    weos::thread t1(weos::thread::attributes().setName("moved"),
+                    &observe, &observed);
+    weos::thread::id id = t1.get_id();
+    weos::thread t2(std::move(t1));
+    ASSERT_FALSE(t1.joinable());
+    ASSERT_TRUE(t2.joinable());
+    ASSERT_TRUE(id == t2.get_id());
+
+    weos::thread t3;
+    t3 = std::move(t2);
+    ASSERT_FALSE(t2.joinable());
+    t3.join();
+
+    ASSERT_TRUE(id == observed.id);
+    ASSERT_STREQ("moved", observed.name);
+}
+
+TEST(thread_attributes, detach)
+{
+    // The semaphore outlives the detached thread.
+    static weos::semaphore sem;
+    weos::thread t(weos::thread::attributes(), &postSemaphore, &sem);
+    t.detach();
+    ASSERT_FALSE(t.joinable());
+    ASSERT_TRUE(weos::thread::id() == t.get_id());
+    sem.wait();
+}
+
+TEST(thread_attributes, stack_usage)
+{
+    Stack shallowStack;
+    std::size_t shallowWatermark = 0;
+    weos::thread shallow(weos::thread::attributes()
+                             .setStack(shallowStack.begin, STACK_SIZE)
+                             .setStackPainting(true),
+                         &useStack, 1, &shallowWatermark);
+    shallow.join();
+
+    Stack deepStack;
+    std::size_t deepWatermark = 0;
+    weos::thread deep(weos::thread::attributes()
+                          .setStack(deepStack.begin, STACK_SIZE)
+                          .setStackPainting(true),
+                      &useStack, 12, &deepWatermark);
+    deep.join();
+
+    // The usage can only grow after the watermark has been taken.
+    ASSERT_LE(shallowWatermark, shallow.stack_usage());
+    ASSERT_LE(deepWatermark, deep.stack_usage());
+    ASSERT_LT(shallow.stack_usage(), STACK_SIZE);
+    ASSERT_LT(deep.stack_usage(), STACK_SIZE);
+
+    ASSERT_GE(deepWatermark, shallowWatermark + 11 * 1024);
+}
+
+TEST(thread_attributes, stack_usage_of_running_thread)
+{
+    Stack stack;
+    Observed observed;
+    weos::thread t(weos::thread::attributes()
+                       .setStack(stack.begin, STACK_SIZE)
+                       .setStackPainting(true),
+                   &waitForSignal, &observed);
+    std::size_t usage = t.stack_usage();
+    ASSERT_LT(usage, STACK_SIZE);
+    t.set_signals(1);
+    t.join();
+    ASSERT_GE(t.stack_usage(), usage);
+}
+
+#endif // WEOS_WRAP_CXX11 && __linux__
+
+#if defined(WEOS_WRAP_KEIL_CMSIS_RTOS)
+
+#include <cstddef>
+#include <cstdint>
+
+namespace
+{
+
+//! Recurses \p depth times with 64 bytes of stack per call.
+void recurse(int depth)
+{
+    volatile char buffer[64];
+    for (std::size_t i = 0; i < sizeof(buffer); ++i)
+        buffer[i] = char(i);
+    if (depth > 1)
+        recurse(depth - 1);
+    buffer[0] = buffer[1];
+}
+
+//! Uses some stack when \p go is posted and posts \p done afterwards.
+//! Returns when \p finish is posted.
+void useStackOnDemand(weos::semaphore* go, weos::semaphore* done,
+                      weos::semaphore* finish)
+{
+    go->wait();
+    recurse(8);
+    done->post();
+    finish->wait();
+}
+
+} // anonymous namespace
+
+TEST(thread_attributes, stack_usage)
+{
+    static std::uint32_t stack[256];
+    weos::semaphore go;
+    weos::semaphore done;
+    weos::semaphore finish;
+    weos::thread t(weos::thread::attributes()
+                       .setStack(stack, sizeof(stack))
+                       .setStackPainting(true),
+                   &useStackOnDemand, &go, &done, &finish);
+
+    // The thread data is released by join(), so the usage is measured
+    // while the thread is blocked.
+    weos::this_thread::sleep_for(weos::chrono::milliseconds(1));
+    std::size_t idleUsage = t.stack_usage();
+    ASSERT_LT(idleUsage, sizeof(stack));
+
+    go.post();
+    done.wait();
+    ASSERT_GE(t.stack_usage(), idleUsage + 8 * 64);
+    ASSERT_LT(t.stack_usage(), sizeof(stack));
+
+    finish.post();
+    t.join();
+}
+
+#endif // WEOS_WRAP_KEIL_CMSIS_RTOS
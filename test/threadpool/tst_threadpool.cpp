@@ -0,0 +1,246 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <threadpool.hpp>
+
+#include <atomic.hpp>
+#include <functional.hpp>
+#include <semaphore.hpp>
+
+#include "gtest/gtest.h"
+
+namespace
+{
+
+void increment(weos::atomic_int* counter)
+{
+    counter->fetch_add(1);
+}
+
+void blockOn(weos::semaphore* gate, weos::semaphore* started)
+{
+    started->post();
+    gate->wait();
+}
+
+typedef weos::thread_pool<3, 16> test_pool;
+
+// Submits \p count tasks from within a task, so they go to the deque of
+// the calling worker.
+void fanOut(test_pool* pool, weos::atomic_int* counter, int count)
+{
+    for (int idx = 0; idx < count; ++idx)
+        pool->submit(weos::bind(&increment, counter));
+}
+
+typedef weos::thread_pool<1, 2> small_pool;
+
+void throwInt()
+{
+    throw 42;
+}
+
+void postTo(weos::semaphore* s)
+{
+    s->post();
+}
+
+// Fills the \p pool with a throwing task and makes the worker execute it
+// inline in submit(). The slot of the throwing task must be reusable.
+void submitAfterThrowingTask(small_pool* pool, weos::semaphore* done)
+{
+    pool->submit(&throwInt);
+    try
+    {
+        pool->submit(&throwInt);
+    }
+    catch (int)
+    {
+    }
+    pool->submit(weos::bind(&postTo, done));
+}
+
+#if defined(WEOS_WRAP_CXX11)
+// A task whose copy constructor throws while \p throwOnCopy is set.
+struct ThrowingCopy
+{
+    static bool throwOnCopy;
+
+    explicit ThrowingCopy(weos::atomic_int* counter)
+        : m_counter(counter)
+    {
+    }
+
+    ThrowingCopy(const ThrowingCopy& other)
+        : m_counter(other.m_counter)
+    {
+        if (throwOnCopy)
+            throw 42;
+    }
+
+    void operator()()
+    {
+        increment(m_counter);
+    }
+
+    weos::atomic_int* m_counter;
+};
+
+bool ThrowingCopy::throwOnCopy = false;
+#endif // WEOS_WRAP_CXX11
+
+} // anonymous namespace
+
+TEST(work_stealing_deque, take_and_steal)
+{
+    typedef weos::detail::work_stealing_deque<4> deque_type;
+    deque_type deque;
+    ASSERT_TRUE(deque.seems_empty());
+    ASSERT_EQ(deque_type::empty, deque.take());
+    ASSERT_EQ(deque_type::empty, deque.steal());
+
+    // The owner works LIFO, thieves work FIFO.
+    deque.push(1);
+    deque.push(2);
+    deque.push(3);
+    ASSERT_FALSE(deque.seems_empty());
+    ASSERT_EQ(3, deque.take());
+    ASSERT_EQ(1, deque.steal());
+    ASSERT_EQ(2, deque.take());
+    ASSERT_EQ(deque_type::empty, deque.take());
+    ASSERT_EQ(deque_type::empty, deque.steal());
+    ASSERT_TRUE(deque.seems_empty());
+
+    // Wrap around the ring buffer a few times.
+    for (int round = 0; round < 10; ++round)
+    {
+        for (int idx = 0; idx < 4; ++idx)
+            deque.push(idx);
+        ASSERT_EQ(0, deque.steal());
+        ASSERT_EQ(3, deque.take());
+        ASSERT_EQ(1, deque.steal());
+        ASSERT_EQ(2, deque.take());
+        ASSERT_TRUE(deque.seems_empty());
+    }
+}
+
+TEST(thread_pool, construct_and_destruct)
+{
+    test_pool pool;
+    ASSERT_EQ(3u, pool.num_workers());
+    ASSERT_EQ(16u, pool.capacity());
+}
+
+TEST(thread_pool, submit)
+{
+    weos::atomic_int counter(0);
+    {
+        test_pool pool;
+        for (int idx = 0; idx < 1000; ++idx)
+            pool.submit(weos::bind(&increment, &counter));
+    }
+    ASSERT_EQ(1000, counter.load());
+}
+
+TEST(thread_pool, submit_from_task)
+{
+    weos::atomic_int counter(0);
+    {
+        test_pool pool;
+        for (int idx = 0; idx < 10; ++idx)
+            pool.submit(weos::bind(&fanOut, &pool, &counter, 10));
+    }
+    ASSERT_EQ(100, counter.load());
+}
+
+TEST(thread_pool, try_submit_when_full)
+{
+    weos::semaphore gate;
+    weos::semaphore started;
+    weos::atomic_int counter(0);
+    {
+        weos::thread_pool<1, 4> pool;
+        ASSERT_TRUE(pool.try_submit(weos::bind(&blockOn, &gate, &started)));
+        started.wait();
+
+        // The blocked task still occupies its slot.
+        for (int idx = 0; idx < 3; ++idx)
+            ASSERT_TRUE(pool.try_submit(weos::bind(&increment, &counter)));
+        ASSERT_FALSE(pool.try_submit(weos::bind(&increment, &counter)));
+        ASSERT_EQ(0, counter.load());
+
+        gate.post();
+        // The slots become free again.
+        pool.submit(weos::bind(&increment, &counter));
+    }
+    ASSERT_EQ(4, counter.load());
+}
+
+TEST(thread_pool, destructor_drains_tasks)
+{
+    weos::semaphore gate;
+    weos::semaphore started;
+    weos::atomic_int counter(0);
+    {
+        weos::thread_pool<2, 8> pool;
+        pool.submit(weos::bind(&blockOn, &gate, &started));
+        pool.submit(weos::bind(&blockOn, &gate, &started));
+        started.wait();
+        started.wait();
+        for (int idx = 0; idx < 6; ++idx)
+            pool.submit(weos::bind(&increment, &counter));
+        gate.post(2);
+    }
+    ASSERT_EQ(6, counter.load());
+}
+
+TEST(thread_pool, throwing_task_frees_its_slot)
+{
+    weos::semaphore done;
+    small_pool pool;
+    pool.submit(weos::bind(&submitAfterThrowingTask, &pool, &done));
+    ASSERT_TRUE(done.try_wait_for(weos::chrono::seconds(1)));
+}
+
+#if defined(WEOS_WRAP_CXX11)
+TEST(thread_pool, throwing_copy_frees_its_slot)
+{
+    weos::atomic_int counter(0);
+    {
+        weos::thread_pool<1, 1> pool;
+        weos::function<void()> task = ThrowingCopy(&counter);
+        ThrowingCopy::throwOnCopy = true;
+        EXPECT_THROW(pool.try_submit(task), int);
+        ThrowingCopy::throwOnCopy = false;
+
+        // The slot of the failed submission must be free again.
+        ASSERT_TRUE(pool.try_submit(task));
+    }
+    ASSERT_EQ(1, counter.load());
+}
+#endif // WEOS_WRAP_CXX11
@@ -0,0 +1,182 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <config.hpp>
+#include <common/waiter_queue.hpp>
+
+#include "gtest/gtest.h"
+
+using weos::detail::waiter_queue;
+using weos::detail::waiter_queue_hook;
+
+namespace
+{
+
+struct Waiter : public waiter_queue_hook
+{
+    Waiter()
+        : id(0)
+    {
+    }
+
+    int id;
+};
+
+// Pops all waiters from the queue and checks that their ids match the
+// expected ones.
+void expectOrder(waiter_queue& queue, const int* ids, int numIds)
+{
+    for (int idx = 0; idx < numIds; ++idx)
+    {
+        waiter_queue_hook* hook = queue.pop_front();
+        ASSERT_TRUE(hook != 0);
+        ASSERT_EQ(ids[idx], static_cast<Waiter*>(hook)->id);
+        ASSERT_FALSE(hook->queued);
+        ASSERT_TRUE(hook->next == 0);
+    }
+    ASSERT_TRUE(queue.empty());
+}
+
+} // anonymous namespace
+
+TEST(waiter_queue, Constructor)
+{
+    waiter_queue queue;
+    ASSERT_TRUE(queue.empty());
+    ASSERT_TRUE(queue.front() == 0);
+    ASSERT_TRUE(queue.pop_front() == 0);
+    ASSERT_TRUE(queue.take_all() == 0);
+}
+
+TEST(waiter_queue, push_back_and_pop_front)
+{
+    Waiter waiters[5];
+    waiter_queue queue;
+    for (int idx = 0; idx < 5; ++idx)
+    {
+        waiters[idx].id = idx;
+        queue.push_back(waiters[idx]);
+        ASSERT_TRUE(waiters[idx].queued);
+        ASSERT_FALSE(queue.empty());
+        ASSERT_TRUE(queue.front() == &waiters[0]);
+    }
+
+    const int expected[] = {0, 1, 2, 3, 4};
+    expectOrder(queue, expected, 5);
+}
+
+TEST(waiter_queue, remove)
+{
+    Waiter waiters[5];
+    waiter_queue queue;
+    for (int idx = 0; idx < 5; ++idx)
+    {
+        waiters[idx].id = idx;
+        queue.push_back(waiters[idx]);
+    }
+
+    // Remove from the middle, the front and the back.
+    queue.remove(waiters[2]);
+    ASSERT_FALSE(waiters[2].queued);
+    queue.remove(waiters[0]);
+    ASSERT_TRUE(queue.front() == &waiters[1]);
+    queue.remove(waiters[4]);
+
+    // The tail must have been updated, so appending works again.
+    queue.push_back(waiters[0]);
+
+    const int expected[] = {1, 3, 0};
+    expectOrder(queue, expected, 3);
+}
+
+TEST(waiter_queue, remove_only_waiter)
+{
+    Waiter w;
+    waiter_queue queue;
+    queue.push_back(w);
+    queue.remove(w);
+    ASSERT_TRUE(queue.empty());
+    ASSERT_FALSE(w.queued);
+
+    // The waiter can be enqueued again.
+    queue.push_back(w);
+    ASSERT_TRUE(queue.front() == &w);
+    queue.pop_front();
+    ASSERT_TRUE(queue.empty());
+}
+
+TEST(waiter_queue, take_all)
+{
+    Waiter waiters[4];
+    waiter_queue queue;
+    for (int idx = 0; idx < 4; ++idx)
+    {
+        waiters[idx].id = idx;
+        queue.push_back(waiters[idx]);
+    }
+
+    waiter_queue_hook* chain = queue.take_all();
+    ASSERT_TRUE(queue.empty());
+
+    // The waiters are chained in FIFO order and none of them is queued.
+    int count = 0;
+    for (waiter_queue_hook* iter = chain; iter; iter = iter->next, ++count)
+    {
+        ASSERT_EQ(count, static_cast<Waiter*>(iter)->id);
+        ASSERT_FALSE(iter->queued);
+    }
+    ASSERT_EQ(4, count);
+
+    // New waiters do not disturb the detached chain.
+    Waiter late;
+    late.id = 42;
+    queue.push_back(late);
+    ASSERT_TRUE(waiters[3].next == 0);
+    ASSERT_TRUE(queue.pop_front() == &late);
+}
+
+TEST(waiter_queue, interleaved)
+{
+    Waiter waiters[8];
+    waiter_queue queue;
+    for (int idx = 0; idx < 8; ++idx)
+        waiters[idx].id = idx;
+
+    queue.push_back(waiters[0]);
+    queue.push_back(waiters[1]);
+    queue.push_back(waiters[2]);
+    ASSERT_EQ(0, static_cast<Waiter*>(queue.pop_front())->id);
+    queue.push_back(waiters[3]);
+    queue.remove(waiters[3]);
+    queue.push_back(waiters[4]);
+    queue.remove(waiters[1]);
+    queue.push_back(waiters[5]);
+
+    const int expected[] = {2, 4, 5};
+    expectOrder(queue, expected, 3);
+}
@@ -0,0 +1,282 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2014, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <waitset.hpp>
+#include <messagequeue.hpp>
+#include <semaphore.hpp>
+#include <thread.hpp>
+
+#include "gtest/gtest.h"
+
+namespace
+{
+
+void delayedSend(weos::message_queue<int, 4>* queue, int value)
+{
+    weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+    queue->send(value);
+}
+
+void delayedPost(weos::semaphore* sem)
+{
+    weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+    sem->post();
+}
+
+struct SignalWaiterData
+{
+    SignalWaiterData()
+        : ready(false),
+          index(-1),
+          signals(0)
+    {
+    }
+
+    weos::semaphore started;
+    weos::message_queue<int, 4> queue;
+    volatile bool ready;
+    volatile int index;
+    volatile weos::thread::signal_set signals;
+};
+
+void signalWaiter(SignalWaiterData* data)
+{
+    weos::wait_set set;
+    set.add(data->queue);
+    set.add_signals(0x0C);
+    data->started.post();
+
+    std::size_t index = set.wait_any();
+    data->index = int(index);
+    if (index == 1)
+        data->signals = weos::this_thread::try_wait_for_any_signal();
+}
+
+} // anonymous namespace
+
+TEST(wait_set, Constructor)
+{
+    weos::wait_set set;
+    ASSERT_EQ(0u, set.size());
+    ASSERT_FALSE(set.try_wait_any());
+}
+
+TEST(wait_set, add)
+{
+    weos::message_queue<int, 4> queue1;
+    weos::message_queue<int, 4, weos::spsc_tag> queue2;
+    weos::message_queue<int, 4, weos::mpmc_tag> queue3;
+    weos::semaphore sem;
+
+    weos::wait_set set;
+    ASSERT_EQ(0u, set.add(queue1));
+    ASSERT_EQ(1u, set.add(queue2));
+    ASSERT_EQ(2u, set.add(queue3));
+    ASSERT_EQ(3u, set.add(sem));
+    ASSERT_EQ(4u, set.size());
+    ASSERT_FALSE(set.try_wait_any());
+}
+
+TEST(wait_set, try_wait_any)
+{
+    weos::message_queue<int, 4> queue1;
+    weos::message_queue<int, 4, weos::spsc_tag> queue2;
+    weos::message_queue<int, 4, weos::mpmc_tag> queue3;
+    weos::semaphore sem;
+
+    weos::wait_set set;
+    set.add(queue1);
+    set.add(queue2);
+    set.add(queue3);
+    set.add(sem);
+
+    queue2.send(2);
+    weos::optional<std::size_t> index = set.try_wait_any();
+    ASSERT_TRUE(index.has_value());
+    ASSERT_EQ(1u, *index);
+    // Waiting does not consume the element.
+    ASSERT_TRUE(set.try_wait_any().has_value());
+    ASSERT_EQ(2, *queue2.try_receive());
+    ASSERT_FALSE(set.try_wait_any());
+
+    queue3.send(3);
+    index = set.try_wait_any();
+    ASSERT_TRUE(index.has_value());
+    ASSERT_EQ(2u, *index);
+    ASSERT_EQ(3, *queue3.try_receive());
+
+    sem.post();
+    index = set.try_wait_any();
+    ASSERT_TRUE(index.has_value());
+    ASSERT_EQ(3u, *index);
+    ASSERT_TRUE(sem.try_wait());
+
+    queue1.send(1);
+    index = set.try_wait_any();
+    ASSERT_TRUE(index.has_value());
+    ASSERT_EQ(0u, *index);
+    ASSERT_EQ(1, *queue1.try_receive());
+    ASSERT_FALSE(set.try_wait_any());
+}
+
+TEST(wait_set, ready_sources_take_turns)
+{
+    weos::message_queue<int, 4> queue1;
+    weos::message_queue<int, 4> queue2;
+    queue1.send(1);
+    queue2.send(2);
+
+    weos::wait_set set;
+    set.add(queue1);
+    set.add(queue2);
+
+    for (int count = 0; count < 5; ++count)
+    {
+        ASSERT_EQ(0u, set.wait_any());
+        ASSERT_EQ(1u, set.wait_any());
+    }
+}
+
+TEST(wait_set, try_wait_any_for_times_out)
+{
+    weos::message_queue<int, 4> queue;
+    weos::semaphore sem;
+
+    weos::wait_set set;
+    set.add(queue);
+    set.add(sem);
+
+    weos::chrono::steady_clock::time_point start
+            = weos::chrono::steady_clock::now();
+    ASSERT_FALSE(set.try_wait_any_for(weos::chrono::milliseconds(20)));
+    ASSERT_TRUE(weos::chrono::steady_clock::now() - start
+                >= weos::chrono::milliseconds(20));
+}
+
+TEST(wait_set, wait_any_wakes_on_send)
+{
+    weos::message_queue<int, 4> queue1;
+    weos::message_queue<int, 4> queue2;
+    weos::semaphore sem;
+
+    weos::wait_set set;
+    set.add(queue1);
+    set.add(sem);
+    set.add(queue2);
+
+    weos::thread t(&delayedSend, &queue2, 42);
+    ASSERT_EQ(2u, set.wait_any());
+    ASSERT_EQ(42, *queue2.try_receive());
+    t.join();
+}
+
+TEST(wait_set, try_wait_any_for_wakes_on_post)
+{
+    weos::message_queue<int, 4> queue;
+    weos::semaphore sem;
+
+    weos::wait_set set;
+    set.add(queue);
+    set.add(sem);
+
+    weos::thread t(&delayedPost, &sem);
+    weos::optional<std::size_t> index
+            = set.try_wait_any_for(weos::chrono::seconds(5));
+    ASSERT_TRUE(index.has_value());
+    ASSERT_EQ(1u, *index);
+    ASSERT_TRUE(sem.try_wait());
+    t.join();
+}
+
+TEST(wait_set, wait_any_wakes_on_lock_free_queues)
+{
+    weos::message_queue<int, 4, weos::spsc_tag> queue1;
+    weos::message_queue<int, 4, weos::mpmc_tag> queue2;
+
+    weos::wait_set set;
+    set.add(queue1);
+    set.add(queue2);
+
+    weos::thread t1([&] {
+        weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+        queue2.send(2);
+    });
+    ASSERT_EQ(1u, set.wait_any());
+    ASSERT_EQ(2, *queue2.try_receive());
+    t1.join();
+
+    weos::thread t2([&] {
+        weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+        queue1.send(1);
+    });
+    ASSERT_EQ(0u, set.wait_any());
+    ASSERT_EQ(1, *queue1.try_receive());
+    t2.join();
+}
+
+TEST(wait_set, wait_any_wakes_on_signal)
+{
+    SignalWaiterData data;
+    weos::thread t(&signalWaiter, &data);
+    data.started.wait();
+
+    // A signal which is not selected does not wake the waiter.
+    t.set_signals(0x01);
+    weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+    ASSERT_EQ(-1, data.index);
+
+    t.set_signals(0x04);
+    t.join();
+    ASSERT_EQ(1, data.index);
+    ASSERT_EQ(0x05u, data.signals);
+}
+
+TEST(wait_set, destroyed_set_is_not_signalled)
+{
+    weos::message_queue<int, 4> queue1;
+    weos::message_queue<int, 4, weos::mpmc_tag> queue2;
+    weos::semaphore sem;
+    {
+        weos::wait_set set1;
+        set1.add(queue1);
+        set1.add(queue2);
+        set1.add(sem);
+
+        weos::wait_set set2;
+        set2.add(queue1);
+        set2.add(queue2);
+        set2.add(sem);
+    }
+
+    queue1.send(1);
+    queue2.send(2);
+    sem.post();
+    ASSERT_EQ(1, *queue1.try_receive());
+    ASSERT_EQ(2, *queue2.try_receive());
+    ASSERT_TRUE(sem.try_wait());
+}